@@ -0,0 +1,6 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AbilityDefinition.h"
+
+const FPrimaryAssetType UAbilityDefinition::PrimaryAssetType(TEXT("Ability"));
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "CombatAISubsystem.h"
+#include "AbilityDefinition.generated.h"
+
+class UNiagaraSystem;
+
+/**
+ * An ability a unit can use, registered with the Asset Manager as an "Ability" primary asset.
+ * Cosmetic assets are soft references in the "FX" bundle, which dedicated servers never load.
+ */
+UCLASS(BlueprintType)
+class NECROMANCER_API UAbilityDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	static const FPrimaryAssetType PrimaryAssetType;
+
+	virtual FPrimaryAssetId GetPrimaryAssetId() const override { return FPrimaryAssetId(PrimaryAssetType, GetFName()); }
+
+	/** How UCombatAISubsystem scores and applies this ability */
+	UPROPERTY(EditDefaultsOnly, Category = Ability)
+	FCombatAIAbility AI;
+
+	/** Index into UProjectileSubsystem::ProjectileTypes fired on use, or none */
+	UPROPERTY(EditDefaultsOnly, Category = Ability)
+	int32 ProjectileType = INDEX_NONE;
+
+	UPROPERTY(EditDefaultsOnly, Category = FX, meta = (AssetBundles = "FX"))
+	TSoftObjectPtr<UNiagaraSystem> CastFX;
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BenchmarkWorld.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/WorldSettings.h"
+#include "HAL/PlatformTime.h"
+
+FBenchmarkWorld::FBenchmarkWorld()
+{
+	World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("NecroBenchmarkWorld"));
+	FWorldContext& Context = GEngine->CreateNewWorldContext(EWorldType::Game);
+	Context.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+}
+
+FBenchmarkWorld::~FBenchmarkWorld()
+{
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+void FBenchmarkWorld::BeginPlay()
+{
+	World->BeginPlay();
+
+	// Without a game mode nothing tells the actors to begin play
+	if (!World->GetBegunPlay())
+	{
+		World->GetWorldSettings()->NotifyBeginPlay();
+	}
+}
+
+double FBenchmarkWorld::Tick(float DeltaSeconds)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	World->Tick(LEVELTICK_All, DeltaSeconds);
+	return FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+}
+
+double FBenchmarkFrameTimes::GetAverage() const
+{
+	double Total = 0.0;
+	for (const double Sample : Samples)
+	{
+		Total += Sample;
+	}
+	return Samples.Num() > 0 ? Total / Samples.Num() : 0.0;
+}
+
+double FBenchmarkFrameTimes::GetPercentile(int32 Percent) const
+{
+	if (Samples.Num() == 0)
+	{
+		return 0.0;
+	}
+
+	TArray<double> Sorted(Samples);
+	Sorted.Sort();
+	return Sorted[FMath::Min(Sorted.Num() * Percent / 100, Sorted.Num() - 1)];
+}
+
+double FBenchmarkFrameTimes::GetMax() const
+{
+	return Samples.Num() > 0 ? FMath::Max(Samples) : 0.0;
+}
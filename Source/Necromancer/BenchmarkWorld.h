@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+/**
+ * An empty game world of its own, for benchmarks run from commandlets and console commands. They spawn into and
+ * tick this world instead of the one being played, which is left untouched. World subsystems are created as for a
+ * game; actors spawned before BeginPlay begin play with it, later ones on spawn. Destroyed with the object.
+ */
+class NECROMANCER_API FBenchmarkWorld : public FNoncopyable
+{
+public:
+	FBenchmarkWorld();
+	~FBenchmarkWorld();
+
+	UWorld* Get() const { return World; }
+
+	/** Begins play for the world's subsystems and actors */
+	void BeginPlay();
+
+	/** Ticks the whole world once, as a frame of DeltaSeconds would. Returns the game thread milliseconds it took. */
+	double Tick(float DeltaSeconds);
+
+private:
+	UWorld* World = nullptr;
+};
+
+/** Milliseconds of the frames of a benchmark run */
+struct NECROMANCER_API FBenchmarkFrameTimes
+{
+	void Add(double Milliseconds) { Samples.Add(Milliseconds); }
+	void Reset() { Samples.Reset(); }
+	int32 Num() const { return Samples.Num(); }
+
+	double GetAverage() const;
+	double GetPercentile(int32 Percent) const;
+	double GetMax() const;
+
+private:
+	TArray<double> Samples;
+};
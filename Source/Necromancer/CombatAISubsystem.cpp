@@ -0,0 +1,395 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatAISubsystem.h"
+#include "CombatPawn.h"
+#include "CombatManagerComponent.h"
+#include "CombatSubsystem.h"
+#include "UnitSignificanceSubsystem.h"
+#include "VisibilitySubsystem.h"
+#include "NecromancerStats.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+
+DECLARE_CYCLE_STAT(TEXT("Combat AI"), STAT_CombatAI, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Combat AI Score"), STAT_CombatAIScore, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat AI Agents"), STAT_CombatAIAgents, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat AI Pending Decisions"), STAT_CombatAIPending, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat AI Decisions/Frame"), STAT_CombatAIDecisions, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat AI Budget Overruns"), STAT_CombatAIOverruns, STATGROUP_Necromancer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Combat AI Overrun (ms)"), STAT_CombatAIOverrunMs, STATGROUP_Necromancer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Combat AI Latency P50 (ms)"), STAT_CombatAILatencyP50, STATGROUP_Necromancer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Combat AI Latency P95 (ms)"), STAT_CombatAILatencyP95, STATGROUP_Necromancer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Combat AI Latency P99 (ms)"), STAT_CombatAILatencyP99, STATGROUP_Necromancer);
+
+namespace CombatAI
+{
+	// Agents decided between two budget checks
+	constexpr int32 BatchSize = 64;
+
+	// Agents scored by one parallel task
+	constexpr int32 ScoreTaskSize = 16;
+
+	// Recent decisions kept for the latency percentiles
+	constexpr int32 LatencyWindow = 1024;
+
+	// Tier assumed for pawns the significance subsystem does not know
+	constexpr int32 UnknownTier = 3;
+}
+
+void UCombatAISubsystem::Deinitialize()
+{
+	AgentPawn.Empty();
+	DueTime.Empty();
+	Priority.Empty();
+	PawnToAgent.Empty();
+	DueAgents.Empty();
+	Latencies.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UCombatAISubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCombatAISubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatAISubsystem, STATGROUP_Tickables);
+}
+
+UCombatSubsystem* UCombatAISubsystem::GetCombatSubsystem() const
+{
+	return GetWorld()->GetSubsystem<UCombatSubsystem>();
+}
+
+void UCombatAISubsystem::RegisterPawn(ACombatPawn* InPawn)
+{
+	if (!InPawn || PawnToAgent.Contains(InPawn))
+	{
+		return;
+	}
+
+	// Spread first decisions over an interval, so pawns spawned together do not stay in lockstep
+	const int32 Index = AgentPawn.Add(InPawn);
+	DueTime.Add(GetWorld()->GetTimeSeconds() + FMath::FRand() * DecisionInterval);
+	Priority.Add(0.f);
+	PawnToAgent.Add(InPawn, Index);
+}
+
+void UCombatAISubsystem::UnregisterPawn(ACombatPawn* InPawn)
+{
+	if (const int32* Index = PawnToAgent.Find(InPawn))
+	{
+		RemoveAgent(*Index);
+	}
+}
+
+void UCombatAISubsystem::RemoveAgent(int32 Index)
+{
+	PawnToAgent.Remove(AgentPawn[Index]);
+
+	AgentPawn.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	DueTime.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Priority.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	if (AgentPawn.IsValidIndex(Index))
+	{
+		PawnToAgent[AgentPawn[Index]] = Index;
+	}
+}
+
+void UCombatAISubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	NECRO_SCOPE(STAT_CombatAI, AI);
+
+	UCombatSubsystem* Combat = GetCombatSubsystem();
+	if (!Combat || GetWorld()->GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	Prioritize(*Combat, Now);
+
+	// Whole batches until the budget is spent; the first always runs so the most urgent pawns make progress
+	const double StartTime = FPlatformTime::Seconds();
+	const double BudgetSeconds = FrameBudgetMs / 1000.0;
+	double Elapsed = 0.0;
+	int32 NumDecided = 0;
+	while (NumDecided < DueAgents.Num() && (NumDecided == 0 || Elapsed < BudgetSeconds))
+	{
+		const int32 Num = FMath::Min(CombatAI::BatchSize, DueAgents.Num() - NumDecided);
+		GatherBatch(*Combat, NumDecided, Num);
+		ScoreBatch(*Combat);
+		ApplyBatch(*Combat, Now);
+
+		NumDecided += Num;
+		Elapsed = FPlatformTime::Seconds() - StartTime;
+	}
+
+	const bool bOverrun = Elapsed > BudgetSeconds;
+	if (bOverrun)
+	{
+		++NumOverruns;
+	}
+	SET_FLOAT_STAT(STAT_CombatAIOverrunMs, bOverrun ? (Elapsed - BudgetSeconds) * 1000.0 : 0.0);
+	SET_DWORD_STAT(STAT_CombatAIDecisions, NumDecided);
+	UpdateStats(DueAgents.Num() - NumDecided);
+}
+
+void UCombatAISubsystem::Prioritize(const UCombatSubsystem& Combat, double Now)
+{
+	const FCombatSimulation& Simulation = Combat.GetSimulation();
+	const UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>();
+	const float EngagedDistanceSq = FMath::Square(CandidateRadius * 0.5f);
+
+	// Drop destroyed pawns first, so the swaps cannot move an agent already in DueAgents
+	for (int32 Index = AgentPawn.Num() - 1; Index >= 0; --Index)
+	{
+		if (!AgentPawn[Index].IsValid())
+		{
+			RemoveAgent(Index);
+		}
+	}
+
+	DueAgents.Reset();
+	for (int32 Index = 0; Index < AgentPawn.Num(); ++Index)
+	{
+		const ACombatPawn* AgentActor = AgentPawn[Index].Get();
+		if (DueTime[Index] > Now || AgentActor->IsPlayerControlled())
+		{
+			continue;
+		}
+
+		const FCombatHandle Handle = AgentActor->GetCombatComponent()->GetCombatHandle();
+		if (!Simulation.IsAlive(Handle))
+		{
+			continue;
+		}
+
+		// Near, visible pawns first; hurt or engaged ones sooner; anyone left waiting climbs steadily
+		const int32 Tier = Significance ? Significance->GetUnitTier(AgentActor) : INDEX_NONE;
+		const float SignificanceScore = 1.f / (1 + (Tier == INDEX_NONE ? CombatAI::UnknownTier : Tier));
+
+		const float MaxHealth = Simulation.GetMaxHealth(Handle);
+		float Threat = MaxHealth > 0.f ? 1.f - Simulation.GetHealth(Handle) / MaxHealth : 0.f;
+		const FCombatHandle Target = Simulation.GetTarget(Handle);
+		if (Simulation.IsAlive(Target) && FVector::DistSquared2D(Simulation.GetLocation(Handle), Simulation.GetLocation(Target)) <= EngagedDistanceSq)
+		{
+			Threat += 1.f;
+		}
+
+		const float Overdue = static_cast<float>(Now - DueTime[Index]) / FMath::Max(DecisionInterval, UE_KINDA_SMALL_NUMBER);
+		Priority[Index] = SignificanceScore * (1.f + ThreatWeight * Threat) + Overdue;
+		DueAgents.Add(Index);
+	}
+
+	DueAgents.Sort([this](int32 A, int32 B)
+	{
+		return Priority[A] > Priority[B];
+	});
+}
+
+void UCombatAISubsystem::GatherBatch(const UCombatSubsystem& Combat, int32 First, int32 Num)
+{
+	const FCombatSimulation& Simulation = Combat.GetSimulation();
+
+	BatchAgent.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchCombatant.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchLocation.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchTeam.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchCurrentTarget.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchAbilityStart.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchAbilityNum.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchChosenTarget.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchChosenAbility.SetNumUninitialized(Num, EAllowShrinking::No);
+	BatchAbilities.Reset();
+
+	for (int32 Entry = 0; Entry < Num; ++Entry)
+	{
+		const int32 Agent = DueAgents[First + Entry];
+		const ACombatPawn* AgentActor = AgentPawn[Agent].Get();
+		const UCombatManagerComponent* CombatComponent = AgentActor->GetCombatComponent();
+		const FCombatHandle Handle = CombatComponent->GetCombatHandle();
+
+		BatchAgent[Entry] = Agent;
+		BatchCombatant[Entry] = Handle;
+		BatchLocation[Entry] = Simulation.GetLocation(Handle);
+		BatchTeam[Entry] = Simulation.GetTeam(Handle);
+		BatchCurrentTarget[Entry] = Simulation.GetTarget(Handle);
+
+		// Cooldowns live in a map on the component, so only ready abilities are handed to the scoring pass
+		BatchAbilityStart[Entry] = BatchAbilities.Num();
+		for (const FCombatAIAbility& Ability : AgentActor->Abilities)
+		{
+			if (!CombatComponent->IsOnCooldown(Ability.StatusEffect))
+			{
+				BatchAbilities.Add(Ability);
+			}
+		}
+		BatchAbilityNum[Entry] = BatchAbilities.Num() - BatchAbilityStart[Entry];
+	}
+}
+
+void UCombatAISubsystem::ScoreBatch(const UCombatSubsystem& Combat)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CombatAIScore);
+
+	const FCombatSimulation& Simulation = Combat.GetSimulation();
+	const UVisibilitySubsystem* Visibility = GetWorld()->GetSubsystem<UVisibilitySubsystem>();
+	const int32 Num = BatchAgent.Num();
+
+	// Reads simulation and visibility state only; every entry writes its own outputs
+	ParallelFor(FMath::DivideAndRoundUp(Num, CombatAI::ScoreTaskSize), [this, &Simulation, Visibility, Num](int32 TaskIndex)
+	{
+		const int32 Start = TaskIndex * CombatAI::ScoreTaskSize;
+		const int32 End = FMath::Min(Start + CombatAI::ScoreTaskSize, Num);
+		TArray<FCombatHandle, TInlineAllocator<16>> Candidates;
+
+		for (int32 Entry = Start; Entry < End; ++Entry)
+		{
+			const FCombatHandle Self = BatchCombatant[Entry];
+			const FVector& SelfLocation = BatchLocation[Entry];
+
+			FCombatSpatialQuery Query;
+			Query.Shape = ECombatQueryShape::Nearest;
+			Query.Origin = SelfLocation;
+			Query.Radius = CandidateRadius;
+			Query.TeamMask = CombatHostileTeamMask(BatchTeam[Entry]);
+			Query.MaxResults = MaxCandidates;
+			Candidates.Reset();
+			Simulation.Query(Query, Candidates);
+
+			FCombatHandle BestTarget;
+			float BestScore = -MAX_flt;
+			float BestDistance = 0.f;
+			for (const FCombatHandle& Candidate : Candidates)
+			{
+				// Nothing hidden by the fog of war is picked
+				const FVector CandidateLocation = Simulation.GetLocation(Candidate);
+				if (Visibility && !Visibility->IsVisibleToTeam(BatchTeam[Entry], CandidateLocation))
+				{
+					continue;
+				}
+
+				const float Distance = FVector::Dist2D(SelfLocation, CandidateLocation);
+				const float MaxHealth = Simulation.GetMaxHealth(Candidate);
+				const float HealthFraction = MaxHealth > 0.f ? Simulation.GetHealth(Candidate) / MaxHealth : 1.f;
+
+				float Score = ProximityWeight * (1.f - Distance / CandidateRadius) + LowHealthWeight * (1.f - HealthFraction);
+				if (Simulation.GetTarget(Candidate) == Self)
+				{
+					Score += RetaliationWeight;
+				}
+				if (Candidate == BatchCurrentTarget[Entry])
+				{
+					Score += CurrentTargetBonus;
+				}
+
+				if (Score > BestScore)
+				{
+					BestScore = Score;
+					BestTarget = Candidate;
+					BestDistance = Distance;
+				}
+			}
+			BatchChosenTarget[Entry] = BestTarget;
+
+			// Target abilities are not wasted on nearly dead enemies; self casts only make sense in a fight
+			int32 BestAbility = INDEX_NONE;
+			float BestAbilityScore = 0.f;
+			if (BestTarget.IsValid())
+			{
+				const float TargetMaxHealth = Simulation.GetMaxHealth(BestTarget);
+				const float TargetHealthFraction = TargetMaxHealth > 0.f ? Simulation.GetHealth(BestTarget) / TargetMaxHealth : 0.f;
+				for (int32 AbilityIndex = 0; AbilityIndex < BatchAbilityNum[Entry]; ++AbilityIndex)
+				{
+					const FCombatAIAbility& Ability = BatchAbilities[BatchAbilityStart[Entry] + AbilityIndex];
+					if (BestDistance > Ability.Range)
+					{
+						continue;
+					}
+
+					const float Score = Ability.Weight * (Ability.bSelfCast ? 1.f : TargetHealthFraction);
+					if (Score > BestAbilityScore)
+					{
+						BestAbilityScore = Score;
+						BestAbility = AbilityIndex;
+					}
+				}
+			}
+			BatchChosenAbility[Entry] = BestAbility;
+		}
+	});
+}
+
+void UCombatAISubsystem::ApplyBatch(UCombatSubsystem& Combat, double Now)
+{
+	FCombatSimulation& Simulation = Combat.GetSimulation();
+	FStatusEffectStore& StatusEffects = Combat.GetStatusEffects();
+
+	for (int32 Entry = 0; Entry < BatchAgent.Num(); ++Entry)
+	{
+		const int32 Agent = BatchAgent[Entry];
+		const FCombatHandle Self = BatchCombatant[Entry];
+
+		if (BatchChosenTarget[Entry].IsValid() && BatchChosenTarget[Entry] != BatchCurrentTarget[Entry])
+		{
+			Simulation.SetTarget(Self, BatchChosenTarget[Entry]);
+		}
+
+		if (BatchChosenAbility[Entry] != INDEX_NONE)
+		{
+			const FCombatAIAbility& Ability = BatchAbilities[BatchAbilityStart[Entry] + BatchChosenAbility[Entry]];
+			const int32 Definition = StatusEffects.FindDefinition(Ability.StatusEffect);
+			if (Definition != INDEX_NONE)
+			{
+				StatusEffects.Apply(Ability.bSelfCast ? Self : BatchChosenTarget[Entry], Self, Definition);
+				AgentPawn[Agent]->GetCombatComponent()->StartCooldown(Ability.StatusEffect, Ability.Cooldown);
+			}
+		}
+
+		// Ring buffer of recent latencies
+		const float Latency = static_cast<float>(Now - DueTime[Agent]);
+		if (Latencies.Num() < CombatAI::LatencyWindow)
+		{
+			Latencies.Add(Latency);
+		}
+		else
+		{
+			Latencies[NextLatency] = Latency;
+		}
+		NextLatency = (NextLatency + 1) % CombatAI::LatencyWindow;
+
+		DueTime[Agent] = Now + DecisionInterval;
+	}
+}
+
+void UCombatAISubsystem::UpdateStats(int32 NumPending)
+{
+	SET_DWORD_STAT(STAT_CombatAIAgents, AgentPawn.Num());
+	SET_DWORD_STAT(STAT_CombatAIPending, NumPending);
+	SET_DWORD_STAT(STAT_CombatAIOverruns, NumOverruns);
+
+#if STATS
+	if (Latencies.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<float, TInlineAllocator<CombatAI::LatencyWindow>> Sorted(Latencies);
+	Sorted.Sort();
+	auto Percentile = [&Sorted](int32 Percent)
+	{
+		return Sorted[FMath::Min(Sorted.Num() * Percent / 100, Sorted.Num() - 1)] * 1000.f;
+	};
+	SET_FLOAT_STAT(STAT_CombatAILatencyP50, Percentile(50));
+	SET_FLOAT_STAT(STAT_CombatAILatencyP95, Percentile(95));
+	SET_FLOAT_STAT(STAT_CombatAILatencyP99, Percentile(99));
+#endif
+}
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "CombatAISubsystem.generated.h"
+
+class ACombatPawn;
+class UCombatSubsystem;
+
+/** Status effect a combat pawn's AI may choose to use */
+USTRUCT(BlueprintType)
+struct FCombatAIAbility
+{
+	GENERATED_BODY()
+
+	/** Status effect from UCombatSubsystem's definitions. Also names the ability's cooldown. */
+	UPROPERTY(EditAnywhere, Category = AI)
+	FName StatusEffect;
+
+	/** Applied to the pawn itself while an enemy is in range, instead of to its target */
+	UPROPERTY(EditAnywhere, Category = AI)
+	bool bSelfCast = false;
+
+	UPROPERTY(EditAnywhere, Category = AI)
+	float Range = 600.f;
+
+	UPROPERTY(EditAnywhere, Category = AI)
+	float Cooldown = 10.f;
+
+	/** Scales this ability's score against the pawn's other abilities */
+	UPROPERTY(EditAnywhere, Category = AI)
+	float Weight = 1.f;
+};
+
+/**
+ * Chooses targets and abilities for combat pawns under a fixed budget per frame.
+ *
+ * A pawn asks for a decision every DecisionInterval. Due pawns are ordered by priority, which rises with their
+ * significance tier, the threat they are under and how long they have been waiting, and are then decided in
+ * batches until the frame budget is spent; the rest wait for the next frame. Each batch gathers its inputs
+ * on the game thread into flat arrays, scores candidate targets and abilities in parallel and applies the
+ * results on the game thread. Decision latency percentiles and budget overruns are shown by "stat Necromancer".
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UCombatAISubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterPawn(ACombatPawn* InPawn);
+	void UnregisterPawn(ACombatPawn* InPawn);
+
+	int32 GetNumAgents() const { return AgentPawn.Num(); }
+
+	/** Milliseconds of decisions per frame. The first batch of a frame always runs, so pawns are never starved. */
+	UPROPERTY(Config)
+	float FrameBudgetMs = 1.f;
+
+	/** Seconds between two decisions of the same pawn */
+	UPROPERTY(Config)
+	float DecisionInterval = 0.5f;
+
+	/** Hostiles within this distance are considered as targets */
+	UPROPERTY(Config)
+	float CandidateRadius = 1500.f;
+
+	/** Nearest hostiles scored per decision */
+	UPROPERTY(Config)
+	int32 MaxCandidates = 8;
+
+	/** Priority gained from being hurt or engaged, relative to significance */
+	UPROPERTY(Config)
+	float ThreatWeight = 1.f;
+
+	/** Target score weights */
+	UPROPERTY(Config)
+	float ProximityWeight = 1.f;
+
+	UPROPERTY(Config)
+	float LowHealthWeight = 0.5f;
+
+	UPROPERTY(Config)
+	float RetaliationWeight = 0.75f;
+
+	/** Bonus for keeping the current target, so decisions do not flip between equal candidates */
+	UPROPERTY(Config)
+	float CurrentTargetBonus = 0.25f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void RemoveAgent(int32 Index);
+
+	/** Fills DueAgents with the agents due for a decision, highest priority first */
+	void Prioritize(const UCombatSubsystem& Combat, double Now);
+
+	/** Decides Batch agents of DueAgents from First on */
+	void GatherBatch(const UCombatSubsystem& Combat, int32 First, int32 Num);
+	void ScoreBatch(const UCombatSubsystem& Combat);
+	void ApplyBatch(UCombatSubsystem& Combat, double Now);
+
+	void UpdateStats(int32 NumPending);
+
+	UCombatSubsystem* GetCombatSubsystem() const;
+
+	/** Agents, one entry per registered pawn */
+	TArray<TWeakObjectPtr<ACombatPawn>> AgentPawn;
+	TArray<double> DueTime;
+	TArray<float> Priority;
+	TMap<TWeakObjectPtr<ACombatPawn>, int32> PawnToAgent;
+
+	TArray<int32> DueAgents;
+
+	/** Inputs and outputs of the batch being decided, indexed by position in the batch */
+	TArray<int32> BatchAgent;
+	TArray<FCombatHandle> BatchCombatant;
+	TArray<FVector> BatchLocation;
+	TArray<ECombatTeam> BatchTeam;
+	TArray<FCombatHandle> BatchCurrentTarget;
+	TArray<int32> BatchAbilityStart;
+	TArray<int32> BatchAbilityNum;
+	TArray<FCombatHandle> BatchChosenTarget;
+	TArray<int32> BatchChosenAbility;
+
+	/** Ready abilities of the batch, BatchAbilityNum[i] of them for entry i from BatchAbilityStart[i] */
+	TArray<FCombatAIAbility> BatchAbilities;
+
+	/** Seconds between a decision falling due and being made, most recent last */
+	TArray<float> Latencies;
+	int32 NextLatency = 0;
+
+	uint32 NumOverruns = 0;
+};
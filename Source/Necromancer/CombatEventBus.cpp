@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatEventBus.h"
+#include "CombatSimulation.h"
+#include "Necromancer.h"
+
+DECLARE_CYCLE_STAT(TEXT("Combat Event Apply"), STAT_CombatEventApply, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat Events/Step"), STAT_CombatEventsPerStep, STATGROUP_Necromancer);
+
+FCombatEvent FCombatEvent::MakeDamage(FCombatHandle Target, FCombatHandle Instigator, float Damage)
+{
+	return { ECombatEventType::Damage, Target, Instigator, CombatFixed::FromFloat(Damage) };
+}
+
+FCombatEvent FCombatEvent::MakeHeal(FCombatHandle Target, FCombatHandle Instigator, float Amount)
+{
+	return { ECombatEventType::Heal, Target, Instigator, CombatFixed::FromFloat(Amount) };
+}
+
+FCombatEvent FCombatEvent::MakeKill(FCombatHandle Target, FCombatHandle Instigator)
+{
+	return { ECombatEventType::Kill, Target, Instigator };
+}
+
+FCombatEvent FCombatEvent::MakeRaise(FCombatHandle Target, FCombatHandle Instigator, ECombatTeam Team)
+{
+	return { ECombatEventType::Raise, Target, Instigator, 0, Team };
+}
+
+void FCombatEventBus::Enqueue(const FCombatEvent& Event)
+{
+	SingleEvents.Enqueue(Event);
+}
+
+void FCombatEventBus::EnqueueBatch(TArray<FCombatEvent>&& Events)
+{
+	if (Events.Num() > 0)
+	{
+		EventBatches.Enqueue(MoveTemp(Events));
+	}
+}
+
+int32 FCombatEventBus::Apply(FCombatSimulation& Simulation, TArray<FCombatEventResult>& OutResults)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CombatEventApply);
+
+	Pending.Reset();
+	TArray<FCombatEvent> Batch;
+	while (EventBatches.Dequeue(Batch))
+	{
+		Pending.Append(MoveTemp(Batch));
+	}
+	FCombatEvent Event;
+	while (SingleEvents.Dequeue(Event))
+	{
+		Pending.Add(Event);
+	}
+
+	SET_DWORD_STAT(STAT_CombatEventsPerStep, Pending.Num());
+	if (Pending.Num() == 0)
+	{
+		return 0;
+	}
+
+	// Arrival order depends on thread timing, so order by content alone
+	Pending.Sort([](const FCombatEvent& A, const FCombatEvent& B)
+	{
+		if (A.Target.Slot != B.Target.Slot) return A.Target.Slot < B.Target.Slot;
+		if (A.Target.Serial != B.Target.Serial) return A.Target.Serial < B.Target.Serial;
+		if (A.Type != B.Type) return A.Type < B.Type;
+		if (A.Instigator.Slot != B.Instigator.Slot) return A.Instigator.Slot < B.Instigator.Slot;
+		if (A.Instigator.Serial != B.Instigator.Serial) return A.Instigator.Serial < B.Instigator.Serial;
+		if (A.Amount != B.Amount) return A.Amount < B.Amount;
+		return A.Team < B.Team;
+	});
+
+	for (int32 First = 0; First < Pending.Num();)
+	{
+		const FCombatHandle Target = Pending[First].Target;
+		int32 End = First;
+
+		FCombatEventResult Result;
+		Result.Target = Target;
+		bool bKill = false;
+		bool bRaise = false;
+		ECombatTeam RaiseTeam = ECombatTeam::Undead;
+		for (; End < Pending.Num() && Pending[End].Target == Target; ++End)
+		{
+			const FCombatEvent& TargetEvent = Pending[End];
+			switch (TargetEvent.Type)
+			{
+			case ECombatEventType::Raise:
+				if (!bRaise)
+				{
+					bRaise = true;
+					RaiseTeam = TargetEvent.Team;
+				}
+				break;
+			case ECombatEventType::Heal:
+				Result.Healed += TargetEvent.Amount;
+				break;
+			case ECombatEventType::Damage:
+				if (Result.Damage == 0)
+				{
+					Result.Instigator = TargetEvent.Instigator;
+				}
+				Result.Damage += TargetEvent.Amount;
+				break;
+			case ECombatEventType::Kill:
+				bKill = true;
+				break;
+			}
+		}
+		First = End;
+
+		if (!Simulation.IsValid(Target))
+		{
+			continue;
+		}
+
+		Result.bRaised = bRaise && Simulation.Revive(Target, RaiseTeam);
+		const bool bWasAlive = Simulation.IsAlive(Target);
+
+		// Healing and damage in the same step net out, so their order within the step does not matter
+		const int32 Net = Result.Damage - Result.Healed;
+		if (Net > 0)
+		{
+			Simulation.ApplyFixedDamage(Target, Net);
+		}
+		else if (Net < 0)
+		{
+			Simulation.ApplyFixedHeal(Target, -Net);
+		}
+		if (bKill)
+		{
+			Simulation.Kill(Target);
+		}
+
+		Result.bKilled = bWasAlive && !Simulation.IsAlive(Target);
+		OutResults.Add(Result);
+	}
+
+	return Pending.Num();
+}
+
+void FCombatEventBus::Discard()
+{
+	TArray<FCombatEvent> Batch;
+	while (EventBatches.Dequeue(Batch))
+	{
+	}
+	FCombatEvent Event;
+	while (SingleEvents.Dequeue(Event))
+	{
+	}
+	Pending.Reset();
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/MpscQueue.h"
+#include "CombatTypes.h"
+
+class FCombatSimulation;
+
+/** What a combat event does. Within one target, events apply in this order. */
+enum class ECombatEventType : uint8
+{
+	Raise,
+	Heal,
+	Damage,
+	Kill,
+};
+
+/** A change to one combatant, queued on FCombatEventBus */
+struct FCombatEvent
+{
+	ECombatEventType Type = ECombatEventType::Damage;
+	FCombatHandle Target;
+	FCombatHandle Instigator;
+
+	/** Damage or Heal amount in CombatFixed units */
+	int32 Amount = 0;
+
+	/** Team a Raise event brings the target back on */
+	ECombatTeam Team = ECombatTeam::Undead;
+
+	static FCombatEvent MakeDamage(FCombatHandle Target, FCombatHandle Instigator, float Damage);
+	static FCombatEvent MakeHeal(FCombatHandle Target, FCombatHandle Instigator, float Amount);
+	static FCombatEvent MakeKill(FCombatHandle Target, FCombatHandle Instigator);
+	static FCombatEvent MakeRaise(FCombatHandle Target, FCombatHandle Instigator, ECombatTeam Team);
+};
+
+/** Everything that happened to one combatant in one apply phase */
+struct FCombatEventResult
+{
+	FCombatHandle Target;
+
+	/** Instigator of the first damage event in sorted order */
+	FCombatHandle Instigator;
+
+	/** Totals in CombatFixed units, as requested by the events */
+	int32 Damage = 0;
+	int32 Healed = 0;
+
+	bool bKilled = false;
+	bool bRaised = false;
+};
+
+/**
+ * Collects combat events from any thread and applies them in one deterministic phase.
+ *
+ * Producers push single events or whole buffers into lock-free multi-producer queues. Apply drains both on the
+ * game thread, sorts by target and content so the result does not depend on which thread got there first,
+ * coalesces each target's events (heals and damage net out) and applies them to the simulation.
+ */
+class NECROMANCER_API FCombatEventBus
+{
+public:
+	/** Safe from any thread */
+	void Enqueue(const FCombatEvent& Event);
+
+	/** Safe from any thread. One queue operation for a whole buffer, for producers emitting many events. */
+	void EnqueueBatch(TArray<FCombatEvent>&& Events);
+
+	/** Game thread only. Appends one result per affected combatant, ordered by handle. Returns the number of events consumed. */
+	int32 Apply(FCombatSimulation& Simulation, TArray<FCombatEventResult>& OutResults);
+
+	/** Game thread only. Drops every queued event without applying it. */
+	void Discard();
+
+private:
+	TMpscQueue<FCombatEvent> SingleEvents;
+	TMpscQueue<TArray<FCombatEvent>> EventBatches;
+
+	/** Drained events, reused between applies */
+	TArray<FCombatEvent> Pending;
+};
@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatEventStressCommandlet.h"
+#include "CombatEventBus.h"
+#include "CombatSimulation.h"
+#include "Necromancer.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+
+namespace CombatEventStress
+{
+	// Events a producer collects before handing them over with EnqueueBatch
+	constexpr int32 ProducerBatchSize = 256;
+
+	struct FStressSettings
+	{
+		int32 Producers = 8;
+		int32 EventsPerProducer = 250000;
+		int32 Targets = 2000;
+		int32 Rounds = 5;
+		int32 Seed = 0;
+	};
+
+	struct FStressResult
+	{
+		uint64 Events = 0;
+		uint64 Results = 0;
+		double EnqueueSeconds = 0.0;
+		double ApplySeconds = 0.0;
+		uint32 Checksum = 0;
+	};
+
+	FCombatEvent MakeRandomEvent(FRandomStream& Random, TConstArrayView<FCombatHandle> Units)
+	{
+		const FCombatHandle Target = Units[Random.RandHelper(Units.Num())];
+		const FCombatHandle Instigator = Units[Random.RandHelper(Units.Num())];
+		const int32 Roll = Random.RandHelper(1000);
+		if (Roll < 800)
+		{
+			return FCombatEvent::MakeDamage(Target, Instigator, Random.FRandRange(1.f, 20.f));
+		}
+		if (Roll < 970)
+		{
+			return FCombatEvent::MakeHeal(Target, Instigator, Random.FRandRange(1.f, 20.f));
+		}
+		if (Roll < 985)
+		{
+			return FCombatEvent::MakeKill(Target, Instigator);
+		}
+		return FCombatEvent::MakeRaise(Target, Instigator, Random.RandHelper(2) ? ECombatTeam::Undead : ECombatTeam::Living);
+	}
+
+	FStressResult Run(const FStressSettings& Settings)
+	{
+		FCombatSimulation Simulation;
+		FCombatEventBus Bus;
+
+		TArray<FCombatHandle> Units;
+		for (int32 Index = 0; Index < Settings.Targets; ++Index)
+		{
+			FCombatantDesc Desc;
+			Desc.Team = Index % 2 ? ECombatTeam::Living : ECombatTeam::Undead;
+			Desc.MaxHealth = 1000.f;
+			Desc.Location = FVector(Index * 100.f, 0.f, 0.f);
+			Units.Add(Simulation.Add(Desc));
+		}
+
+		FStressResult Result;
+		TArray<FCombatEventResult> Results;
+		for (int32 Round = 0; Round < Settings.Rounds; ++Round)
+		{
+			// Half the producers push events one by one, the other half in batches
+			const double EnqueueStart = FPlatformTime::Seconds();
+			ParallelFor(Settings.Producers, [&Settings, &Bus, &Units, Round](int32 Producer)
+			{
+				FRandomStream Random(HashCombine(GetTypeHash(Settings.Seed + Round), GetTypeHash(Producer)));
+				const bool bBatched = Producer % 2 == 1;
+				TArray<FCombatEvent> Batch;
+				for (int32 Index = 0; Index < Settings.EventsPerProducer; ++Index)
+				{
+					const FCombatEvent Event = MakeRandomEvent(Random, Units);
+					if (!bBatched)
+					{
+						Bus.Enqueue(Event);
+						continue;
+					}
+
+					Batch.Add(Event);
+					if (Batch.Num() == ProducerBatchSize)
+					{
+						Bus.EnqueueBatch(MoveTemp(Batch));
+						Batch.Reset();
+					}
+				}
+				Bus.EnqueueBatch(MoveTemp(Batch));
+			});
+			const double ApplyStart = FPlatformTime::Seconds();
+
+			Results.Reset();
+			Result.Events += Bus.Apply(Simulation, Results);
+			Result.Results += Results.Num();
+
+			const double ApplyEnd = FPlatformTime::Seconds();
+			Result.EnqueueSeconds += ApplyStart - EnqueueStart;
+			Result.ApplySeconds += ApplyEnd - ApplyStart;
+		}
+
+		Result.Checksum = Simulation.ComputeChecksum();
+		return Result;
+	}
+}
+
+UCombatEventStressCommandlet::UCombatEventStressCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatEventStressCommandlet::Main(const FString& Params)
+{
+	CombatEventStress::FStressSettings Settings;
+	FParse::Value(*Params, TEXT("Producers="), Settings.Producers);
+	FParse::Value(*Params, TEXT("EventsPerProducer="), Settings.EventsPerProducer);
+	FParse::Value(*Params, TEXT("Targets="), Settings.Targets);
+	FParse::Value(*Params, TEXT("Rounds="), Settings.Rounds);
+	FParse::Value(*Params, TEXT("Seed="), Settings.Seed);
+	Settings.Producers = FMath::Max(Settings.Producers, 1);
+	Settings.Targets = FMath::Max(Settings.Targets, 1);
+
+	const CombatEventStress::FStressResult Result = CombatEventStress::Run(Settings);
+	const double EnqueueSeconds = FMath::Max(Result.EnqueueSeconds, UE_SMALL_NUMBER);
+	const double ApplySeconds = FMath::Max(Result.ApplySeconds, UE_SMALL_NUMBER);
+
+	UE_LOG(LogNecromancer, Display, TEXT("CombatEventStress: %llu events from %d producers onto %d targets in %d rounds"),
+		Result.Events, Settings.Producers, Settings.Targets, Settings.Rounds);
+	UE_LOG(LogNecromancer, Display, TEXT("CombatEventStress: enqueue %.2fs (%.1fM events/s), apply %.2fs (%.1fM events/s), %llu target results"),
+		EnqueueSeconds, Result.Events / EnqueueSeconds / 1e6, ApplySeconds, Result.Events / ApplySeconds / 1e6, Result.Results);
+
+	// Thread timing changes arrival order every run; the applied state must not change with it
+	const CombatEventStress::FStressResult Replay = CombatEventStress::Run(Settings);
+	if (Replay.Checksum != Result.Checksum)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatEventStress: repeated run diverged (checksum %08x vs %08x)"), Replay.Checksum, Result.Checksum);
+		return 1;
+	}
+
+	return 0;
+}
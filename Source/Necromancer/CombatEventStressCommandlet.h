@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatEventStressCommandlet.generated.h"
+
+/**
+ * Floods FCombatEventBus from many producer threads at once and measures enqueue and apply throughput.
+ *
+ * Usage: -run=CombatEventStress [-Producers=8] [-EventsPerProducer=250000] [-Targets=2000] [-Rounds=5] [-Seed=0]
+ * Returns non-zero if a repeated run leaves the simulation in a different state.
+ */
+UCLASS()
+class UCombatEventStressCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatEventStressCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatFrameBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "CombatManagerComponent.h"
+#include "CombatSubsystem.h"
+#include "Necromancer.h"
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+
+namespace CombatFrameBenchmark
+{
+	constexpr float UnitSpacing = 120.f;
+
+	// Gap between the two armies, inside attack range of the front ranks
+	constexpr float FrontGap = 100.f;
+
+	// Enough health that the armies are still whole at the end of a run
+	constexpr float UnitHealth = 1000000.f;
+
+	AActor* SpawnCombatant(UWorld* World, const FVector& Location, ECombatTeam Team)
+	{
+		AActor* Actor = World->SpawnActorDeferred<AActor>(AActor::StaticClass(), FTransform(Location));
+		USceneComponent* Root = NewObject<USceneComponent>(Actor, TEXT("Root"));
+		Actor->SetRootComponent(Root);
+		Root->RegisterComponent();
+
+		UCombatManagerComponent* Combatant = NewObject<UCombatManagerComponent>(Actor, TEXT("CombatComponent"));
+		Combatant->Team = Team;
+		Combatant->MaxHealth = UnitHealth;
+		Combatant->RegisterComponent();
+
+		Actor->FinishSpawning(FTransform(Location));
+		return Actor;
+	}
+}
+
+UCombatFrameBenchmarkCommandlet::UCombatFrameBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatFrameBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumCombatants = 5000;
+	int32 Frames = 600;
+	float FrameRate = 60.f;
+	float MaxP95Ms = 4.f;
+	float MaxP99Ms = 6.f;
+	FParse::Value(*Params, TEXT("Combatants="), NumCombatants);
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	FParse::Value(*Params, TEXT("MaxP95Ms="), MaxP95Ms);
+	FParse::Value(*Params, TEXT("MaxP99Ms="), MaxP99Ms);
+	NumCombatants = FMath::Max(NumCombatants, 2);
+	Frames = FMath::Max(Frames, 1);
+	FrameRate = FMath::Max(FrameRate, 1.f);
+
+	FBenchmarkWorld World;
+	World.BeginPlay();
+	UCombatSubsystem* Combat = World.Get()->GetSubsystem<UCombatSubsystem>();
+	if (!Combat)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatFrameBenchmark: the benchmark world has no combat subsystem"));
+		return 1;
+	}
+
+	// Two square armies facing each other along X
+	const double SetupStart = FPlatformTime::Seconds();
+	const int32 PerSide = NumCombatants / 2;
+	const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(PerSide)));
+	for (int32 Index = 0; Index < NumCombatants; ++Index)
+	{
+		const bool bUndead = Index < PerSide;
+		const int32 Rank = bUndead ? Index : Index - PerSide;
+		const float Depth = CombatFrameBenchmark::FrontGap * 0.5f + (Rank / Columns) * CombatFrameBenchmark::UnitSpacing;
+		const FVector Location(bUndead ? -Depth : Depth, (Rank % Columns) * CombatFrameBenchmark::UnitSpacing, 0.f);
+		CombatFrameBenchmark::SpawnCombatant(World.Get(), Location, bUndead ? ECombatTeam::Undead : ECombatTeam::Living);
+	}
+	const double SetupMs = (FPlatformTime::Seconds() - SetupStart) * 1000.0;
+
+	if (Combat->GetSimulation().Num() != NumCombatants)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatFrameBenchmark: %d of %d combatants registered"), Combat->GetSimulation().Num(), NumCombatants);
+		return 1;
+	}
+
+	// Nothing else in the world has per-frame work, so the subsystem is ticked on its own. The first second lets
+	// targets be acquired and attack timers spread out.
+	const float DeltaSeconds = 1.f / FrameRate;
+	const int32 WarmupFrames = FMath::CeilToInt32(FrameRate);
+	FBenchmarkFrameTimes CombatMs;
+	for (int32 Frame = 0; Frame < WarmupFrames + Frames; ++Frame)
+	{
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		Combat->Tick(DeltaSeconds);
+		if (Frame >= WarmupFrames)
+		{
+			CombatMs.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+		}
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("CombatFrameBenchmark: %d combatants on actors, spawned in %.1fms, %d frames at %.0f fps"),
+		NumCombatants, SetupMs, Frames, FrameRate);
+	UE_LOG(LogNecromancer, Display, TEXT("CombatFrameBenchmark: combat %.3fms on average, p95 %.3fms, p99 %.3fms, worst %.3fms"),
+		CombatMs.GetAverage(), CombatMs.GetPercentile(95), CombatMs.GetPercentile(99), CombatMs.GetMax());
+
+	bool bFailed = false;
+	if (MaxP95Ms > 0.f && CombatMs.GetPercentile(95) > MaxP95Ms)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatFrameBenchmark: p95 %.3fms exceeds %.3fms"), CombatMs.GetPercentile(95), MaxP95Ms);
+		bFailed = true;
+	}
+	if (MaxP99Ms > 0.f && CombatMs.GetPercentile(99) > MaxP99Ms)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatFrameBenchmark: p99 %.3fms exceeds %.3fms"), CombatMs.GetPercentile(99), MaxP99Ms);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatFrameBenchmarkCommandlet.generated.h"
+
+/**
+ * Spawns actors with a UCombatManagerComponent into a benchmark world, two armies in contact, and measures what a
+ * frame of UCombatSubsystem costs with all of them registered. Meant to run with -nullrhi.
+ *
+ * Usage: -run=CombatFrameBenchmark [-Combatants=5000] [-Frames=600] [-FrameRate=60] [-MaxP95Ms=4] [-MaxP99Ms=6]
+ * Returns non-zero if a combatant failed to register or a limit is exceeded; a limit of zero is not checked.
+ */
+UCLASS()
+class UCombatFrameBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatFrameBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
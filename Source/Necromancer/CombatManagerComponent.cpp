@@ -2,15 +2,15 @@
 
 
 #include "CombatManagerComponent.h"
+#include "CombatSubsystem.h"
+#include "VisibilitySubsystem.h"
+#include "Engine/World.h"
 
 // Sets default values for this component's properties
 UCombatManagerComponent::UCombatManagerComponent()
 {
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = true;
-
-	// ...
+	// Combat state is updated in bulk by UCombatSubsystem, so the component itself never ticks.
+	PrimaryComponentTick.bCanEverTick = false;
 }
 
 
@@ -19,16 +19,212 @@ void UCombatManagerComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// ...
-	
+	if (CombatHandle.IsValid())
+	{
+		AdoptCombatant(CombatHandle);
+	}
+	else
+	{
+		RegisterCombatant();
+	}
+}
+
+
+// Called when the component is removed from play
+void UCombatManagerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterCombatant();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+UCombatSubsystem* UCombatManagerComponent::GetCombatSubsystem() const
+{
+	const UWorld* World = GetWorld();
+	return World ? World->GetSubsystem<UCombatSubsystem>() : nullptr;
+}
+
+void UCombatManagerComponent::RegisterCombatant()
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem || CombatHandle.IsValid())
+	{
+		return;
+	}
+
+	FCombatantDesc Desc;
+	Desc.Team = Team;
+	Desc.MaxHealth = MaxHealth;
+	Desc.AttackDamage = AttackDamage;
+	Desc.AttackInterval = AttackInterval;
+	Desc.AttackRange = AttackRange;
+	Desc.Location = GetOwner()->GetActorLocation();
+	CombatHandle = CombatSubsystem->RegisterCombatant(Desc, this);
+}
+
+void UCombatManagerComponent::UnregisterCombatant()
+{
+	CancelCooldowns();
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->UnregisterCombatant(CombatHandle);
+	}
+	CombatHandle.Reset();
+}
+
+void UCombatManagerComponent::AdoptCombatant(FCombatHandle Handle)
+{
+	CombatHandle = Handle;
+
+	// Before BeginPlay the link is made there instead
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (CombatSubsystem && HasBegunPlay())
+	{
+		CombatSubsystem->SetCombatantComponent(CombatHandle, this);
+	}
+}
+
+FCombatHandle UCombatManagerComponent::ReleaseCombatant()
+{
+	CancelCooldowns();
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->SetCombatantComponent(CombatHandle, nullptr);
+	}
+
+	const FCombatHandle Released = CombatHandle;
+	CombatHandle.Reset();
+	return Released;
+}
+
+float UCombatManagerComponent::GetHealth() const
+{
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	return CombatSubsystem ? CombatSubsystem->GetSimulation().GetHealth(CombatHandle) : 0.f;
+}
+
+bool UCombatManagerComponent::IsAlive() const
+{
+	return GetHealth() > 0.f;
+}
+
+bool UCombatManagerComponent::IsVisibleToTeam(ECombatTeam Viewer) const
+{
+	const UVisibilitySubsystem* Visibility = GetWorld()->GetSubsystem<UVisibilitySubsystem>();
+	return !Visibility || Visibility->IsCombatantVisibleToTeam(Viewer, CombatHandle);
+}
+
+void UCombatManagerComponent::SetTarget(UCombatManagerComponent* NewTarget)
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->GetSimulation().SetTarget(CombatHandle, NewTarget ? NewTarget->GetCombatHandle() : FCombatHandle());
+	}
 }
 
+void UCombatManagerComponent::ReceiveDamage(float Damage)
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->GetEventBus().Enqueue(FCombatEvent::MakeDamage(CombatHandle, FCombatHandle(), Damage));
+	}
+}
 
-// Called every frame
-void UCombatManagerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void UCombatManagerComponent::ReceiveHeal(float Amount)
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->GetEventBus().Enqueue(FCombatEvent::MakeHeal(CombatHandle, FCombatHandle(), Amount));
+	}
+}
+
+void UCombatManagerComponent::StartCooldown(FName Ability, float Seconds)
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem)
+	{
+		return;
+	}
 
-	// ...
+	FCombatTimerHandle& Cooldown = Cooldowns.FindOrAdd(Ability);
+	CombatSubsystem->CancelTimer(Cooldown);
+	Cooldown = Seconds > 0.f ? CombatSubsystem->ScheduleTimer(Seconds, ECombatTimerChannel::Cooldown, CombatHandle) : FCombatTimerHandle();
+}
+
+void UCombatManagerComponent::CancelCooldowns()
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		for (const TPair<FName, FCombatTimerHandle>& Cooldown : Cooldowns)
+		{
+			CombatSubsystem->CancelTimer(Cooldown.Value);
+		}
+	}
+	Cooldowns.Reset();
+}
+
+bool UCombatManagerComponent::IsOnCooldown(FName Ability) const
+{
+	return GetCooldownRemaining(Ability) > 0.f;
+}
+
+float UCombatManagerComponent::GetCooldownRemaining(FName Ability) const
+{
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	const FCombatTimerHandle* Cooldown = Cooldowns.Find(Ability);
+	return CombatSubsystem && Cooldown ? CombatSubsystem->GetTimerRemaining(*Cooldown) : 0.f;
 }
 
+bool UCombatManagerComponent::ApplyStatusEffect(FName Effect, UCombatManagerComponent* Source)
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem)
+	{
+		return false;
+	}
+
+	FStatusEffectStore& StatusEffects = CombatSubsystem->GetStatusEffects();
+	return StatusEffects.Apply(CombatHandle, Source ? Source->GetCombatHandle() : FCombatHandle(), StatusEffects.FindDefinition(Effect));
+}
+
+void UCombatManagerComponent::RemoveStatusEffect(FName Effect)
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		FStatusEffectStore& StatusEffects = CombatSubsystem->GetStatusEffects();
+		StatusEffects.Remove(CombatHandle, StatusEffects.FindDefinition(Effect));
+	}
+}
+
+int32 UCombatManagerComponent::GetStatusEffectStacks(FName Effect) const
+{
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem)
+	{
+		return 0;
+	}
+
+	const FStatusEffectStore& StatusEffects = CombatSubsystem->GetStatusEffects();
+	return StatusEffects.GetStacks(CombatHandle, StatusEffects.FindDefinition(Effect));
+}
+
+void UCombatManagerComponent::NotifyDied()
+{
+	OnDied.Broadcast(this);
+}
+
+void UCombatManagerComponent::NotifyEvents(const FCombatEventResult& Result)
+{
+	if (Result.bRaised)
+	{
+		OnRaised.Broadcast(this);
+	}
+	if (Result.Healed > 0)
+	{
+		OnHealed.Broadcast(this, CombatFixed::ToFloat(Result.Healed));
+	}
+	if (Result.Damage > 0)
+	{
+		OnDamaged.Broadcast(this, CombatFixed::ToFloat(Result.Damage));
+	}
+}
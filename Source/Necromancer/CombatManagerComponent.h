@@ -4,9 +4,22 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "CombatTypes.h"
+#include "CombatTimerWheel.h"
 #include "CombatManagerComponent.generated.h"
 
+class UCombatSubsystem;
+struct FCombatEventResult;
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCombatantDied, UCombatManagerComponent*, Combatant);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnCombatantDamaged, UCombatManagerComponent*, Combatant, float, Damage);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnCombatantHealed, UCombatManagerComponent*, Combatant, float, Amount);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCombatantRaised, UCombatManagerComponent*, Combatant);
+
+/**
+ * Handle to the owning actor's combat state. The state itself lives in UCombatSubsystem,
+ * which updates every combatant in one batched pass, so this component never ticks.
+ */
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class NECROMANCER_API UCombatManagerComponent : public UActorComponent
 {
@@ -16,13 +29,118 @@ public:
 	// Sets default values for this component's properties
 	UCombatManagerComponent();
 
+	/** Team this combatant fights for */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Combat)
+	ECombatTeam Team = ECombatTeam::Living;
+
+	/** Health when registered */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Combat)
+	float MaxHealth = 100.f;
+
+	/** Damage dealt per attack */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Combat)
+	float AttackDamage = 10.f;
+
+	/** Seconds between attacks */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Combat)
+	float AttackInterval = 1.f;
+
+	/** Distance at which the target can be hit */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Combat)
+	float AttackRange = 150.f;
+
+	/** Broadcast when health reaches zero */
+	UPROPERTY(BlueprintAssignable, Category = Combat)
+	FOnCombatantDied OnDied;
+
+	/** Broadcast at most once per combat step with all damage queued on the event bus for this combatant */
+	UPROPERTY(BlueprintAssignable, Category = Combat)
+	FOnCombatantDamaged OnDamaged;
+
+	/** Broadcast at most once per combat step with all healing queued on the event bus for this combatant */
+	UPROPERTY(BlueprintAssignable, Category = Combat)
+	FOnCombatantHealed OnHealed;
+
+	/** Broadcast when a raise event brings this combatant back to life */
+	UPROPERTY(BlueprintAssignable, Category = Combat)
+	FOnCombatantRaised OnRaised;
+
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	float GetHealth() const;
+
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	bool IsAlive() const;
+
+	/** True if a member of Viewer's team can see this combatant through the fog of war */
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	bool IsVisibleToTeam(ECombatTeam Viewer) const;
+
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	void SetTarget(UCombatManagerComponent* NewTarget);
+
+	/** Queues damage on the combat event bus; it is applied at the start of the next combat step */
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	void ReceiveDamage(float Damage);
+
+	/** Queues healing on the combat event bus; it is applied at the start of the next combat step */
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	void ReceiveHeal(float Amount);
+
+	/** Puts Ability on cooldown for Seconds, replacing any cooldown it already has */
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	void StartCooldown(FName Ability, float Seconds);
+
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	bool IsOnCooldown(FName Ability) const;
+
+	/** Seconds until Ability is ready again, or 0 if it is ready */
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	float GetCooldownRemaining(FName Ability) const;
+
+	/** Adds a stack of the named status effect from UCombatSubsystem's definitions. Source is optional. */
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	bool ApplyStatusEffect(FName Effect, UCombatManagerComponent* Source = nullptr);
+
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	void RemoveStatusEffect(FName Effect);
+
+	UFUNCTION(BlueprintCallable, Category = Combat)
+	int32 GetStatusEffectStacks(FName Effect) const;
+
+	FCombatHandle GetCombatHandle() const { return CombatHandle; }
+
+	/** Creates this component's combatant from its properties. Done by BeginPlay unless one was adopted. */
+	void RegisterCombatant();
+
+	/** Removes this component's combatant from the simulation. Done by EndPlay. */
+	void UnregisterCombatant();
+
+	/** Takes over an existing combatant. Called before BeginPlay, it replaces the registration BeginPlay would do. */
+	void AdoptCombatant(FCombatHandle Handle);
+
+	/** Detaches from the combatant without unregistering it, so its state can be handed to another owner. */
+	FCombatHandle ReleaseCombatant();
+
+	/** Called by UCombatSubsystem when this combatant's health reaches zero */
+	void NotifyDied();
+
+	/** Called by UCombatSubsystem once per step in which events changed this combatant */
+	void NotifyEvents(const FCombatEventResult& Result);
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
-public:	
-	// Called every frame
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	// Called when the component is removed from play
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UCombatSubsystem* GetCombatSubsystem() const;
+
+private:
+	void CancelCooldowns();
+
+	FCombatHandle CombatHandle;
 
-		
+	/** Timers on the combat subsystem's wheel; an entry whose timer fired is simply stale */
+	TMap<FName, FCombatTimerHandle> Cooldowns;
 };
@@ -2,27 +2,76 @@
 
 
 #include "CombatPawn.h"
+#include "CombatAISubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatPawnMovementComponent.h"
+#include "CombatPawnPoolSubsystem.h"
+#include "CorpseSubsystem.h"
+#include "UnitSignificanceSubsystem.h"
+#include "AIController.h"
+#include "BrainComponent.h"
 
 // Sets default values
 ACombatPawn::ACombatPawn()
 {
- 	// Set this pawn to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// No per-frame work; components tick on their own and are throttled by UUnitSignificanceSubsystem
+	PrimaryActorTick.bCanEverTick = false;
 
+	CombatComponent = CreateDefaultSubobject<UCombatManagerComponent>(TEXT("CombatComponent"));
+
+	CombatPawnMovement = CreateDefaultSubobject<UCombatPawnMovementComponent>(TEXT("CombatPawnMovement"));
 }
 
 // Called when the game starts or when spawned
 void ACombatPawn::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	CombatComponent->OnDied.AddUniqueDynamic(this, &ACombatPawn::HandleCombatantDied);
+
+	if (UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>())
+	{
+		Significance->RegisterUnit(this);
+	}
+
+	if (UCombatAISubsystem* CombatAI = GetWorld()->GetSubsystem<UCombatAISubsystem>())
+	{
+		CombatAI->RegisterPawn(this);
+	}
 }
 
-// Called every frame
-void ACombatPawn::Tick(float DeltaTime)
+// Called when the pawn is removed from play
+void ACombatPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	if (UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>())
+	{
+		Significance->UnregisterUnit(this);
+	}
 
+	if (UCombatAISubsystem* CombatAI = GetWorld()->GetSubsystem<UCombatAISubsystem>())
+	{
+		CombatAI->UnregisterPawn(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACombatPawn::HandleCombatantDied(UCombatManagerComponent* Combatant)
+{
+	UCorpseSubsystem* Corpses = GetWorld()->GetSubsystem<UCorpseSubsystem>();
+	if (!Corpses || IsPlayerControlled())
+	{
+		return;
+	}
+
+	// The dead combatant moves into the corpse record, so the pawn can go back to the pool at once
+	Corpses->AddCorpse(CombatComponent->ReleaseCombatant(), GetActorLocation(), GetActorRotation().Yaw, CorpseType);
+	GetWorld()->GetSubsystem<UCombatPawnPoolSubsystem>()->ReleasePawn(this);
+}
+
+UPawnMovementComponent* ACombatPawn::GetMovementComponent() const
+{
+	return CombatPawnMovement;
 }
 
 // Called to bind functionality to input
@@ -32,3 +81,71 @@ void ACombatPawn::SetupPlayerInputComponent(UInputComponent* PlayerInputComponen
 
 }
 
+void ACombatPawn::OnPooledActivate(const FTransform& SpawnTransform)
+{
+	bInPool = false;
+
+	SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+	RegisterAllComponents();
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	SetActorTickEnabled(bTickEnabledBeforePool);
+
+	CombatComponent->RegisterCombatant();
+
+	if (UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>())
+	{
+		Significance->RegisterUnit(this);
+	}
+
+	if (UCombatAISubsystem* CombatAI = GetWorld()->GetSubsystem<UCombatAISubsystem>())
+	{
+		CombatAI->RegisterPawn(this);
+	}
+
+	if (AAIController* AIController = Cast<AAIController>(GetController()))
+	{
+		if (UBrainComponent* Brain = AIController->GetBrainComponent())
+		{
+			Brain->ResumeLogic(TEXT("Pooled"));
+		}
+	}
+
+	ReceivePooledActivate();
+}
+
+void ACombatPawn::OnPooledDeactivate()
+{
+	ReceivePooledDeactivate();
+
+	// Keep the controller possessing us, but stop it from thinking while pooled
+	if (AAIController* AIController = Cast<AAIController>(GetController()))
+	{
+		AIController->StopMovement();
+		if (UBrainComponent* Brain = AIController->GetBrainComponent())
+		{
+			Brain->PauseLogic(TEXT("Pooled"));
+		}
+	}
+
+	CombatComponent->UnregisterCombatant();
+
+	if (UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>())
+	{
+		Significance->UnregisterUnit(this);
+	}
+
+	if (UCombatAISubsystem* CombatAI = GetWorld()->GetSubsystem<UCombatAISubsystem>())
+	{
+		CombatAI->UnregisterPawn(this);
+	}
+
+	// The pawn itself never ticks, but a subclass that does should come back the way it left
+	bTickEnabledBeforePool = IsActorTickEnabled();
+	SetActorTickEnabled(false);
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+	UnregisterAllComponents();
+
+	bInPool = true;
+}
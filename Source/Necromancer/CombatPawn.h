@@ -4,8 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
+#include "CombatAISubsystem.h"
 #include "CombatPawn.generated.h"
 
+class UCombatManagerComponent;
+class UCombatPawnMovementComponent;
+
 UCLASS()
 class NECROMANCER_API ACombatPawn : public APawn
 {
@@ -19,11 +23,62 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	/** Blueprint counterpart of OnPooledActivate */
+	UFUNCTION(BlueprintImplementableEvent, Category = Pooling, meta = (DisplayName = "Pooled Activate"))
+	void ReceivePooledActivate();
+
+	/** Blueprint counterpart of OnPooledDeactivate */
+	UFUNCTION(BlueprintImplementableEvent, Category = Pooling, meta = (DisplayName = "Pooled Deactivate"))
+	void ReceivePooledDeactivate();
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Leaves a corpse record and returns the pawn to the pool. Pawns under player control are left as they are. */
+	UFUNCTION()
+	virtual void HandleCombatantDied(UCombatManagerComponent* Combatant);
 
+public:	
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	virtual UPawnMovementComponent* GetMovementComponent() const override;
+
+	/**
+	 * Called by UCombatPawnPoolSubsystem when this pawn is handed out again. Takes the place of BeginPlay for a reused pawn:
+	 * components are registered again and the pawn joins combat, unless a combatant was adopted beforehand.
+	 */
+	virtual void OnPooledActivate(const FTransform& SpawnTransform);
+
+	/** Called by UCombatPawnPoolSubsystem when this pawn is returned. Takes the place of EndPlay while the pawn waits in the pool. */
+	virtual void OnPooledDeactivate();
+
+	bool IsInPool() const { return bInPool; }
+
+	/** Corpse left in UCorpseSubsystem when this pawn dies */
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	FName CorpseType;
+
+	/** Abilities UCombatAISubsystem may use when it decides for this pawn */
+	UPROPERTY(EditDefaultsOnly, Category = AI)
+	TArray<FCombatAIAbility> Abilities;
+
+	/** Returns CombatComponent subobject **/
+	FORCEINLINE UCombatManagerComponent* GetCombatComponent() const { return CombatComponent; }
+
+	/** Returns CombatPawnMovement subobject **/
+	FORCEINLINE UCombatPawnMovementComponent* GetCombatPawnMovement() const { return CombatPawnMovement; }
+
+private:
+	/** Handle to this pawn's state in the combat subsystem */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	UCombatManagerComponent* CombatComponent;
+
+	/** Kinematic movement, moved in batches by UCombatPawnMovementSubsystem */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
+	UCombatPawnMovementComponent* CombatPawnMovement;
+
+	bool bInPool = false;
+
+	/** Actor tick state when the pawn entered the pool; only subclasses that tick ever see it set */
+	bool bTickEnabledBeforePool = false;
 };
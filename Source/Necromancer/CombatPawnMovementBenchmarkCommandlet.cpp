@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatPawnMovementBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "CombatPawn.h"
+#include "CombatPawnMovementComponent.h"
+#include "CombatPawnMovementSubsystem.h"
+#include "Necromancer.h"
+#include "Components/BoxComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+
+namespace CombatPawnMovementBenchmark
+{
+	constexpr float PawnSpacing = 150.f;
+	constexpr float DeltaSeconds = 1.f / 60.f;
+
+	// Characters start just above the floor and land during these untimed frames
+	constexpr int32 WarmupFrames = 10;
+	constexpr float FloorTopZ = -100.f;
+
+	/** A static slab under the whole formation, with room to walk off for the length of a run */
+	void SpawnFloor(UWorld* World, float HalfSize)
+	{
+		AActor* Floor = World->SpawnActor<AActor>();
+		UBoxComponent* Box = NewObject<UBoxComponent>(Floor, TEXT("Floor"));
+		Box->InitBoxExtent(FVector(HalfSize, HalfSize, 50.f));
+		Box->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		Floor->SetRootComponent(Box);
+		Box->RegisterComponent();
+		Box->SetWorldLocation(FVector(0.f, 0.f, FloorTopZ - 50.f));
+	}
+}
+
+UCombatPawnMovementBenchmarkCommandlet::UCombatPawnMovementBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatPawnMovementBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString CountsParam = TEXT("500,2000,5000");
+	int32 Frames = 120;
+	float MinSpeedup = 2.f;
+	float MaxFrameMs = 8.f;
+	FParse::Value(*Params, TEXT("Counts="), CountsParam, false);
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("MinSpeedup="), MinSpeedup);
+	FParse::Value(*Params, TEXT("MaxFrameMs="), MaxFrameMs);
+	Frames = FMath::Max(Frames, 1);
+
+	TArray<FString> CountStrings;
+	CountsParam.ParseIntoArray(CountStrings, TEXT(","));
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	bool bFailed = false;
+	for (const FString& CountString : CountStrings)
+	{
+		const int32 Count = FMath::Max(FCString::Atoi(*CountString), 1);
+
+		// Same square formation and headings for both kinds of pawn
+		const int32 Side = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(Count)));
+		TArray<FVector> Starts;
+		TArray<FVector> Headings;
+		FRandomStream Random(Count);
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			Starts.Add(FVector((Index % Side - Side / 2) * CombatPawnMovementBenchmark::PawnSpacing, (Index / Side - Side / 2) * CombatPawnMovementBenchmark::PawnSpacing, 0.f));
+			const float Angle = Random.FRandRange(0.f, UE_TWO_PI);
+			Headings.Add(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f));
+		}
+
+		FBenchmarkWorld World;
+		World.BeginPlay();
+		UCombatPawnMovementSubsystem* Movement = World.Get()->GetSubsystem<UCombatPawnMovementSubsystem>();
+		if (!Movement)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatPawnMovementBenchmark: the benchmark world has no combat pawn movement subsystem"));
+			return 1;
+		}
+		const float WalkDistance = (CombatPawnMovementBenchmark::WarmupFrames + Frames) * CombatPawnMovementBenchmark::DeltaSeconds * 1000.f;
+		CombatPawnMovementBenchmark::SpawnFloor(World.Get(), Side * CombatPawnMovementBenchmark::PawnSpacing + WalkDistance);
+
+		TArray<UCombatPawnMovementComponent*> CombatMovers;
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			ACombatPawn* Pawn = World.Get()->SpawnActor<ACombatPawn>(ACombatPawn::StaticClass(), FTransform(Starts[Index]), SpawnParams);
+			if (!Pawn)
+			{
+				continue;
+			}
+
+			// The native class has no root; give it the capsule a character would have
+			if (!Pawn->GetRootComponent())
+			{
+				UCapsuleComponent* Capsule = NewObject<UCapsuleComponent>(Pawn);
+				Capsule->InitCapsuleSize(34.f, 88.f);
+				Pawn->SetRootComponent(Capsule);
+				Capsule->RegisterComponent();
+				Capsule->SetWorldLocation(Starts[Index]);
+				Pawn->GetCombatPawnMovement()->SetUpdatedComponent(Capsule);
+			}
+			CombatMovers.Add(Pawn->GetCombatPawnMovement());
+		}
+
+		// Requests are renewed every frame, as path following renews them, so both kinds of pawn pay for steering each frame
+		FBenchmarkFrameTimes CombatMs;
+		for (int32 Frame = 0; Frame < CombatPawnMovementBenchmark::WarmupFrames + Frames; ++Frame)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			for (int32 Index = 0; Index < CombatMovers.Num(); ++Index)
+			{
+				CombatMovers[Index]->RequestDirectMove(Headings[Index] * CombatMovers[Index]->MaxSpeed, false);
+			}
+			Movement->UpdateMovement(CombatPawnMovementBenchmark::DeltaSeconds);
+			if (Frame >= CombatPawnMovementBenchmark::WarmupFrames)
+			{
+				CombatMs.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+			}
+		}
+
+		for (UCombatPawnMovementComponent* Mover : CombatMovers)
+		{
+			Mover->GetOwner()->Destroy();
+		}
+
+		TArray<UCharacterMovementComponent*> CharacterMovers;
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			ACharacter* Character = World.Get()->SpawnActor<ACharacter>(ACharacter::StaticClass(), FTransform(Starts[Index]), SpawnParams);
+			if (!Character)
+			{
+				continue;
+			}
+
+			// Ticked by hand below so only the movement itself is timed
+			UCharacterMovementComponent* CharacterMovement = Character->GetCharacterMovement();
+			CharacterMovement->bRunPhysicsWithNoController = true;
+			CharacterMovement->SetComponentTickEnabled(false);
+			CharacterMovers.Add(CharacterMovement);
+		}
+
+		FBenchmarkFrameTimes CharacterMs;
+		for (int32 Frame = 0; Frame < CombatPawnMovementBenchmark::WarmupFrames + Frames; ++Frame)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			for (int32 Index = 0; Index < CharacterMovers.Num(); ++Index)
+			{
+				CharacterMovers[Index]->RequestDirectMove(Headings[Index] * CharacterMovers[Index]->MaxWalkSpeed, false);
+				CharacterMovers[Index]->TickComponent(CombatPawnMovementBenchmark::DeltaSeconds, LEVELTICK_All, nullptr);
+			}
+			if (Frame >= CombatPawnMovementBenchmark::WarmupFrames)
+			{
+				CharacterMs.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+			}
+		}
+
+		const double Speedup = CharacterMs.GetAverage() / FMath::Max(CombatMs.GetAverage(), UE_SMALL_NUMBER);
+		UE_LOG(LogNecromancer, Display, TEXT("CombatPawnMovementBenchmark: %d pawns over %d frames: combat pawn movement %.3fms a frame (worst %.3fms), character movement %.3fms (worst %.3fms), %.1fx"),
+			Count, Frames, CombatMs.GetAverage(), CombatMs.GetMax(), CharacterMs.GetAverage(), CharacterMs.GetMax(), Speedup);
+
+		if (CombatMovers.Num() != Count || CharacterMovers.Num() != Count)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatPawnMovementBenchmark: spawned %d combat pawns and %d characters of %d"), CombatMovers.Num(), CharacterMovers.Num(), Count);
+			bFailed = true;
+		}
+		if (MinSpeedup > 0.f && Speedup < MinSpeedup)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatPawnMovementBenchmark: %.1fx faster than character movement with %d pawns, below %.1fx"), Speedup, Count, MinSpeedup);
+			bFailed = true;
+		}
+		if (MaxFrameMs > 0.f && CombatMs.GetAverage() > MaxFrameMs)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatPawnMovementBenchmark: %.3fms a frame with %d pawns exceeds %.3fms"), CombatMs.GetAverage(), Count, MaxFrameMs);
+			bFailed = true;
+		}
+	}
+	return bFailed ? 1 : 0;
+}
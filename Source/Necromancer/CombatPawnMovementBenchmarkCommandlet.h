@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatPawnMovementBenchmarkCommandlet.generated.h"
+
+/**
+ * Compares UCombatPawnMovementSubsystem against UCharacterMovementComponent at several pawn counts. For each count a
+ * benchmark world with a floor gets a square formation of combat pawns, which walk on fixed random headings for a
+ * number of frames, then the same formation of characters on the same headings. The world has no player, so every
+ * combat pawn takes the unswept path that all but the pawns near a player take in a game.
+ *
+ * Usage: -run=CombatPawnMovementBenchmark [-Counts=500,2000,5000] [-Frames=120] [-MinSpeedup=2] [-MaxFrameMs=8]
+ * Returns non-zero if a pawn failed to spawn, if combat pawn movement is less than MinSpeedup times as fast as
+ * character movement at any count, or if it takes more than MaxFrameMs a frame on average; a limit of zero is not
+ * checked.
+ */
+UCLASS()
+class UCombatPawnMovementBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatPawnMovementBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
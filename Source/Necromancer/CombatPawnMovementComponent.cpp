@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatPawnMovementComponent.h"
+#include "CombatPawnMovementSubsystem.h"
+#include "Engine/World.h"
+
+UCombatPawnMovementComponent::UCombatPawnMovementComponent()
+{
+	// Moved in batches by UCombatPawnMovementSubsystem
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UCombatPawnMovementComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	// Pooled pawns unregister their components while they wait, which takes them out of the batch too
+	if (UCombatPawnMovementSubsystem* Movement = GetWorld() ? GetWorld()->GetSubsystem<UCombatPawnMovementSubsystem>() : nullptr)
+	{
+		Movement->RegisterComponent(this);
+	}
+}
+
+void UCombatPawnMovementComponent::OnUnregister()
+{
+	if (UCombatPawnMovementSubsystem* Movement = GetWorld() ? GetWorld()->GetSubsystem<UCombatPawnMovementSubsystem>() : nullptr)
+	{
+		Movement->UnregisterComponent(this);
+	}
+
+	Super::OnUnregister();
+}
+
+void UCombatPawnMovementComponent::RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed)
+{
+	RequestedVelocity = bForceMaxSpeed ? MoveVelocity.GetSafeNormal() * MaxSpeed : MoveVelocity.GetClampedToMaxSize(MaxSpeed);
+	bHasRequestedVelocity = true;
+}
+
+void UCombatPawnMovementComponent::StopActiveMovement()
+{
+	Super::StopActiveMovement();
+
+	RequestedVelocity = FVector::ZeroVector;
+	bHasRequestedVelocity = false;
+}
+
+void UCombatPawnMovementComponent::StopMovementImmediately()
+{
+	Super::StopMovementImmediately();
+
+	RequestedVelocity = FVector::ZeroVector;
+	bHasRequestedVelocity = false;
+}
+
+FVector UCombatPawnMovementComponent::ConsumeDesiredVelocity()
+{
+	// Path following may tick less often than the batch, so its request stands until replaced or stopped
+	const FVector Input = ConsumeInputVector();
+	if (bHasRequestedVelocity)
+	{
+		return RequestedVelocity;
+	}
+	return Input.GetClampedToMaxSize(1.f) * MaxSpeed;
+}
+
+float UCombatPawnMovementComponent::GetGroundOffset() const
+{
+	if (GroundOffset >= 0.f || !UpdatedComponent)
+	{
+		return FMath::Max(GroundOffset, 0.f);
+	}
+	return UpdatedComponent->Bounds.BoxExtent.Z;
+}
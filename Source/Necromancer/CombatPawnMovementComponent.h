@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "CombatPawnMovementComponent.generated.h"
+
+/**
+ * Kinematic ground movement for combat pawns. Never ticks: UCombatPawnMovementSubsystem moves every pawn in one
+ * parallel batch, snapping to the navmesh heights cached by the flow field cost grid and sliding along other
+ * combatants and blocked cells instead of sweeping. Pawns near a player are moved with real sweeps.
+ * Takes movement input and path following requests like any pawn movement component.
+ */
+UCLASS(ClassGroup = Movement, meta = (BlueprintSpawnableComponent))
+class NECROMANCER_API UCombatPawnMovementComponent : public UPawnMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCombatPawnMovementComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
+	float MaxSpeed = 300.f;
+
+	/** Rate at which velocity reaches the requested velocity */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
+	float Acceleration = 2000.f;
+
+	/** Footprint used to slide along other combatants */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
+	float Radius = 40.f;
+
+	/** Height of the updated component above the ground. Negative to use half the height of its bounds. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
+	float GroundOffset = -1.f;
+
+	virtual float GetMaxSpeed() const override { return MaxSpeed; }
+	virtual void RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed) override;
+	virtual void StopActiveMovement() override;
+	virtual void StopMovementImmediately() override;
+
+	/** Velocity wanted for the next update: the path following request while one stands, else the pending input */
+	FVector ConsumeDesiredVelocity();
+
+	float GetGroundOffset() const;
+
+protected:
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+
+private:
+	FVector RequestedVelocity = FVector::ZeroVector;
+	bool bHasRequestedVelocity = false;
+};
@@ -0,0 +1,281 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatPawnMovementSubsystem.h"
+#include "CombatPawnMovementComponent.h"
+#include "CombatManagerComponent.h"
+#include "CombatPawn.h"
+#include "CombatSubsystem.h"
+#include "FlowFieldSubsystem.h"
+#include "NecromancerStats.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Combat Pawn Movement"), STAT_CombatPawnMovement, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat Pawn Movers"), STAT_CombatPawnMovers, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat Pawn Movers Swept"), STAT_CombatPawnMoversSwept, STATGROUP_Necromancer);
+
+namespace CombatPawnMovement
+{
+	// Movers solved by one parallel task
+	constexpr int32 MoveTaskSize = 64;
+
+	// Closest combatants each mover is pushed away from
+	constexpr int32 MaxNeighbours = 6;
+
+	// Below this speed a mover with nothing requested is at rest and skipped
+	constexpr float RestSpeed = 1.f;
+}
+
+void UCombatPawnMovementSubsystem::Deinitialize()
+{
+	Movers.Empty();
+	MoverIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UCombatPawnMovementSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCombatPawnMovementSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatPawnMovementSubsystem, STATGROUP_Tickables);
+}
+
+void UCombatPawnMovementSubsystem::RegisterComponent(UCombatPawnMovementComponent* Component)
+{
+	if (Component && !MoverIndices.Contains(Component))
+	{
+		MoverIndices.Add(Component, Movers.Add(Component));
+	}
+}
+
+void UCombatPawnMovementSubsystem::UnregisterComponent(UCombatPawnMovementComponent* Component)
+{
+	if (const int32* Index = MoverIndices.Find(Component))
+	{
+		RemoveMover(*Index);
+	}
+}
+
+void UCombatPawnMovementSubsystem::RemoveMover(int32 Index)
+{
+	MoverIndices.Remove(Movers[Index]);
+	Movers.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (Movers.IsValidIndex(Index))
+	{
+		MoverIndices[Movers[Index]] = Index;
+	}
+}
+
+void UCombatPawnMovementSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	UpdateMovement(DeltaTime);
+}
+
+void UCombatPawnMovementSubsystem::UpdateMovement(float DeltaTime)
+{
+	NECRO_SCOPE(STAT_CombatPawnMovement, Movement);
+
+	if (DeltaTime <= 0.f)
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	const UCombatSubsystem* Combat = World->GetSubsystem<UCombatSubsystem>();
+	const UFlowFieldSubsystem* FlowFields = World->GetSubsystem<UFlowFieldSubsystem>();
+	const TSharedPtr<const FFlowFieldCostGrid> CostGrid = FlowFields ? FlowFields->GetCostGrid() : TSharedPtr<const FFlowFieldCostGrid>();
+
+	PlayerLocations.Reset();
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->Get() ? It->Get()->GetPawn() : nullptr)
+		{
+			PlayerLocations.Add(PlayerPawn->GetActorLocation());
+		}
+	}
+	const float SweepRadiusSq = FMath::Square(SweepRadius);
+
+	// Gather on the game thread; pawns at rest with nothing requested are left where they are
+	for (int32 Index = Movers.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Movers[Index].IsValid())
+		{
+			RemoveMover(Index);
+		}
+	}
+
+	TArray<UCombatPawnMovementComponent*> Active;
+	Active.Reserve(Movers.Num());
+	Location.Reset();
+	Velocity.Reset();
+	DesiredVelocity.Reset();
+	MaxSpeed.Reset();
+	Acceleration.Reset();
+	Radius.Reset();
+	GroundOffset.Reset();
+	Combatant.Reset();
+	NeedsSweep.Reset();
+	for (const TWeakObjectPtr<UCombatPawnMovementComponent>& Weak : Movers)
+	{
+		UCombatPawnMovementComponent* Mover = Weak.Get();
+		if (!Mover->UpdatedComponent || Mover->UpdatedComponent->IsSimulatingPhysics())
+		{
+			continue;
+		}
+
+		const FVector Desired = Mover->ConsumeDesiredVelocity();
+		if (Desired.SizeSquared2D() < FMath::Square(CombatPawnMovement::RestSpeed) && Mover->Velocity.SizeSquared2D() < FMath::Square(CombatPawnMovement::RestSpeed))
+		{
+			Mover->Velocity = FVector::ZeroVector;
+			continue;
+		}
+
+		const FVector MoverLocation = Mover->UpdatedComponent->GetComponentLocation();
+		bool bNearPlayer = false;
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			bNearPlayer |= FVector::DistSquared2D(MoverLocation, PlayerLocation) <= SweepRadiusSq;
+		}
+
+		const ACombatPawn* CombatPawn = Cast<ACombatPawn>(Mover->GetPawnOwner());
+		Active.Add(Mover);
+		Location.Add(MoverLocation);
+		Velocity.Add(FVector(Mover->Velocity.X, Mover->Velocity.Y, 0.f));
+		DesiredVelocity.Add(FVector(Desired.X, Desired.Y, 0.f));
+		MaxSpeed.Add(Mover->MaxSpeed);
+		Acceleration.Add(Mover->Acceleration);
+		Radius.Add(Mover->Radius);
+		GroundOffset.Add(Mover->GetGroundOffset());
+		Combatant.Add(CombatPawn ? CombatPawn->GetCombatComponent()->GetCombatHandle() : FCombatHandle());
+		NeedsSweep.Add(bNearPlayer);
+	}
+
+	const int32 Num = Active.Num();
+	NewLocation.SetNumUninitialized(Num);
+	NewVelocity.SetNumUninitialized(Num);
+
+	// Reads simulation and cost grid state only; every mover writes its own outputs
+	const FCombatSimulation* Simulation = Combat ? &Combat->GetSimulation() : nullptr;
+	const FFlowFieldCostGrid* Grid = CostGrid.Get();
+	ParallelFor(FMath::DivideAndRoundUp(Num, CombatPawnMovement::MoveTaskSize), [this, Simulation, Grid, DeltaTime, Num](int32 TaskIndex)
+	{
+		const int32 Start = TaskIndex * CombatPawnMovement::MoveTaskSize;
+		const int32 End = FMath::Min(Start + CombatPawnMovement::MoveTaskSize, Num);
+		TArray<FCombatHandle> Neighbours;
+
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			const FVector& From = Location[Index];
+			const FVector ToDesired = DesiredVelocity[Index] - Velocity[Index];
+			FVector MoveVelocity = (Velocity[Index] + ToDesired.GetClampedToMaxSize(Acceleration[Index] * DeltaTime)).GetClampedToMaxSize(MaxSpeed[Index]);
+			FVector To = From + MoveVelocity * DeltaTime;
+
+			// Push out of the closest combatants instead of sweeping against their capsules
+			if (Simulation)
+			{
+				const float MinDistance = Radius[Index] * 2.f;
+				FCombatSpatialQuery Query;
+				Query.Shape = ECombatQueryShape::Nearest;
+				Query.Origin = To;
+				Query.Radius = MinDistance;
+				Query.MaxResults = CombatPawnMovement::MaxNeighbours + 1;
+				Neighbours.Reset();
+				Simulation->Query(Query, Neighbours);
+
+				for (const FCombatHandle& Neighbour : Neighbours)
+				{
+					if (Neighbour == Combatant[Index])
+					{
+						continue;
+					}
+					FVector Offset = To - Simulation->GetLocation(Neighbour);
+					Offset.Z = 0.f;
+					const float Distance = Offset.Size();
+					if (Distance > UE_KINDA_SMALL_NUMBER && Distance < MinDistance)
+					{
+						// Half the overlap; the neighbour takes the other half on its own move
+						To += Offset * ((MinDistance - Distance) * 0.5f / Distance);
+					}
+				}
+			}
+
+			if (Grid)
+			{
+				// Slide along blocked cells one axis at a time
+				auto IsBlocked = [Grid](const FVector& Point)
+				{
+					const FIntPoint Cell = Grid->ToCell(Point);
+					return !Grid->IsValidCell(Cell) || Grid->Cost[Grid->ToIndex(Cell)] == FFlowFieldCostGrid::Blocked;
+				};
+				if (IsBlocked(To) && !IsBlocked(From))
+				{
+					if (!IsBlocked(FVector(To.X, From.Y, To.Z)))
+					{
+						To.Y = From.Y;
+						MoveVelocity.Y = 0.f;
+					}
+					else if (!IsBlocked(FVector(From.X, To.Y, To.Z)))
+					{
+						To.X = From.X;
+						MoveVelocity.X = 0.f;
+					}
+					else
+					{
+						To = From;
+						MoveVelocity = FVector::ZeroVector;
+					}
+				}
+
+				if (Grid->IsValidCell(Grid->ToCell(To)))
+				{
+					To.Z = Grid->SampleHeight(To) + GroundOffset[Index];
+				}
+			}
+
+			NewLocation[Index] = To;
+			NewVelocity[Index] = MoveVelocity;
+		}
+	});
+
+	// Apply on the game thread
+	int32 NumSwept = 0;
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		UCombatPawnMovementComponent* Mover = Active[Index];
+		USceneComponent* Updated = Mover->UpdatedComponent;
+		const FRotator Rotation = NewVelocity[Index].SizeSquared2D() > FMath::Square(CombatPawnMovement::RestSpeed)
+			? FRotator(0.f, NewVelocity[Index].Rotation().Yaw, 0.f)
+			: Updated->GetComponentRotation();
+
+		if (NeedsSweep[Index])
+		{
+			const FVector Delta = NewLocation[Index] - Location[Index];
+			FHitResult Hit;
+			Mover->SafeMoveUpdatedComponent(Delta, Rotation, true, Hit);
+			if (Hit.IsValidBlockingHit())
+			{
+				Mover->SlideAlongSurface(Delta, 1.f - Hit.Time, Hit.Normal, Hit, true);
+			}
+			++NumSwept;
+		}
+		else
+		{
+			Updated->SetWorldLocationAndRotation(NewLocation[Index], Rotation);
+		}
+
+		Mover->Velocity = NewVelocity[Index];
+		Mover->UpdateComponentVelocity();
+	}
+
+	SET_DWORD_STAT(STAT_CombatPawnMovers, Num);
+	SET_DWORD_STAT(STAT_CombatPawnMoversSwept, NumSwept);
+	NECRO_COUNT(Traces, NumSwept);
+}
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "CombatPawnMovementSubsystem.generated.h"
+
+class UCombatPawnMovementComponent;
+
+/**
+ * Moves every UCombatPawnMovementComponent once per frame. Inputs are gathered on the game thread into flat arrays,
+ * the moves are computed in parallel batches, and the results are written back on the game thread.
+ * A move accelerates toward the requested velocity, slides along nearby combatants found in the combat spatial grid
+ * and along blocked cells of the flow field cost grid, then snaps to that grid's cached navmesh height.
+ * Only pawns within SweepRadius of a player pawn are moved with collision sweeps; the rest are placed directly.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UCombatPawnMovementSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterComponent(UCombatPawnMovementComponent* Component);
+	void UnregisterComponent(UCombatPawnMovementComponent* Component);
+
+	/** Moves every registered component by DeltaTime. Done by Tick. */
+	void UpdateMovement(float DeltaTime);
+
+	/** Pawns closer than this to a player pawn are moved with sweeps against the world */
+	UPROPERTY(Config)
+	float SweepRadius = 2000.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void RemoveMover(int32 Index);
+
+	/** Registered components */
+	TArray<TWeakObjectPtr<UCombatPawnMovementComponent>> Movers;
+	TMap<TWeakObjectPtr<UCombatPawnMovementComponent>, int32> MoverIndices;
+
+	/** Per-frame inputs and outputs, one entry per mover */
+	TArray<FVector> Location;
+	TArray<FVector> Velocity;
+	TArray<FVector> DesiredVelocity;
+	TArray<float> MaxSpeed;
+	TArray<float> Acceleration;
+	TArray<float> Radius;
+	TArray<float> GroundOffset;
+	TArray<FCombatHandle> Combatant;
+	TArray<uint8> NeedsSweep;
+	TArray<FVector> NewLocation;
+	TArray<FVector> NewVelocity;
+
+	TArray<FVector> PlayerLocations;
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatPawnPoolBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "CombatPawn.h"
+#include "CombatPawnPoolSubsystem.h"
+#include "Necromancer.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+#include "UObject/UObjectGlobals.h"
+
+UCombatPawnPoolBenchmarkCommandlet::UCombatPawnPoolBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatPawnPoolBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 Count = 500;
+	int32 Rounds = 5;
+	float MinSpeedup = 2.f;
+	FParse::Value(*Params, TEXT("Count="), Count);
+	FParse::Value(*Params, TEXT("Rounds="), Rounds);
+	FParse::Value(*Params, TEXT("MinSpeedup="), MinSpeedup);
+	Count = FMath::Max(Count, 1);
+	Rounds = FMath::Max(Rounds, 1);
+
+	IConsoleVariable* PoolEnabled = IConsoleManager::Get().FindConsoleVariable(TEXT("necro.Pool.Enabled"));
+	if (!PoolEnabled)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatPawnPoolBenchmark: necro.Pool.Enabled is not registered"));
+		return 1;
+	}
+	const bool bWasEnabled = PoolEnabled->GetBool();
+
+	FBenchmarkWorld World;
+	World.BeginPlay();
+	UCombatPawnPoolSubsystem* Pool = World.Get()->GetSubsystem<UCombatPawnPoolSubsystem>();
+	if (!Pool)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatPawnPoolBenchmark: the benchmark world has no pawn pool subsystem"));
+		return 1;
+	}
+
+	// Best round of each mode, so a stray hitch does not decide the comparison
+	double CycleMs[2] = { TNumericLimits<double>::Max(), TNumericLimits<double>::Max() };
+	double GCMs[2] = { TNumericLimits<double>::Max(), TNumericLimits<double>::Max() };
+	int32 PooledSpawns = 0;
+	TArray<ACombatPawn*> Pawns;
+	Pawns.Reserve(Count);
+	for (const bool bPooling : { false, true })
+	{
+		PoolEnabled->Set(bPooling, ECVF_SetByCode);
+		if (bPooling)
+		{
+			Pool->Prewarm(ACombatPawn::StaticClass(), Count - Pool->GetNumPooled(ACombatPawn::StaticClass()));
+		}
+
+		const int32 SpawnedBefore = Pool->GetStats().Spawned;
+		for (int32 Round = 0; Round < Rounds; ++Round)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				Pawns.Add(Pool->AcquirePawn(ACombatPawn::StaticClass(), FTransform(FVector(Index * 100.f, 0.f, 0.f))));
+			}
+			for (ACombatPawn* Pawn : Pawns)
+			{
+				Pool->ReleasePawn(Pawn);
+			}
+			Pawns.Reset();
+			CycleMs[bPooling] = FMath::Min(CycleMs[bPooling], FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+
+			const uint64 GCStartCycles = FPlatformTime::Cycles64();
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+			GCMs[bPooling] = FMath::Min(GCMs[bPooling], FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - GCStartCycles));
+		}
+		if (bPooling)
+		{
+			PooledSpawns = Pool->GetStats().Spawned - SpawnedBefore;
+		}
+
+		UE_LOG(LogNecromancer, Display, TEXT("CombatPawnPoolBenchmark: pooling %s, %d acquire/release cycles in %.2fms (%.0f pawns/s), GC %.2fms"),
+			bPooling ? TEXT("on") : TEXT("off"), Count, CycleMs[bPooling], Count / FMath::Max(CycleMs[bPooling] / 1000.0, UE_SMALL_NUMBER), GCMs[bPooling]);
+	}
+	PoolEnabled->Set(bWasEnabled, ECVF_SetByCode);
+
+	const double Speedup = CycleMs[0] / FMath::Max(CycleMs[1], UE_SMALL_NUMBER);
+	UE_LOG(LogNecromancer, Display, TEXT("CombatPawnPoolBenchmark: pooled cycles %.1fx as fast"), Speedup);
+
+	bool bFailed = false;
+	if (PooledSpawns > 0)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatPawnPoolBenchmark: %d pawns were spawned with a prewarmed pool"), PooledSpawns);
+		bFailed = true;
+	}
+	if (MinSpeedup > 0.f && Speedup < MinSpeedup)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatPawnPoolBenchmark: pooled cycles are %.1fx as fast, below %.1fx"), Speedup, MinSpeedup);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
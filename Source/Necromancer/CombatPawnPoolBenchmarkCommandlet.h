@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatPawnPoolBenchmarkCommandlet.generated.h"
+
+/**
+ * Times acquire/release cycles of combat pawns in a benchmark world, and the garbage collection after them, first
+ * with necro.Pool.Enabled off so every pawn is spawned and destroyed, then with a prewarmed pool.
+ *
+ * Usage: -run=CombatPawnPoolBenchmark [-Count=500] [-Rounds=5] [-MinSpeedup=2]
+ * Returns non-zero if the pooled rounds had to spawn a pawn, or if pooled cycles are less than MinSpeedup times as
+ * fast as spawning and destroying; a limit of zero is not checked.
+ */
+UCLASS()
+class UCombatPawnPoolBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatPawnPoolBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatPawnPoolSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatPawn.h"
+#include "NecromancerStats.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarCombatPawnPoolEnabled(
+	TEXT("necro.Pool.Enabled"),
+	true,
+	TEXT("When false, combat pawns are spawned and destroyed instead of pooled"));
+
+bool UCombatPawnPoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UCombatPawnPoolSubsystem::Deinitialize()
+{
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+ACombatPawn* UCombatPawnPoolSubsystem::SpawnPawn(TSubclassOf<ACombatPawn> PawnClass, const FTransform& SpawnTransform, FCombatHandle AdoptHandle)
+{
+	ACombatPawn* Pawn = GetWorld()->SpawnActorDeferred<ACombatPawn>(PawnClass, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+	if (Pawn)
+	{
+		if (AdoptHandle.IsValid())
+		{
+			Pawn->GetCombatComponent()->AdoptCombatant(AdoptHandle);
+		}
+		Pawn->FinishSpawning(SpawnTransform);
+		++Stats.Spawned;
+		NECRO_COUNT(Spawns, 1);
+	}
+	return Pawn;
+}
+
+void UCombatPawnPoolSubsystem::Prewarm(TSubclassOf<ACombatPawn> PawnClass, int32 Count)
+{
+	if (!PawnClass)
+	{
+		return;
+	}
+
+	FCombatPawnPool& Pool = Pools.FindOrAdd(PawnClass.Get());
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		if (ACombatPawn* Pawn = SpawnPawn(PawnClass, FTransform::Identity, FCombatHandle()))
+		{
+			Pawn->OnPooledDeactivate();
+			Pool.Free.Add(Pawn);
+		}
+	}
+}
+
+ACombatPawn* UCombatPawnPoolSubsystem::AcquirePawn(TSubclassOf<ACombatPawn> PawnClass, const FTransform& SpawnTransform, FCombatHandle AdoptHandle)
+{
+	if (!PawnClass)
+	{
+		return nullptr;
+	}
+
+	if (CVarCombatPawnPoolEnabled.GetValueOnGameThread())
+	{
+		if (FCombatPawnPool* Pool = Pools.Find(PawnClass.Get()))
+		{
+			while (Pool->Free.Num() > 0)
+			{
+				ACombatPawn* Pawn = Pool->Free.Pop(EAllowShrinking::No);
+				if (!IsValid(Pawn))
+				{
+					continue;
+				}
+
+				if (AdoptHandle.IsValid())
+				{
+					Pawn->GetCombatComponent()->AdoptCombatant(AdoptHandle);
+				}
+				Pawn->OnPooledActivate(SpawnTransform);
+				++Stats.Reused;
+				return Pawn;
+			}
+		}
+	}
+
+	return SpawnPawn(PawnClass, SpawnTransform, AdoptHandle);
+}
+
+void UCombatPawnPoolSubsystem::ReleasePawn(ACombatPawn* Pawn)
+{
+	if (!IsValid(Pawn) || Pawn->IsInPool())
+	{
+		return;
+	}
+
+	if (!CVarCombatPawnPoolEnabled.GetValueOnGameThread())
+	{
+		Pawn->Destroy();
+		++Stats.Destroyed;
+		return;
+	}
+
+	Pawn->OnPooledDeactivate();
+	Pools.FindOrAdd(Pawn->GetClass()).Free.Add(Pawn);
+	++Stats.Released;
+}
+
+int32 UCombatPawnPoolSubsystem::GetNumPooled(TSubclassOf<ACombatPawn> PawnClass) const
+{
+	const FCombatPawnPool* Pool = Pools.Find(PawnClass.Get());
+	return Pool ? Pool->Free.Num() : 0;
+}
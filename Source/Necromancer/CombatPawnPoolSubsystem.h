@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "CombatPawnPoolSubsystem.generated.h"
+
+class ACombatPawn;
+
+/** Inactive pawns of one class */
+USTRUCT()
+struct FCombatPawnPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ACombatPawn>> Free;
+};
+
+/** Counters since the world started */
+struct FCombatPawnPoolStats
+{
+	int32 Spawned = 0;
+	int32 Reused = 0;
+	int32 Released = 0;
+	int32 Destroyed = 0;
+};
+
+/**
+ * Reuses ACombatPawn instances instead of spawning and destroying one per unit.
+ * Pooled pawns stay in the world with their components unregistered; see ACombatPawn::OnPooledActivate/OnPooledDeactivate.
+ * Set necro.Pool.Enabled 0 to spawn and destroy every time, for comparison; -run=CombatPawnPoolBenchmark measures both.
+ */
+UCLASS()
+class NECROMANCER_API UCombatPawnPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Spawns Count pawns of PawnClass straight into the pool */
+	void Prewarm(TSubclassOf<ACombatPawn> PawnClass, int32 Count);
+
+	/**
+	 * Hands out a pawn of PawnClass at SpawnTransform, reusing a pooled one if possible.
+	 * If AdoptHandle is valid the pawn takes over that combatant instead of registering a new one.
+	 */
+	ACombatPawn* AcquirePawn(TSubclassOf<ACombatPawn> PawnClass, const FTransform& SpawnTransform, FCombatHandle AdoptHandle = FCombatHandle());
+
+	/** Returns a pawn to its pool. It leaves combat and stops ticking, rendering and colliding. */
+	void ReleasePawn(ACombatPawn* Pawn);
+
+	int32 GetNumPooled(TSubclassOf<ACombatPawn> PawnClass) const;
+	const FCombatPawnPoolStats& GetStats() const { return Stats; }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	ACombatPawn* SpawnPawn(TSubclassOf<ACombatPawn> PawnClass, const FTransform& SpawnTransform, FCombatHandle AdoptHandle);
+
+	UPROPERTY(Transient)
+	TMap<TObjectPtr<UClass>, FCombatPawnPool> Pools;
+
+	FCombatPawnPoolStats Stats;
+};
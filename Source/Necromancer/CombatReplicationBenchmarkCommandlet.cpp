@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatReplicationBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "CombatEventBus.h"
+#include "CombatReplicationProxy.h"
+#include "CombatSimulation.h"
+#include "Necromancer.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+#include "UObject/CoreNet.h"
+
+namespace CombatReplicationBenchmark
+{
+	// Half the distance between the two armies at the start, and how far each unit may start from its army's center
+	constexpr float ArmyOffset = 1500.f;
+	constexpr float ArmySpread = 1000.f;
+
+	constexpr float MoveSpeed = 300.f;
+
+	/** Bits the fields of Record take on the wire */
+	int64 GetPayloadBits(const FCombatantNetRecord& Record)
+	{
+		FCombatantNetRecord Copy = Record;
+		FNetBitWriter Writer(nullptr, 0);
+		bool bSuccess = true;
+		Writer << Copy.Slot;
+		Writer << Copy.Serial;
+		Copy.Position.NetSerialize(Writer, nullptr, bSuccess);
+		Writer << Copy.Health;
+		Writer << Copy.Team;
+		return Writer.GetNumBits();
+	}
+}
+
+UCombatReplicationBenchmarkCommandlet::UCombatReplicationBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatReplicationBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumUnits = 2000;
+	float Seconds = 10.f;
+	float Radius = 6000.f;
+	int32 MaxRecords = 512;
+	float MaxUpdateMs = 1.f;
+	float MaxBytesPerSecond = 80000.f;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Units="), NumUnits);
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+	FParse::Value(*Params, TEXT("Radius="), Radius);
+	FParse::Value(*Params, TEXT("MaxRecords="), MaxRecords);
+	FParse::Value(*Params, TEXT("MaxUpdateMs="), MaxUpdateMs);
+	FParse::Value(*Params, TEXT("MaxBytesPerSecond="), MaxBytesPerSecond);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	NumUnits = FMath::Max(NumUnits, 2);
+	Seconds = FMath::Max(Seconds, 1.f);
+	MaxRecords = FMath::Max(MaxRecords, 1);
+
+	FBenchmarkWorld World;
+	World.BeginPlay();
+	ACombatReplicationProxy* Proxy = World.Get()->SpawnActor<ACombatReplicationProxy>();
+	if (!Proxy)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatReplicationBenchmark: could not spawn a replication proxy"));
+		return 1;
+	}
+
+	// Two blobs on either side of the viewer, so positions and health keep changing
+	FRandomStream Random(Seed);
+	FCombatSimulation Simulation;
+	FCombatEventBus EventBus;
+	TArray<FCombatEvent> Hits;
+	TArray<FCombatEventResult> EventResults;
+	TArray<FCombatHandle> Units;
+	TArray<FVector> Locations;
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		FCombatantDesc Desc;
+		Desc.Team = Index % 2 ? ECombatTeam::Living : ECombatTeam::Undead;
+		const float Side = Desc.Team == ECombatTeam::Living ? 1.f : -1.f;
+		Desc.Location = FVector(Side * CombatReplicationBenchmark::ArmyOffset + Random.FRandRange(-CombatReplicationBenchmark::ArmySpread, CombatReplicationBenchmark::ArmySpread),
+			Random.FRandRange(-CombatReplicationBenchmark::ArmySpread, CombatReplicationBenchmark::ArmySpread), 0.f);
+		Units.Add(Simulation.Add(Desc));
+		Locations.Add(Desc.Location);
+	}
+
+	const float NetUpdateFrequency = FMath::Max(Proxy->GetNetUpdateFrequency(), 1.f);
+	const int32 StepsPerUpdate = Simulation.SecondsToSteps(1.f / NetUpdateFrequency);
+	const int32 Steps = Simulation.SecondsToSteps(Seconds);
+	const float StepDistance = CombatReplicationBenchmark::MoveSpeed * Simulation.GetStepSeconds();
+
+	FBenchmarkFrameTimes UpdateMs;
+	int64 PayloadBits = 0;
+	int64 DirtyRecords = 0;
+	TMap<FCombatHandle, int32> SentKeys;
+	TMap<FCombatHandle, int32> CurrentKeys;
+	for (int32 Step = 0; Step < Steps; ++Step)
+	{
+		// Each army walks toward the other's side until they meet in the middle
+		for (int32 Index = 0; Index < Units.Num(); ++Index)
+		{
+			const float Direction = Simulation.GetTeam(Units[Index]) == ECombatTeam::Living ? -1.f : 1.f;
+			if (Locations[Index].X * Direction < 0.f)
+			{
+				Locations[Index].X += Direction * StepDistance;
+			}
+			Locations[Index].Y += Random.FRandRange(-StepDistance, StepDistance);
+		}
+		Simulation.SetLocations(Units, Locations);
+		Simulation.Step(Hits);
+		EventBus.EnqueueBatch(MoveTemp(Hits));
+		EventResults.Reset();
+		EventBus.Apply(Simulation, EventResults);
+
+		if (Step % StepsPerUpdate != 0)
+		{
+			continue;
+		}
+
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		const int32 NumDirty = Proxy->UpdateView(Simulation, FVector::ZeroVector, Radius, MaxRecords);
+		UpdateMs.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+
+		// Marking a record dirty moves its replication key; records new to the view are sent whatever their key
+		DirtyRecords += NumDirty;
+		CurrentKeys.Reset();
+		for (const FCombatantNetRecord& Record : Proxy->GetCombatants())
+		{
+			const int32* SentKey = SentKeys.Find(Record.GetHandle());
+			if (!SentKey || *SentKey != Record.ReplicationKey)
+			{
+				PayloadBits += CombatReplicationBenchmark::GetPayloadBits(Record);
+			}
+			CurrentKeys.Add(Record.GetHandle(), Record.ReplicationKey);
+		}
+		Swap(SentKeys, CurrentKeys);
+	}
+
+	const double BytesPerSecond = PayloadBits / 8.0 / Seconds;
+	UE_LOG(LogNecromancer, Display, TEXT("CombatReplicationBenchmark: %d units, %d view updates over %.0fs, %.0f dirty records per update"),
+		NumUnits, UpdateMs.Num(), Seconds, DirtyRecords / static_cast<double>(FMath::Max(UpdateMs.Num(), 1)));
+	UE_LOG(LogNecromancer, Display, TEXT("CombatReplicationBenchmark: update %.3fms on average, %.3fms worst, %.0f payload bytes/s"),
+		UpdateMs.GetAverage(), UpdateMs.GetMax(), BytesPerSecond);
+
+	bool bFailed = false;
+	if (MaxUpdateMs > 0.f && UpdateMs.GetMax() > MaxUpdateMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatReplicationBenchmark: worst update %.3fms exceeds %.3fms"), UpdateMs.GetMax(), MaxUpdateMs);
+		bFailed = true;
+	}
+	if (MaxBytesPerSecond > 0.f && BytesPerSecond > MaxBytesPerSecond)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatReplicationBenchmark: %.0f bytes/s exceeds %.0f"), BytesPerSecond, MaxBytesPerSecond);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
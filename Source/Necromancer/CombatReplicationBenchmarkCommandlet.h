@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatReplicationBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs two armies closing on each other in a scratch combat simulation and refreshes one ACombatReplicationProxy
+ * from it at the proxy's net update rate, in a benchmark world without a network. Measures the server cost of
+ * UpdateView and the payload of the records it marks dirty, which is what a connection would be sent; fast array
+ * headers and packet overhead are not counted.
+ *
+ * Usage: -run=CombatReplicationBenchmark [-Units=2000] [-Seconds=10] [-Radius=6000] [-MaxRecords=512] [-MaxUpdateMs=1] [-MaxBytesPerSecond=80000] [-Seed=0]
+ * Returns non-zero if the worst update or the payload rate exceeds its limit; a limit of zero is not checked.
+ */
+UCLASS()
+class UCombatReplicationBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatReplicationBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
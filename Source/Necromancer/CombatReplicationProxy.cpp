@@ -0,0 +1,261 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatReplicationProxy.h"
+#include "CombatSimulation.h"
+#include "NecromancerGameState.h"
+#include "VisibilitySubsystem.h"
+#include "Necromancer.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("Combat Net Serialize"), STAT_CombatNetSerialize, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Combat Net Update View"), STAT_CombatNetUpdateView, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat Net Dirty Records"), STAT_CombatNetDirtyRecords, STATGROUP_Necromancer);
+
+namespace CombatReplication
+{
+	constexpr float PlanarStep = 8.f;
+	constexpr float HeightStep = 16.f;
+
+	// Zigzag keeps small negative coordinates as short as small positive ones once packed
+	FORCEINLINE uint32 ZigZag(int32 Value) { return (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31); }
+	FORCEINLINE int32 UnZigZag(uint32 Value) { return static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1); }
+
+	FORCEINLINE uint8 QuantizeHealth(float Health, float MaxHealth)
+	{
+		return MaxHealth > 0.f ? static_cast<uint8>(FMath::Clamp(FMath::CeilToInt32(Health / MaxHealth * 255.f), 0, 255)) : 0;
+	}
+}
+
+static FAutoConsoleCommandWithWorld GCombatNetReportCommand(
+	TEXT("necro.Net.Report"),
+	TEXT("Logs the combat replication bytes per second and server serialization time since the last report, then resets them"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		// Totals over every connection's proxy
+		FCombatNetCounters Total;
+		Total.StartTime = FPlatformTime::Seconds();
+		for (TActorIterator<ACombatReplicationProxy> It(World); It; ++It)
+		{
+			const FCombatNetCounters& Counters = It->GetCounters();
+			Total.SerializedBits += Counters.SerializedBits;
+			Total.SerializeSeconds += Counters.SerializeSeconds;
+			Total.StartTime = FMath::Min(Total.StartTime, Counters.StartTime);
+			It->ResetCounters();
+		}
+
+		const double Elapsed = FMath::Max(FPlatformTime::Seconds() - Total.StartTime, UE_DOUBLE_SMALL_NUMBER);
+		UE_LOG(LogNecromancer, Log, TEXT("Combat replication over %.1f s: %.0f bytes/s, %.3f ms/s serializing"),
+			Elapsed, Total.SerializedBits / 8.0 / Elapsed, Total.SerializeSeconds * 1000.0 / Elapsed);
+	}));
+
+FCombatNetPosition FCombatNetPosition::FromVector(const FVector& Location)
+{
+	FCombatNetPosition Position;
+	Position.X = FMath::RoundToInt32(Location.X / CombatReplication::PlanarStep);
+	Position.Y = FMath::RoundToInt32(Location.Y / CombatReplication::PlanarStep);
+	Position.Z = FMath::RoundToInt32(Location.Z / CombatReplication::HeightStep);
+	return Position;
+}
+
+FVector FCombatNetPosition::ToVector() const
+{
+	return FVector(X * CombatReplication::PlanarStep, Y * CombatReplication::PlanarStep, Z * CombatReplication::HeightStep);
+}
+
+bool FCombatNetPosition::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 PackedX = CombatReplication::ZigZag(X);
+	uint32 PackedY = CombatReplication::ZigZag(Y);
+	uint32 PackedZ = CombatReplication::ZigZag(Z);
+	Ar.SerializeIntPacked(PackedX);
+	Ar.SerializeIntPacked(PackedY);
+	Ar.SerializeIntPacked(PackedZ);
+	if (Ar.IsLoading())
+	{
+		X = CombatReplication::UnZigZag(PackedX);
+		Y = CombatReplication::UnZigZag(PackedY);
+		Z = CombatReplication::UnZigZag(PackedZ);
+	}
+
+	bOutSuccess = true;
+	return true;
+}
+
+bool FCombatantNetArray::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CombatNetSerialize);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int64 StartBits = DeltaParms.Writer ? DeltaParms.Writer->GetNumBits() : 0;
+
+	const bool bResult = FFastArraySerializer::FastArrayDeltaSerialize<FCombatantNetRecord, FCombatantNetArray>(Items, DeltaParms, *this);
+
+	if (DeltaParms.Writer && Owner)
+	{
+		Owner->AddSerializeCost(DeltaParms.Writer->GetNumBits() - StartBits, FPlatformTime::Seconds() - StartTime);
+	}
+	return bResult;
+}
+
+void FCombatantNetArray::PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters)
+{
+	if (Owner)
+	{
+		Owner->NotifyViewChanged();
+	}
+}
+
+ACombatReplicationProxy::ACombatReplicationProxy()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	bReplicates = true;
+	bOnlyRelevantToOwner = true;
+	bAlwaysRelevant = false;
+	SetNetUpdateFrequency(10.f);
+}
+
+void ACombatReplicationProxy::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ACombatReplicationProxy, Combatants);
+}
+
+void ACombatReplicationProxy::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	Combatants.Owner = this;
+	ResetCounters();
+}
+
+void ACombatReplicationProxy::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Only the owning client ever receives this actor, so it is that client's view
+	if (!HasAuthority())
+	{
+		if (ANecromancerGameState* GameState = GetWorld()->GetGameState<ANecromancerGameState>())
+		{
+			GameState->SetLocalCombatView(this);
+		}
+	}
+}
+
+void ACombatReplicationProxy::NotifyViewChanged()
+{
+	OnViewChanged.Broadcast();
+}
+
+void ACombatReplicationProxy::AddSerializeCost(int64 Bits, double Seconds)
+{
+	Counters.SerializedBits += Bits;
+	Counters.SerializeSeconds += Seconds;
+}
+
+void ACombatReplicationProxy::ResetCounters()
+{
+	Counters = FCombatNetCounters();
+	Counters.StartTime = FPlatformTime::Seconds();
+}
+
+int32 ACombatReplicationProxy::UpdateView(const FCombatSimulation& Simulation, const FVector& ViewLocation, float Radius, int32 MaxRecords,
+	const UVisibilitySubsystem* Visibility, ECombatTeam ViewerTeam)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CombatNetUpdateView);
+
+	// Over budget, the closest combatants win
+	FCombatSpatialQuery Query;
+	Query.Shape = ECombatQueryShape::Nearest;
+	Query.Origin = ViewLocation;
+	Query.Radius = Radius;
+	Query.MaxResults = MaxRecords;
+	Candidates.Reset();
+	Simulation.Query(Query, Candidates);
+
+	// Hidden enemies are never sent, so clients cannot reveal them
+	if (Visibility)
+	{
+		Candidates.RemoveAll([&Simulation, Visibility, ViewerTeam](const FCombatHandle& Handle)
+		{
+			return Simulation.GetTeam(Handle) != ViewerTeam && !Visibility->IsVisibleToTeam(ViewerTeam, Simulation.GetLocation(Handle));
+		});
+	}
+
+	++UpdateSerial;
+	int32 NumDirty = 0;
+	for (const FCombatHandle& Handle : Candidates)
+	{
+		const FCombatNetPosition Position = FCombatNetPosition::FromVector(Simulation.GetLocation(Handle));
+		const uint8 Health = CombatReplication::QuantizeHealth(Simulation.GetHealth(Handle), Simulation.GetMaxHealth(Handle));
+		const ECombatTeam Team = Simulation.GetTeam(Handle);
+
+		int32 ItemIndex;
+		if (const int32* Found = HandleToItem.Find(Handle))
+		{
+			ItemIndex = *Found;
+			FCombatantNetRecord& Record = Combatants.Items[ItemIndex];
+			if (!(Record.Position == Position) || Record.Health != Health || Record.Team != Team)
+			{
+				Record.Position = Position;
+				Record.Health = Health;
+				Record.Team = Team;
+				Combatants.MarkItemDirty(Record);
+				++NumDirty;
+			}
+		}
+		else
+		{
+			ItemIndex = Combatants.Items.AddDefaulted();
+			FCombatantNetRecord& Record = Combatants.Items[ItemIndex];
+			Record.Slot = Handle.Slot;
+			Record.Serial = Handle.Serial;
+			Record.Position = Position;
+			Record.Health = Health;
+			Record.Team = Team;
+			Combatants.MarkItemDirty(Record);
+			HandleToItem.Add(Handle, ItemIndex);
+			ItemLastSeen.Add(0);
+			++NumDirty;
+		}
+		ItemLastSeen[ItemIndex] = UpdateSerial;
+	}
+
+	// Drop whatever left the view. Walk backwards so swaps only move already visited records.
+	bool bRemoved = false;
+	for (int32 ItemIndex = Combatants.Items.Num() - 1; ItemIndex >= 0; --ItemIndex)
+	{
+		if (ItemLastSeen[ItemIndex] == UpdateSerial)
+		{
+			continue;
+		}
+
+		HandleToItem.Remove(Combatants.Items[ItemIndex].GetHandle());
+		Combatants.Items.RemoveAtSwap(ItemIndex, 1, EAllowShrinking::No);
+		ItemLastSeen.RemoveAtSwap(ItemIndex, 1, EAllowShrinking::No);
+		if (Combatants.Items.IsValidIndex(ItemIndex))
+		{
+			HandleToItem[Combatants.Items[ItemIndex].GetHandle()] = ItemIndex;
+		}
+		bRemoved = true;
+	}
+	if (bRemoved)
+	{
+		Combatants.MarkArrayDirty();
+	}
+
+	INC_DWORD_STAT_BY(STAT_CombatNetDirtyRecords, NumDirty);
+	return NumDirty;
+}
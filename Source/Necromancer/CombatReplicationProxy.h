@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "CombatTypes.h"
+#include "CombatReplicationProxy.generated.h"
+
+class ACombatReplicationProxy;
+class FCombatSimulation;
+class UVisibilitySubsystem;
+struct FCombatantNetArray;
+
+/** Location quantized to 8 cm steps in XY and 16 cm in Z, sent as packed integers */
+USTRUCT()
+struct FCombatNetPosition
+{
+	GENERATED_BODY()
+
+	int32 X = 0;
+	int32 Y = 0;
+	int32 Z = 0;
+
+	static FCombatNetPosition FromVector(const FVector& Location);
+	FVector ToVector() const;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+	bool operator==(const FCombatNetPosition& Other) const { return X == Other.X && Y == Other.Y && Z == Other.Z; }
+};
+
+template<>
+struct TStructOpsTypeTraits<FCombatNetPosition> : public TStructOpsTypeTraitsBase2<FCombatNetPosition>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+/** One combatant as seen by a client */
+USTRUCT()
+struct FCombatantNetRecord : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	/** Handle of the combatant on the server */
+	UPROPERTY()
+	int32 Slot = INDEX_NONE;
+
+	UPROPERTY()
+	uint32 Serial = 0;
+
+	UPROPERTY()
+	FCombatNetPosition Position;
+
+	/** Health as a fraction of maximum health, 0 to 255 */
+	UPROPERTY()
+	uint8 Health = 0;
+
+	UPROPERTY()
+	ECombatTeam Team = ECombatTeam::Neutral;
+
+	FCombatHandle GetHandle() const { return { Slot, Serial }; }
+};
+
+/** The combatants relevant to one connection. Only records marked dirty are serialized. */
+USTRUCT()
+struct FCombatantNetArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FCombatantNetRecord> Items;
+
+	/** Told about changes on clients */
+	ACombatReplicationProxy* Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+	void PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters);
+};
+
+template<>
+struct TStructOpsTypeTraits<FCombatantNetArray> : public TStructOpsTypeTraitsBase2<FCombatantNetArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+DECLARE_MULTICAST_DELEGATE(FOnCombatViewChanged);
+
+/** Server side serialization totals of one proxy since its counters were last reset */
+struct FCombatNetCounters
+{
+	int64 SerializedBits = 0;
+	double SerializeSeconds = 0.0;
+
+	/** FPlatformTime::Seconds() at the last reset */
+	double StartTime = 0.0;
+};
+
+/**
+ * Carries the combat state one player connection can see. Spawned by ANecromancerGameState for every remote player
+ * and relevant only to its owner, so each client receives its own slice of the battlefield.
+ * The server refreshes the slice from the combat simulation's spatial grid, keeps the closest combatants
+ * when there are too many, and marks a record dirty only when its quantized values changed.
+ */
+UCLASS(NotPlaceable, Transient)
+class NECROMANCER_API ACombatReplicationProxy : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACombatReplicationProxy();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostInitializeComponents() override;
+	virtual void BeginPlay() override;
+
+	/**
+	 * Server: makes the replicated slice match the combatants within Radius of ViewLocation, at most MaxRecords of them.
+	 * With Visibility, enemies ViewerTeam cannot see are left out. Returns how many records were marked dirty.
+	 */
+	int32 UpdateView(const FCombatSimulation& Simulation, const FVector& ViewLocation, float Radius, int32 MaxRecords,
+		const UVisibilitySubsystem* Visibility = nullptr, ECombatTeam ViewerTeam = ECombatTeam::Undead);
+
+	TConstArrayView<FCombatantNetRecord> GetCombatants() const { return Combatants.Items; }
+
+	/** Client: broadcast after a replication update changed the slice */
+	FOnCombatViewChanged OnViewChanged;
+
+	/** Client: called once per received replication update */
+	void NotifyViewChanged();
+
+	/** Server: counts one delta serialization of the slice, for necro.Net.Report */
+	void AddSerializeCost(int64 Bits, double Seconds);
+	const FCombatNetCounters& GetCounters() const { return Counters; }
+	void ResetCounters();
+
+private:
+	UPROPERTY(Replicated)
+	FCombatantNetArray Combatants;
+
+	/** Server: index into Combatants.Items, and the update that last found each record relevant */
+	TMap<FCombatHandle, int32> HandleToItem;
+	TArray<uint32> ItemLastSeen;
+	uint32 UpdateSerial = 0;
+
+	TArray<FCombatHandle> Candidates;
+
+	FCombatNetCounters Counters;
+};
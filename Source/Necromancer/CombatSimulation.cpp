@@ -0,0 +1,553 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSimulation.h"
+#include "CombatSnapshot.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Crc.h"
+
+namespace CombatSimulation
+{
+	// Combatants processed per ParallelFor task
+	constexpr int32 BatchSize = 512;
+
+	// Movement lattice, in world units
+	constexpr double MoveSnap = 0.125;
+}
+
+FCombatSimulation::FCombatSimulation(const FCombatSimulationSettings& InSettings)
+	: Settings(InSettings)
+	, StepSeconds(1.f / InSettings.StepsPerSecond)
+	, SpatialGrid(InSettings.SpatialCellSize)
+{
+	check(InSettings.StepsPerSecond > 0);
+}
+
+void FCombatSimulation::Reset()
+{
+	SlotToDense.Reset();
+	SlotSerials.Reset();
+	FreeSlots.Reset();
+	DenseToSlot.Reset();
+	Team.Reset();
+	Health.Reset();
+	MaxHealth.Reset();
+	AttackDamage.Reset();
+	AttackIntervalSteps.Reset();
+	AttackCooldownSteps.Reset();
+	AttackRange.Reset();
+	Target.Reset();
+	Location.Reset();
+	PendingHits.Reset();
+	Killed.Reset();
+	SpatialGrid.Reset();
+	StepIndex = 0;
+	NextSerial = 1;
+}
+
+FCombatHandle FCombatSimulation::Add(const FCombatantDesc& Desc)
+{
+	FCombatHandle Handle;
+	if (FreeSlots.Num() > 0)
+	{
+		Handle.Slot = FreeSlots.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		Handle.Slot = SlotToDense.Add(INDEX_NONE);
+		SlotSerials.Add(0);
+	}
+	Handle.Serial = NextSerial++;
+	SlotSerials[Handle.Slot] = Handle.Serial;
+
+	const int32 DenseIndex = DenseToSlot.Add(Handle.Slot);
+	SlotToDense[Handle.Slot] = DenseIndex;
+
+	Team.Add(Desc.Team);
+	Health.Add(CombatFixed::FromFloat(Desc.MaxHealth));
+	MaxHealth.Add(CombatFixed::FromFloat(Desc.MaxHealth));
+	AttackDamage.Add(CombatFixed::FromFloat(Desc.AttackDamage));
+	AttackIntervalSteps.Add(SecondsToSteps(Desc.AttackInterval));
+	AttackCooldownSteps.Add(0);
+	AttackRange.Add(Desc.AttackRange);
+	Target.AddDefaulted();
+	Location.Add(Desc.Location);
+
+	if (Health[DenseIndex] > 0)
+	{
+		SpatialGrid.Add(Handle.Slot, Desc.Location, CombatTeamBit(Desc.Team));
+	}
+
+	return Handle;
+}
+
+void FCombatSimulation::Remove(FCombatHandle Handle)
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	if (DenseIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	RemoveDense(DenseIndex);
+	SpatialGrid.Remove(Handle.Slot);
+	SlotToDense[Handle.Slot] = INDEX_NONE;
+	SlotSerials[Handle.Slot] = 0;
+	FreeSlots.Add(Handle.Slot);
+}
+
+int32 FCombatSimulation::ResolveDense(FCombatHandle Handle) const
+{
+	if (!SlotToDense.IsValidIndex(Handle.Slot) || SlotSerials[Handle.Slot] != Handle.Serial)
+	{
+		return INDEX_NONE;
+	}
+	return SlotToDense[Handle.Slot];
+}
+
+void FCombatSimulation::RemoveDense(int32 DenseIndex)
+{
+	// Swap the last combatant into the hole so the arrays stay contiguous
+	const int32 LastIndex = DenseToSlot.Num() - 1;
+	if (DenseIndex != LastIndex)
+	{
+		SlotToDense[DenseToSlot[LastIndex]] = DenseIndex;
+	}
+
+	DenseToSlot.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	Team.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	Health.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	MaxHealth.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	AttackDamage.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	AttackIntervalSteps.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	AttackCooldownSteps.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	AttackRange.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	Target.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+	Location.RemoveAtSwap(DenseIndex, 1, EAllowShrinking::No);
+}
+
+float FCombatSimulation::GetHealth(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE ? CombatFixed::ToFloat(Health[DenseIndex]) : 0.f;
+}
+
+float FCombatSimulation::GetMaxHealth(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE ? CombatFixed::ToFloat(MaxHealth[DenseIndex]) : 0.f;
+}
+
+bool FCombatSimulation::IsAlive(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE && Health[DenseIndex] > 0;
+}
+
+ECombatTeam FCombatSimulation::GetTeam(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE ? Team[DenseIndex] : ECombatTeam::Neutral;
+}
+
+float FCombatSimulation::GetAttackRange(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE ? AttackRange[DenseIndex] : 0.f;
+}
+
+float FCombatSimulation::GetAttribute(FCombatHandle Handle, ECombatAttribute Attribute) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	if (DenseIndex == INDEX_NONE)
+	{
+		return 0.f;
+	}
+
+	switch (Attribute)
+	{
+	case ECombatAttribute::MaxHealth:
+		return CombatFixed::ToFloat(MaxHealth[DenseIndex]);
+	case ECombatAttribute::AttackDamage:
+		return CombatFixed::ToFloat(AttackDamage[DenseIndex]);
+	case ECombatAttribute::AttackInterval:
+		return AttackIntervalSteps[DenseIndex] * StepSeconds;
+	case ECombatAttribute::AttackRange:
+		return AttackRange[DenseIndex];
+	default:
+		return 0.f;
+	}
+}
+
+void FCombatSimulation::SetAttribute(FCombatHandle Handle, ECombatAttribute Attribute, float Value)
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	if (DenseIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	switch (Attribute)
+	{
+	case ECombatAttribute::MaxHealth:
+		MaxHealth[DenseIndex] = FMath::Max(CombatFixed::FromFloat(Value), 1);
+		Health[DenseIndex] = FMath::Min(Health[DenseIndex], MaxHealth[DenseIndex]);
+		break;
+	case ECombatAttribute::AttackDamage:
+		AttackDamage[DenseIndex] = FMath::Max(CombatFixed::FromFloat(Value), 0);
+		break;
+	case ECombatAttribute::AttackInterval:
+		AttackIntervalSteps[DenseIndex] = SecondsToSteps(Value);
+		break;
+	case ECombatAttribute::AttackRange:
+		AttackRange[DenseIndex] = FMath::Max(Value, 0.f);
+		break;
+	default:
+		break;
+	}
+}
+
+FVector FCombatSimulation::GetLocation(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE ? Location[DenseIndex] : FVector::ZeroVector;
+}
+
+FCombatHandle FCombatSimulation::GetTarget(FCombatHandle Handle) const
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	return DenseIndex != INDEX_NONE ? Target[DenseIndex] : FCombatHandle();
+}
+
+void FCombatSimulation::SetLocation(FCombatHandle Handle, const FVector& NewLocation)
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	if (DenseIndex != INDEX_NONE)
+	{
+		Location[DenseIndex] = NewLocation;
+	}
+}
+
+void FCombatSimulation::SetLocations(TConstArrayView<FCombatHandle> Handles, TConstArrayView<FVector> NewLocations)
+{
+	check(Handles.Num() == NewLocations.Num());
+	for (int32 Index = 0; Index < Handles.Num(); ++Index)
+	{
+		const int32 DenseIndex = ResolveDense(Handles[Index]);
+		if (DenseIndex != INDEX_NONE)
+		{
+			Location[DenseIndex] = NewLocations[Index];
+		}
+	}
+}
+
+void FCombatSimulation::SetTarget(FCombatHandle Attacker, FCombatHandle NewTarget)
+{
+	const int32 DenseIndex = ResolveDense(Attacker);
+	if (DenseIndex != INDEX_NONE)
+	{
+		Target[DenseIndex] = NewTarget;
+	}
+}
+
+bool FCombatSimulation::ApplyDamage(FCombatHandle Victim, float Damage)
+{
+	return ApplyFixedDamage(Victim, CombatFixed::FromFloat(Damage));
+}
+
+bool FCombatSimulation::ApplyFixedDamage(FCombatHandle Victim, int32 Damage)
+{
+	const int32 DenseIndex = ResolveDense(Victim);
+	if (DenseIndex == INDEX_NONE || Health[DenseIndex] <= 0)
+	{
+		return false;
+	}
+
+	Health[DenseIndex] = FMath::Max(Health[DenseIndex] - Damage, 0);
+	if (Health[DenseIndex] > 0)
+	{
+		return false;
+	}
+
+	HandleDeath(DenseIndex);
+	return true;
+}
+
+void FCombatSimulation::ApplyFixedHeal(FCombatHandle Recipient, int32 Amount)
+{
+	const int32 DenseIndex = ResolveDense(Recipient);
+	if (DenseIndex != INDEX_NONE && Health[DenseIndex] > 0)
+	{
+		Health[DenseIndex] = FMath::Min(Health[DenseIndex] + FMath::Max(Amount, 0), MaxHealth[DenseIndex]);
+	}
+}
+
+bool FCombatSimulation::Kill(FCombatHandle Victim)
+{
+	const int32 DenseIndex = ResolveDense(Victim);
+	return DenseIndex != INDEX_NONE && ApplyFixedDamage(Victim, Health[DenseIndex]);
+}
+
+bool FCombatSimulation::Revive(FCombatHandle Handle, ECombatTeam NewTeam)
+{
+	const int32 DenseIndex = ResolveDense(Handle);
+	if (DenseIndex == INDEX_NONE || Health[DenseIndex] > 0 || MaxHealth[DenseIndex] <= 0)
+	{
+		return false;
+	}
+
+	Team[DenseIndex] = NewTeam;
+	Health[DenseIndex] = MaxHealth[DenseIndex];
+	AttackCooldownSteps[DenseIndex] = 0;
+	Target[DenseIndex].Reset();
+	SpatialGrid.Add(Handle.Slot, Location[DenseIndex], CombatTeamBit(NewTeam));
+	return true;
+}
+
+void FCombatSimulation::GatherLive(TArray<FCombatHandle>& OutHandles, TArray<ECombatTeam>& OutTeams, TArray<FVector>& OutLocations) const
+{
+	for (int32 DenseIndex = 0; DenseIndex < Health.Num(); ++DenseIndex)
+	{
+		if (Health[DenseIndex] > 0)
+		{
+			OutHandles.Add(MakeHandle(DenseToSlot[DenseIndex]));
+			OutTeams.Add(Team[DenseIndex]);
+			OutLocations.Add(Location[DenseIndex]);
+		}
+	}
+}
+
+void FCombatSimulation::QueryBatch(TConstArrayView<FCombatSpatialQuery> Queries, TArray<TArray<FCombatHandle>>& OutResults) const
+{
+	OutResults.SetNum(Queries.Num());
+	ParallelFor(Queries.Num(), [this, Queries, &OutResults](int32 QueryIndex)
+	{
+		OutResults[QueryIndex].Reset();
+		Query(Queries[QueryIndex], OutResults[QueryIndex]);
+	});
+}
+
+void FCombatSimulation::UpdateSpatialGrid()
+{
+	// Dead combatants were removed from the grid when they died
+	for (int32 Index = 0; Index < Health.Num(); ++Index)
+	{
+		if (Health[Index] > 0)
+		{
+			SpatialGrid.Update(DenseToSlot[Index], Location[Index]);
+		}
+	}
+}
+
+int32 FCombatSimulation::AcquireTarget(int32 DenseIndex)
+{
+	FCombatSpatialQuery Nearest;
+	Nearest.Shape = ECombatQueryShape::Nearest;
+	Nearest.Origin = Location[DenseIndex];
+	Nearest.Radius = Settings.TargetAcquisitionRadius;
+	Nearest.TeamMask = CombatHostileTeamMask(Team[DenseIndex]);
+	Nearest.MaxResults = 1;
+
+	TArray<int32, TInlineAllocator<1>> Found;
+	SpatialGrid.Query(Nearest, Found);
+	if (Found.Num() == 0)
+	{
+		Target[DenseIndex].Reset();
+		return INDEX_NONE;
+	}
+
+	Target[DenseIndex] = MakeHandle(Found[0]);
+	return SlotToDense[Found[0]];
+}
+
+void FCombatSimulation::Step(TArray<FCombatEvent>& OutHits)
+{
+	++StepIndex;
+	Killed.Reset();
+
+	const int32 NumCombatants = Health.Num();
+	if (NumCombatants == 0)
+	{
+		return;
+	}
+
+	UpdateSpatialGrid();
+
+	// Cooldowns, target acquisition and attack checks only read other combatants, so every batch can run independently
+	PendingHits.SetNumUninitialized(NumCombatants, EAllowShrinking::No);
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumCombatants, CombatSimulation::BatchSize);
+	ParallelFor(NumBatches, [this, NumCombatants](int32 BatchIndex)
+	{
+		const int32 Start = BatchIndex * CombatSimulation::BatchSize;
+		const int32 End = FMath::Min(Start + CombatSimulation::BatchSize, NumCombatants);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			PendingHits[Index] = INDEX_NONE;
+			if (Health[Index] <= 0)
+			{
+				continue;
+			}
+
+			int32 TargetIndex = ResolveDense(Target[Index]);
+			if (TargetIndex == INDEX_NONE || Health[TargetIndex] <= 0)
+			{
+				TargetIndex = AcquireTarget(Index);
+			}
+
+			AttackCooldownSteps[Index] = FMath::Max(AttackCooldownSteps[Index] - 1, 0);
+			if (AttackCooldownSteps[Index] > 0 || TargetIndex == INDEX_NONE)
+			{
+				continue;
+			}
+
+			if (FVector::DistSquared(Location[Index], Location[TargetIndex]) <= FMath::Square(AttackRange[Index]))
+			{
+				PendingHits[Index] = TargetIndex;
+				AttackCooldownSteps[Index] = AttackIntervalSteps[Index];
+			}
+		}
+	});
+
+	// Report hits in index order so results don't depend on task scheduling
+	for (int32 Index = 0; Index < NumCombatants; ++Index)
+	{
+		const int32 VictimIndex = PendingHits[Index];
+		if (VictimIndex != INDEX_NONE)
+		{
+			OutHits.Add({ ECombatEventType::Damage, MakeHandle(DenseToSlot[VictimIndex]), MakeHandle(DenseToSlot[Index]), AttackDamage[Index] });
+		}
+	}
+}
+
+void FCombatSimulation::HandleDeath(int32 DenseIndex)
+{
+	Target[DenseIndex].Reset();
+	SpatialGrid.Remove(DenseToSlot[DenseIndex]);
+	Killed.Add(MakeHandle(DenseToSlot[DenseIndex]));
+}
+
+uint32 FCombatSimulation::ComputeChecksum() const
+{
+	uint32 Crc = FCrc::MemCrc32(&StepIndex, sizeof(StepIndex));
+	Crc = FCrc::MemCrc32(Health.GetData(), Health.Num() * Health.GetTypeSize(), Crc);
+	Crc = FCrc::MemCrc32(AttackCooldownSteps.GetData(), AttackCooldownSteps.Num() * AttackCooldownSteps.GetTypeSize(), Crc);
+	Crc = FCrc::MemCrc32(Location.GetData(), Location.Num() * Location.GetTypeSize(), Crc);
+	Crc = FCrc::MemCrc32(Target.GetData(), Target.Num() * Target.GetTypeSize(), Crc);
+	return Crc;
+}
+
+void FCombatSimulation::WriteSnapshot(FCombatSnapshotWriter& Writer) const
+{
+	const uint32 State[] = { StepIndex, NextSerial, static_cast<uint32>(Settings.StepsPerSecond) };
+	Writer.AddSection<uint32>(ECombatSnapshotSection::SimState, State);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimSlotToDense, SlotToDense);
+	Writer.AddSection<uint32>(ECombatSnapshotSection::SimSlotSerials, SlotSerials);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimFreeSlots, FreeSlots);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimDenseToSlot, DenseToSlot);
+	Writer.AddSection<ECombatTeam>(ECombatSnapshotSection::SimTeam, Team);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimHealth, Health);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimMaxHealth, MaxHealth);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimAttackDamage, AttackDamage);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimAttackIntervalSteps, AttackIntervalSteps);
+	Writer.AddSection<int32>(ECombatSnapshotSection::SimAttackCooldownSteps, AttackCooldownSteps);
+	Writer.AddSection<float>(ECombatSnapshotSection::SimAttackRange, AttackRange);
+	Writer.AddSection<FCombatHandle>(ECombatSnapshotSection::SimTarget, Target);
+	Writer.AddSection<FVector>(ECombatSnapshotSection::SimLocation, Location);
+}
+
+bool FCombatSimulation::ReadSnapshot(const FCombatSnapshotReader& Reader)
+{
+	const TConstArrayView<uint32> State = Reader.GetSection<uint32>(ECombatSnapshotSection::SimState);
+	if (State.Num() < 3 || State[2] != static_cast<uint32>(Settings.StepsPerSecond))
+	{
+		return false;
+	}
+
+	// Everything indexed by slot or dense index has to agree before any of it is trusted
+	const TConstArrayView<int32> InSlotToDense = Reader.GetSection<int32>(ECombatSnapshotSection::SimSlotToDense);
+	const TConstArrayView<int32> InFreeSlots = Reader.GetSection<int32>(ECombatSnapshotSection::SimFreeSlots);
+	const TConstArrayView<int32> InDenseToSlot = Reader.GetSection<int32>(ECombatSnapshotSection::SimDenseToSlot);
+	const TConstArrayView<ECombatTeam> InTeam = Reader.GetSection<ECombatTeam>(ECombatSnapshotSection::SimTeam);
+	const int32 NumSlots = InSlotToDense.Num();
+	const int32 NumDense = InDenseToSlot.Num();
+	const bool bSizesMatch = Reader.GetSection<uint32>(ECombatSnapshotSection::SimSlotSerials).Num() == NumSlots
+		&& InTeam.Num() == NumDense
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::SimHealth).Num() == NumDense
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::SimMaxHealth).Num() == NumDense
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::SimAttackDamage).Num() == NumDense
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::SimAttackIntervalSteps).Num() == NumDense
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::SimAttackCooldownSteps).Num() == NumDense
+		&& Reader.GetSection<float>(ECombatSnapshotSection::SimAttackRange).Num() == NumDense
+		&& Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::SimTarget).Num() == NumDense
+		&& Reader.GetSection<FVector>(ECombatSnapshotSection::SimLocation).Num() == NumDense;
+	if (!bSizesMatch)
+	{
+		return false;
+	}
+	for (int32 Index = 0; Index < NumDense; ++Index)
+	{
+		const int32 Slot = InDenseToSlot[Index];
+		if (Slot < 0 || Slot >= NumSlots || InSlotToDense[Slot] != Index || static_cast<uint8>(InTeam[Index]) > static_cast<uint8>(ECombatTeam::Neutral))
+		{
+			return false;
+		}
+	}
+	for (const int32 Slot : InFreeSlots)
+	{
+		if (Slot < 0 || Slot >= NumSlots || InSlotToDense[Slot] != INDEX_NONE)
+		{
+			return false;
+		}
+	}
+
+	Reset();
+	StepIndex = State[0];
+	NextSerial = State[1];
+	Reader.CopySection(ECombatSnapshotSection::SimSlotToDense, SlotToDense);
+	Reader.CopySection(ECombatSnapshotSection::SimSlotSerials, SlotSerials);
+	Reader.CopySection(ECombatSnapshotSection::SimFreeSlots, FreeSlots);
+	Reader.CopySection(ECombatSnapshotSection::SimDenseToSlot, DenseToSlot);
+	Reader.CopySection(ECombatSnapshotSection::SimTeam, Team);
+	Reader.CopySection(ECombatSnapshotSection::SimHealth, Health);
+	Reader.CopySection(ECombatSnapshotSection::SimMaxHealth, MaxHealth);
+	Reader.CopySection(ECombatSnapshotSection::SimAttackDamage, AttackDamage);
+	Reader.CopySection(ECombatSnapshotSection::SimAttackIntervalSteps, AttackIntervalSteps);
+	Reader.CopySection(ECombatSnapshotSection::SimAttackCooldownSteps, AttackCooldownSteps);
+	Reader.CopySection(ECombatSnapshotSection::SimAttackRange, AttackRange);
+	Reader.CopySection(ECombatSnapshotSection::SimTarget, Target);
+	Reader.CopySection(ECombatSnapshotSection::SimLocation, Location);
+
+	// The grid is derived state and cheaper to rebuild than to store
+	for (int32 Index = 0; Index < NumDense; ++Index)
+	{
+		if (Health[Index] > 0)
+		{
+			SpatialGrid.Add(DenseToSlot[Index], Location[Index], CombatTeamBit(Team[Index]));
+		}
+	}
+	return true;
+}
+
+FVector FCombatSimulation::StepTowards(FVector& Location, const FVector& Goal, float StopDistance, float Speed, float DeltaSeconds)
+{
+	FVector ToGoal = Goal - Location;
+	ToGoal.Z = 0.f;
+	const double Distance = ToGoal.Size();
+	if (Distance <= StopDistance)
+	{
+		return FVector::ZeroVector;
+	}
+
+	// Only IEEE exact operations (add, mul, div, sqrt) so every platform computes the same lattice point
+	const FVector Direction = ToGoal / Distance;
+	const double Step = FMath::Min(static_cast<double>(Speed) * DeltaSeconds, Distance - StopDistance);
+	Location.X = FMath::GridSnap(Location.X + Direction.X * Step, CombatSimulation::MoveSnap);
+	Location.Y = FMath::GridSnap(Location.Y + Direction.Y * Step, CombatSimulation::MoveSnap);
+	return Direction;
+}
+
+void FCombatSimulation::MoveBy(FVector& Location, const FVector& Velocity, float DeltaSeconds)
+{
+	Location.X = FMath::GridSnap(Location.X + Velocity.X * DeltaSeconds, CombatSimulation::MoveSnap);
+	Location.Y = FMath::GridSnap(Location.Y + Velocity.Y * DeltaSeconds, CombatSimulation::MoveSnap);
+}
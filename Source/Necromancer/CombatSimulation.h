@@ -0,0 +1,183 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatTypes.h"
+#include "CombatEventBus.h"
+#include "CombatSpatialGrid.h"
+
+class FCombatSnapshotReader;
+class FCombatSnapshotWriter;
+
+/** Health and damage are stored as integers in units of 1 / Scale health points. */
+namespace CombatFixed
+{
+	constexpr int32 Scale = 100;
+
+	FORCEINLINE int32 FromFloat(float Value) { return FMath::RoundToInt32(Value * Scale); }
+	FORCEINLINE float ToFloat(int32 Value) { return static_cast<float>(Value) / Scale; }
+}
+
+/** Parameters fixed for the lifetime of an FCombatSimulation. */
+struct FCombatSimulationSettings
+{
+	int32 StepsPerSecond = 30;
+	float TargetAcquisitionRadius = 1200.f;
+	float SpatialCellSize = 500.f;
+};
+
+/**
+ * Combat state of every combatant and the fixed-rate step that advances it. Independent of UWorld,
+ * so it can run faster than real time without a game world.
+ *
+ * A step gives the same result for the same inputs: health and damage are fixed point, cooldowns
+ * count whole steps, movement is snapped to a fixed lattice, and hits are applied in dense index order
+ * after the parallel pass.
+ *
+ * State is kept as parallel arrays indexed by a dense index; FCombatHandle maps to it through a slot table.
+ * Live combatants are also indexed in a spatial grid keyed by slot.
+ */
+class NECROMANCER_API FCombatSimulation
+{
+public:
+	explicit FCombatSimulation(const FCombatSimulationSettings& InSettings = FCombatSimulationSettings());
+
+	FCombatHandle Add(const FCombatantDesc& Desc);
+	void Remove(FCombatHandle Handle);
+	void Reset();
+
+	bool IsValid(FCombatHandle Handle) const { return ResolveDense(Handle) != INDEX_NONE; }
+	int32 Num() const { return Health.Num(); }
+
+	float GetHealth(FCombatHandle Handle) const;
+	float GetMaxHealth(FCombatHandle Handle) const;
+	bool IsAlive(FCombatHandle Handle) const;
+	ECombatTeam GetTeam(FCombatHandle Handle) const;
+	float GetAttackRange(FCombatHandle Handle) const;
+	FVector GetLocation(FCombatHandle Handle) const;
+	FCombatHandle GetTarget(FCombatHandle Handle) const;
+
+	/** Current value of a modifiable stat, in the units of FCombatantDesc */
+	float GetAttribute(FCombatHandle Handle, ECombatAttribute Attribute) const;
+
+	/** Overwrites a modifiable stat. Lowering MaxHealth also caps current health. */
+	void SetAttribute(FCombatHandle Handle, ECombatAttribute Attribute, float Value);
+
+	void SetLocation(FCombatHandle Handle, const FVector& NewLocation);
+	void SetLocations(TConstArrayView<FCombatHandle> Handles, TConstArrayView<FVector> NewLocations);
+	void SetTarget(FCombatHandle Attacker, FCombatHandle NewTarget);
+
+	/** Applies damage immediately. Returns true if it killed the combatant. */
+	bool ApplyDamage(FCombatHandle Victim, float Damage);
+
+	/** ApplyDamage with Damage already in CombatFixed units */
+	bool ApplyFixedDamage(FCombatHandle Victim, int32 Damage);
+
+	/** Restores Amount (CombatFixed units) of health, up to the maximum. The dead are not healed. */
+	void ApplyFixedHeal(FCombatHandle Recipient, int32 Amount);
+
+	/** Sets health to zero. Returns true if the combatant was alive. */
+	bool Kill(FCombatHandle Victim);
+
+	/** Brings a dead combatant back at full health, fighting for NewTeam. Returns false if it is alive or unknown. */
+	bool Revive(FCombatHandle Handle, ECombatTeam NewTeam);
+
+	/** Appends the live combatants matching Query to OutHandles. */
+	template <typename AllocatorType>
+	void Query(const FCombatSpatialQuery& Query, TArray<FCombatHandle, AllocatorType>& OutHandles) const;
+
+	/** Appends every live combatant with its team and location, in dense order */
+	void GatherLive(TArray<FCombatHandle>& OutHandles, TArray<ECombatTeam>& OutTeams, TArray<FVector>& OutLocations) const;
+
+	/** Runs independent queries in parallel. OutResults[i] receives the matches of Queries[i]. */
+	void QueryBatch(TConstArrayView<FCombatSpatialQuery> Queries, TArray<TArray<FCombatHandle>>& OutResults) const;
+
+	/**
+	 * Advances cooldowns, target acquisition and attacks by one fixed step. Attacks do not change health here: each
+	 * hit is appended to OutHits as a damage event, in attacker order, to be applied through FCombatEventBus.
+	 */
+	void Step(TArray<FCombatEvent>& OutHits);
+
+	/** Combatants killed by the last Step or by damage applied since */
+	TConstArrayView<FCombatHandle> GetKilledLastStep() const { return Killed; }
+
+	uint32 GetStepIndex() const { return StepIndex; }
+	float GetStepSeconds() const { return StepSeconds; }
+	int32 SecondsToSteps(float Seconds) const { return FMath::Max(FMath::RoundToInt32(Seconds * Settings.StepsPerSecond), 1); }
+	const FCombatSimulationSettings& GetSettings() const { return Settings; }
+
+	/** Hash of the dense state, for comparing two runs of the same scenario. */
+	uint32 ComputeChecksum() const;
+
+	/** Copies the slot table and every dense array into Writer */
+	void WriteSnapshot(FCombatSnapshotWriter& Writer) const;
+
+	/**
+	 * Replaces the whole state by the one in Reader, keeping every handle it contained valid. Returns false and
+	 * leaves the state untouched if the snapshot is inconsistent or was taken at another step rate.
+	 */
+	bool ReadSnapshot(const FCombatSnapshotReader& Reader);
+
+	/**
+	 * Moves Location toward Goal on the XY plane by at most Speed * DeltaSeconds, stopping StopDistance short.
+	 * The result is snapped to a 1/8 unit lattice. Returns the direction moved, or zero if already there.
+	 */
+	static FVector StepTowards(FVector& Location, const FVector& Goal, float StopDistance, float Speed, float DeltaSeconds);
+
+	/** Moves Location by Velocity * DeltaSeconds on the XY plane, snapped to the same lattice as StepTowards. */
+	static void MoveBy(FVector& Location, const FVector& Velocity, float DeltaSeconds);
+
+private:
+	int32 ResolveDense(FCombatHandle Handle) const;
+	FCombatHandle MakeHandle(int32 Slot) const { return { Slot, SlotSerials[Slot] }; }
+	void RemoveDense(int32 DenseIndex);
+	void UpdateSpatialGrid();
+	void HandleDeath(int32 DenseIndex);
+
+	/** Points DenseIndex at the nearest hostile and returns its dense index. Only writes DenseIndex's own state. */
+	int32 AcquireTarget(int32 DenseIndex);
+
+	FCombatSimulationSettings Settings;
+	float StepSeconds;
+	uint32 StepIndex = 0;
+
+	/** Slot table, indexed by FCombatHandle::Slot. */
+	TArray<int32> SlotToDense;
+	TArray<uint32> SlotSerials;
+	TArray<int32> FreeSlots;
+	uint32 NextSerial = 1;
+
+	/** Dense combatant state, one entry per combatant. */
+	TArray<int32> DenseToSlot;
+	TArray<ECombatTeam> Team;
+	TArray<int32> Health;
+	TArray<int32> MaxHealth;
+	TArray<int32> AttackDamage;
+	TArray<int32> AttackIntervalSteps;
+	TArray<int32> AttackCooldownSteps;
+	TArray<float> AttackRange;
+	TArray<FCombatHandle> Target;
+	TArray<FVector> Location;
+
+	/** Live combatants keyed by slot */
+	FCombatSpatialGrid SpatialGrid;
+
+	/** Dense index of the victim each attacker hit this step, or INDEX_NONE. Written by the parallel pass. */
+	TArray<int32> PendingHits;
+
+	TArray<FCombatHandle> Killed;
+};
+
+template <typename AllocatorType>
+void FCombatSimulation::Query(const FCombatSpatialQuery& InQuery, TArray<FCombatHandle, AllocatorType>& OutHandles) const
+{
+	TArray<int32, TInlineAllocator<64>> Slots;
+	SpatialGrid.Query(InQuery, Slots);
+
+	OutHandles.Reserve(OutHandles.Num() + Slots.Num());
+	for (const int32 Slot : Slots)
+	{
+		OutHandles.Add(MakeHandle(Slot));
+	}
+}
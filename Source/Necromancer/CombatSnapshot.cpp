@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSnapshot.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+
+namespace CombatSnapshot
+{
+	// 'NCSS' in the writer's byte order; a reader with the other byte order sees it reversed and rejects the file
+	constexpr uint32 Magic = 0x4E435353;
+	constexpr uint32 Version = 1;
+
+	// Every section starts on this boundary, so mapped views can be used as arrays of any stored type
+	constexpr int64 Alignment = 16;
+
+	struct FFileHeader
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		uint32 NumSections = 0;
+		uint32 Reserved = 0;
+		int64 FileSize = 0;
+	};
+
+	constexpr int64 TableOffset = Align(static_cast<int64>(sizeof(FFileHeader)), Alignment);
+
+	int64 GetPayloadStart(int32 NumSections)
+	{
+		return Align(TableOffset + NumSections * static_cast<int64>(sizeof(FCombatSnapshotSectionEntry)), Alignment);
+	}
+}
+
+int32 FCombatSnapshotWriter::AddString(FName Name)
+{
+	if (const int32* Index = StringIndices.Find(Name))
+	{
+		return *Index;
+	}
+
+	const FTCHARToUTF8 Utf8(*Name.ToString());
+	StringData.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	StringOffsets.Add(StringData.Num());
+	return StringIndices.Add(Name, StringOffsets.Num() - 1);
+}
+
+void FCombatSnapshotWriter::AddRawSection(ECombatSnapshotSection Id, uint32 ElementSize, const void* Data, int64 Count)
+{
+	FSection& Section = Sections.AddDefaulted_GetRef();
+	Section.Id = Id;
+	Section.ElementSize = ElementSize;
+	Section.Count = Count;
+	Section.PayloadOffset = Align(Payload.Num(), CombatSnapshot::Alignment);
+
+	const int64 NumBytes = static_cast<int64>(ElementSize) * Count;
+	const int64 PaddingStart = Payload.Num();
+	Payload.SetNumUninitialized(Section.PayloadOffset + NumBytes, EAllowShrinking::No);
+	FMemory::Memzero(Payload.GetData() + PaddingStart, Section.PayloadOffset - PaddingStart);
+	if (NumBytes > 0)
+	{
+		FMemory::Memcpy(Payload.GetData() + Section.PayloadOffset, Data, NumBytes);
+	}
+}
+
+int64 FCombatSnapshotWriter::ComputeLayout(TArray<FCombatSnapshotSectionEntry>& OutTable) const
+{
+	const int32 NumSections = Sections.Num() + 2;
+	const int64 PayloadStart = CombatSnapshot::GetPayloadStart(NumSections);
+
+	OutTable.Reset(NumSections);
+	for (const FSection& Section : Sections)
+	{
+		OutTable.Add({ static_cast<uint32>(Section.Id), Section.ElementSize, PayloadStart + Section.PayloadOffset, Section.Count });
+	}
+
+	const int64 OffsetsStart = Align(PayloadStart + Payload.Num(), CombatSnapshot::Alignment);
+	const int64 DataStart = Align(OffsetsStart + StringOffsets.Num() * static_cast<int64>(sizeof(uint32)), CombatSnapshot::Alignment);
+	OutTable.Add({ static_cast<uint32>(ECombatSnapshotSection::StringOffsets), sizeof(uint32), OffsetsStart, StringOffsets.Num() });
+	OutTable.Add({ static_cast<uint32>(ECombatSnapshotSection::StringData), sizeof(uint8), DataStart, StringData.Num() });
+	return DataStart + StringData.Num();
+}
+
+int64 FCombatSnapshotWriter::GetTotalSize() const
+{
+	TArray<FCombatSnapshotSectionEntry> Table;
+	return ComputeLayout(Table);
+}
+
+bool FCombatSnapshotWriter::SaveToFile(const FString& Filename) const
+{
+	TArray<FCombatSnapshotSectionEntry> Table;
+	CombatSnapshot::FFileHeader Header;
+	Header.Magic = CombatSnapshot::Magic;
+	Header.Version = CombatSnapshot::Version;
+	Header.FileSize = ComputeLayout(Table);
+	Header.NumSections = Table.Num();
+
+	// Readers never see a half-written file: it only takes Filename's place once complete
+	const FString TempFilename = Filename + TEXT(".tmp");
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempFilename));
+	if (!Writer)
+	{
+		return false;
+	}
+
+	static uint8 Padding[CombatSnapshot::Alignment] = {};
+	const auto WriteAt = [&Writer](int64 Offset, const void* Bytes, int64 NumBytes)
+	{
+		check(Offset >= Writer->Tell() && Offset - Writer->Tell() < CombatSnapshot::Alignment);
+		Writer->Serialize(Padding, Offset - Writer->Tell());
+		Writer->Serialize(const_cast<void*>(Bytes), NumBytes);
+	};
+
+	WriteAt(0, &Header, sizeof(Header));
+	WriteAt(CombatSnapshot::TableOffset, Table.GetData(), Table.Num() * sizeof(FCombatSnapshotSectionEntry));
+	WriteAt(CombatSnapshot::GetPayloadStart(Table.Num()), Payload.GetData(), Payload.Num());
+	WriteAt(Table.Last(1).Offset, StringOffsets.GetData(), StringOffsets.Num() * sizeof(uint32));
+	WriteAt(Table.Last().Offset, StringData.GetData(), StringData.Num());
+
+	const bool bWritten = Writer->Close();
+	Writer.Reset();
+	if (!bWritten)
+	{
+		IFileManager::Get().Delete(*TempFilename);
+		return false;
+	}
+	return IFileManager::Get().Move(*Filename, *TempFilename, true, true);
+}
+
+FCombatSnapshotReader::FCombatSnapshotReader() = default;
+
+FCombatSnapshotReader::~FCombatSnapshotReader()
+{
+	// The region has to go before the file it maps
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+bool FCombatSnapshotReader::Open(const FString& Filename, FString& OutError)
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	Loaded.Empty();
+	Sections = {};
+	Strings.Reset();
+	Data = nullptr;
+	Size = 0;
+
+	if (FPlatformProperties::SupportsMemoryMappedFiles())
+	{
+		FOpenMappedResult Result = FPlatformFileManager::Get().GetPlatformFile().OpenMappedEx(*Filename);
+		if (Result.HasValue())
+		{
+			MappedFile = Result.StealValue();
+			MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+		}
+	}
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedFile.Reset();
+		if (!FFileHelper::LoadFileToArray(Loaded, *Filename, FILEREAD_Silent))
+		{
+			OutError = FString::Printf(TEXT("cannot read %s"), *Filename);
+			return false;
+		}
+		Data = Loaded.GetData();
+		Size = Loaded.Num();
+	}
+
+	CombatSnapshot::FFileHeader Header;
+	if (Size < static_cast<int64>(sizeof(Header)))
+	{
+		OutError = TEXT("file is truncated");
+		return false;
+	}
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+	if (Header.Magic != CombatSnapshot::Magic)
+	{
+		OutError = TEXT("not a combat snapshot, or written on a platform of the other byte order");
+		return false;
+	}
+	if (Header.Version != CombatSnapshot::Version)
+	{
+		OutError = FString::Printf(TEXT("version %u, expected %u"), Header.Version, CombatSnapshot::Version);
+		return false;
+	}
+	if (Header.FileSize != Size || CombatSnapshot::TableOffset + Header.NumSections * static_cast<int64>(sizeof(FCombatSnapshotSectionEntry)) > Size)
+	{
+		OutError = TEXT("file is truncated");
+		return false;
+	}
+
+	Sections = TConstArrayView<FCombatSnapshotSectionEntry>(reinterpret_cast<const FCombatSnapshotSectionEntry*>(Data + CombatSnapshot::TableOffset), Header.NumSections);
+	for (const FCombatSnapshotSectionEntry& Section : Sections)
+	{
+		const bool bInBounds = Section.ElementSize > 0 && Section.Count >= 0 && Section.Count <= MAX_int32
+			&& Section.Offset % CombatSnapshot::Alignment == 0 && Section.Offset >= CombatSnapshot::TableOffset && Section.Offset <= Size
+			&& Section.Count <= (Size - Section.Offset) / Section.ElementSize;
+		if (!bInBounds)
+		{
+			OutError = FString::Printf(TEXT("section %u is out of bounds"), Section.Id);
+			Sections = {};
+			return false;
+		}
+	}
+
+	const TConstArrayView<uint32> StringOffsets = GetSection<uint32>(ECombatSnapshotSection::StringOffsets);
+	const TConstArrayView<uint8> StringData = GetSection<uint8>(ECombatSnapshotSection::StringData);
+	uint32 Start = 0;
+	Strings.Reserve(StringOffsets.Num());
+	for (const uint32 End : StringOffsets)
+	{
+		if (End < Start || End > static_cast<uint32>(StringData.Num()))
+		{
+			OutError = TEXT("string table is corrupt");
+			return false;
+		}
+		const FUTF8ToTCHAR Name(reinterpret_cast<const UTF8CHAR*>(StringData.GetData() + Start), End - Start);
+		Strings.Add(FName(Name.Length(), Name.Get()));
+		Start = End;
+	}
+	return true;
+}
+
+const void* FCombatSnapshotReader::FindSection(ECombatSnapshotSection Id, uint32 ElementSize, int64& OutCount) const
+{
+	for (const FCombatSnapshotSectionEntry& Section : Sections)
+	{
+		if (Section.Id == static_cast<uint32>(Id))
+		{
+			if (Section.ElementSize != ElementSize)
+			{
+				break;
+			}
+			OutCount = Section.Count;
+			return Data + Section.Offset;
+		}
+	}
+
+	OutCount = 0;
+	return nullptr;
+}
+
+FName FCombatSnapshotReader::GetString(int32 Index) const
+{
+	return Strings.IsValidIndex(Index) ? Strings[Index] : NAME_None;
+}
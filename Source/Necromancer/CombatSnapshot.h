@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <type_traits>
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Sections of a combat snapshot. Each one is a single fragment array copied verbatim. Ids stay stable across
+ * versions; readers ignore ids they do not know and treat missing ones as empty.
+ */
+enum class ECombatSnapshotSection : uint32
+{
+	/** FCombatSimulation: step index, next serial and steps per second as uint32, then its slot table and dense arrays */
+	SimState = 1,
+	SimSlotToDense,
+	SimSlotSerials,
+	SimFreeSlots,
+	SimDenseToSlot,
+	SimTeam,
+	SimHealth,
+	SimMaxHealth,
+	SimAttackDamage,
+	SimAttackIntervalSteps,
+	SimAttackCooldownSteps,
+	SimAttackRange,
+	SimTarget,
+	SimLocation,
+
+	/** Combatants owned by actors, which register again on load instead of being restored */
+	ActorCombatants = 32,
+
+	/** FStatusEffectStore: one entry per affected combatant, then its records in chain order */
+	EffectTarget = 48,
+	EffectBase,
+	EffectFinal,
+	EffectNumRecords,
+	EffectRecordSource,
+	EffectRecordDefinition,
+	EffectRecordStacks,
+	EffectRecordRemainingSteps,
+
+	/** UMinionHordeSubsystem, promoted pawns included */
+	HordeCombatant = 64,
+	HordeLocation,
+	HordeYaw,
+	HordeMoveGoal,
+	HordeHasMoveGoal,
+	HordeIgnoresTargets,
+	HordeOwner,
+
+	/** UCorpseSubsystem */
+	CorpseCombatant = 80,
+	CorpseLocation,
+	CorpseYaw,
+	CorpseType,
+	CorpseDecaySteps,
+
+	/** Names referenced by index from other sections: end offset of every string, then their UTF-8 bytes */
+	StringOffsets = 240,
+	StringData,
+};
+
+/** Where a section lives in the file, as stored in the table after the file header */
+struct FCombatSnapshotSectionEntry
+{
+	uint32 Id = 0;
+	uint32 ElementSize = 0;
+	int64 Offset = 0;
+	int64 Count = 0;
+};
+
+/**
+ * Collects the sections of one snapshot. Adding a section copies its array in one block, so the game thread only
+ * pays for the copies and the file can be written from another thread while the game keeps changing.
+ */
+class NECROMANCER_API FCombatSnapshotWriter
+{
+public:
+	template <typename T>
+	void AddSection(ECombatSnapshotSection Id, TConstArrayView<T> Elements)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Snapshot sections are copied as raw memory");
+		AddRawSection(Id, sizeof(T), Elements.GetData(), Elements.Num());
+	}
+
+	/** Index of Name in the string table, added on first use */
+	int32 AddString(FName Name);
+
+	/** Bytes the file will take */
+	int64 GetTotalSize() const;
+
+	/** Writes the snapshot next to Filename and moves it into place once complete. Safe from any thread. */
+	bool SaveToFile(const FString& Filename) const;
+
+private:
+	struct FSection
+	{
+		ECombatSnapshotSection Id;
+		uint32 ElementSize = 0;
+		int64 Count = 0;
+
+		/** Start of the section's bytes in Payload */
+		int64 PayloadOffset = 0;
+	};
+
+	void AddRawSection(ECombatSnapshotSection Id, uint32 ElementSize, const void* Data, int64 Count);
+
+	/** Fills the section table, string sections last, and returns the file size */
+	int64 ComputeLayout(TArray<FCombatSnapshotSectionEntry>& OutTable) const;
+
+	TArray<FSection> Sections;
+	TArray64<uint8> Payload;
+
+	TMap<FName, int32> StringIndices;
+	TArray<uint32> StringOffsets;
+	TArray<uint8> StringData;
+};
+
+/**
+ * Read-only view of a snapshot file. The file is memory mapped where the platform supports it and read into
+ * memory otherwise; either way sections are handed out as views of the file's bytes, so restoring a fragment
+ * array is one copy. Only files written by the same build layout are accepted.
+ */
+class NECROMANCER_API FCombatSnapshotReader
+{
+public:
+	FCombatSnapshotReader();
+	~FCombatSnapshotReader();
+
+	/** Returns false and explains why in OutError if the file is missing, truncated or of another version */
+	bool Open(const FString& Filename, FString& OutError);
+
+	/** Elements of a section, or an empty view if it is missing or stored with another element size */
+	template <typename T>
+	TConstArrayView<T> GetSection(ECombatSnapshotSection Id) const
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Snapshot sections are copied as raw memory");
+		int64 Count = 0;
+		const void* SectionData = FindSection(Id, sizeof(T), Count);
+		return TConstArrayView<T>(static_cast<const T*>(SectionData), static_cast<int32>(Count));
+	}
+
+	/** Replaces OutElements by the elements of a section in one copy */
+	template <typename T>
+	void CopySection(ECombatSnapshotSection Id, TArray<T>& OutElements) const
+	{
+		const TConstArrayView<T> Elements = GetSection<T>(Id);
+		OutElements.Reset(Elements.Num());
+		OutElements.Append(Elements.GetData(), Elements.Num());
+	}
+
+	/** Name stored at Index of the string table, or NAME_None */
+	FName GetString(int32 Index) const;
+
+	bool IsMapped() const { return MappedRegion.IsValid(); }
+	int64 GetSize() const { return Size; }
+
+private:
+	const void* FindSection(ECombatSnapshotSection Id, uint32 ElementSize, int64& OutCount) const;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray64<uint8> Loaded;
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+
+	/** Table in the file, validated against Size on open */
+	TConstArrayView<FCombatSnapshotSectionEntry> Sections;
+
+	TArray<FName> Strings;
+};
@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSnapshotBenchmarkCommandlet.h"
+#include "CombatEventBus.h"
+#include "CombatSimulation.h"
+#include "CombatSnapshot.h"
+#include "CombatTimerWheel.h"
+#include "StatusEffectStore.h"
+#include "Necromancer.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Tasks/Task.h"
+
+namespace CombatSnapshotBenchmark
+{
+	constexpr float UnitSpacing = 150.f;
+
+	/** Plain modifiers without damage ticks, which restart their interval on load and would make states differ */
+	TArray<FStatusEffectDef> MakeDefinitions(int32 NumEffects, FRandomStream& Random)
+	{
+		TArray<FStatusEffectDef> Definitions;
+		for (int32 Index = 0; Index < NumEffects; ++Index)
+		{
+			FStatusEffectDef& Def = Definitions.AddDefaulted_GetRef();
+			Def.Name = FName(TEXT("SnapshotEffect"), Index + 1);
+			Def.Attribute = static_cast<ECombatAttribute>(Index % static_cast<int32>(ECombatAttribute::Num));
+			Def.Op = Index % 2 ? EStatusEffectOp::Multiply : EStatusEffectOp::Add;
+			Def.Magnitude = Def.Op == EStatusEffectOp::Multiply ? 0.05f : 2.f;
+			Def.Duration = Index % 3 == 0 ? 0.f : Random.FRandRange(1.f, 6.f);
+			Def.MaxStacks = 3;
+		}
+		return Definitions;
+	}
+}
+
+UCombatSnapshotBenchmarkCommandlet::UCombatSnapshotBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatSnapshotBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumEntities = 10000;
+	int32 EffectsPerUnit = 4;
+	int32 Iterations = 5;
+	int32 StepsBetween = 30;
+	float MaxCaptureMs = 0.f;
+	float MaxLoadMs = 0.f;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Entities="), NumEntities);
+	FParse::Value(*Params, TEXT("EffectsPerUnit="), EffectsPerUnit);
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	FParse::Value(*Params, TEXT("StepsBetween="), StepsBetween);
+	FParse::Value(*Params, TEXT("MaxCaptureMs="), MaxCaptureMs);
+	FParse::Value(*Params, TEXT("MaxLoadMs="), MaxLoadMs);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	NumEntities = FMath::Max(NumEntities, 2);
+	EffectsPerUnit = FMath::Max(EffectsPerUnit, 1);
+	Iterations = FMath::Max(Iterations, 1);
+
+	FRandomStream Random(Seed);
+	FCombatSimulation Simulation;
+	FCombatTimerWheel Timers;
+	FCombatEventBus EventBus;
+	FStatusEffectStore StatusEffects(Simulation, Timers, EventBus);
+	const TArray<FStatusEffectDef> Definitions = CombatSnapshotBenchmark::MakeDefinitions(EffectsPerUnit * 2, Random);
+	StatusEffects.SetDefinitions(Definitions);
+
+	// A checkerboard of both teams, so fights break out everywhere and leave holes in the slot table
+	const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumEntities)));
+	TArray<FCombatHandle> Units;
+	for (int32 Index = 0; Index < NumEntities; ++Index)
+	{
+		const int32 Column = Index % Columns;
+		const int32 Row = Index / Columns;
+
+		FCombatantDesc Desc;
+		Desc.Team = (Column + Row) % 2 ? ECombatTeam::Living : ECombatTeam::Undead;
+		Desc.MaxHealth = Random.FRandRange(40.f, 200.f);
+		Desc.AttackDamage = Random.FRandRange(5.f, 15.f);
+		Desc.AttackInterval = Random.FRandRange(0.5f, 1.5f);
+		Desc.AttackRange = 200.f;
+		Desc.Location = FVector(Column * CombatSnapshotBenchmark::UnitSpacing, Row * CombatSnapshotBenchmark::UnitSpacing, 0.f);
+		Units.Add(Simulation.Add(Desc));
+	}
+	for (const FCombatHandle& Unit : Units)
+	{
+		for (int32 Effect = 0; Effect < EffectsPerUnit; ++Effect)
+		{
+			StatusEffects.Apply(Unit, Units[Random.RandHelper(NumEntities)], Random.RandHelper(Definitions.Num()));
+		}
+	}
+
+	TArray<FCombatTimerExpiry> Expired;
+	TArray<FCombatEvent> Hits;
+	TArray<FCombatEventResult> EventResults;
+	const auto RunStep = [&]()
+	{
+		Expired.Reset();
+		Timers.Advance(Expired);
+		StatusEffects.HandleExpiredTimers(Expired);
+		for (int32 Index = 0; Index < NumEntities / 100; ++Index)
+		{
+			StatusEffects.Apply(Units[Random.RandHelper(NumEntities)], FCombatHandle(), Random.RandHelper(Definitions.Num()));
+		}
+		StatusEffects.Flush();
+		Simulation.Step(Hits);
+
+		// Applied right after the step, so the kills show up in GetKilledLastStep
+		EventBus.EnqueueBatch(MoveTemp(Hits));
+		EventResults.Reset();
+		EventBus.Apply(Simulation, EventResults);
+		for (const FCombatHandle& Killed : Simulation.GetKilledLastStep())
+		{
+			StatusEffects.RemoveAll(Killed);
+			Simulation.Remove(Killed);
+		}
+	};
+
+	const FString Filename = FPaths::ProjectSavedDir() / TEXT("Snapshots") / TEXT("Benchmark.necrosnap");
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+
+	double CaptureSeconds = 0.0;
+	double WorstCaptureSeconds = 0.0;
+	double WriteSeconds = 0.0;
+	double LoadSeconds = 0.0;
+	double WorstLoadSeconds = 0.0;
+	int64 FileSize = 0;
+	bool bMapped = false;
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		for (int32 Step = 0; Step < StepsBetween; ++Step)
+		{
+			RunStep();
+		}
+
+		double Start = FPlatformTime::Seconds();
+		FCombatSnapshotWriter Writer;
+		Simulation.WriteSnapshot(Writer);
+		StatusEffects.WriteSnapshot(Writer);
+		const double Capture = FPlatformTime::Seconds() - Start;
+		CaptureSeconds += Capture;
+		WorstCaptureSeconds = FMath::Max(WorstCaptureSeconds, Capture);
+		FileSize = Writer.GetTotalSize();
+
+		UE::Tasks::TTask<double> Save = UE::Tasks::Launch(UE_SOURCE_LOCATION, [&Writer, &Filename]()
+		{
+			const double WriteStart = FPlatformTime::Seconds();
+			return Writer.SaveToFile(Filename) ? FPlatformTime::Seconds() - WriteStart : -1.0;
+		});
+		const double Write = Save.GetResult();
+		if (Write < 0.0)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatSnapshotBenchmark: cannot write %s"), *Filename);
+			return 1;
+		}
+		WriteSeconds += Write;
+
+		FCombatSimulation Restored(Simulation.GetSettings());
+		FCombatTimerWheel RestoredTimers;
+		FCombatEventBus RestoredEventBus;
+		FStatusEffectStore RestoredEffects(Restored, RestoredTimers, RestoredEventBus);
+		RestoredEffects.SetDefinitions(Definitions);
+
+		Start = FPlatformTime::Seconds();
+		FCombatSnapshotReader Reader;
+		FString Error;
+		const bool bLoaded = Reader.Open(Filename, Error) && Restored.ReadSnapshot(Reader) && RestoredEffects.ReadSnapshot(Reader);
+		const double Load = FPlatformTime::Seconds() - Start;
+		LoadSeconds += Load;
+		WorstLoadSeconds = FMath::Max(WorstLoadSeconds, Load);
+		bMapped = Reader.IsMapped();
+
+		if (!bLoaded)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatSnapshotBenchmark: cannot load %s %s"), *Filename, *Error);
+			return 1;
+		}
+		if (Restored.ComputeChecksum() != Simulation.ComputeChecksum() || Restored.Num() != Simulation.Num()
+			|| RestoredEffects.GetNumEffects() != StatusEffects.GetNumEffects())
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatSnapshotBenchmark: iteration %d restored %d combatants and %d effects (checksum %08x), saved %d and %d (checksum %08x)"),
+				Iteration, Restored.Num(), RestoredEffects.GetNumEffects(), Restored.ComputeChecksum(), Simulation.Num(), StatusEffects.GetNumEffects(), Simulation.ComputeChecksum());
+			return 1;
+		}
+	}
+	IFileManager::Get().Delete(*Filename);
+
+	const double AverageCaptureMs = CaptureSeconds * 1000.0 / Iterations;
+	const double AverageLoadMs = LoadSeconds * 1000.0 / Iterations;
+	UE_LOG(LogNecromancer, Display, TEXT("CombatSnapshotBenchmark: %d combatants, %d effects, %.1f KB per snapshot"),
+		Simulation.Num(), StatusEffects.GetNumEffects(), FileSize / 1024.0);
+	UE_LOG(LogNecromancer, Display, TEXT("CombatSnapshotBenchmark: capture %.3fms on average, %.3fms worst; background write %.3fms on average"),
+		AverageCaptureMs, WorstCaptureSeconds * 1000.0, WriteSeconds * 1000.0 / Iterations);
+	UE_LOG(LogNecromancer, Display, TEXT("CombatSnapshotBenchmark: %s load %.3fms on average, %.3fms worst"),
+		bMapped ? TEXT("mapped") : TEXT("read"), AverageLoadMs, WorstLoadSeconds * 1000.0);
+
+	bool bFailed = false;
+	if (MaxCaptureMs > 0.f && AverageCaptureMs > MaxCaptureMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatSnapshotBenchmark: capture %.3fms exceeds %.3fms"), AverageCaptureMs, MaxCaptureMs);
+		bFailed = true;
+	}
+	if (MaxLoadMs > 0.f && AverageLoadMs > MaxLoadMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("CombatSnapshotBenchmark: load %.3fms exceeds %.3fms"), AverageLoadMs, MaxLoadMs);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatSnapshotBenchmarkCommandlet.generated.h"
+
+/**
+ * Saves a running fight with status effects to a combat snapshot and restores it, timing the capture on the calling
+ * thread, the background write and the mapped load. Fails if a restored state differs from the saved one or a
+ * limit is exceeded; a limit of zero is not checked.
+ *
+ * Usage: -run=CombatSnapshotBenchmark [-Entities=10000] [-EffectsPerUnit=4] [-Iterations=5] [-StepsBetween=30]
+ *        [-MaxCaptureMs=0] [-MaxLoadMs=0] [-Seed=0]
+ */
+UCLASS()
+class UCombatSnapshotBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatSnapshotBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,194 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSnapshotSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatSnapshot.h"
+#include "CombatSubsystem.h"
+#include "CorpseSubsystem.h"
+#include "MinionHordeSubsystem.h"
+#include "Necromancer.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+
+static FAutoConsoleCommandWithWorldAndArgs GSnapshotSaveCommand(
+	TEXT("necro.Snapshot.Save"),
+	TEXT("necro.Snapshot.Save [Name]: saves the battle to Saved/Snapshots/<Name>.necrosnap, written in the background"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UCombatSnapshotSubsystem* Snapshots = World ? World->GetSubsystem<UCombatSnapshotSubsystem>() : nullptr;
+		if (!Snapshots || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("necro.Snapshot.Save needs a standalone game or a server"));
+			return;
+		}
+
+		Snapshots->SaveSnapshot(Args.Num() > 0 ? Args[0] : TEXT("Quick"));
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GSnapshotLoadCommand(
+	TEXT("necro.Snapshot.Load"),
+	TEXT("necro.Snapshot.Load [Name]: replaces the battle by Saved/Snapshots/<Name>.necrosnap"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UCombatSnapshotSubsystem* Snapshots = World ? World->GetSubsystem<UCombatSnapshotSubsystem>() : nullptr;
+		if (!Snapshots || World->GetNetMode() == NM_Client)
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("necro.Snapshot.Load needs a standalone game or a server"));
+			return;
+		}
+
+		Snapshots->LoadSnapshot(Args.Num() > 0 ? Args[0] : TEXT("Quick"));
+	}));
+
+void UCombatSnapshotSubsystem::Deinitialize()
+{
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	Super::Deinitialize();
+}
+
+bool UCombatSnapshotSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FString UCombatSnapshotSubsystem::GetSnapshotFilename(const FString& Name)
+{
+	return FPaths::ProjectSavedDir() / TEXT("Snapshots") / Name + TEXT(".necrosnap");
+}
+
+bool UCombatSnapshotSubsystem::SaveSnapshot(const FString& Name)
+{
+	UWorld* World = GetWorld();
+	UCombatSubsystem* CombatSubsystem = World->GetSubsystem<UCombatSubsystem>();
+	if (!CombatSubsystem || IsSaving())
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Cannot save snapshot %s: %s"), *Name, CombatSubsystem ? TEXT("the last save is still being written") : TEXT("no combat running"));
+		return false;
+	}
+
+	const double CaptureStart = FPlatformTime::Seconds();
+	FCombatSnapshotWriter Writer;
+	CombatSubsystem->WriteSnapshot(Writer);
+	if (const UMinionHordeSubsystem* Horde = World->GetSubsystem<UMinionHordeSubsystem>())
+	{
+		Horde->WriteSnapshot(Writer);
+	}
+	if (const UCorpseSubsystem* Corpses = World->GetSubsystem<UCorpseSubsystem>())
+	{
+		Corpses->WriteSnapshot(Writer);
+	}
+	const double CaptureMs = (FPlatformTime::Seconds() - CaptureStart) * 1000.0;
+
+	const int32 NumCombatants = CombatSubsystem->GetSimulation().Num();
+	const FString Filename = GetSnapshotFilename(Name);
+	PendingSave = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Writer = MoveTemp(Writer), Filename, CaptureMs, NumCombatants]()
+	{
+		const double WriteStart = FPlatformTime::Seconds();
+		IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+		if (!Writer.SaveToFile(Filename))
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("Cannot write snapshot %s"), *Filename);
+			return;
+		}
+
+		UE_LOG(LogNecromancer, Display, TEXT("Saved %d combatants to %s: %.1f KB, %.2f ms on the game thread, %.2f ms written in the background"),
+			NumCombatants, *Filename, Writer.GetTotalSize() / 1024.0, CaptureMs, (FPlatformTime::Seconds() - WriteStart) * 1000.0);
+	});
+	return true;
+}
+
+bool UCombatSnapshotSubsystem::LoadSnapshot(const FString& Name)
+{
+	UWorld* World = GetWorld();
+	UCombatSubsystem* CombatSubsystem = World->GetSubsystem<UCombatSubsystem>();
+	if (!CombatSubsystem)
+	{
+		return false;
+	}
+
+	// The file may be the one still being written
+	if (PendingSave.IsValid())
+	{
+		PendingSave.Wait();
+	}
+
+	const double LoadStart = FPlatformTime::Seconds();
+	const FString Filename = GetSnapshotFilename(Name);
+	FCombatSnapshotReader Reader;
+	FString Error;
+	if (!Reader.Open(Filename, Error))
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Cannot load snapshot %s: %s"), *Filename, *Error);
+		return false;
+	}
+
+	// Read into a separate simulation first, so a snapshot that does not fit leaves the battle alone
+	FCombatSimulation Restored(CombatSubsystem->GetSimulation().GetSettings());
+	if (!Restored.ReadSnapshot(Reader))
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Cannot load snapshot %s: its combat state is inconsistent or was saved at another step rate"), *Filename);
+		return false;
+	}
+
+	// Every other part is checked too before anything is cleared, so a failed load really changes nothing
+	UMinionHordeSubsystem* Horde = World->GetSubsystem<UMinionHordeSubsystem>();
+	UCorpseSubsystem* Corpses = World->GetSubsystem<UCorpseSubsystem>();
+	const TCHAR* Unfit = !FStatusEffectStore::CanReadSnapshot(Reader) ? TEXT("status effects")
+		: Horde && !Horde->CanReadSnapshot(Reader) ? TEXT("horde")
+		: Corpses && !Corpses->CanReadSnapshot(Reader) ? TEXT("corpses")
+		: nullptr;
+	if (Unfit)
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Cannot load snapshot %s: its %s sections do not fit together"), *Filename, Unfit);
+		return false;
+	}
+
+	// Everything holding combatants lets go of them while their handles still resolve
+	if (Horde)
+	{
+		Horde->ClearForSnapshot();
+	}
+	if (Corpses)
+	{
+		Corpses->ClearForSnapshot();
+	}
+
+	TArray<TWeakObjectPtr<UCombatManagerComponent>> Released;
+	CombatSubsystem->RestoreSnapshot(MoveTemp(Restored), Reader, Released);
+	if (Horde)
+	{
+		Horde->ReadSnapshot(Reader);
+	}
+	if (Corpses)
+	{
+		Corpses->ReadSnapshot(Reader);
+	}
+
+	// Combatants of actors are dropped unless they became a minion or a corpse; the actors living now register anew
+	for (const FCombatHandle& Handle : Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::ActorCombatants))
+	{
+		if (!(Horde && Horde->IsHordeMinion(Handle)) && !(Corpses && Corpses->IsCorpse(Handle)))
+		{
+			CombatSubsystem->UnregisterCombatant(Handle);
+		}
+	}
+	for (const TWeakObjectPtr<UCombatManagerComponent>& WeakComponent : Released)
+	{
+		if (UCombatManagerComponent* Component = WeakComponent.Get())
+		{
+			Component->RegisterCombatant();
+		}
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("Loaded %d combatants from %s: %.1f KB %s in %.2f ms"),
+		CombatSubsystem->GetSimulation().Num(), *Filename, Reader.GetSize() / 1024.0, Reader.IsMapped() ? TEXT("mapped") : TEXT("read"),
+		(FPlatformTime::Seconds() - LoadStart) * 1000.0);
+	return true;
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "CombatSnapshotSubsystem.generated.h"
+
+/**
+ * Saves the battle to a flat binary snapshot and restores it, through necro.Snapshot.Save and necro.Snapshot.Load.
+ *
+ * A save copies the fragment arrays of the combat simulation, status effects, horde and corpses on the game thread
+ * and leaves the file writing to a worker. A load maps the file and copies each array back in one block; spatial
+ * grids and other derived state are rebuilt. Combatants owned by actors are not restored: the actors keep their
+ * place and register fresh combatants. Ability cooldowns and summon timers are not saved.
+ */
+UCLASS()
+class NECROMANCER_API UCombatSnapshotSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Captures the battle now and writes it to GetSnapshotFilename(Name) in the background. Returns false if a save is still being written. */
+	bool SaveSnapshot(const FString& Name);
+
+	/** Replaces the battle by a saved one. Returns false and changes nothing if the file cannot be used. */
+	bool LoadSnapshot(const FString& Name);
+
+	bool IsSaving() const { return PendingSave.IsValid() && !PendingSave.IsCompleted(); }
+
+	static FString GetSnapshotFilename(const FString& Name);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	UE::Tasks::TTask<void> PendingSave;
+};
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSoakCommandlet.h"
+#include "CombatEventBus.h"
+#include "CombatSimulation.h"
+#include "Necromancer.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+
+namespace CombatSoak
+{
+	constexpr float MoveSpeed = 300.f;
+	constexpr float LineSpacing = 120.f;
+	constexpr float FrontDistance = 800.f;
+
+	struct FFightResult
+	{
+		uint32 Steps = 0;
+		uint32 Checksum = 0;
+		ECombatTeam Winner = ECombatTeam::Neutral;
+	};
+
+	FFightResult RunFight(int32 UnitsPerSide, int32 MaxSteps, int32 Seed)
+	{
+		FCombatSimulation Simulation;
+		FCombatEventBus EventBus;
+		TArray<FCombatEvent> Hits;
+		TArray<FCombatEventResult> EventResults;
+		FRandomStream Random(Seed);
+
+		TArray<FCombatHandle> Units;
+		for (int32 Index = 0; Index < UnitsPerSide * 2; ++Index)
+		{
+			const bool bUndead = Index < UnitsPerSide;
+			const int32 Rank = Index % UnitsPerSide;
+
+			FCombatantDesc Desc;
+			Desc.Team = bUndead ? ECombatTeam::Undead : ECombatTeam::Living;
+			Desc.MaxHealth = Random.FRandRange(60.f, 140.f);
+			Desc.AttackDamage = Random.FRandRange(5.f, 15.f);
+			Desc.AttackInterval = Random.FRandRange(0.8f, 1.6f);
+			Desc.AttackRange = 150.f;
+			Desc.Location = FVector(bUndead ? 0.f : FrontDistance, Rank * LineSpacing, 0.f);
+			Units.Add(Simulation.Add(Desc));
+		}
+
+		FFightResult Result;
+		for (; Result.Steps < static_cast<uint32>(MaxSteps); ++Result.Steps)
+		{
+			// Close in on targets before the step, as the horde does
+			int32 AliveUndead = 0;
+			int32 AliveLiving = 0;
+			for (const FCombatHandle& Unit : Units)
+			{
+				if (!Simulation.IsAlive(Unit))
+				{
+					continue;
+				}
+				(Simulation.GetTeam(Unit) == ECombatTeam::Undead ? AliveUndead : AliveLiving)++;
+
+				const FCombatHandle Target = Simulation.GetTarget(Unit);
+				if (Simulation.IsAlive(Target))
+				{
+					FVector Location = Simulation.GetLocation(Unit);
+					FCombatSimulation::StepTowards(Location, Simulation.GetLocation(Target), Simulation.GetAttackRange(Unit) * 0.9f, MoveSpeed, Simulation.GetStepSeconds());
+					Simulation.SetLocation(Unit, Location);
+				}
+			}
+
+			if (AliveUndead == 0 || AliveLiving == 0)
+			{
+				Result.Winner = AliveUndead > 0 ? ECombatTeam::Undead : (AliveLiving > 0 ? ECombatTeam::Living : ECombatTeam::Neutral);
+				break;
+			}
+
+			// Hits go through the bus right away, as the apply phase at the start of the next step would
+			Simulation.Step(Hits);
+			EventBus.EnqueueBatch(MoveTemp(Hits));
+			EventResults.Reset();
+			EventBus.Apply(Simulation, EventResults);
+		}
+
+		Result.Checksum = Simulation.ComputeChecksum();
+		return Result;
+	}
+}
+
+UCombatSoakCommandlet::UCombatSoakCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatSoakCommandlet::Main(const FString& Params)
+{
+	int32 NumFights = 1000;
+	int32 UnitsPerSide = 50;
+	float MaxSimSeconds = 120.f;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Fights="), NumFights);
+	FParse::Value(*Params, TEXT("UnitsPerSide="), UnitsPerSide);
+	FParse::Value(*Params, TEXT("MaxSimSeconds="), MaxSimSeconds);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+
+	const int32 MaxSteps = FCombatSimulationSettings().StepsPerSecond * MaxSimSeconds;
+
+	int32 Wins[3] = { 0, 0, 0 };
+	uint64 TotalSteps = 0;
+	CombatSoak::FFightResult FirstResult;
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Fight = 0; Fight < NumFights; ++Fight)
+	{
+		const CombatSoak::FFightResult Result = CombatSoak::RunFight(UnitsPerSide, MaxSteps, Seed + Fight);
+		if (Fight == 0)
+		{
+			FirstResult = Result;
+		}
+		TotalSteps += Result.Steps;
+		++Wins[static_cast<uint8>(Result.Winner)];
+	}
+	const double WallSeconds = FMath::Max(FPlatformTime::Seconds() - StartTime, UE_SMALL_NUMBER);
+	const double SimSeconds = TotalSteps / static_cast<double>(FCombatSimulationSettings().StepsPerSecond);
+
+	UE_LOG(LogNecromancer, Display, TEXT("CombatSoak: %d fights of %d vs %d in %.2fs (%.0f fights/minute, %.1fx real time)"),
+		NumFights, UnitsPerSide, UnitsPerSide, WallSeconds, NumFights * 60.0 / WallSeconds, SimSeconds / WallSeconds);
+	UE_LOG(LogNecromancer, Display, TEXT("CombatSoak: Undead won %d, Living won %d, unresolved %d"),
+		Wins[static_cast<uint8>(ECombatTeam::Undead)], Wins[static_cast<uint8>(ECombatTeam::Living)], Wins[static_cast<uint8>(ECombatTeam::Neutral)]);
+
+	if (NumFights > 0)
+	{
+		const CombatSoak::FFightResult Replay = CombatSoak::RunFight(UnitsPerSide, MaxSteps, Seed);
+		if (Replay.Checksum != FirstResult.Checksum || Replay.Steps != FirstResult.Steps)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatSoak: replay of fight 0 diverged (checksum %08x vs %08x)"), Replay.Checksum, FirstResult.Checksum);
+			return 1;
+		}
+	}
+
+	return 0;
+}
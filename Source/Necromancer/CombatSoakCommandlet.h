@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatSoakCommandlet.generated.h"
+
+/**
+ * Runs many simulated fights back to back on FCombatSimulation without a game world, as fast as the CPU allows.
+ *
+ * Usage: -run=CombatSoak [-Fights=1000] [-UnitsPerSide=50] [-MaxSimSeconds=120] [-Seed=0]
+ * Returns non-zero if replaying the first fight gives a different final state.
+ */
+UCLASS()
+class UCombatSoakCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatSoakCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
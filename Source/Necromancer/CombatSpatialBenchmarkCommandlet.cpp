@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSpatialBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "CombatSpatialGrid.h"
+#include "CombatTypes.h"
+#include "Necromancer.h"
+#include "Algo/BinarySearch.h"
+#include "Components/SphereComponent.h"
+#include "Engine/OverlapResult.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+
+namespace CombatSpatialBenchmark
+{
+	// Average distance between units, and the footprint each one has in the physics scene
+	constexpr float UnitSpacing = 200.f;
+	constexpr float UnitRadius = 40.f;
+
+	// Units on the edge of a query may fall either way; only misses further in or out count as disagreements
+	constexpr float EdgeTolerance = 1.f;
+
+	constexpr float MoveDistance = 150.f;
+
+	struct FQueryRound
+	{
+		TArray<TArray<int32>> Inside;
+		TArray<int32> Nearest;
+		double Seconds = 0.0;
+	};
+
+	struct FUnits
+	{
+		TArray<FVector> Locations;
+		TArray<ECombatTeam> Teams;
+	};
+
+	/** Counts the results of Round that differ from Reference by more than edge cases */
+	int32 CountDisagreements(const FUnits& Units, TConstArrayView<FVector> Centers, float Radius, const FQueryRound& Round, const FQueryRound& Reference)
+	{
+		const auto IsOnEdge = [&Units](int32 Id, const FVector& Center, float EdgeDistance)
+		{
+			return FMath::Abs(FVector::Dist2D(Units.Locations[Id], Center) - EdgeDistance) <= EdgeTolerance;
+		};
+
+		int32 NumDisagreements = 0;
+		for (int32 Query = 0; Query < Centers.Num(); ++Query)
+		{
+			TArray<int32> Found = Round.Inside[Query];
+			TArray<int32> Expected = Reference.Inside[Query];
+			Found.Sort();
+			Expected.Sort();
+			for (const int32 Id : Found)
+			{
+				NumDisagreements += Algo::BinarySearch(Expected, Id) == INDEX_NONE && !IsOnEdge(Id, Centers[Query], Radius + UnitRadius) ? 1 : 0;
+			}
+			for (const int32 Id : Expected)
+			{
+				NumDisagreements += Algo::BinarySearch(Found, Id) == INDEX_NONE && !IsOnEdge(Id, Centers[Query], Radius + UnitRadius) ? 1 : 0;
+			}
+
+			// Ties for nearest are fine as long as both are as close
+			const int32 FoundNearest = Round.Nearest[Query];
+			const int32 ExpectedNearest = Reference.Nearest[Query];
+			if (FoundNearest != ExpectedNearest)
+			{
+				const bool bSameDistance = FoundNearest != INDEX_NONE && ExpectedNearest != INDEX_NONE
+					&& FMath::IsNearlyEqual(FVector::Dist2D(Units.Locations[FoundNearest], Centers[Query]), FVector::Dist2D(Units.Locations[ExpectedNearest], Centers[Query]), EdgeTolerance);
+				NumDisagreements += bSameDistance ? 0 : 1;
+			}
+		}
+		return NumDisagreements;
+	}
+}
+
+UCombatSpatialBenchmarkCommandlet::UCombatSpatialBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatSpatialBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString CountsParam = TEXT("1000,5000,20000");
+	int32 NumQueries = 2000;
+	float Radius = 800.f;
+	int32 Moves = 5;
+	float MinSpeedup = 1.f;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Counts="), CountsParam, false);
+	FParse::Value(*Params, TEXT("Queries="), NumQueries);
+	FParse::Value(*Params, TEXT("Radius="), Radius);
+	FParse::Value(*Params, TEXT("Moves="), Moves);
+	FParse::Value(*Params, TEXT("MinSpeedup="), MinSpeedup);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	NumQueries = FMath::Max(NumQueries, 1);
+	Moves = FMath::Max(Moves, 0);
+
+	TArray<FString> CountStrings;
+	CountsParam.ParseIntoArray(CountStrings, TEXT(","));
+
+	bool bFailed = false;
+	for (const FString& CountString : CountStrings)
+	{
+		const int32 NumUnits = FMath::Max(FCString::Atoi(*CountString), 1);
+		FRandomStream Random(Seed + NumUnits);
+		const float Side = FMath::Sqrt(static_cast<float>(NumUnits)) * CombatSpatialBenchmark::UnitSpacing;
+
+		CombatSpatialBenchmark::FUnits Units;
+		for (int32 Id = 0; Id < NumUnits; ++Id)
+		{
+			Units.Locations.Add(FVector(Random.FRandRange(0.f, Side), Random.FRandRange(0.f, Side), 0.f));
+			Units.Teams.Add(Random.RandHelper(2) ? ECombatTeam::Living : ECombatTeam::Undead);
+		}
+
+		// The grid, sized as UCombatSubsystem sizes it by default
+		FCombatSpatialGrid Grid;
+		double Start = FPlatformTime::Seconds();
+		for (int32 Id = 0; Id < NumUnits; ++Id)
+		{
+			Grid.Add(Id, Units.Locations[Id], CombatTeamBit(Units.Teams[Id]));
+		}
+		const double GridAddMs = (FPlatformTime::Seconds() - Start) * 1000.0;
+
+		// The physics scene, one query-only sphere per unit
+		FBenchmarkWorld World;
+		World.BeginPlay();
+		AActor* Holder = World.Get()->SpawnActor<AActor>();
+		TArray<USphereComponent*> Spheres;
+		TMap<const UPrimitiveComponent*, int32> SphereIds;
+		Start = FPlatformTime::Seconds();
+		for (int32 Id = 0; Id < NumUnits; ++Id)
+		{
+			USphereComponent* Sphere = NewObject<USphereComponent>(Holder);
+			Sphere->SetSphereRadius(CombatSpatialBenchmark::UnitRadius);
+			Sphere->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+			Sphere->SetCollisionObjectType(ECC_Pawn);
+			Sphere->SetCollisionResponseToAllChannels(ECR_Overlap);
+			Sphere->SetGenerateOverlapEvents(false);
+			Sphere->SetWorldLocation(Units.Locations[Id]);
+			Sphere->RegisterComponent();
+			Spheres.Add(Sphere);
+			SphereIds.Add(Sphere, Id);
+		}
+		const double PhysicsAddMs = (FPlatformTime::Seconds() - Start) * 1000.0;
+		World.Tick(1.f / 60.f);
+
+		const auto RunGrid = [&](TConstArrayView<FVector> Centers, TConstArrayView<ECombatTeam> Teams)
+		{
+			CombatSpatialBenchmark::FQueryRound Round;
+			Round.Inside.SetNum(Centers.Num());
+			Round.Nearest.Init(INDEX_NONE, Centers.Num());
+
+			const double RoundStart = FPlatformTime::Seconds();
+			for (int32 Query = 0; Query < Centers.Num(); ++Query)
+			{
+				FCombatSpatialQuery Inside;
+				Inside.Origin = Centers[Query];
+				Inside.Radius = Radius + CombatSpatialBenchmark::UnitRadius;
+				Inside.TeamMask = CombatHostileTeamMask(Teams[Query]);
+				Grid.Query(Inside, Round.Inside[Query]);
+
+				FCombatSpatialQuery Nearest = Inside;
+				Nearest.Shape = ECombatQueryShape::Nearest;
+				Nearest.MaxResults = 1;
+				TArray<int32, TInlineAllocator<1>> Found;
+				Grid.Query(Nearest, Found);
+				Round.Nearest[Query] = Found.Num() > 0 ? Found[0] : INDEX_NONE;
+			}
+			Round.Seconds = FPlatformTime::Seconds() - RoundStart;
+			return Round;
+		};
+
+		const auto RunPhysics = [&](TConstArrayView<FVector> Centers, TConstArrayView<ECombatTeam> Teams)
+		{
+			CombatSpatialBenchmark::FQueryRound Round;
+			Round.Inside.SetNum(Centers.Num());
+			Round.Nearest.Init(INDEX_NONE, Centers.Num());
+
+			const FCollisionObjectQueryParams ObjectParams(ECC_Pawn);
+			const FCollisionShape Shape = FCollisionShape::MakeSphere(Radius);
+			TArray<FOverlapResult> Overlaps;
+			const double RoundStart = FPlatformTime::Seconds();
+			for (int32 Query = 0; Query < Centers.Num(); ++Query)
+			{
+				// One overlap answers both questions, as a game without the grid would do it
+				Overlaps.Reset();
+				World.Get()->OverlapMultiByObjectType(Overlaps, Centers[Query], FQuat::Identity, ObjectParams, Shape);
+
+				float NearestDistSq = MAX_flt;
+				for (const FOverlapResult& Overlap : Overlaps)
+				{
+					const int32* Id = SphereIds.Find(Overlap.GetComponent());
+					if (!Id || (CombatTeamBit(Units.Teams[*Id]) & CombatHostileTeamMask(Teams[Query])) == 0)
+					{
+						continue;
+					}
+
+					Round.Inside[Query].Add(*Id);
+					const float DistSq = FVector::DistSquared2D(Units.Locations[*Id], Centers[Query]);
+					if (DistSq < NearestDistSq)
+					{
+						NearestDistSq = DistSq;
+						Round.Nearest[Query] = *Id;
+					}
+				}
+			}
+			Round.Seconds = FPlatformTime::Seconds() - RoundStart;
+			return Round;
+		};
+
+		double GridQuerySeconds = 0.0;
+		double PhysicsQuerySeconds = 0.0;
+		double GridUpdateSeconds = 0.0;
+		double PhysicsUpdateSeconds = 0.0;
+		int32 NumDisagreements = 0;
+		TArray<FVector> Centers;
+		TArray<ECombatTeam> Teams;
+		for (int32 Pass = 0; Pass <= Moves; ++Pass)
+		{
+			if (Pass > 0)
+			{
+				for (FVector& Location : Units.Locations)
+				{
+					Location += FVector(Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f), 0.f) * CombatSpatialBenchmark::MoveDistance;
+				}
+
+				Start = FPlatformTime::Seconds();
+				for (int32 Id = 0; Id < NumUnits; ++Id)
+				{
+					Grid.Update(Id, Units.Locations[Id]);
+				}
+				GridUpdateSeconds += FPlatformTime::Seconds() - Start;
+
+				Start = FPlatformTime::Seconds();
+				for (int32 Id = 0; Id < NumUnits; ++Id)
+				{
+					Spheres[Id]->SetWorldLocation(Units.Locations[Id], false, nullptr, ETeleportType::TeleportPhysics);
+				}
+				PhysicsUpdateSeconds += FPlatformTime::Seconds() - Start;
+				World.Tick(1.f / 60.f);
+			}
+
+			Centers.Reset();
+			Teams.Reset();
+			for (int32 Query = 0; Query < NumQueries; ++Query)
+			{
+				Centers.Add(FVector(Random.FRandRange(0.f, Side), Random.FRandRange(0.f, Side), 0.f));
+				Teams.Add(Random.RandHelper(2) ? ECombatTeam::Living : ECombatTeam::Undead);
+			}
+
+			const CombatSpatialBenchmark::FQueryRound GridRound = RunGrid(Centers, Teams);
+			const CombatSpatialBenchmark::FQueryRound PhysicsRound = RunPhysics(Centers, Teams);
+			GridQuerySeconds += GridRound.Seconds;
+			PhysicsQuerySeconds += PhysicsRound.Seconds;
+			NumDisagreements += CombatSpatialBenchmark::CountDisagreements(Units, Centers, Radius, GridRound, PhysicsRound);
+		}
+
+		const int32 TotalQueries = NumQueries * (Moves + 1);
+		const double GridQueryUs = GridQuerySeconds * 1000000.0 / TotalQueries;
+		const double PhysicsQueryUs = PhysicsQuerySeconds * 1000000.0 / TotalQueries;
+		const double Speedup = GridQueryUs > 0.0 ? PhysicsQueryUs / GridQueryUs : 0.0;
+		UE_LOG(LogNecromancer, Display, TEXT("CombatSpatialBenchmark: %6d units  add grid %8.2fms physics %8.2fms  query grid %7.2fus physics %7.2fus (%.1fx)  move grid %7.2fms physics %8.2fms"),
+			NumUnits, GridAddMs, PhysicsAddMs, GridQueryUs, PhysicsQueryUs, Speedup,
+			GridUpdateSeconds * 1000.0 / FMath::Max(Moves, 1), PhysicsUpdateSeconds * 1000.0 / FMath::Max(Moves, 1));
+
+		if (NumDisagreements > 0)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatSpatialBenchmark: %d units, grid and physics disagree on %d results"), NumUnits, NumDisagreements);
+			bFailed = true;
+		}
+		if (MinSpeedup > 0.f && Speedup < MinSpeedup)
+		{
+			UE_LOG(LogNecromancer, Error, TEXT("CombatSpatialBenchmark: %d units, grid queries are %.2fx as fast as physics, expected at least %.2fx"), NumUnits, Speedup, MinSpeedup);
+			bFailed = true;
+		}
+	}
+	return bFailed ? 1 : 0;
+}
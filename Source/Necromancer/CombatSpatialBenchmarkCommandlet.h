@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatSpatialBenchmarkCommandlet.generated.h"
+
+/**
+ * Compares FCombatSpatialGrid against physics overlaps, the obvious way to find units, at several unit counts.
+ * The same units are added to a grid and as query-only spheres to the physics scene of a benchmark world; both
+ * then answer the same radius and nearest-enemy queries and follow the same moves.
+ *
+ * Usage: -run=CombatSpatialBenchmark [-Counts=1000,5000,20000] [-Queries=2000] [-Radius=800] [-Moves=5] [-MinSpeedup=1] [-Seed=0]
+ * Returns non-zero if the two disagree on any query, or if the grid answers queries less than MinSpeedup times
+ * as fast as the physics scene at any count.
+ */
+UCLASS()
+class UCombatSpatialBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatSpatialBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSpatialGrid.h"
+
+FCombatSpatialGrid::FCombatSpatialGrid(float InCellSize)
+	: CellSize(InCellSize)
+	, InvCellSize(1.f / InCellSize)
+{
+	check(InCellSize > 0.f);
+}
+
+FIntPoint FCombatSpatialGrid::ToCellCoord(const FVector& Position) const
+{
+	return FIntPoint(FMath::FloorToInt32(Position.X * InvCellSize), FMath::FloorToInt32(Position.Y * InvCellSize));
+}
+
+uint64 FCombatSpatialGrid::ToCellKey(const FIntPoint& Coord)
+{
+	return (static_cast<uint64>(static_cast<uint32>(Coord.X)) << 32) | static_cast<uint32>(Coord.Y);
+}
+
+int32 FCombatSpatialGrid::FindOrAddCell(const FIntPoint& Coord)
+{
+	const uint64 Key = ToCellKey(Coord);
+	if (const int32* CellIndex = CellLookup.Find(Key))
+	{
+		return *CellIndex;
+	}
+
+	const int32 CellIndex = Cells.AddDefaulted();
+	CellCoords.Add(Coord);
+	CellLookup.Add(Key, CellIndex);
+	return CellIndex;
+}
+
+const FCombatSpatialGrid::FCell* FCombatSpatialGrid::FindCell(int32 X, int32 Y) const
+{
+	const int32* CellIndex = CellLookup.Find(ToCellKey(FIntPoint(X, Y)));
+	return CellIndex ? &Cells[*CellIndex] : nullptr;
+}
+
+void FCombatSpatialGrid::Add(int32 Id, const FVector& Position, uint32 TeamBit)
+{
+	check(Id >= 0);
+	if (Contains(Id))
+	{
+		Remove(Id);
+	}
+	if (Id >= ItemCells.Num())
+	{
+		ItemCells.SetNum(Id + 1);
+	}
+
+	const int32 CellIndex = FindOrAddCell(ToCellCoord(Position));
+	ItemCells[Id].CellIndex = CellIndex;
+	ItemCells[Id].EntryIndex = Cells[CellIndex].Entries.Add({ Position, Id, TeamBit });
+	++NumItems;
+}
+
+void FCombatSpatialGrid::Update(int32 Id, const FVector& Position)
+{
+	if (!Contains(Id))
+	{
+		return;
+	}
+
+	FItemCell& Item = ItemCells[Id];
+	const FIntPoint NewCoord = ToCellCoord(Position);
+	if (CellCoords[Item.CellIndex] == NewCoord)
+	{
+		Cells[Item.CellIndex].Entries[Item.EntryIndex].Position = Position;
+		return;
+	}
+
+	const uint32 TeamBit = Cells[Item.CellIndex].Entries[Item.EntryIndex].TeamBit;
+	RemoveFromCell(Item.CellIndex, Item.EntryIndex);
+
+	const int32 CellIndex = FindOrAddCell(NewCoord);
+	Item.CellIndex = CellIndex;
+	Item.EntryIndex = Cells[CellIndex].Entries.Add({ Position, Id, TeamBit });
+}
+
+void FCombatSpatialGrid::Remove(int32 Id)
+{
+	if (!Contains(Id))
+	{
+		return;
+	}
+
+	FItemCell& Item = ItemCells[Id];
+	RemoveFromCell(Item.CellIndex, Item.EntryIndex);
+	Item = FItemCell();
+	--NumItems;
+}
+
+void FCombatSpatialGrid::RemoveFromCell(int32 CellIndex, int32 EntryIndex)
+{
+	TArray<FEntry>& Entries = Cells[CellIndex].Entries;
+	Entries.RemoveAtSwap(EntryIndex, 1, EAllowShrinking::No);
+	if (Entries.IsValidIndex(EntryIndex))
+	{
+		ItemCells[Entries[EntryIndex].Id].EntryIndex = EntryIndex;
+	}
+}
+
+void FCombatSpatialGrid::Reset()
+{
+	Cells.Reset();
+	CellCoords.Reset();
+	CellLookup.Reset();
+	ItemCells.Reset();
+	NumItems = 0;
+}
@@ -0,0 +1,309 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Algo/BinarySearch.h"
+
+/** Shape tested by an FCombatSpatialQuery. All shapes are evaluated on the XY plane. */
+enum class ECombatQueryShape : uint8
+{
+	Nearest,
+	Radius,
+	Cone,
+	Box,
+	Polygon,
+};
+
+/** One spatial query against FCombatSpatialGrid. Fields not used by Shape are ignored. */
+struct FCombatSpatialQuery
+{
+	ECombatQueryShape Shape = ECombatQueryShape::Radius;
+	FVector Origin = FVector::ZeroVector;
+
+	/** Radius for Radius and Nearest, length for Cone */
+	float Radius = 0.f;
+
+	/** Facing direction for Cone */
+	FVector Direction = FVector::ForwardVector;
+	float HalfAngleRadians = 0.f;
+
+	/** Half size of the XY box centred on Origin, for Box */
+	FVector2D BoxExtent = FVector2D::ZeroVector;
+
+	/** Convex polygon on XY with counter-clockwise corners, for Polygon. Not copied; must outlive the query. */
+	TConstArrayView<FVector2D> PolygonPoints;
+
+	/** Only entries whose team bit is in this mask are returned */
+	uint32 TeamMask = MAX_uint32;
+
+	/** Result cap. Nearest returns the closest ones sorted by distance, other shapes stop early. */
+	int32 MaxResults = MAX_int32;
+};
+
+/**
+ * Uniform hash grid over the XY plane. Entries are stored inline per cell (position, id, team bit)
+ * so queries walk contiguous memory. Moving an entry inside its cell only rewrites the position;
+ * crossing a cell boundary moves it with two swaps. Ids are small non-negative integers chosen by the caller.
+ */
+class NECROMANCER_API FCombatSpatialGrid
+{
+public:
+	explicit FCombatSpatialGrid(float InCellSize = 500.f);
+
+	void Add(int32 Id, const FVector& Position, uint32 TeamBit);
+	void Update(int32 Id, const FVector& Position);
+	void Remove(int32 Id);
+	void Reset();
+
+	bool Contains(int32 Id) const { return ItemCells.IsValidIndex(Id) && ItemCells[Id].CellIndex != INDEX_NONE; }
+	int32 Num() const { return NumItems; }
+	float GetCellSize() const { return CellSize; }
+
+	/** Appends the ids matching Query to OutIds. Safe to call from several threads at once. */
+	template <typename AllocatorType>
+	void Query(const FCombatSpatialQuery& Query, TArray<int32, AllocatorType>& OutIds) const;
+
+private:
+	struct FEntry
+	{
+		FVector Position;
+		int32 Id;
+		uint32 TeamBit;
+	};
+
+	struct FCell
+	{
+		TArray<FEntry> Entries;
+	};
+
+	struct FItemCell
+	{
+		int32 CellIndex = INDEX_NONE;
+		int32 EntryIndex = INDEX_NONE;
+	};
+
+	FIntPoint ToCellCoord(const FVector& Position) const;
+	static uint64 ToCellKey(const FIntPoint& Coord);
+	int32 FindOrAddCell(const FIntPoint& Coord);
+	const FCell* FindCell(int32 X, int32 Y) const;
+	void RemoveFromCell(int32 CellIndex, int32 EntryIndex);
+
+	template <typename PredicateType, typename AllocatorType>
+	void GatherInCellRange(const FIntPoint& Min, const FIntPoint& Max, uint32 TeamMask, int32 MaxResults, PredicateType Predicate, TArray<int32, AllocatorType>& OutIds) const;
+	template <typename AllocatorType>
+	void QueryNearest(const FCombatSpatialQuery& Query, TArray<int32, AllocatorType>& OutIds) const;
+
+	float CellSize;
+	float InvCellSize;
+	int32 NumItems = 0;
+
+	TArray<FCell> Cells;
+	TArray<FIntPoint> CellCoords;
+	TMap<uint64, int32> CellLookup;
+
+	/** Where each id is stored, indexed by id */
+	TArray<FItemCell> ItemCells;
+};
+
+template <typename PredicateType, typename AllocatorType>
+void FCombatSpatialGrid::GatherInCellRange(const FIntPoint& Min, const FIntPoint& Max, uint32 TeamMask, int32 MaxResults, PredicateType Predicate, TArray<int32, AllocatorType>& OutIds) const
+{
+	int32 NumFound = 0;
+	for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+	{
+		for (int32 X = Min.X; X <= Max.X; ++X)
+		{
+			const FCell* Cell = FindCell(X, Y);
+			if (!Cell)
+			{
+				continue;
+			}
+
+			for (const FEntry& Entry : Cell->Entries)
+			{
+				if ((Entry.TeamBit & TeamMask) != 0 && Predicate(Entry.Position))
+				{
+					OutIds.Add(Entry.Id);
+					if (++NumFound >= MaxResults)
+					{
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename AllocatorType>
+void FCombatSpatialGrid::Query(const FCombatSpatialQuery& Query, TArray<int32, AllocatorType>& OutIds) const
+{
+	if (NumItems == 0 || Query.MaxResults <= 0)
+	{
+		return;
+	}
+
+	switch (Query.Shape)
+	{
+	case ECombatQueryShape::Nearest:
+		QueryNearest(Query, OutIds);
+		break;
+
+	case ECombatQueryShape::Radius:
+	{
+		const FVector Extent(Query.Radius, Query.Radius, 0.f);
+		const float RadiusSq = FMath::Square(Query.Radius);
+		GatherInCellRange(ToCellCoord(Query.Origin - Extent), ToCellCoord(Query.Origin + Extent), Query.TeamMask, Query.MaxResults,
+			[&Query, RadiusSq](const FVector& Position)
+			{
+				return FVector::DistSquared2D(Position, Query.Origin) <= RadiusSq;
+			}, OutIds);
+		break;
+	}
+
+	case ECombatQueryShape::Cone:
+	{
+		const FVector Extent(Query.Radius, Query.Radius, 0.f);
+		const float RadiusSq = FMath::Square(Query.Radius);
+		const FVector2D Forward = FVector2D(Query.Direction).GetSafeNormal();
+		const float CosHalfAngle = FMath::Cos(Query.HalfAngleRadians);
+		GatherInCellRange(ToCellCoord(Query.Origin - Extent), ToCellCoord(Query.Origin + Extent), Query.TeamMask, Query.MaxResults,
+			[&Query, RadiusSq, Forward, CosHalfAngle](const FVector& Position)
+			{
+				const FVector2D ToEntry(Position - Query.Origin);
+				const float DistSq = ToEntry.SizeSquared();
+				if (DistSq > RadiusSq)
+				{
+					return false;
+				}
+				return FVector2D::DotProduct(ToEntry, Forward) >= CosHalfAngle * FMath::Sqrt(DistSq);
+			}, OutIds);
+		break;
+	}
+
+	case ECombatQueryShape::Box:
+	{
+		const FVector Extent(Query.BoxExtent.X, Query.BoxExtent.Y, 0.f);
+		const FVector Min = Query.Origin - Extent;
+		const FVector Max = Query.Origin + Extent;
+		GatherInCellRange(ToCellCoord(Min), ToCellCoord(Max), Query.TeamMask, Query.MaxResults,
+			[&Min, &Max](const FVector& Position)
+			{
+				return Position.X >= Min.X && Position.X <= Max.X && Position.Y >= Min.Y && Position.Y <= Max.Y;
+			}, OutIds);
+		break;
+	}
+
+	case ECombatQueryShape::Polygon:
+	{
+		if (Query.PolygonPoints.Num() < 3)
+		{
+			break;
+		}
+
+		// Cells under the polygon's bounds, then one side test per edge
+		const FBox2D Bounds(Query.PolygonPoints.GetData(), Query.PolygonPoints.Num());
+		const TConstArrayView<FVector2D> Points = Query.PolygonPoints;
+		GatherInCellRange(ToCellCoord(FVector(Bounds.Min, 0.f)), ToCellCoord(FVector(Bounds.Max, 0.f)), Query.TeamMask, Query.MaxResults,
+			[Points](const FVector& Position)
+			{
+				const FVector2D Point(Position);
+				for (int32 Index = 0, Previous = Points.Num() - 1; Index < Points.Num(); Previous = Index++)
+				{
+					if (FVector2D::CrossProduct(Points[Index] - Points[Previous], Point - Points[Previous]) < 0.0)
+					{
+						return false;
+					}
+				}
+				return true;
+			}, OutIds);
+		break;
+	}
+	}
+}
+
+template <typename AllocatorType>
+void FCombatSpatialGrid::QueryNearest(const FCombatSpatialQuery& Query, TArray<int32, AllocatorType>& OutIds) const
+{
+	struct FCandidate
+	{
+		float DistSq;
+		int32 Id;
+	};
+
+	// Best candidates so far, kept sorted by distance
+	TArray<FCandidate, TInlineAllocator<16>> Best;
+	const int32 MaxResults = FMath::Min(Query.MaxResults, NumItems);
+	const float MaxDistSq = Query.Radius > 0.f ? FMath::Square(Query.Radius) : MAX_flt;
+	const int32 MaxRing = Query.Radius > 0.f ? FMath::CeilToInt32(Query.Radius * InvCellSize) + 1 : MAX_int32;
+	const FIntPoint Center = ToCellCoord(Query.Origin);
+
+	// Once every cell has been seen there is nothing left to find
+	int32 CellsVisited = 0;
+
+	for (int32 Ring = 0; Ring <= MaxRing && CellsVisited < CellLookup.Num(); ++Ring)
+	{
+		// Everything in this ring or beyond is at least (Ring - 1) cells away
+		if (Best.Num() == MaxResults)
+		{
+			const float RingMinDist = FMath::Max(Ring - 1, 0) * CellSize;
+			if (FMath::Square(RingMinDist) > Best.Last().DistSq)
+			{
+				break;
+			}
+		}
+
+		auto VisitCell = [&](int32 X, int32 Y)
+		{
+			const FCell* Cell = FindCell(X, Y);
+			if (!Cell)
+			{
+				return;
+			}
+			++CellsVisited;
+
+			for (const FEntry& Entry : Cell->Entries)
+			{
+				if ((Entry.TeamBit & Query.TeamMask) == 0)
+				{
+					continue;
+				}
+
+				const float DistSq = FVector::DistSquared2D(Entry.Position, Query.Origin);
+				if (DistSq > MaxDistSq || (Best.Num() == MaxResults && DistSq >= Best.Last().DistSq))
+				{
+					continue;
+				}
+
+				const int32 InsertAt = Algo::UpperBoundBy(Best, DistSq, &FCandidate::DistSq);
+				Best.Insert({ DistSq, Entry.Id }, InsertAt);
+				if (Best.Num() > MaxResults)
+				{
+					Best.Pop(EAllowShrinking::No);
+				}
+			}
+		};
+
+		if (Ring == 0)
+		{
+			VisitCell(Center.X, Center.Y);
+			continue;
+		}
+
+		for (int32 Offset = -Ring; Offset <= Ring; ++Offset)
+		{
+			VisitCell(Center.X + Offset, Center.Y - Ring);
+			VisitCell(Center.X + Offset, Center.Y + Ring);
+		}
+		for (int32 Offset = -Ring + 1; Offset <= Ring - 1; ++Offset)
+		{
+			VisitCell(Center.X - Ring, Center.Y + Offset);
+			VisitCell(Center.X + Ring, Center.Y + Offset);
+		}
+	}
+
+	for (const FCandidate& Candidate : Best)
+	{
+		OutIds.Add(Candidate.Id);
+	}
+}
@@ -0,0 +1,248 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatSnapshot.h"
+#include "NecromancerStats.h"
+#include "Algo/StableSort.h"
+#include "GameFramework/Actor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Combat Tick"), STAT_CombatTick, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Combat Timers"), STAT_CombatTimers, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat Timers Live"), STAT_CombatTimersLive, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Combat Timers Fired/Step"), STAT_CombatTimersFired, STATGROUP_Necromancer);
+
+void UCombatSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FCombatSimulationSettings Settings;
+	Settings.StepsPerSecond = StepsPerSecond;
+	Settings.TargetAcquisitionRadius = TargetAcquisitionRadius;
+	Settings.SpatialCellSize = SpatialCellSize;
+	Simulation = FCombatSimulation(Settings);
+
+	StatusEffects.SetDefinitions(StatusEffectDefinitions);
+	OnTimersExpired(ECombatTimerChannel::StatusEffect).AddRaw(&StatusEffects, &FStatusEffectStore::HandleExpiredTimers);
+}
+
+void UCombatSubsystem::Deinitialize()
+{
+	for (FOnCombatTimersExpired& Delegate : TimerExpiredDelegates)
+	{
+		Delegate.Clear();
+	}
+	StatusEffects.Reset();
+	Simulation.Reset();
+	Timers.Reset();
+	Components.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UCombatSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCombatSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatSubsystem, STATGROUP_Tickables);
+}
+
+void UCombatSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	NECRO_SCOPE(STAT_CombatTick, Combat);
+	NECRO_SET_COUNT(Units, Simulation.Num());
+
+	const float StepSeconds = Simulation.GetStepSeconds();
+	Accumulator += DeltaTime;
+
+	int32 NumSteps = 0;
+	while (Accumulator >= StepSeconds && NumSteps < MaxStepsPerFrame)
+	{
+		RunStep();
+		Accumulator -= StepSeconds;
+		++NumSteps;
+	}
+
+	// Drop whatever could not be simulated this frame
+	if (Accumulator >= StepSeconds)
+	{
+		Accumulator = FMath::Fmod(Accumulator, StepSeconds);
+	}
+	InterpolationAlpha = Accumulator / StepSeconds;
+}
+
+void UCombatSubsystem::RunStep()
+{
+	GatherComponentLocations();
+	OnPreStep.Broadcast(Simulation.GetStepSeconds());
+
+	EventResults.Reset();
+	EventBus.Apply(Simulation, EventResults);
+
+	const uint32 AuraRefreshSteps = Simulation.SecondsToSteps(AuraRefreshInterval);
+	if (Simulation.GetStepIndex() % AuraRefreshSteps == 0)
+	{
+		StatusEffects.RefreshAuras(AuraRefreshSteps * 2);
+	}
+	StatusEffects.Flush();
+
+	TArray<FCombatEvent> Hits;
+	Simulation.Step(Hits);
+	EventBus.EnqueueBatch(MoveTemp(Hits));
+	NotifyStepResults();
+	DispatchTimers();
+}
+
+void UCombatSubsystem::NotifyStepResults()
+{
+	// Copy first: notifications may unregister combatants or queue new events
+	const TArray<FCombatEventResult> Results = MoveTemp(EventResults);
+	TArray<FCombatHandle, TInlineAllocator<16>> Killed(Simulation.GetKilledLastStep());
+
+	if (Results.Num() > 0)
+	{
+		OnEventsApplied.Broadcast(Results);
+	}
+	for (const FCombatEventResult& Result : Results)
+	{
+		if (Result.bKilled)
+		{
+			Killed.Add(Result.Target);
+		}
+		if (UCombatManagerComponent* Component = Components.FindRef(Result.Target).Get())
+		{
+			Component->NotifyEvents(Result);
+		}
+	}
+	for (const FCombatHandle& Handle : Killed)
+	{
+		StatusEffects.RemoveAll(Handle);
+		if (UCombatManagerComponent* Component = Components.FindRef(Handle).Get())
+		{
+			Component->NotifyDied();
+		}
+	}
+}
+
+void UCombatSubsystem::DispatchTimers()
+{
+	SCOPE_CYCLE_COUNTER(STAT_CombatTimers);
+
+	ExpiredTimers.Reset();
+	Timers.Advance(ExpiredTimers);
+	SET_DWORD_STAT(STAT_CombatTimersLive, Timers.GetNumActive());
+	SET_DWORD_STAT(STAT_CombatTimersFired, ExpiredTimers.Num());
+	if (ExpiredTimers.Num() == 0)
+	{
+		return;
+	}
+
+	// One broadcast per channel. Listeners may schedule new timers, but those only fire on later steps.
+	Algo::StableSortBy(ExpiredTimers, &FCombatTimerExpiry::Channel);
+	for (int32 First = 0; First < ExpiredTimers.Num();)
+	{
+		const ECombatTimerChannel Channel = ExpiredTimers[First].Channel;
+		int32 End = First + 1;
+		while (End < ExpiredTimers.Num() && ExpiredTimers[End].Channel == Channel)
+		{
+			++End;
+		}
+		OnTimersExpired(Channel).Broadcast(MakeArrayView(ExpiredTimers).Slice(First, End - First));
+		First = End;
+	}
+}
+
+FCombatTimerHandle UCombatSubsystem::ScheduleTimer(float Seconds, ECombatTimerChannel Channel, FCombatHandle Target, uint32 Payload)
+{
+	return Timers.Schedule(Simulation.SecondsToSteps(Seconds), Channel, Target, Payload);
+}
+
+FCombatHandle UCombatSubsystem::RegisterCombatant(const FCombatantDesc& Desc, UCombatManagerComponent* Component)
+{
+	const FCombatHandle Handle = Simulation.Add(Desc);
+	if (Component)
+	{
+		Components.Add(Handle, Component);
+	}
+	return Handle;
+}
+
+void UCombatSubsystem::UnregisterCombatant(FCombatHandle Handle)
+{
+	StatusEffects.RemoveAll(Handle);
+	Simulation.Remove(Handle);
+	Components.Remove(Handle);
+}
+
+void UCombatSubsystem::WriteSnapshot(FCombatSnapshotWriter& Writer) const
+{
+	Simulation.WriteSnapshot(Writer);
+	StatusEffects.WriteSnapshot(Writer);
+
+	TArray<FCombatHandle> ActorCombatants;
+	Components.GenerateKeyArray(ActorCombatants);
+	Writer.AddSection<FCombatHandle>(ECombatSnapshotSection::ActorCombatants, ActorCombatants);
+}
+
+void UCombatSubsystem::RestoreSnapshot(FCombatSimulation&& Restored, const FCombatSnapshotReader& Reader, TArray<TWeakObjectPtr<UCombatManagerComponent>>& OutReleased)
+{
+	// Released while their handles still resolve, so cooldowns are cancelled on the wheel they were scheduled on
+	TArray<TWeakObjectPtr<UCombatManagerComponent>> Owners;
+	Components.GenerateValueArray(Owners);
+	for (const TWeakObjectPtr<UCombatManagerComponent>& Owner : Owners)
+	{
+		if (UCombatManagerComponent* Component = Owner.Get())
+		{
+			Component->ReleaseCombatant();
+			OutReleased.Add(Component);
+		}
+	}
+	Components.Reset();
+
+	StatusEffects.Reset();
+	Timers.Reset();
+	EventBus.Discard();
+	Simulation = MoveTemp(Restored);
+	if (!StatusEffects.ReadSnapshot(Reader))
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Combat snapshot has inconsistent status effects; they were dropped"));
+	}
+
+	Accumulator = 0.f;
+	InterpolationAlpha = 0.f;
+}
+
+void UCombatSubsystem::SetCombatantComponent(FCombatHandle Handle, UCombatManagerComponent* Component)
+{
+	if (!Simulation.IsValid(Handle))
+	{
+		return;
+	}
+
+	if (Component)
+	{
+		Components.Add(Handle, Component);
+	}
+	else
+	{
+		Components.Remove(Handle);
+	}
+}
+
+void UCombatSubsystem::GatherComponentLocations()
+{
+	for (const TPair<FCombatHandle, TWeakObjectPtr<UCombatManagerComponent>>& Pair : Components)
+	{
+		const UCombatManagerComponent* Component = Pair.Value.Get();
+		if (const AActor* Owner = Component ? Component->GetOwner() : nullptr)
+		{
+			Simulation.SetLocation(Pair.Key, Owner->GetActorLocation());
+		}
+	}
+}
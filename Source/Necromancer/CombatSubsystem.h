@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatSimulation.h"
+#include "CombatEventBus.h"
+#include "CombatTimerWheel.h"
+#include "StatusEffectStore.h"
+#include "CombatSubsystem.generated.h"
+
+class UCombatManagerComponent;
+class FCombatSnapshotReader;
+class FCombatSnapshotWriter;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnCombatStep, float /*StepSeconds*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnCombatEventsApplied, TConstArrayView<FCombatEventResult> /*Results*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnCombatTimersExpired, TConstArrayView<FCombatTimerExpiry> /*Expired*/);
+
+/**
+ * Runs the world's FCombatSimulation at a fixed rate, independent of the render frame rate.
+ * Frame time is accumulated and spent in whole steps; the remainder is exposed as an interpolation alpha.
+ * A slow frame runs at most MaxStepsPerFrame steps and drops the rest rather than catching up in one go.
+ * Damage, healing and raising from other systems go through the event bus and are applied once at the start of every step.
+ * Cooldowns, status effects and decay windows run on a timing wheel advanced by the same step.
+ * Status effect attribute changes are flushed right before the simulation steps.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UCombatSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Adds a combatant. Component is optional and only used to mirror location and report deaths. */
+	FCombatHandle RegisterCombatant(const FCombatantDesc& Desc, UCombatManagerComponent* Component = nullptr);
+	void UnregisterCombatant(FCombatHandle Handle);
+	void SetCombatantComponent(FCombatHandle Handle, UCombatManagerComponent* Component);
+
+	/** The component of an actor-backed combatant, or null */
+	UCombatManagerComponent* FindCombatantComponent(FCombatHandle Handle) const
+	{
+		const TWeakObjectPtr<UCombatManagerComponent>* Found = Components.Find(Handle);
+		return Found ? Found->Get() : nullptr;
+	}
+
+	/**
+	 * Queue for combat events, safe to feed from any thread. Events are applied at the start of the next step.
+	 * Melee hits of every step are queued here as well, so all damage reaches OnEventsApplied and the components.
+	 */
+	FCombatEventBus& GetEventBus() { return EventBus; }
+
+	/** Schedules a timer on the combat step clock, rounded to whole steps. Expiries are broadcast per channel after the step. */
+	FCombatTimerHandle ScheduleTimer(float Seconds, ECombatTimerChannel Channel, FCombatHandle Target = FCombatHandle(), uint32 Payload = 0);
+	bool CancelTimer(FCombatTimerHandle Handle) { return Timers.Cancel(Handle); }
+	float GetTimerRemaining(FCombatTimerHandle Handle) const { return Timers.GetRemainingSteps(Handle) * Simulation.GetStepSeconds(); }
+	FCombatTimerWheel& GetTimers() { return Timers; }
+
+	/** Buffs, debuffs and auras. Attribute changes reach the simulation at the start of the next step. */
+	FStatusEffectStore& GetStatusEffects() { return StatusEffects; }
+	const FStatusEffectStore& GetStatusEffects() const { return StatusEffects; }
+
+	/** Broadcast once per step with the timers of Channel that expired in it */
+	FOnCombatTimersExpired& OnTimersExpired(ECombatTimerChannel Channel) { return TimerExpiredDelegates[static_cast<uint8>(Channel)]; }
+
+	/** Copies the simulation, the status effects and the handles of actor-backed combatants into Writer */
+	void WriteSnapshot(FCombatSnapshotWriter& Writer) const;
+
+	/**
+	 * Replaces the simulation by Restored, read from Reader, and the status effects by Reader's. Queued events and
+	 * every timer are dropped. Actor-backed combatants lose their combatant; their components are appended to
+	 * OutReleased so that they can register again once the rest of the world was restored.
+	 */
+	void RestoreSnapshot(FCombatSimulation&& Restored, const FCombatSnapshotReader& Reader, TArray<TWeakObjectPtr<UCombatManagerComponent>>& OutReleased);
+
+	FCombatSimulation& GetSimulation() { return Simulation; }
+	const FCombatSimulation& GetSimulation() const { return Simulation; }
+
+	/** How far the current frame is between the last step and the next, in [0, 1) */
+	float GetInterpolationAlpha() const { return InterpolationAlpha; }
+
+	/** Broadcast before every fixed step, after actor locations were gathered. Systems moving combatants advance them here. */
+	FOnCombatStep OnPreStep;
+
+	/** Broadcast once per step with every combatant the event bus changed, including those without a component */
+	FOnCombatEventsApplied OnEventsApplied;
+
+	UPROPERTY(Config)
+	int32 StepsPerSecond = 30;
+
+	/** Steps run in one frame at most. Time beyond that is dropped, slowing the simulation down instead. */
+	UPROPERTY(Config)
+	int32 MaxStepsPerFrame = 4;
+
+	/** Combatants without a live target pick the nearest hostile within this distance */
+	UPROPERTY(Config)
+	float TargetAcquisitionRadius = 1200.f;
+
+	/** Every kind of status effect in the game, referenced by name */
+	UPROPERTY(Config)
+	TArray<FStatusEffectDef> StatusEffectDefinitions;
+
+	/** Seconds between aura range checks. Effects applied by an aura last twice as long. */
+	UPROPERTY(Config)
+	float AuraRefreshInterval = 0.5f;
+
+	/** Edge length of a spatial grid cell. Roughly the most common query radius works best. */
+	UPROPERTY(Config)
+	float SpatialCellSize = 500.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void GatherComponentLocations();
+	void RunStep();
+	void NotifyStepResults();
+	void DispatchTimers();
+
+	FCombatSimulation Simulation;
+	FCombatEventBus EventBus;
+
+	/** Results of this step's event apply phase */
+	TArray<FCombatEventResult> EventResults;
+
+	FCombatTimerWheel Timers;
+	FOnCombatTimersExpired TimerExpiredDelegates[static_cast<uint8>(ECombatTimerChannel::Num)];
+	TArray<FCombatTimerExpiry> ExpiredTimers;
+
+	FStatusEffectStore StatusEffects{ Simulation, Timers, EventBus };
+
+	/** Actor-backed combatants */
+	TMap<FCombatHandle, TWeakObjectPtr<UCombatManagerComponent>> Components;
+
+	float Accumulator = 0.f;
+	float InterpolationAlpha = 0.f;
+};
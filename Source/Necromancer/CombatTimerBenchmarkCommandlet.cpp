@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatTimerBenchmarkCommandlet.h"
+#include "CombatTimerWheel.h"
+#include "Necromancer.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+#include "TimerManager.h"
+
+namespace CombatTimerBenchmark
+{
+	constexpr float MinInterval = 1.f;
+	constexpr float MaxInterval = 10.f;
+
+	struct FTimings
+	{
+		double ScheduleSeconds = 0.0;
+		double RunSeconds = 0.0;
+		double CancelSeconds = 0.0;
+		uint64 Fired = 0;
+	};
+
+	FTimings RunTimerManager(TConstArrayView<float> Intervals, int32 Steps, float StepSeconds)
+	{
+		FTimings Timings;
+		FTimerManager TimerManager;
+		TArray<FTimerHandle> Handles;
+		Handles.SetNum(Intervals.Num());
+		uint64 Fired = 0;
+		const FTimerDelegate Delegate = FTimerDelegate::CreateLambda([&Fired]() { ++Fired; });
+
+		double Start = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < Intervals.Num(); ++Index)
+		{
+			TimerManager.SetTimer(Handles[Index], Delegate, Intervals[Index], true);
+		}
+		Timings.ScheduleSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < Steps; ++Step)
+		{
+			// FTimerManager ticks once per engine frame; there is no engine loop here to advance the counter
+			++GFrameCounter;
+			TimerManager.Tick(StepSeconds);
+		}
+		Timings.RunSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		for (FTimerHandle& Handle : Handles)
+		{
+			TimerManager.ClearTimer(Handle);
+		}
+		Timings.CancelSeconds = FPlatformTime::Seconds() - Start;
+
+		Timings.Fired = Fired;
+		return Timings;
+	}
+
+	FTimings RunWheel(TConstArrayView<float> Intervals, int32 Steps, float StepSeconds)
+	{
+		FTimings Timings;
+		FCombatTimerWheel Wheel;
+		TArray<FCombatTimerHandle> Handles;
+		Handles.SetNum(Intervals.Num());
+		TArray<FCombatTimerExpiry> Expired;
+
+		double Start = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < Intervals.Num(); ++Index)
+		{
+			const uint32 IntervalSteps = FMath::Max(FMath::RoundToInt32(Intervals[Index] / StepSeconds), 1);
+			Handles[Index] = Wheel.Schedule(IntervalSteps, ECombatTimerChannel::Cooldown, FCombatHandle(), Index);
+		}
+		Timings.ScheduleSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < Steps; ++Step)
+		{
+			Expired.Reset();
+			Wheel.Advance(Expired);
+			Timings.Fired += Expired.Num();
+
+			// Loop like the FTimerManager timers do
+			for (const FCombatTimerExpiry& Expiry : Expired)
+			{
+				const int32 Index = Expiry.Payload;
+				const uint32 IntervalSteps = FMath::Max(FMath::RoundToInt32(Intervals[Index] / StepSeconds), 1);
+				Handles[Index] = Wheel.Schedule(IntervalSteps, ECombatTimerChannel::Cooldown, FCombatHandle(), Index);
+			}
+		}
+		Timings.RunSeconds = FPlatformTime::Seconds() - Start;
+
+		Start = FPlatformTime::Seconds();
+		for (const FCombatTimerHandle& Handle : Handles)
+		{
+			Wheel.Cancel(Handle);
+		}
+		Timings.CancelSeconds = FPlatformTime::Seconds() - Start;
+
+		return Timings;
+	}
+
+	void LogTimings(const TCHAR* Name, const FTimings& Timings, int32 Steps)
+	{
+		UE_LOG(LogNecromancer, Display, TEXT("CombatTimerBenchmark: %-13s schedule %7.2fms  step %8.4fms  cancel %7.2fms  fired %llu"),
+			Name, Timings.ScheduleSeconds * 1000.0, Timings.RunSeconds * 1000.0 / FMath::Max(Steps, 1), Timings.CancelSeconds * 1000.0, Timings.Fired);
+	}
+}
+
+UCombatTimerBenchmarkCommandlet::UCombatTimerBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCombatTimerBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumTimers = 100000;
+	float Seconds = 20.f;
+	int32 StepsPerSecond = 30;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Timers="), NumTimers);
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+	FParse::Value(*Params, TEXT("StepsPerSecond="), StepsPerSecond);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	StepsPerSecond = FMath::Max(StepsPerSecond, 1);
+
+	const float StepSeconds = 1.f / StepsPerSecond;
+	const int32 Steps = FMath::CeilToInt32(Seconds * StepsPerSecond);
+
+	// Both sides get the same looping intervals, so they keep NumTimers live for the whole run
+	FRandomStream Random(Seed);
+	TArray<float> Intervals;
+	Intervals.SetNumUninitialized(NumTimers);
+	for (float& Interval : Intervals)
+	{
+		Interval = Random.FRandRange(CombatTimerBenchmark::MinInterval, CombatTimerBenchmark::MaxInterval);
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("CombatTimerBenchmark: %d looping timers over %d steps of %.1fms"), NumTimers, Steps, StepSeconds * 1000.f);
+	CombatTimerBenchmark::LogTimings(TEXT("FTimerManager"), CombatTimerBenchmark::RunTimerManager(Intervals, Steps, StepSeconds), Steps);
+	CombatTimerBenchmark::LogTimings(TEXT("Timer wheel"), CombatTimerBenchmark::RunWheel(Intervals, Steps, StepSeconds), Steps);
+
+	return 0;
+}
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatTimerBenchmarkCommandlet.generated.h"
+
+/**
+ * Compares FCombatTimerWheel against the engine's FTimerManager with the same set of looping timers.
+ *
+ * Usage: -run=CombatTimerBenchmark [-Timers=100000] [-Seconds=20] [-StepsPerSecond=30] [-Seed=0]
+ */
+UCLASS()
+class UCombatTimerBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCombatTimerBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
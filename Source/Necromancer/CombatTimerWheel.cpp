@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatTimerWheel.h"
+
+namespace CombatTimerWheel
+{
+	constexpr uint64 SlotMask = FCombatTimerWheel::SlotsPerLevel - 1;
+
+	// Furthest a timer can be filed ahead of the current step
+	constexpr uint64 MaxFiledDelta = (uint64(1) << (FCombatTimerWheel::SlotBits * FCombatTimerWheel::NumLevels)) - 1;
+}
+
+FCombatTimerWheel::FCombatTimerWheel()
+{
+	SlotHeads.Init(INDEX_NONE, NumLevels * SlotsPerLevel);
+	SlotTails.Init(INDEX_NONE, NumLevels * SlotsPerLevel);
+}
+
+FCombatTimerHandle FCombatTimerWheel::Schedule(uint32 DelaySteps, ECombatTimerChannel Channel, FCombatHandle Target, uint32 Payload)
+{
+	const int32 NodeIndex = AllocateNode();
+	FNode& Node = Nodes[NodeIndex];
+	Node.DueStep = CurrentStep + FMath::Max<uint32>(DelaySteps, 1) - 1;
+	Node.Channel = Channel;
+	Node.Target = Target;
+	Node.Payload = Payload;
+	Link(NodeIndex);
+
+	++NumActive;
+	return { NodeIndex, Node.Serial };
+}
+
+bool FCombatTimerWheel::Cancel(FCombatTimerHandle Handle)
+{
+	if (!FindNode(Handle))
+	{
+		return false;
+	}
+
+	Unlink(Handle.Node);
+	FreeNode(Handle.Node);
+	--NumActive;
+	return true;
+}
+
+bool FCombatTimerWheel::IsActive(FCombatTimerHandle Handle) const
+{
+	return FindNode(Handle) != nullptr;
+}
+
+uint32 FCombatTimerWheel::GetRemainingSteps(FCombatTimerHandle Handle) const
+{
+	const FNode* Node = FindNode(Handle);
+	return Node ? static_cast<uint32>(Node->DueStep - CurrentStep + 1) : 0;
+}
+
+void FCombatTimerWheel::Advance(TArray<FCombatTimerExpiry>& OutExpired)
+{
+	// Whenever a level wraps, the next slot of the level above comes within its range and is spread out below
+	for (int32 Level = 1; Level < NumLevels; ++Level)
+	{
+		if (((CurrentStep >> (SlotBits * (Level - 1))) & CombatTimerWheel::SlotMask) != 0)
+		{
+			break;
+		}
+		Cascade(Level);
+	}
+
+	const int32 Slot = static_cast<int32>(CurrentStep & CombatTimerWheel::SlotMask);
+	for (int32 NodeIndex = SlotHeads[Slot]; NodeIndex != INDEX_NONE;)
+	{
+		const FNode& Node = Nodes[NodeIndex];
+		const int32 NextIndex = Node.Next;
+		check(Node.DueStep == CurrentStep);
+
+		OutExpired.Add({ { NodeIndex, Node.Serial }, Node.Channel, Node.Target, Node.Payload });
+		FreeNode(NodeIndex);
+		--NumActive;
+		NodeIndex = NextIndex;
+	}
+	SlotHeads[Slot] = INDEX_NONE;
+	SlotTails[Slot] = INDEX_NONE;
+
+	++CurrentStep;
+}
+
+void FCombatTimerWheel::Reset()
+{
+	for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); ++NodeIndex)
+	{
+		if (Nodes[NodeIndex].Slot != INDEX_NONE)
+		{
+			FreeNode(NodeIndex);
+		}
+	}
+	for (int32 Slot = 0; Slot < SlotHeads.Num(); ++Slot)
+	{
+		SlotHeads[Slot] = INDEX_NONE;
+		SlotTails[Slot] = INDEX_NONE;
+	}
+	CurrentStep = 0;
+	NumActive = 0;
+}
+
+void FCombatTimerWheel::Reserve(int32 NumTimers)
+{
+	while (Nodes.Num() < NumTimers)
+	{
+		FreeNode(Nodes.AddDefaulted());
+	}
+}
+
+const FCombatTimerWheel::FNode* FCombatTimerWheel::FindNode(FCombatTimerHandle Handle) const
+{
+	if (!Nodes.IsValidIndex(Handle.Node))
+	{
+		return nullptr;
+	}
+
+	const FNode& Node = Nodes[Handle.Node];
+	return Node.Slot != INDEX_NONE && Node.Serial == Handle.Serial ? &Node : nullptr;
+}
+
+int32 FCombatTimerWheel::AllocateNode()
+{
+	int32 NodeIndex = FreeHead;
+	if (NodeIndex != INDEX_NONE)
+	{
+		FreeHead = Nodes[NodeIndex].Next;
+	}
+	else
+	{
+		NodeIndex = Nodes.AddDefaulted();
+	}
+
+	Nodes[NodeIndex].Serial = NextSerial++;
+	return NodeIndex;
+}
+
+void FCombatTimerWheel::FreeNode(int32 NodeIndex)
+{
+	FNode& Node = Nodes[NodeIndex];
+	Node.Slot = INDEX_NONE;
+	Node.Prev = INDEX_NONE;
+	Node.Next = FreeHead;
+	FreeHead = NodeIndex;
+}
+
+void FCombatTimerWheel::Link(int32 NodeIndex)
+{
+	FNode& Node = Nodes[NodeIndex];
+
+	// File by how far ahead the timer is: level L holds timers due within 64^(L+1) steps
+	uint64 Due = Node.DueStep;
+	const uint64 Delta = Due - CurrentStep;
+	int32 Level = 0;
+	while (Level < NumLevels - 1 && Delta >> (SlotBits * (Level + 1)) != 0)
+	{
+		++Level;
+	}
+	if (Delta > CombatTimerWheel::MaxFiledDelta)
+	{
+		// Parked in the last level's furthest slot until it comes within range
+		Due = CurrentStep + CombatTimerWheel::MaxFiledDelta;
+	}
+
+	const int32 Slot = Level * SlotsPerLevel + static_cast<int32>((Due >> (SlotBits * Level)) & CombatTimerWheel::SlotMask);
+	Node.Slot = Slot;
+	Node.Prev = SlotTails[Slot];
+	Node.Next = INDEX_NONE;
+	if (Node.Prev != INDEX_NONE)
+	{
+		Nodes[Node.Prev].Next = NodeIndex;
+	}
+	else
+	{
+		SlotHeads[Slot] = NodeIndex;
+	}
+	SlotTails[Slot] = NodeIndex;
+}
+
+void FCombatTimerWheel::Unlink(int32 NodeIndex)
+{
+	const FNode& Node = Nodes[NodeIndex];
+	if (Node.Prev != INDEX_NONE)
+	{
+		Nodes[Node.Prev].Next = Node.Next;
+	}
+	else
+	{
+		SlotHeads[Node.Slot] = Node.Next;
+	}
+	if (Node.Next != INDEX_NONE)
+	{
+		Nodes[Node.Next].Prev = Node.Prev;
+	}
+	else
+	{
+		SlotTails[Node.Slot] = Node.Prev;
+	}
+}
+
+void FCombatTimerWheel::Cascade(int32 Level)
+{
+	const int32 Slot = Level * SlotsPerLevel + static_cast<int32>((CurrentStep >> (SlotBits * Level)) & CombatTimerWheel::SlotMask);
+
+	// Detach the whole list first: re-filing may put nodes back into this same slot
+	int32 NodeIndex = SlotHeads[Slot];
+	SlotHeads[Slot] = INDEX_NONE;
+	SlotTails[Slot] = INDEX_NONE;
+	while (NodeIndex != INDEX_NONE)
+	{
+		const int32 NextIndex = Nodes[NodeIndex].Next;
+		Link(NodeIndex);
+		NodeIndex = NextIndex;
+	}
+}
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatTypes.h"
+
+/** What a combat timer is for. Expired timers are reported grouped by channel. */
+enum class ECombatTimerChannel : uint8
+{
+	Cooldown,
+	StatusEffect,
+	Summon,
+	CorpseDecay,
+	Num,
+};
+
+/** Reference to a scheduled timer. Safe to keep after the timer fired or was cancelled. */
+struct FCombatTimerHandle
+{
+	int32 Node = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Node != INDEX_NONE; }
+	void Reset() { Node = INDEX_NONE; Serial = 0; }
+
+	bool operator==(const FCombatTimerHandle& Other) const { return Node == Other.Node && Serial == Other.Serial; }
+	bool operator!=(const FCombatTimerHandle& Other) const { return !(*this == Other); }
+};
+
+/** A timer that came due */
+struct FCombatTimerExpiry
+{
+	FCombatTimerHandle Handle;
+	ECombatTimerChannel Channel = ECombatTimerChannel::Cooldown;
+	FCombatHandle Target;
+	uint32 Payload = 0;
+};
+
+/**
+ * Hierarchical timing wheel counting in combat steps.
+ *
+ * Four levels of 64 slots each cover 2^24 steps; longer timers wait in the last level and are re-filed as they
+ * come closer. Scheduling and cancelling are O(1) and advancing a step only touches the timers that fire or move
+ * down a level, so the cost follows the number of expiries rather than the number of live timers.
+ * Timer nodes are pooled in one array and linked by index, so a timer costs no allocation once the pool has grown.
+ * Timers due on the same step fire in an order that depends only on the sequence of calls, never on timing.
+ */
+class NECROMANCER_API FCombatTimerWheel
+{
+public:
+	FCombatTimerWheel();
+
+	/** Fires after DelaySteps steps, at least one. */
+	FCombatTimerHandle Schedule(uint32 DelaySteps, ECombatTimerChannel Channel, FCombatHandle Target = FCombatHandle(), uint32 Payload = 0);
+
+	/** Stops a pending timer. Returns false if it already fired or was cancelled. */
+	bool Cancel(FCombatTimerHandle Handle);
+
+	bool IsActive(FCombatTimerHandle Handle) const;
+
+	/** Steps until the timer fires, or 0 if it is not active */
+	uint32 GetRemainingSteps(FCombatTimerHandle Handle) const;
+
+	/** Moves time forward by one step and appends every timer that came due to OutExpired. */
+	void Advance(TArray<FCombatTimerExpiry>& OutExpired);
+
+	/** Cancels every timer and rewinds to step zero. Keeps the node pool. */
+	void Reset();
+
+	/** Grows the node pool up front, e.g. before a fight spawns thousands of timers */
+	void Reserve(int32 NumTimers);
+
+	int32 GetNumActive() const { return NumActive; }
+	uint64 GetCurrentStep() const { return CurrentStep; }
+
+	static constexpr int32 SlotBits = 6;
+	static constexpr int32 SlotsPerLevel = 1 << SlotBits;
+	static constexpr int32 NumLevels = 4;
+
+private:
+	struct FNode
+	{
+		uint64 DueStep = 0;
+		int32 Prev = INDEX_NONE;
+		int32 Next = INDEX_NONE;
+
+		/** Slot list this node is linked into, or INDEX_NONE while it sits in the free list */
+		int32 Slot = INDEX_NONE;
+		uint32 Serial = 0;
+		ECombatTimerChannel Channel = ECombatTimerChannel::Cooldown;
+		FCombatHandle Target;
+		uint32 Payload = 0;
+	};
+
+	const FNode* FindNode(FCombatTimerHandle Handle) const;
+	int32 AllocateNode();
+	void FreeNode(int32 NodeIndex);
+	void Link(int32 NodeIndex);
+	void Unlink(int32 NodeIndex);
+
+	/** Re-files every timer of a slot one level up against the current step */
+	void Cascade(int32 Level);
+
+	TArray<FNode> Nodes;
+	int32 FreeHead = INDEX_NONE;
+	uint32 NextSerial = 1;
+
+	/** Head and tail node of each slot, indexed by Level * SlotsPerLevel + Slot */
+	TArray<int32> SlotHeads;
+	TArray<int32> SlotTails;
+
+	/** The step Advance processes next */
+	uint64 CurrentStep = 0;
+	int32 NumActive = 0;
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatTypes.generated.h"
+
+/** Side a combatant fights for. Raised minions join the Undead team. */
+UENUM(BlueprintType)
+enum class ECombatTeam : uint8
+{
+	Undead,
+	Living,
+	Neutral,
+};
+
+/** Combat stat that status effects can modify */
+UENUM(BlueprintType)
+enum class ECombatAttribute : uint8
+{
+	MaxHealth,
+	AttackDamage,
+	AttackInterval,
+	AttackRange,
+	Num UMETA(Hidden),
+};
+
+/** Returns the bit used for Team in team masks. */
+FORCEINLINE uint32 CombatTeamBit(ECombatTeam Team)
+{
+	return 1u << static_cast<uint8>(Team);
+}
+
+/** Returns the mask of every team Team attacks. Neutral combatants are never attacked automatically. */
+FORCEINLINE uint32 CombatHostileTeamMask(ECombatTeam Team)
+{
+	const uint32 AllTeams = CombatTeamBit(ECombatTeam::Undead) | CombatTeamBit(ECombatTeam::Living);
+	return Team == ECombatTeam::Neutral ? 0u : AllTeams & ~CombatTeamBit(Team);
+}
+
+/** Stable reference to a combatant stored in UCombatSubsystem. Survives removal of other combatants. */
+struct FCombatHandle
+{
+	int32 Slot = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Slot != INDEX_NONE; }
+	void Reset() { Slot = INDEX_NONE; Serial = 0; }
+
+	bool operator==(const FCombatHandle& Other) const { return Slot == Other.Slot && Serial == Other.Serial; }
+	bool operator!=(const FCombatHandle& Other) const { return !(*this == Other); }
+
+	friend uint32 GetTypeHash(const FCombatHandle& Handle)
+	{
+		return HashCombine(GetTypeHash(Handle.Slot), GetTypeHash(Handle.Serial));
+	}
+};
+
+/** Initial state of a combatant when it is registered. */
+struct FCombatantDesc
+{
+	ECombatTeam Team = ECombatTeam::Living;
+	float MaxHealth = 100.f;
+	float AttackDamage = 10.f;
+	float AttackInterval = 1.f;
+	float AttackRange = 150.f;
+	FVector Location = FVector::ZeroVector;
+};
@@ -0,0 +1,464 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CorpseSubsystem.h"
+#include "CombatSnapshot.h"
+#include "CombatSubsystem.h"
+#include "MinionHordeSubsystem.h"
+#include "Necromancer.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+
+DEFINE_STAT(STAT_CorpseQuery);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Corpses"), STAT_Corpses, STATGROUP_Necromancer);
+
+namespace CorpseRegistry
+{
+	// Per-instance custom data slot the corpse material reads for hover highlighting
+	constexpr int32 HighlightDataIndex = 0;
+
+	// Bits of the Highlighted fragment
+	constexpr uint8 HighlightedFlag = 1;
+	constexpr uint8 InRangeFlag = 2;
+}
+
+void UCorpseSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SpatialGrid = FCombatSpatialGrid(GridCellSize);
+
+	UCombatSubsystem* CombatSubsystem = Collection.InitializeDependency<UCombatSubsystem>();
+	DecayHandle = CombatSubsystem->OnTimersExpired(ECombatTimerChannel::CorpseDecay).AddUObject(this, &UCorpseSubsystem::HandleDecay);
+	EventsAppliedHandle = CombatSubsystem->OnEventsApplied.AddUObject(this, &UCorpseSubsystem::HandleEventsApplied);
+}
+
+void UCorpseSubsystem::Deinitialize()
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->OnTimersExpired(ECombatTimerChannel::CorpseDecay).Remove(DecayHandle);
+		CombatSubsystem->OnEventsApplied.Remove(EventsAppliedHandle);
+	}
+
+	Combatant.Empty();
+	Location.Empty();
+	Yaw.Empty();
+	Type.Empty();
+	DecayTimer.Empty();
+	MeshInstance.Empty();
+	Highlighted.Empty();
+	CombatantToCorpse.Empty();
+	SlotToCorpse.Empty();
+	SpatialGrid.Reset();
+	HighlightedCorpses.Empty();
+	RisingCorpses.Empty();
+	InstancedMeshes.Empty();
+	FreeInstances.Empty();
+	PendingHighlights.Empty();
+	RenderActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UCorpseSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCorpseSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCorpseSubsystem, STATGROUP_Tickables);
+}
+
+void UCorpseSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	InstancedMeshes.Init(nullptr, CorpseTypes.Num());
+	FreeInstances.SetNum(CorpseTypes.Num());
+	PendingHighlights.SetNum(CorpseTypes.Num());
+	DirtyMeshes.Init(false, CorpseTypes.Num());
+
+	// Servers never draw corpses
+	if (InWorld.GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	RenderActor = InWorld.SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+	RenderActor->SetRootComponent(NewObject<USceneComponent>(RenderActor, TEXT("Root")));
+	RenderActor->GetRootComponent()->RegisterComponent();
+
+	for (int32 Index = 0; Index < CorpseTypes.Num(); ++Index)
+	{
+		UStaticMesh* Mesh = CorpseTypes[Index].Mesh.LoadSynchronous();
+		if (!Mesh)
+		{
+			continue;
+		}
+
+		UInstancedStaticMeshComponent* InstancedMesh = NewObject<UInstancedStaticMeshComponent>(RenderActor);
+		InstancedMesh->SetMobility(EComponentMobility::Movable);
+		InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		InstancedMesh->SetCastShadow(false);
+		InstancedMesh->SetStaticMesh(Mesh);
+		InstancedMesh->NumCustomDataFloats = 1;
+		InstancedMesh->SetupAttachment(RenderActor->GetRootComponent());
+		InstancedMesh->RegisterComponent();
+		InstancedMeshes[Index] = InstancedMesh;
+	}
+}
+
+void UCorpseSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Highlight changes are applied in the order they were made, so the last one for an instance wins
+	for (int32 TypeIndex = 0; TypeIndex < PendingHighlights.Num(); ++TypeIndex)
+	{
+		UInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[TypeIndex];
+		if (InstancedMesh && PendingHighlights[TypeIndex].Num() > 0)
+		{
+			for (const FPendingHighlight& Pending : PendingHighlights[TypeIndex])
+			{
+				InstancedMesh->SetCustomDataValue(Pending.Instance, CorpseRegistry::HighlightDataIndex, Pending.Value, false);
+			}
+			DirtyMeshes[TypeIndex] = true;
+		}
+		PendingHighlights[TypeIndex].Reset();
+	}
+
+	// Instance edits during the frame skip the render update; send each changed mesh once
+	for (TConstSetBitIterator<> It(DirtyMeshes); It; ++It)
+	{
+		if (UInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[It.GetIndex()])
+		{
+			InstancedMesh->MarkRenderStateDirty();
+		}
+	}
+	DirtyMeshes.SetRange(0, DirtyMeshes.Num(), false);
+
+	SET_DWORD_STAT(STAT_Corpses, Combatant.Num());
+}
+
+UCombatSubsystem* UCorpseSubsystem::GetCombatSubsystem() const
+{
+	return GetWorld()->GetSubsystem<UCombatSubsystem>();
+}
+
+int32 UCorpseSubsystem::FindCorpseType(FName Name) const
+{
+	const int32 Index = CorpseTypes.IndexOfByPredicate([Name](const FCorpseType& CorpseType)
+	{
+		return CorpseType.Name == Name;
+	});
+	if (Index == INDEX_NONE)
+	{
+		// No name asks for the first type; any other name missing from CorpseTypes is a setup mistake
+		UE_CLOG(!Name.IsNone(), LogNecromancer, Warning, TEXT("Unknown corpse type %s, using %s instead"), *Name.ToString(), *CorpseTypes[0].Name.ToString());
+		return 0;
+	}
+	return Index;
+}
+
+void UCorpseSubsystem::AddCorpse(FCombatHandle InCombatant, const FVector& CorpseLocation, float CorpseYaw, FName CorpseType)
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem || !InCombatant.IsValid() || CombatantToCorpse.Contains(InCombatant))
+	{
+		return;
+	}
+
+	// Without a configured type there is nothing to show or decay, so the body is simply gone
+	if (CorpseTypes.Num() == 0)
+	{
+		CombatSubsystem->UnregisterCombatant(InCombatant);
+		return;
+	}
+
+	const int32 TypeIndex = FindCorpseType(CorpseType);
+	AddCorpseAt(InCombatant, CorpseLocation, CorpseYaw, TypeIndex, CombatSubsystem->GetSimulation().SecondsToSteps(CorpseTypes[TypeIndex].DecaySeconds));
+}
+
+void UCorpseSubsystem::AddCorpseAt(FCombatHandle InCombatant, const FVector& CorpseLocation, float CorpseYaw, int32 TypeIndex, uint32 DecaySteps)
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	const FCorpseType& Def = CorpseTypes[TypeIndex];
+
+	const int32 Index = Combatant.Add(InCombatant);
+	Location.Add(CorpseLocation);
+	Yaw.Add(CorpseYaw);
+	Type.Add(static_cast<uint8>(TypeIndex));
+	DecayTimer.Add(CombatSubsystem->GetTimers().Schedule(DecaySteps, ECombatTimerChannel::CorpseDecay, InCombatant));
+	MeshInstance.Add(AcquireInstance(TypeIndex, FTransform(FRotator(0.f, CorpseYaw, 0.f), CorpseLocation, Def.MeshScale)));
+	Highlighted.Add(0);
+	CombatantToCorpse.Add(InCombatant, Index);
+
+	if (SlotToCorpse.Num() <= InCombatant.Slot)
+	{
+		SlotToCorpse.SetNum(InCombatant.Slot + 1);
+	}
+	SlotToCorpse[InCombatant.Slot] = Index;
+	SpatialGrid.Add(InCombatant.Slot, CorpseLocation, CombatTeamBit(CombatSubsystem->GetSimulation().GetTeam(InCombatant)));
+}
+
+void UCorpseSubsystem::RemoveCorpse(FCombatHandle InCombatant)
+{
+	if (const int32* Index = CombatantToCorpse.Find(InCombatant))
+	{
+		RemoveCorpseAt(*Index, true);
+	}
+}
+
+void UCorpseSubsystem::RemoveCorpseAt(int32 Index, bool bUnregister)
+{
+	const FCombatHandle Handle = Combatant[Index];
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (CombatSubsystem)
+	{
+		CombatSubsystem->CancelTimer(DecayTimer[Index]);
+	}
+	ReleaseInstance(Type[Index], MeshInstance[Index]);
+	SpatialGrid.Remove(Handle.Slot);
+	CombatantToCorpse.Remove(Handle);
+	RisingCorpses.Remove(Handle);
+	if (Highlighted[Index])
+	{
+		HighlightedCorpses.RemoveSwap(Handle);
+	}
+
+	Combatant.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Location.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Yaw.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Type.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	DecayTimer.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	MeshInstance.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Highlighted.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (Combatant.IsValidIndex(Index))
+	{
+		CombatantToCorpse[Combatant[Index]] = Index;
+		SlotToCorpse[Combatant[Index].Slot] = Index;
+	}
+
+	if (bUnregister && CombatSubsystem)
+	{
+		CombatSubsystem->UnregisterCombatant(Handle);
+	}
+}
+
+void UCorpseSubsystem::WriteSnapshot(FCombatSnapshotWriter& Writer) const
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	TArray<int32> TypeNames;
+	TArray<uint32> DecaySteps;
+	TypeNames.Reserve(Combatant.Num());
+	DecaySteps.Reserve(Combatant.Num());
+	for (int32 Index = 0; Index < Combatant.Num(); ++Index)
+	{
+		TypeNames.Add(Writer.AddString(CorpseTypes[Type[Index]].Name));
+		DecaySteps.Add(CombatSubsystem ? CombatSubsystem->GetTimers().GetRemainingSteps(DecayTimer[Index]) : 0);
+	}
+
+	Writer.AddSection<FCombatHandle>(ECombatSnapshotSection::CorpseCombatant, Combatant);
+	Writer.AddSection<FVector>(ECombatSnapshotSection::CorpseLocation, Location);
+	Writer.AddSection<float>(ECombatSnapshotSection::CorpseYaw, Yaw);
+	Writer.AddSection<int32>(ECombatSnapshotSection::CorpseType, TypeNames);
+	Writer.AddSection<uint32>(ECombatSnapshotSection::CorpseDecaySteps, DecaySteps);
+}
+
+void UCorpseSubsystem::ClearForSnapshot()
+{
+	for (int32 Index = Combatant.Num() - 1; Index >= 0; --Index)
+	{
+		RemoveCorpseAt(Index, false);
+	}
+}
+
+bool UCorpseSubsystem::CanReadSnapshot(const FCombatSnapshotReader& Reader) const
+{
+	const int32 NumSaved = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::CorpseCombatant).Num();
+	return (CorpseTypes.Num() > 0 || NumSaved == 0)
+		&& Reader.GetSection<FVector>(ECombatSnapshotSection::CorpseLocation).Num() == NumSaved
+		&& Reader.GetSection<float>(ECombatSnapshotSection::CorpseYaw).Num() == NumSaved
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::CorpseType).Num() == NumSaved
+		&& Reader.GetSection<uint32>(ECombatSnapshotSection::CorpseDecaySteps).Num() == NumSaved;
+}
+
+void UCorpseSubsystem::ReadSnapshot(const FCombatSnapshotReader& Reader)
+{
+	const TConstArrayView<FCombatHandle> SavedCombatant = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::CorpseCombatant);
+	const TConstArrayView<FVector> SavedLocation = Reader.GetSection<FVector>(ECombatSnapshotSection::CorpseLocation);
+	const TConstArrayView<float> SavedYaw = Reader.GetSection<float>(ECombatSnapshotSection::CorpseYaw);
+	const TConstArrayView<int32> SavedType = Reader.GetSection<int32>(ECombatSnapshotSection::CorpseType);
+	const TConstArrayView<uint32> SavedDecaySteps = Reader.GetSection<uint32>(ECombatSnapshotSection::CorpseDecaySteps);
+	const int32 NumSaved = SavedCombatant.Num();
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem || NumSaved == 0 || !CanReadSnapshot(Reader))
+	{
+		return;
+	}
+
+	const FCombatSimulation& Simulation = CombatSubsystem->GetSimulation();
+	for (int32 Saved = 0; Saved < NumSaved; ++Saved)
+	{
+		const FCombatHandle Handle = SavedCombatant[Saved];
+		if (Simulation.IsValid(Handle) && !CombatantToCorpse.Contains(Handle))
+		{
+			AddCorpseAt(Handle, SavedLocation[Saved], SavedYaw[Saved], FindCorpseType(Reader.GetString(SavedType[Saved])), SavedDecaySteps[Saved]);
+		}
+	}
+}
+
+void UCorpseSubsystem::HandleDecay(TConstArrayView<FCombatTimerExpiry> Expired)
+{
+	for (const FCombatTimerExpiry& Expiry : Expired)
+	{
+		// A rising corpse is removed once its raise is applied, whichever way it goes
+		const int32* Index = CombatantToCorpse.Find(Expiry.Target);
+		if (Index && DecayTimer[*Index] == Expiry.Handle && !RisingCorpses.Contains(Expiry.Target))
+		{
+			RemoveCorpseAt(*Index, true);
+		}
+	}
+}
+
+int32 UCorpseSubsystem::RaiseCorpses(const FVector& Center, float Radius, int32 MaxCorpses, int32 OwnerId, ECombatTeam Team)
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem)
+	{
+		return 0;
+	}
+
+	TArray<FCombatHandle, TInlineAllocator<64>> Raised;
+	FindCorpses(Center, Radius, Raised, MaxCorpses);
+
+	// Leaving the grid keeps the corpse from being found again before its event is applied
+	for (const FCombatHandle& Handle : Raised)
+	{
+		SpatialGrid.Remove(Handle.Slot);
+		RisingCorpses.Add(Handle, OwnerId);
+		CombatSubsystem->GetEventBus().Enqueue(FCombatEvent::MakeRaise(Handle, FCombatHandle(), Team));
+	}
+	return Raised.Num();
+}
+
+void UCorpseSubsystem::HandleEventsApplied(TConstArrayView<FCombatEventResult> Results)
+{
+	if (RisingCorpses.Num() == 0)
+	{
+		return;
+	}
+
+	// The revived combatant is brought back as it was and joins the horde where it fell
+	UMinionHordeSubsystem* Horde = GetWorld()->GetSubsystem<UMinionHordeSubsystem>();
+	for (const FCombatEventResult& Result : Results)
+	{
+		const int32* OwnerId = RisingCorpses.Find(Result.Target);
+		if (!OwnerId)
+		{
+			continue;
+		}
+
+		const int32 Owner = *OwnerId;
+		const int32 Index = CombatantToCorpse.FindChecked(Result.Target);
+		const FVector RaiseLocation = Location[Index];
+		const bool bJoinsHorde = Result.bRaised && Horde;
+		RemoveCorpseAt(Index, !bJoinsHorde);
+		if (bJoinsHorde)
+		{
+			Horde->AdoptMinion(Result.Target, RaiseLocation, Owner);
+		}
+	}
+}
+
+void UCorpseSubsystem::SetHighlight(const FVector& Center, float Radius)
+{
+	TArray<int32, TInlineAllocator<64>> Indices;
+	QueryCorpses(Center, Radius, MAX_int32, Indices);
+
+	// Flag the new set first, so the old set can tell which of its corpses are still in range
+	for (const int32 Index : Indices)
+	{
+		Highlighted[Index] |= CorpseRegistry::InRangeFlag;
+	}
+	for (const FCombatHandle& Handle : HighlightedCorpses)
+	{
+		const int32 Index = CombatantToCorpse.FindChecked(Handle);
+		if (!(Highlighted[Index] & CorpseRegistry::InRangeFlag))
+		{
+			Highlighted[Index] = 0;
+			SetInstanceHighlighted(Type[Index], MeshInstance[Index], false);
+		}
+	}
+
+	HighlightedCorpses.Reset();
+	for (const int32 Index : Indices)
+	{
+		if (!(Highlighted[Index] & CorpseRegistry::HighlightedFlag))
+		{
+			SetInstanceHighlighted(Type[Index], MeshInstance[Index], true);
+		}
+		Highlighted[Index] = CorpseRegistry::HighlightedFlag;
+		HighlightedCorpses.Add(Combatant[Index]);
+	}
+}
+
+void UCorpseSubsystem::ClearHighlight()
+{
+	for (const FCombatHandle& Handle : HighlightedCorpses)
+	{
+		const int32 Index = CombatantToCorpse.FindChecked(Handle);
+		Highlighted[Index] = 0;
+		SetInstanceHighlighted(Type[Index], MeshInstance[Index], false);
+	}
+	HighlightedCorpses.Reset();
+}
+
+int32 UCorpseSubsystem::AcquireInstance(int32 TypeIndex, const FTransform& InstanceTransform)
+{
+	UInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes.IsValidIndex(TypeIndex) ? InstancedMeshes[TypeIndex].Get() : nullptr;
+	if (!InstancedMesh)
+	{
+		return INDEX_NONE;
+	}
+
+	DirtyMeshes[TypeIndex] = true;
+	if (FreeInstances[TypeIndex].Num() > 0)
+	{
+		const int32 Instance = FreeInstances[TypeIndex].Pop(EAllowShrinking::No);
+		InstancedMesh->UpdateInstanceTransform(Instance, InstanceTransform, true, false, true);
+		return Instance;
+	}
+	return InstancedMesh->AddInstance(InstanceTransform, true);
+}
+
+void UCorpseSubsystem::ReleaseInstance(int32 TypeIndex, int32 Instance)
+{
+	UInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes.IsValidIndex(TypeIndex) ? InstancedMeshes[TypeIndex].Get() : nullptr;
+	if (!InstancedMesh || Instance == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Collapsed rather than removed: removal would renumber the instances other corpses hold
+	InstancedMesh->UpdateInstanceTransform(Instance, FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector), true, false, true);
+	PendingHighlights[TypeIndex].Add({ Instance, 0.f });
+	FreeInstances[TypeIndex].Add(Instance);
+	DirtyMeshes[TypeIndex] = true;
+}
+
+void UCorpseSubsystem::SetInstanceHighlighted(int32 TypeIndex, int32 Instance, bool bHighlighted)
+{
+	UInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes.IsValidIndex(TypeIndex) ? InstancedMeshes[TypeIndex].Get() : nullptr;
+	if (!InstancedMesh || Instance == INDEX_NONE)
+	{
+		return;
+	}
+
+	PendingHighlights[TypeIndex].Add({ Instance, bHighlighted ? 1.f : 0.f });
+}
@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "CombatSpatialGrid.h"
+#include "CombatTimerWheel.h"
+#include "Necromancer.h"
+#include "CorpseSubsystem.generated.h"
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Corpse Query"), STAT_CorpseQuery, STATGROUP_Necromancer, NECROMANCER_API);
+
+struct FCombatEventResult;
+class FCombatSnapshotReader;
+class FCombatSnapshotWriter;
+class UCombatSubsystem;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/** Kind of corpse left behind, referenced by name when a corpse is added */
+USTRUCT()
+struct FCorpseType
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName Name;
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UStaticMesh> Mesh;
+
+	UPROPERTY(Config)
+	FVector MeshScale = FVector::OneVector;
+
+	/** Seconds until the corpse rots away and can no longer be raised */
+	UPROPERTY(Config)
+	float DecaySeconds = 30.f;
+};
+
+/**
+ * Every corpse on the battlefield, as a lightweight record instead of an actor: location, type, decay timer,
+ * the dead combatant it came from and an instance of its type's pooled mesh.
+ * Corpses are indexed by their own spatial grid, so cursor hover and raise-dead queries only look at nearby cells.
+ * Decay runs on the combat timer wheel and expired corpses are removed together once per step.
+ * Raising a corpse queues a raise event for its combatant. Once the event bus has revived it, the corpse is removed
+ * and the combatant joins the horde where it lay, so no actor is spawned.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UCorpseSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Leaves a corpse for a dead combatant. The registry takes over the combatant and unregisters it when the corpse is gone. */
+	void AddCorpse(FCombatHandle InCombatant, const FVector& CorpseLocation, float CorpseYaw, FName CorpseType);
+
+	/** Removes a corpse and unregisters its combatant */
+	void RemoveCorpse(FCombatHandle InCombatant);
+
+	/** Appends the corpses within Radius of Center, nearest first */
+	template <typename AllocatorType>
+	void FindCorpses(const FVector& Center, float Radius, TArray<FCombatHandle, AllocatorType>& OutCorpses, int32 MaxCorpses = MAX_int32) const;
+
+	/**
+	 * Raises up to MaxCorpses corpses near Center, nearest first, as horde minions of OwnerId on Team. The corpses rise
+	 * when the combat step applies their raise events and cannot be raised again meanwhile. Returns how many were queued.
+	 */
+	int32 RaiseCorpses(const FVector& Center, float Radius, int32 MaxCorpses, int32 OwnerId = INDEX_NONE, ECombatTeam Team = ECombatTeam::Undead);
+
+	/**
+	 * Highlights the corpses within Radius of Center and clears the rest. Only corpses that change are touched, and
+	 * the meshes see the changes once, at the end of the frame.
+	 */
+	void SetHighlight(const FVector& Center, float Radius);
+	void ClearHighlight();
+
+	bool IsCorpse(FCombatHandle Handle) const { return CombatantToCorpse.Contains(Handle); }
+
+	/** Copies every corpse with its remaining decay into Writer. Types are stored by name. */
+	void WriteSnapshot(FCombatSnapshotWriter& Writer) const;
+
+	/** Removes every corpse, leaving the combatants to the caller */
+	void ClearForSnapshot();
+
+	/** True if the corpse sections of Reader fit together and there are corpse types to restore them as */
+	bool CanReadSnapshot(const FCombatSnapshotReader& Reader) const;
+
+	/** Refills the emptied registry from Reader, on a simulation already restored from the same snapshot */
+	void ReadSnapshot(const FCombatSnapshotReader& Reader);
+	int32 GetNumCorpses() const { return Combatant.Num(); }
+
+	UPROPERTY(Config)
+	TArray<FCorpseType> CorpseTypes;
+
+	/** Edge length of a corpse grid cell. Close to the usual raise radius works best. */
+	UPROPERTY(Config)
+	float GridCellSize = 500.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	int32 FindCorpseType(FName Name) const;
+	void AddCorpseAt(FCombatHandle InCombatant, const FVector& CorpseLocation, float CorpseYaw, int32 TypeIndex, uint32 DecaySteps);
+	void RemoveCorpseAt(int32 Index, bool bUnregister);
+	void HandleDecay(TConstArrayView<FCombatTimerExpiry> Expired);
+	void HandleEventsApplied(TConstArrayView<FCombatEventResult> Results);
+	template <typename AllocatorType>
+	void QueryCorpses(const FVector& Center, float Radius, int32 MaxCorpses, TArray<int32, AllocatorType>& OutIndices) const;
+
+	/** Pooled mesh instances: released ones are collapsed and reused before new ones are added */
+	int32 AcquireInstance(int32 TypeIndex, const FTransform& InstanceTransform);
+	void ReleaseInstance(int32 TypeIndex, int32 Instance);
+	void SetInstanceHighlighted(int32 TypeIndex, int32 Instance, bool bHighlighted);
+
+	UCombatSubsystem* GetCombatSubsystem() const;
+
+	/** Corpses, one entry each */
+	TArray<FCombatHandle> Combatant;
+	TArray<FVector> Location;
+	TArray<float> Yaw;
+	TArray<uint8> Type;
+	TArray<FCombatTimerHandle> DecayTimer;
+	TArray<int32> MeshInstance;
+	/** Non-zero while lit by SetHighlight */
+	TArray<uint8> Highlighted;
+
+	TMap<FCombatHandle, int32> CombatantToCorpse;
+
+	/** Corpse index by combatant slot, which is also the corpse's id in the grid */
+	TArray<int32> SlotToCorpse;
+	FCombatSpatialGrid SpatialGrid;
+
+	/** Combatants of the currently highlighted corpses */
+	TArray<FCombatHandle> HighlightedCorpses;
+
+	/** Corpses with a queued raise event, out of the grid until it is applied, and the owner they rise for */
+	TMap<FCombatHandle, int32> RisingCorpses;
+
+	UPROPERTY(Transient)
+	TObjectPtr<AActor> RenderActor;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> InstancedMeshes;
+
+	struct FPendingHighlight
+	{
+		int32 Instance;
+		float Value;
+	};
+
+	TArray<TArray<int32>> FreeInstances;
+
+	/** Highlight values per type, written to the instances by the next Tick */
+	TArray<TArray<FPendingHighlight>> PendingHighlights;
+	TBitArray<> DirtyMeshes;
+
+	FDelegateHandle DecayHandle;
+	FDelegateHandle EventsAppliedHandle;
+};
+
+template <typename AllocatorType>
+void UCorpseSubsystem::FindCorpses(const FVector& Center, float Radius, TArray<FCombatHandle, AllocatorType>& OutCorpses, int32 MaxCorpses) const
+{
+	TArray<int32, TInlineAllocator<64>> Indices;
+	QueryCorpses(Center, Radius, MaxCorpses, Indices);
+	for (const int32 Index : Indices)
+	{
+		OutCorpses.Add(Combatant[Index]);
+	}
+}
+
+template <typename AllocatorType>
+void UCorpseSubsystem::QueryCorpses(const FVector& Center, float Radius, int32 MaxCorpses, TArray<int32, AllocatorType>& OutIndices) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_CorpseQuery);
+
+	FCombatSpatialQuery Query;
+	Query.Shape = ECombatQueryShape::Nearest;
+	Query.Origin = Center;
+	Query.Radius = Radius;
+	Query.MaxResults = MaxCorpses;
+
+	// Grid slots are turned into corpse indices in place
+	const int32 Start = OutIndices.Num();
+	SpatialGrid.Query(Query, OutIndices);
+	for (int32 Entry = Start; Entry < OutIndices.Num(); ++Entry)
+	{
+		OutIndices[Entry] = SlotToCorpse[OutIndices[Entry]];
+	}
+}
@@ -0,0 +1,305 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CrowdAvoidance.h"
+#include "Necromancer.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Crowd Avoidance Solve"), STAT_CrowdAvoidanceSolve, STATGROUP_Necromancer);
+
+namespace CrowdAvoidance
+{
+	// Agents solved per ParallelFor task
+	constexpr int32 BatchSize = 256;
+
+	constexpr float Epsilon = 1.e-5f;
+
+	FORCEINLINE float Det(const FVector2f& A, const FVector2f& B) { return A.X * B.Y - A.Y * B.X; }
+}
+
+FCrowdAvoidance::FCrowdAvoidance(const FCrowdAvoidanceSettings& InSettings)
+	: Settings(InSettings)
+	, SpatialGrid(InSettings.SpatialCellSize)
+{
+}
+
+void FCrowdAvoidance::Reset()
+{
+	Position.Reset();
+	Velocity.Reset();
+	PreferredVelocity.Reset();
+	Radius.Reset();
+	MaxSpeed.Reset();
+	NewVelocity.Reset();
+	SpatialGrid.Reset();
+}
+
+void FCrowdAvoidance::Reserve(int32 NumAgents)
+{
+	Position.Reserve(NumAgents);
+	Velocity.Reserve(NumAgents);
+	PreferredVelocity.Reserve(NumAgents);
+	Radius.Reserve(NumAgents);
+	MaxSpeed.Reserve(NumAgents);
+	NewVelocity.Reserve(NumAgents);
+}
+
+int32 FCrowdAvoidance::AddAgent(const FVector& InPosition, const FVector& InVelocity, const FVector& InPreferredVelocity, float InRadius, float InMaxSpeed)
+{
+	const int32 Index = Position.Add(FVector2f(InPosition.X, InPosition.Y));
+	Velocity.Add(FVector2f(InVelocity.X, InVelocity.Y));
+	PreferredVelocity.Add(FVector2f(InPreferredVelocity.X, InPreferredVelocity.Y));
+	Radius.Add(InRadius);
+	MaxSpeed.Add(InMaxSpeed);
+	NewVelocity.Add(FVector2f(InVelocity.X, InVelocity.Y));
+	SpatialGrid.Add(Index, InPosition, 1u);
+	return Index;
+}
+
+void FCrowdAvoidance::Solve(float StepSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CrowdAvoidanceSolve);
+
+	const int32 NumAgents = Position.Num();
+	if (NumAgents == 0 || StepSeconds <= 0.f)
+	{
+		return;
+	}
+
+	const float InvStepSeconds = 1.f / StepSeconds;
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumAgents, CrowdAvoidance::BatchSize);
+	ParallelFor(NumBatches, [this, NumAgents, InvStepSeconds](int32 BatchIndex)
+	{
+		// Scratch reused by every agent in the batch
+		TArray<int32> Neighbors;
+		FLineArray Lines;
+		FLineArray ProjectedLines;
+
+		const int32 Start = BatchIndex * CrowdAvoidance::BatchSize;
+		const int32 End = FMath::Min(Start + CrowdAvoidance::BatchSize, NumAgents);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			SolveAgent(Index, InvStepSeconds, Neighbors, Lines, ProjectedLines, NewVelocity[Index]);
+		}
+	});
+}
+
+void FCrowdAvoidance::SolveAgent(int32 Index, float InvStepSeconds, TArray<int32>& Neighbors, FLineArray& Lines, FLineArray& ProjectedLines, FVector2f& OutVelocity) const
+{
+	if (MaxSpeed[Index] <= 0.f)
+	{
+		OutVelocity = Velocity[Index];
+		return;
+	}
+
+	FCombatSpatialQuery Query;
+	Query.Shape = ECombatQueryShape::Nearest;
+	Query.Origin = FVector(Position[Index].X, Position[Index].Y, 0.f);
+	Query.Radius = Settings.NeighborRadius;
+	Query.MaxResults = Settings.MaxNeighbors + 1;
+	Neighbors.Reset();
+	SpatialGrid.Query(Query, Neighbors);
+
+	const float InvTimeHorizon = 1.f / Settings.TimeHorizon;
+	Lines.Reset();
+	for (const int32 Other : Neighbors)
+	{
+		if (Other == Index)
+		{
+			continue;
+		}
+
+		const FVector2f RelativePosition = Position[Other] - Position[Index];
+		const FVector2f RelativeVelocity = Velocity[Index] - Velocity[Other];
+		const float DistSq = RelativePosition.SizeSquared();
+		const float CombinedRadius = Radius[Index] + Radius[Other];
+		const float CombinedRadiusSq = FMath::Square(CombinedRadius);
+
+		FLine Line;
+		FVector2f U;
+		if (DistSq > CombinedRadiusSq)
+		{
+			// Vector from the cutoff circle's center to the relative velocity
+			const FVector2f W = RelativeVelocity - RelativePosition * InvTimeHorizon;
+			const float WLengthSq = W.SizeSquared();
+			const float Dot1 = FVector2f::DotProduct(W, RelativePosition);
+
+			if (Dot1 < 0.f && FMath::Square(Dot1) > CombinedRadiusSq * WLengthSq)
+			{
+				// Project on the cutoff circle
+				const float WLength = FMath::Sqrt(WLengthSq);
+				const FVector2f UnitW = W / WLength;
+				Line.Direction = FVector2f(UnitW.Y, -UnitW.X);
+				U = UnitW * (CombinedRadius * InvTimeHorizon - WLength);
+			}
+			else
+			{
+				// Project on the nearer leg of the cone
+				const float Leg = FMath::Sqrt(DistSq - CombinedRadiusSq);
+				if (CrowdAvoidance::Det(RelativePosition, W) > 0.f)
+				{
+					Line.Direction = FVector2f(RelativePosition.X * Leg - RelativePosition.Y * CombinedRadius, RelativePosition.X * CombinedRadius + RelativePosition.Y * Leg) / DistSq;
+				}
+				else
+				{
+					Line.Direction = -FVector2f(RelativePosition.X * Leg + RelativePosition.Y * CombinedRadius, -RelativePosition.X * CombinedRadius + RelativePosition.Y * Leg) / DistSq;
+				}
+				U = Line.Direction * FVector2f::DotProduct(RelativeVelocity, Line.Direction) - RelativeVelocity;
+			}
+		}
+		else
+		{
+			// Already overlapping: resolve within this step
+			const FVector2f W = RelativeVelocity - RelativePosition * InvStepSeconds;
+			const float WLength = W.Size();
+			const FVector2f UnitW = WLength > CrowdAvoidance::Epsilon ? W / WLength : FVector2f(1.f, 0.f);
+			Line.Direction = FVector2f(UnitW.Y, -UnitW.X);
+			U = UnitW * (CombinedRadius * InvStepSeconds - WLength);
+		}
+
+		// Share the avoidance with agents that avoid back, take all of it for obstacles
+		const float Responsibility = MaxSpeed[Other] > 0.f ? 0.5f : 1.f;
+		Line.Point = Velocity[Index] + U * Responsibility;
+		Lines.Add(Line);
+	}
+
+	const int32 FailedLine = LinearProgram2(Lines, MaxSpeed[Index], PreferredVelocity[Index], false, OutVelocity);
+	if (FailedLine < Lines.Num())
+	{
+		LinearProgram3(Lines, FailedLine, MaxSpeed[Index], OutVelocity, ProjectedLines);
+	}
+}
+
+bool FCrowdAvoidance::LinearProgram1(TConstArrayView<FLine> Lines, int32 LineIndex, float SpeedLimit, const FVector2f& OptVelocity, bool bDirectionOpt, FVector2f& Result)
+{
+	const FLine& Line = Lines[LineIndex];
+	const float Dot = FVector2f::DotProduct(Line.Point, Line.Direction);
+	const float Discriminant = FMath::Square(Dot) + FMath::Square(SpeedLimit) - Line.Point.SizeSquared();
+	if (Discriminant < 0.f)
+	{
+		// The max speed circle fully invalidates this line
+		return false;
+	}
+
+	const float SqrtDiscriminant = FMath::Sqrt(Discriminant);
+	float TLeft = -Dot - SqrtDiscriminant;
+	float TRight = -Dot + SqrtDiscriminant;
+
+	for (int32 Index = 0; Index < LineIndex; ++Index)
+	{
+		const float Denominator = CrowdAvoidance::Det(Line.Direction, Lines[Index].Direction);
+		const float Numerator = CrowdAvoidance::Det(Lines[Index].Direction, Line.Point - Lines[Index].Point);
+
+		if (FMath::Abs(Denominator) <= CrowdAvoidance::Epsilon)
+		{
+			// Parallel lines
+			if (Numerator < 0.f)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const float T = Numerator / Denominator;
+		if (Denominator >= 0.f)
+		{
+			TRight = FMath::Min(TRight, T);
+		}
+		else
+		{
+			TLeft = FMath::Max(TLeft, T);
+		}
+
+		if (TLeft > TRight)
+		{
+			return false;
+		}
+	}
+
+	if (bDirectionOpt)
+	{
+		Result = Line.Point + Line.Direction * (FVector2f::DotProduct(OptVelocity, Line.Direction) > 0.f ? TRight : TLeft);
+	}
+	else
+	{
+		const float T = FVector2f::DotProduct(Line.Direction, OptVelocity - Line.Point);
+		Result = Line.Point + Line.Direction * FMath::Clamp(T, TLeft, TRight);
+	}
+	return true;
+}
+
+int32 FCrowdAvoidance::LinearProgram2(TConstArrayView<FLine> Lines, float SpeedLimit, const FVector2f& OptVelocity, bool bDirectionOpt, FVector2f& Result)
+{
+	if (bDirectionOpt)
+	{
+		// OptVelocity is a unit direction here
+		Result = OptVelocity * SpeedLimit;
+	}
+	else if (OptVelocity.SizeSquared() > FMath::Square(SpeedLimit))
+	{
+		Result = OptVelocity.GetSafeNormal() * SpeedLimit;
+	}
+	else
+	{
+		Result = OptVelocity;
+	}
+
+	for (int32 Index = 0; Index < Lines.Num(); ++Index)
+	{
+		if (CrowdAvoidance::Det(Lines[Index].Direction, Lines[Index].Point - Result) > 0.f)
+		{
+			// Result violates this constraint
+			const FVector2f PreviousResult = Result;
+			if (!LinearProgram1(Lines, Index, SpeedLimit, OptVelocity, bDirectionOpt, Result))
+			{
+				Result = PreviousResult;
+				return Index;
+			}
+		}
+	}
+	return Lines.Num();
+}
+
+void FCrowdAvoidance::LinearProgram3(TConstArrayView<FLine> Lines, int32 BeginLine, float SpeedLimit, FVector2f& Result, FLineArray& ProjectedLines)
+{
+	// No velocity satisfies every constraint; minimize the largest violation instead
+	float Distance = 0.f;
+	for (int32 Index = BeginLine; Index < Lines.Num(); ++Index)
+	{
+		const FLine& Line = Lines[Index];
+		if (CrowdAvoidance::Det(Line.Direction, Line.Point - Result) <= Distance)
+		{
+			continue;
+		}
+
+		ProjectedLines.Reset();
+		for (int32 Other = 0; Other < Index; ++Other)
+		{
+			FLine Projected;
+			const float Determinant = CrowdAvoidance::Det(Line.Direction, Lines[Other].Direction);
+			if (FMath::Abs(Determinant) <= CrowdAvoidance::Epsilon)
+			{
+				if (FVector2f::DotProduct(Line.Direction, Lines[Other].Direction) > 0.f)
+				{
+					// Same direction
+					continue;
+				}
+				Projected.Point = (Line.Point + Lines[Other].Point) * 0.5f;
+			}
+			else
+			{
+				Projected.Point = Line.Point + Line.Direction * (CrowdAvoidance::Det(Lines[Other].Direction, Line.Point - Lines[Other].Point) / Determinant);
+			}
+			Projected.Direction = (Lines[Other].Direction - Line.Direction).GetSafeNormal();
+			ProjectedLines.Add(Projected);
+		}
+
+		const FVector2f PreviousResult = Result;
+		if (LinearProgram2(ProjectedLines, SpeedLimit, FVector2f(-Line.Direction.Y, Line.Direction.X), true, Result) < ProjectedLines.Num())
+		{
+			// Only possible through floating point error; keep the last result
+			Result = PreviousResult;
+		}
+		Distance = CrowdAvoidance::Det(Line.Direction, Line.Point - Result);
+	}
+}
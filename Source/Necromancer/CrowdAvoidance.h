@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatSpatialGrid.h"
+
+/** Parameters of FCrowdAvoidance */
+struct FCrowdAvoidanceSettings
+{
+	/** Only agents closer than this are considered */
+	float NeighborRadius = 400.f;
+
+	/** Closest neighbors considered per agent */
+	int32 MaxNeighbors = 10;
+
+	/** Seconds ahead in which collisions are avoided. Longer is smoother but more conservative. */
+	float TimeHorizon = 1.f;
+
+	float SpatialCellSize = 400.f;
+};
+
+/**
+ * Reciprocal velocity obstacle avoidance (ORCA) on the XY plane for a whole crowd at once.
+ * Agents are added as parallel arrays every step, bucketed in a spatial grid for neighbor lists,
+ * then solved in a parallel pass in which each agent only writes its own velocity.
+ *
+ * Agents with a MaxSpeed of zero are obstacles: they keep their velocity, and others take full
+ * responsibility for avoiding them instead of half.
+ */
+class NECROMANCER_API FCrowdAvoidance
+{
+public:
+	explicit FCrowdAvoidance(const FCrowdAvoidanceSettings& InSettings = FCrowdAvoidanceSettings());
+
+	void Reset();
+	void Reserve(int32 NumAgents);
+
+	/** Returns the agent's index for GetVelocity */
+	int32 AddAgent(const FVector& Position, const FVector& Velocity, const FVector& PreferredVelocity, float Radius, float MaxSpeed);
+
+	/** Computes the velocity of every agent closest to its preferred one that avoids collisions within the time horizon. */
+	void Solve(float StepSeconds);
+
+	FVector GetVelocity(int32 Index) const { return FVector(NewVelocity[Index].X, NewVelocity[Index].Y, 0.f); }
+	int32 Num() const { return Position.Num(); }
+	const FCrowdAvoidanceSettings& GetSettings() const { return Settings; }
+
+private:
+	struct FLine
+	{
+		FVector2f Point;
+		FVector2f Direction;
+	};
+
+	using FLineArray = TArray<FLine, TInlineAllocator<16>>;
+
+	void SolveAgent(int32 Index, float InvStepSeconds, TArray<int32>& Neighbors, FLineArray& Lines, FLineArray& ProjectedLines, FVector2f& OutVelocity) const;
+
+	static bool LinearProgram1(TConstArrayView<FLine> Lines, int32 LineIndex, float SpeedLimit, const FVector2f& OptVelocity, bool bDirectionOpt, FVector2f& Result);
+	static int32 LinearProgram2(TConstArrayView<FLine> Lines, float SpeedLimit, const FVector2f& OptVelocity, bool bDirectionOpt, FVector2f& Result);
+	static void LinearProgram3(TConstArrayView<FLine> Lines, int32 BeginLine, float SpeedLimit, FVector2f& Result, FLineArray& ProjectedLines);
+
+	FCrowdAvoidanceSettings Settings;
+
+	/** Agents, one entry each */
+	TArray<FVector2f> Position;
+	TArray<FVector2f> Velocity;
+	TArray<FVector2f> PreferredVelocity;
+	TArray<float> Radius;
+	TArray<float> MaxSpeed;
+	TArray<FVector2f> NewVelocity;
+
+	/** Agents keyed by index */
+	FCombatSpatialGrid SpatialGrid;
+};
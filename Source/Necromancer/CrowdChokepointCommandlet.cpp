@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CrowdChokepointCommandlet.h"
+#include "CombatSimulation.h"
+#include "CrowdAvoidance.h"
+#include "Necromancer.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+
+namespace CrowdChokepoint
+{
+	constexpr float AgentRadius = 40.f;
+	constexpr float MoveSpeed = 300.f;
+	constexpr float StepsPerSecond = 30.f;
+	constexpr float WallHalfLength = 4000.f;
+	constexpr float GoalDistance = 3000.f;
+	constexpr float ArrivalRadius = 200.f;
+
+	// Agents count as through once they are this far past the wall
+	constexpr float ThroughDistance = AgentRadius * 2.f;
+
+	// An agent that is not through and covered less than this in StuckWindowSeconds counts as stuck
+	constexpr float StuckDistance = 50.f;
+	constexpr float StuckWindowSeconds = 2.f;
+}
+
+UCrowdChokepointCommandlet::UCrowdChokepointCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCrowdChokepointCommandlet::Main(const FString& Params)
+{
+	using namespace CrowdChokepoint;
+
+	int32 NumAgents = 2000;
+	float Gap = 400.f;
+	float MaxSimSeconds = 60.f;
+	int32 Seed = 0;
+	FParse::Value(*Params, TEXT("Agents="), NumAgents);
+	FParse::Value(*Params, TEXT("Gap="), Gap);
+	FParse::Value(*Params, TEXT("MaxSimSeconds="), MaxSimSeconds);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+
+	// Agents start in a block left of a wall along X = 0 and head for a point right of the gap around Y = 0
+	FRandomStream Random(Seed);
+	const int32 Columns = FMath::Max(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumAgents))), 1);
+	const float Spacing = AgentRadius * 2.5f;
+	TArray<FVector> Locations;
+	TArray<FVector> Velocities;
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		const float X = -500.f - (Index / Columns) * Spacing + Random.FRandRange(-5.f, 5.f);
+		const float Y = ((Index % Columns) - Columns * 0.5f) * Spacing + Random.FRandRange(-5.f, 5.f);
+		Locations.Add(FVector(X, Y, 0.f));
+	}
+	Velocities.Init(FVector::ZeroVector, NumAgents);
+
+	TArray<FVector> WallPosts;
+	for (float Y = -WallHalfLength; Y <= WallHalfLength; Y += AgentRadius * 2.f)
+	{
+		if (FMath::Abs(Y) > Gap * 0.5f + AgentRadius)
+		{
+			WallPosts.Add(FVector(0.f, Y, 0.f));
+		}
+	}
+
+	const FVector Goal(GoalDistance, 0.f, 0.f);
+	const float StepSeconds = 1.f / StepsPerSecond;
+	const int32 MaxSteps = FMath::CeilToInt32(MaxSimSeconds * StepsPerSecond);
+	const int32 StuckWindowSteps = FMath::CeilToInt32(StuckWindowSeconds * StepsPerSecond);
+
+	FCrowdAvoidance Avoidance;
+	TArray<FVector> WindowStart = Locations;
+	TArray<uint8> Arrived;
+	Arrived.Init(false, NumAgents);
+	int32 NumArrived = 0;
+	int32 NumStuck = 0;
+	double TotalSolveSeconds = 0.0;
+	double MaxSolveSeconds = 0.0;
+	int32 Step = 0;
+
+	for (; Step < MaxSteps && NumArrived < NumAgents; ++Step)
+	{
+		Avoidance.Reset();
+		Avoidance.Reserve(NumAgents + WallPosts.Num());
+		for (int32 Index = 0; Index < NumAgents; ++Index)
+		{
+			// Aim for the gap until through the wall, then for the goal
+			const FVector& Location = Locations[Index];
+			const FVector Waypoint = Location.X < -AgentRadius ? FVector(0.f, FMath::Clamp(Location.Y, -Gap * 0.25f, Gap * 0.25f), 0.f) : Goal;
+			FVector Next = Location;
+			FCombatSimulation::StepTowards(Next, Waypoint, ArrivalRadius, MoveSpeed, StepSeconds);
+			Avoidance.AddAgent(Location, Velocities[Index], (Next - Location) / StepSeconds, AgentRadius, MoveSpeed);
+		}
+		for (const FVector& Post : WallPosts)
+		{
+			Avoidance.AddAgent(Post, FVector::ZeroVector, FVector::ZeroVector, AgentRadius, 0.f);
+		}
+
+		const double SolveStart = FPlatformTime::Seconds();
+		Avoidance.Solve(StepSeconds);
+		const double SolveSeconds = FPlatformTime::Seconds() - SolveStart;
+		TotalSolveSeconds += SolveSeconds;
+		MaxSolveSeconds = FMath::Max(MaxSolveSeconds, SolveSeconds);
+
+		for (int32 Index = 0; Index < NumAgents; ++Index)
+		{
+			Velocities[Index] = Avoidance.GetVelocity(Index);
+			FCombatSimulation::MoveBy(Locations[Index], Velocities[Index], StepSeconds);
+			if (!Arrived[Index] && Locations[Index].X > ThroughDistance)
+			{
+				Arrived[Index] = true;
+				++NumArrived;
+			}
+		}
+
+		if ((Step + 1) % StuckWindowSteps == 0)
+		{
+			NumStuck = 0;
+			for (int32 Index = 0; Index < NumAgents; ++Index)
+			{
+				if (!Arrived[Index] && FVector::DistSquared2D(Locations[Index], WindowStart[Index]) < FMath::Square(StuckDistance))
+				{
+					++NumStuck;
+				}
+			}
+			WindowStart = Locations;
+		}
+	}
+
+	const int32 NumSteps = FMath::Max(Step, 1);
+	UE_LOG(LogNecromancer, Display, TEXT("CrowdChokepoint: %d agents, gap %.0f, %d steps (%.1fs simulated)"), NumAgents, Gap, Step, Step / StepsPerSecond);
+	UE_LOG(LogNecromancer, Display, TEXT("CrowdChokepoint: solve %.3f ms/step average, %.3f ms worst"), TotalSolveSeconds * 1000.0 / NumSteps, MaxSolveSeconds * 1000.0);
+	UE_LOG(LogNecromancer, Display, TEXT("CrowdChokepoint: %d through the gap (%.1f%%), %d stuck in the last %.0fs window (%.1f%%)"),
+		NumArrived, 100.f * NumArrived / FMath::Max(NumAgents, 1), NumStuck, StuckWindowSeconds, 100.f * NumStuck / FMath::Max(NumAgents, 1));
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CrowdChokepointCommandlet.generated.h"
+
+/**
+ * Pushes a crowd through a gap in a wall with FCrowdAvoidance, without a game world, and reports
+ * the solve cost per step and how many agents ended up stuck.
+ *
+ * Usage: -run=CrowdChokepoint [-Agents=2000] [-Gap=400] [-MaxSimSeconds=60] [-Seed=0]
+ */
+UCLASS()
+class UCrowdChokepointCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UCrowdChokepointCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,182 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CursorGroundProjector.h"
+#include "NecromancerStats.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+FCursorGroundProjector::FViewKey FCursorGroundProjector::MakeViewKey(const APlayerController& PlayerController, const FVector2D& ScreenPosition)
+{
+	FViewKey Key;
+	Key.ScreenPosition = ScreenPosition;
+	if (const APlayerCameraManager* CameraManager = PlayerController.PlayerCameraManager)
+	{
+		Key.CameraLocation = CameraManager->GetCameraLocation();
+		Key.CameraRotation = CameraManager->GetCameraRotation();
+		Key.FOV = CameraManager->GetFOVAngle();
+	}
+	return Key;
+}
+
+void FCursorGroundProjector::Invalidate()
+{
+	bHasCachedLocation = false;
+	bCachedExact = false;
+	bCachedMiss = false;
+	bHasLastRay = false;
+	GroundZ.Reset();
+	PendingTrace = FTraceHandle();
+}
+
+void FCursorGroundProjector::PollPendingTrace(UWorld& World)
+{
+	if (!PendingTrace.IsValid())
+	{
+		return;
+	}
+
+	FTraceDatum Datum;
+	if (!World.QueryTraceData(PendingTrace, Datum))
+	{
+		// Still in flight, or its frame has passed
+		if (!World.IsTraceHandleValid(PendingTrace, false))
+		{
+			PendingTrace = FTraceHandle();
+		}
+		return;
+	}
+	PendingTrace = FTraceHandle();
+
+	const FHitResult* Hit = Datum.OutHits.FindByPredicate([](const FHitResult& Result) { return Result.bBlockingHit; });
+	if (!Hit)
+	{
+		// Nothing under the cursor: report a miss like a synchronous trace would
+		if (PendingKey == CachedKey)
+		{
+			bHasCachedLocation = false;
+			bCachedMiss = true;
+		}
+		return;
+	}
+
+	GroundZ = Hit->Location.Z;
+	if (PendingKey == CachedKey)
+	{
+		CachedLocation = Hit->Location;
+		bHasCachedLocation = true;
+		bCachedExact = true;
+	}
+	else if (!bCachedExact && !bCachedMiss)
+	{
+		// The hit was for an older ray, but its height still improves the estimate for the current one
+		bHasCachedLocation = EstimateOnGround(CachedLocation);
+	}
+}
+
+bool FCursorGroundProjector::EstimateOnGround(FVector& OutLocation) const
+{
+	const FVector RayDirection = LastRayEnd - LastRayStart;
+	if (!bHasLastRay || !GroundZ.IsSet() || FMath::IsNearlyZero(RayDirection.Z))
+	{
+		return false;
+	}
+
+	const double Distance = (GroundZ.GetValue() - LastRayStart.Z) / RayDirection.Z;
+	if (Distance < 0.0)
+	{
+		return false;
+	}
+
+	OutLocation = LastRayStart + RayDirection * Distance;
+	return true;
+}
+
+bool FCursorGroundProjector::Project(APlayerController& PlayerController, const FVector2D& ScreenPosition, FVector& OutLocation)
+{
+	UWorld* World = PlayerController.GetWorld();
+	if (!World)
+	{
+		return false;
+	}
+
+	PollPendingTrace(*World);
+
+	const FViewKey Key = MakeViewKey(PlayerController, ScreenPosition);
+	if (Key == CachedKey && (bHasCachedLocation || bCachedMiss))
+	{
+		OutLocation = CachedLocation;
+		return bHasCachedLocation;
+	}
+
+	FVector RayOrigin;
+	FVector RayDirection;
+	if (!PlayerController.DeprojectScreenPositionToWorld(ScreenPosition.X, ScreenPosition.Y, RayOrigin, RayDirection))
+	{
+		return false;
+	}
+
+	CachedKey = Key;
+	bCachedExact = false;
+	bCachedMiss = false;
+	LastRayStart = RayOrigin;
+	LastRayEnd = RayOrigin + RayDirection * PlayerController.HitResultTraceDistance;
+	bHasLastRay = true;
+
+	// Until a trace has hit there is no ground height to estimate with; the synchronous trace answers this ray for good
+	bHasCachedLocation = EstimateOnGround(CachedLocation);
+	if (!bHasCachedLocation && (!GroundZ.IsSet() || FMath::IsNearlyZero(RayDirection.Z)))
+	{
+		return ProjectLastExact(PlayerController, OutLocation);
+	}
+
+	// Refine with a complex trace off the game thread; it is read back on the next call
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ClickableTrace), true);
+	NECRO_COUNT(Traces, 1);
+	PendingTrace = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, LastRayStart, LastRayEnd, TraceChannel, QueryParams);
+	PendingKey = Key;
+
+	OutLocation = CachedLocation;
+	return bHasCachedLocation;
+}
+
+bool FCursorGroundProjector::ProjectLastExact(APlayerController& PlayerController, FVector& OutLocation)
+{
+	UWorld* World = PlayerController.GetWorld();
+	if (!World || !bHasLastRay)
+	{
+		return false;
+	}
+
+	PollPendingTrace(*World);
+	if ((bHasCachedLocation && bCachedExact) || bCachedMiss)
+	{
+		OutLocation = CachedLocation;
+		return !bCachedMiss;
+	}
+
+	FHitResult Hit;
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ClickableTrace), true);
+	NECRO_COUNT(Traces, 1);
+	const bool bHit = World->LineTraceSingleByChannel(Hit, LastRayStart, LastRayEnd, TraceChannel, QueryParams);
+
+	// This ray is answered; an async trace still in flight for it would only repeat the work
+	if (PendingKey == CachedKey)
+	{
+		PendingTrace = FTraceHandle();
+	}
+	if (!bHit)
+	{
+		bHasCachedLocation = false;
+		bCachedMiss = true;
+		return false;
+	}
+
+	GroundZ = Hit.Location.Z;
+	CachedLocation = Hit.Location;
+	bHasCachedLocation = true;
+	bCachedExact = true;
+	OutLocation = CachedLocation;
+	return true;
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+
+class APlayerController;
+
+/**
+ * Finds the world point under a screen position without a synchronous complex trace every frame.
+ *
+ * The result is reused while neither the screen position nor the camera moves. Otherwise the view ray
+ * is intersected with a ground plane at the height of the last traced hit, and an async complex trace
+ * is queued along it. Its result is picked up on the next call, one frame later; a hit for a ray the cursor
+ * has already left still moves the plane. Without any hit yet, the ray is traced synchronously instead.
+ */
+class NECROMANCER_API FCursorGroundProjector
+{
+public:
+	/** Returns false if nothing is under ScreenPosition (the ray misses the ground plane and no trace has hit yet). */
+	bool Project(APlayerController& PlayerController, const FVector2D& ScreenPosition, FVector& OutLocation);
+
+	/**
+	 * Resolves the ray of the last Project call with a synchronous complex trace, unless its async trace already
+	 * answered. Gives the same point as tracing under the cursor on that frame.
+	 */
+	bool ProjectLastExact(APlayerController& PlayerController, FVector& OutLocation);
+
+	/** Forgets all cached results, e.g. after a teleport or level change */
+	void Invalidate();
+
+	ECollisionChannel TraceChannel = ECC_Visibility;
+
+private:
+	struct FViewKey
+	{
+		FVector2D ScreenPosition = FVector2D(-1.f, -1.f);
+		FVector CameraLocation = FVector::ZeroVector;
+		FRotator CameraRotation = FRotator::ZeroRotator;
+		float FOV = 0.f;
+
+		bool operator==(const FViewKey& Other) const
+		{
+			return ScreenPosition == Other.ScreenPosition && CameraLocation == Other.CameraLocation && CameraRotation == Other.CameraRotation && FOV == Other.FOV;
+		}
+	};
+
+	static FViewKey MakeViewKey(const APlayerController& PlayerController, const FVector2D& ScreenPosition);
+	void PollPendingTrace(UWorld& World);
+
+	/** Intersects the last ray with the ground plane at GroundZ */
+	bool EstimateOnGround(FVector& OutLocation) const;
+
+	/** Key the cached location belongs to */
+	FViewKey CachedKey;
+	FVector CachedLocation = FVector::ZeroVector;
+	bool bHasCachedLocation = false;
+	bool bCachedExact = false;
+
+	/** The trace for CachedKey came back without a hit */
+	bool bCachedMiss = false;
+
+	/** Height of the last traced hit, used for the plane estimate */
+	TOptional<double> GroundZ;
+
+	/** Ray of the last Project call */
+	FVector LastRayStart = FVector::ZeroVector;
+	FVector LastRayEnd = FVector::ZeroVector;
+	bool bHasLastRay = false;
+
+	FTraceHandle PendingTrace;
+	FViewKey PendingKey;
+};
@@ -0,0 +1,247 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FXPoolSubsystem.h"
+#include "NecromancerStats.h"
+#include "NiagaraComponent.h"
+#include "NiagaraSystem.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("FX Flush"), STAT_FXFlush, STATGROUP_Necromancer);
+
+static FAutoConsoleCommandWithWorld GDumpFXPoolStatsCommand(
+	TEXT("necro.FX.Stats"),
+	TEXT("Logs the FX pool counters for the current world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UFXPoolSubsystem* FXPool = World ? World->GetSubsystem<UFXPoolSubsystem>() : nullptr)
+		{
+			const FFXPoolStats& Stats = FXPool->GetStats();
+			UE_LOG(LogNecromancer, Display, TEXT("FX pool: %d requests, %d pool hits, %d allocations, %d merged, %d culled, %d spawns avoided"),
+				Stats.Requests, Stats.PoolHits, Stats.Allocations, Stats.Merged, Stats.Culled, Stats.GetSpawnsAvoided());
+		}
+	}));
+
+bool UFXPoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFXPoolSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFXPoolSubsystem, STATGROUP_Tickables);
+}
+
+void UFXPoolSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	for (const FFXPoolPrewarm& Prewarm : PrewarmSystems)
+	{
+		UNiagaraSystem* System = Prewarm.System.LoadSynchronous();
+		if (!System)
+		{
+			continue;
+		}
+		if (System->IsLooping())
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("FX pool: %s loops and cannot be pooled"), *System->GetName());
+			continue;
+		}
+
+		FFXPool& Pool = FindOrAddPool(System);
+		if (Prewarm.MaxActive > 0)
+		{
+			Pool.MaxActive = Prewarm.MaxActive;
+		}
+		for (int32 Index = 0; Index < Prewarm.Count; ++Index)
+		{
+			Pool.Free.Add(CreatePooledComponent(System, Pool));
+		}
+	}
+}
+
+void UFXPoolSubsystem::Deinitialize()
+{
+	// Active effects too, or they outlive the subsystem that would have returned them
+	for (TPair<TObjectPtr<UNiagaraSystem>, FFXPool>& Pair : Pools)
+	{
+		for (UNiagaraComponent* Component : Pair.Value.Components)
+		{
+			if (IsValid(Component))
+			{
+				Component->OnSystemFinished.RemoveAll(this);
+				Component->DestroyComponent();
+			}
+		}
+	}
+	Pools.Empty();
+	PendingRequests.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFXPoolSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	FlushRequests();
+}
+
+void UFXPoolSubsystem::RequestEffect(UNiagaraSystem* System, const FVector& Location, const FRotator& Rotation, const FVector& Scale)
+{
+	if (System && System->IsLooping())
+	{
+		// Nothing would ever return the component to the pool
+		UE_LOG(LogNecromancer, Warning, TEXT("FX pool: %s loops and cannot be pooled"), *System->GetName());
+		return;
+	}
+
+	if (System)
+	{
+		++Stats.Requests;
+		PendingRequests.Add({ System, Location, Rotation, Scale });
+	}
+}
+
+FFXPool& UFXPoolSubsystem::FindOrAddPool(UNiagaraSystem* System)
+{
+	FFXPool* Pool = Pools.Find(System);
+	if (!Pool)
+	{
+		Pool = &Pools.Add(System);
+		Pool->MaxActive = DefaultMaxActive;
+	}
+	return *Pool;
+}
+
+UNiagaraComponent* UFXPoolSubsystem::CreatePooledComponent(UNiagaraSystem* System, FFXPool& Pool)
+{
+	UWorld* World = GetWorld();
+	UNiagaraComponent* Component = NewObject<UNiagaraComponent>(World);
+	Component->SetAsset(System);
+	Component->SetAutoActivate(false);
+	Component->SetAutoDestroy(false);
+	Component->SetUsingAbsoluteLocation(true);
+	Component->SetUsingAbsoluteRotation(true);
+	Component->SetUsingAbsoluteScale(true);
+	Component->OnSystemFinished.AddDynamic(this, &UFXPoolSubsystem::HandleSystemFinished);
+	Component->RegisterComponentWithWorld(World);
+	Pool.Components.Add(Component);
+	return Component;
+}
+
+void UFXPoolSubsystem::FlushRequests()
+{
+	NECRO_SCOPE(STAT_FXFlush, FX);
+
+	if (PendingRequests.Num() == 0)
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	if (World->GetNetMode() == NM_DedicatedServer)
+	{
+		Stats.Culled += PendingRequests.Num();
+		PendingRequests.Reset();
+		return;
+	}
+
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get())
+		{
+			if (PlayerController->IsLocalController() && PlayerController->PlayerCameraManager)
+			{
+				ViewLocations.Add(PlayerController->PlayerCameraManager->GetCameraLocation());
+			}
+		}
+	}
+
+	const float CullDistanceSq = FMath::Square(CullDistance);
+	const float MergeDistanceSq = FMath::Square(MergeDistance);
+	for (int32 RequestIndex = 0; RequestIndex < PendingRequests.Num(); ++RequestIndex)
+	{
+		const FRequest& Request = PendingRequests[RequestIndex];
+		UNiagaraSystem* System = Request.System.Get();
+		if (!System)
+		{
+			continue;
+		}
+
+		// Same effect on the same spot this frame: one is enough
+		bool bMerged = false;
+		for (int32 Earlier = 0; Earlier < RequestIndex && !bMerged; ++Earlier)
+		{
+			const FRequest& Other = PendingRequests[Earlier];
+			bMerged = Other.System == Request.System && FVector::DistSquared(Other.Location, Request.Location) <= MergeDistanceSq;
+		}
+		if (bMerged)
+		{
+			++Stats.Merged;
+			continue;
+		}
+
+		const bool bInRange = ViewLocations.Num() == 0 || ViewLocations.ContainsByPredicate([&Request, CullDistanceSq](const FVector& ViewLocation)
+		{
+			return FVector::DistSquared(ViewLocation, Request.Location) <= CullDistanceSq;
+		});
+
+		FFXPool& Pool = FindOrAddPool(System);
+		if (!bInRange || Pool.NumActive >= Pool.MaxActive)
+		{
+			++Stats.Culled;
+			continue;
+		}
+
+		UNiagaraComponent* Component = nullptr;
+		while (!Component && Pool.Free.Num() > 0)
+		{
+			Component = Pool.Free.Pop(EAllowShrinking::No);
+			Component = IsValid(Component) ? Component : nullptr;
+		}
+		if (Component)
+		{
+			++Stats.PoolHits;
+		}
+		else
+		{
+			Component = CreatePooledComponent(System, Pool);
+			++Stats.Allocations;
+		}
+
+		++Pool.NumActive;
+		Component->SetWorldLocationAndRotation(Request.Location, Request.Rotation);
+		Component->SetWorldScale3D(Request.Scale);
+		Component->SetVisibility(true);
+		Component->ActivateSystem(true);
+		NECRO_COUNT(FX, 1);
+	}
+
+	PendingRequests.Reset();
+}
+
+void UFXPoolSubsystem::HandleSystemFinished(UNiagaraComponent* Component)
+{
+	if (!Component)
+	{
+		return;
+	}
+
+	if (FFXPool* Pool = Pools.Find(Component->GetAsset()))
+	{
+		Pool->NumActive = FMath::Max(Pool->NumActive - 1, 0);
+		Component->SetVisibility(false);
+		Pool->Free.Add(Component);
+	}
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FXPoolSubsystem.generated.h"
+
+class UNiagaraComponent;
+class UNiagaraSystem;
+
+/** Pool created when the map starts */
+USTRUCT()
+struct FFXPoolPrewarm
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UNiagaraSystem> System;
+
+	/** Components created up front */
+	UPROPERTY(Config)
+	int32 Count = 4;
+
+	/** Concurrent effects of this system; further requests are dropped. Zero uses DefaultMaxActive. */
+	UPROPERTY(Config)
+	int32 MaxActive = 0;
+};
+
+/** Per-system pool of inactive components */
+USTRUCT()
+struct FFXPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UNiagaraComponent>> Free;
+
+	/** Every component created for this system, active or free */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UNiagaraComponent>> Components;
+
+	int32 NumActive = 0;
+	int32 MaxActive = 0;
+};
+
+/** Counters since the world started */
+struct FFXPoolStats
+{
+	int32 Requests = 0;
+
+	/** Requests served by a pooled component */
+	int32 PoolHits = 0;
+
+	/** Components created because the pool was empty */
+	int32 Allocations = 0;
+
+	/** Requests merged into an identical one in the same frame */
+	int32 Merged = 0;
+
+	/** Requests dropped by the distance or count budget */
+	int32 Culled = 0;
+
+	/** Requests that did not allocate a component */
+	int32 GetSpawnsAvoided() const { return Requests - Allocations; }
+};
+
+/**
+ * Spawns Niagara effects from per-system pools of reusable components instead of creating and destroying one per effect.
+ * Requests are queued and resolved once per frame, which merges duplicates and applies the distance and count budgets.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UFXPoolSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Queues a one-shot effect, spawned at the end of the frame. Looping systems never finish, so they are rejected. */
+	void RequestEffect(UNiagaraSystem* System, const FVector& Location, const FRotator& Rotation = FRotator::ZeroRotator, const FVector& Scale = FVector::OneVector);
+
+	const FFXPoolStats& GetStats() const { return Stats; }
+
+	UPROPERTY(Config)
+	TArray<FFXPoolPrewarm> PrewarmSystems;
+
+	/** Concurrent effects per system when not set by PrewarmSystems */
+	UPROPERTY(Config)
+	int32 DefaultMaxActive = 32;
+
+	/** Effects further than this from every player camera are dropped */
+	UPROPERTY(Config)
+	float CullDistance = 6000.f;
+
+	/** Requests for the same system closer than this in one frame are merged */
+	UPROPERTY(Config)
+	float MergeDistance = 25.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FRequest
+	{
+		TWeakObjectPtr<UNiagaraSystem> System;
+		FVector Location;
+		FRotator Rotation;
+		FVector Scale;
+	};
+
+	FFXPool& FindOrAddPool(UNiagaraSystem* System);
+	UNiagaraComponent* CreatePooledComponent(UNiagaraSystem* System, FFXPool& Pool);
+	void FlushRequests();
+
+	UFUNCTION()
+	void HandleSystemFinished(UNiagaraComponent* Component);
+
+	UPROPERTY(Transient)
+	TMap<TObjectPtr<UNiagaraSystem>, FFXPool> Pools;
+
+	TArray<FRequest> PendingRequests;
+	FFXPoolStats Stats;
+};
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FlowField.h"
+#include "Necromancer.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flow Field Build"), STAT_FlowFieldBuild, STATGROUP_Necromancer);
+
+namespace FlowField
+{
+	// Counter-clockwise from +X, so the opposite of direction D is (D + 4) % 8
+	const FIntPoint NeighbourOffsets[8] = {
+		{ 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 },
+	};
+
+	FORCEINLINE bool IsDiagonal(int32 Dir) { return (Dir & 1) != 0; }
+	FORCEINLINE uint8 Opposite(int32 Dir) { return static_cast<uint8>((Dir + 4) & 7); }
+}
+
+FFlowField::FFlowField(const TSharedRef<const FFlowFieldCostGrid>& InCostGrid, const FIntPoint& InGoalCell)
+	: CostGrid(InCostGrid)
+	, GoalCell(InGoalCell)
+{
+}
+
+TSharedRef<FFlowField> FFlowField::Build(const TSharedRef<const FFlowFieldCostGrid>& InCostGrid, const FIntPoint& InGoalCell)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldBuild);
+
+	TSharedRef<FFlowField> Field = MakeShareable(new FFlowField(InCostGrid, InGoalCell));
+	const FFlowFieldCostGrid& Grid = *InCostGrid;
+	Field->Direction.Init(NoDirection, Grid.Num());
+	if (!Grid.IsValidCell(InGoalCell))
+	{
+		return Field;
+	}
+
+	struct FOpenCell
+	{
+		float Cost;
+		int32 Index;
+
+		bool operator<(const FOpenCell& Other) const { return Cost < Other.Cost; }
+	};
+
+	TArray<float> Integration;
+	Integration.Init(MAX_flt, Grid.Num());
+
+	TArray<FOpenCell> Open;
+	const int32 GoalIndex = Grid.ToIndex(InGoalCell);
+	Integration[GoalIndex] = 0.f;
+	Open.HeapPush({ 0.f, GoalIndex });
+	Field->NumReachable = 1;
+
+	auto IsOpen = [&Grid](const FIntPoint& Cell)
+	{
+		return Grid.IsValidCell(Cell) && Grid.Cost[Grid.ToIndex(Cell)] != FFlowFieldCostGrid::Blocked;
+	};
+
+	while (Open.Num() > 0)
+	{
+		FOpenCell Current;
+		Open.HeapPop(Current, EAllowShrinking::No);
+		if (Current.Cost > Integration[Current.Index])
+		{
+			continue;
+		}
+
+		const FIntPoint Cell(Current.Index % Grid.Size.X, Current.Index / Grid.Size.X);
+		for (int32 Dir = 0; Dir < 8; ++Dir)
+		{
+			const FIntPoint Offset = FlowField::NeighbourOffsets[Dir];
+			const FIntPoint Neighbour = Cell + Offset;
+			if (!IsOpen(Neighbour))
+			{
+				continue;
+			}
+
+			// Diagonal moves must not clip a blocked corner
+			if (FlowField::IsDiagonal(Dir) && (!IsOpen(FIntPoint(Cell.X + Offset.X, Cell.Y)) || !IsOpen(FIntPoint(Cell.X, Cell.Y + Offset.Y))))
+			{
+				continue;
+			}
+
+			const int32 NeighbourIndex = Grid.ToIndex(Neighbour);
+			const float StepCost = Grid.Cost[NeighbourIndex] * (FlowField::IsDiagonal(Dir) ? UE_SQRT_2 : 1.f);
+			const float NewCost = Current.Cost + StepCost;
+			if (NewCost < Integration[NeighbourIndex])
+			{
+				if (Integration[NeighbourIndex] == MAX_flt)
+				{
+					++Field->NumReachable;
+				}
+				Integration[NeighbourIndex] = NewCost;
+				Field->Direction[NeighbourIndex] = FlowField::Opposite(Dir);
+				Open.HeapPush({ NewCost, NeighbourIndex });
+			}
+		}
+	}
+
+	return Field;
+}
+
+bool FFlowField::GetNextWaypoint(const FVector& Location, FVector& OutWaypoint) const
+{
+	const FFlowFieldCostGrid& Grid = *CostGrid;
+	const FIntPoint Cell = Grid.ToCell(Location);
+	if (!Grid.IsValidCell(Cell) || Cell == GoalCell)
+	{
+		return false;
+	}
+
+	const uint8 Dir = Direction[Grid.ToIndex(Cell)];
+	if (Dir == NoDirection)
+	{
+		return false;
+	}
+
+	const FVector2D Next = Grid.GetCellCenter(Cell + FlowField::NeighbourOffsets[Dir]);
+	OutWaypoint = FVector(Next.X, Next.Y, Location.Z);
+	return true;
+}
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Walkability of the map sampled on a uniform XY grid. Read-only once built, and shared by every field built from it. */
+struct FFlowFieldCostGrid
+{
+	static constexpr uint8 Blocked = MAX_uint8;
+
+	/** Minimum corner of cell (0, 0) */
+	FVector2D Origin = FVector2D::ZeroVector;
+	float CellSize = 100.f;
+	FIntPoint Size = FIntPoint::ZeroValue;
+
+	/** Cost of entering each cell, row major. Blocked cells cannot be entered. */
+	TArray<uint8> Cost;
+
+	/** Navmesh height at each cell center, row major. Blocked cells repeat the previous walkable cell's height. */
+	TArray<float> Height;
+
+	int32 Num() const { return Size.X * Size.Y; }
+	bool IsValidCell(const FIntPoint& Cell) const { return Cell.X >= 0 && Cell.Y >= 0 && Cell.X < Size.X && Cell.Y < Size.Y; }
+	int32 ToIndex(const FIntPoint& Cell) const { return Cell.Y * Size.X + Cell.X; }
+
+	FIntPoint ToCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt32((Location.X - Origin.X) / CellSize), FMath::FloorToInt32((Location.Y - Origin.Y) / CellSize));
+	}
+
+	FVector2D GetCellCenter(const FIntPoint& Cell) const
+	{
+		return Origin + (FVector2D(Cell) + 0.5) * CellSize;
+	}
+
+	/** Ground height at Location, interpolated between the four nearest cell centers */
+	float SampleHeight(const FVector& Location) const
+	{
+		const float GridX = FMath::Clamp((Location.X - Origin.X) / CellSize - 0.5f, 0.f, static_cast<float>(Size.X - 1));
+		const float GridY = FMath::Clamp((Location.Y - Origin.Y) / CellSize - 0.5f, 0.f, static_cast<float>(Size.Y - 1));
+		const int32 X0 = FMath::FloorToInt32(GridX);
+		const int32 Y0 = FMath::FloorToInt32(GridY);
+		const int32 X1 = FMath::Min(X0 + 1, Size.X - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, Size.Y - 1);
+		const float AlphaX = GridX - X0;
+		const float AlphaY = GridY - Y0;
+		const float Top = FMath::Lerp(Height[Y0 * Size.X + X0], Height[Y0 * Size.X + X1], AlphaX);
+		const float Bottom = FMath::Lerp(Height[Y1 * Size.X + X0], Height[Y1 * Size.X + X1], AlphaX);
+		return FMath::Lerp(Top, Bottom, AlphaY);
+	}
+};
+
+/**
+ * Direction toward one goal cell from every reachable cell of a cost grid. Built once per destination
+ * and shared by every unit sent there, instead of one path query per unit.
+ */
+class NECROMANCER_API FFlowField
+{
+public:
+	/** Integrates costs outward from InGoalCell (Dijkstra, 8 neighbours, no corner cutting). Safe on any thread. */
+	static TSharedRef<FFlowField> Build(const TSharedRef<const FFlowFieldCostGrid>& InCostGrid, const FIntPoint& InGoalCell);
+
+	/**
+	 * Center of the next cell to walk to from Location, at Location's height.
+	 * Returns false in the goal cell, outside the grid, or where the goal cannot be reached.
+	 */
+	bool GetNextWaypoint(const FVector& Location, FVector& OutWaypoint) const;
+
+	const FIntPoint& GetGoalCell() const { return GoalCell; }
+	int32 GetNumReachable() const { return NumReachable; }
+
+private:
+	FFlowField(const TSharedRef<const FFlowFieldCostGrid>& InCostGrid, const FIntPoint& InGoalCell);
+
+	static constexpr uint8 NoDirection = MAX_uint8;
+
+	TSharedRef<const FFlowFieldCostGrid> CostGrid;
+	FIntPoint GoalCell;
+
+	/** Index into the neighbour table per cell, or NoDirection */
+	TArray<uint8> Direction;
+	int32 NumReachable = 0;
+};
@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FlowFieldOrderBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "FlowFieldSubsystem.h"
+#include "MinionHordeSubsystem.h"
+#include "Necromancer.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+
+namespace FlowFieldOrderBenchmark
+{
+	constexpr float CellSize = 100.f;
+	constexpr float MinionSpacing = 100.f;
+
+	// Cells between the walls across the grid, each open at alternating ends so the route winds
+	constexpr int32 WallSpacing = 64;
+	constexpr int32 WallGap = 8;
+
+	TSharedRef<FFlowFieldCostGrid> MakeCostGrid(int32 GridSize)
+	{
+		TSharedRef<FFlowFieldCostGrid> Grid = MakeShared<FFlowFieldCostGrid>();
+		Grid->CellSize = CellSize;
+		Grid->Size = FIntPoint(GridSize, GridSize);
+		Grid->Cost.Init(1, Grid->Num());
+		Grid->Height.Init(0.f, Grid->Num());
+		for (int32 WallX = WallSpacing; WallX < GridSize; WallX += WallSpacing)
+		{
+			const bool bGapAtTop = (WallX / WallSpacing) % 2 == 0;
+			for (int32 Y = 0; Y < GridSize; ++Y)
+			{
+				const bool bInGap = bGapAtTop ? Y < WallGap : Y >= GridSize - WallGap;
+				Grid->Cost[Grid->ToIndex(FIntPoint(WallX, Y))] = bInGap ? 1 : FFlowFieldCostGrid::Blocked;
+			}
+		}
+		return Grid;
+	}
+}
+
+UFlowFieldOrderBenchmarkCommandlet::UFlowFieldOrderBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UFlowFieldOrderBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumUnits = 1000;
+	int32 GridSize = 512;
+	int32 Frames = 120;
+	float FrameRate = 30.f;
+	float MaxFrameMs = 8.f;
+	int32 MaxFieldFrames = 5;
+	FParse::Value(*Params, TEXT("Units="), NumUnits);
+	FParse::Value(*Params, TEXT("GridSize="), GridSize);
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	FParse::Value(*Params, TEXT("MaxFrameMs="), MaxFrameMs);
+	FParse::Value(*Params, TEXT("MaxFieldFrames="), MaxFieldFrames);
+	NumUnits = FMath::Max(NumUnits, 1);
+	GridSize = FMath::Max(GridSize, FlowFieldOrderBenchmark::WallSpacing);
+	Frames = FMath::Max(Frames, 1);
+	FrameRate = FMath::Max(FrameRate, 1.f);
+
+	FBenchmarkWorld World;
+	World.BeginPlay();
+	UFlowFieldSubsystem* FlowFields = World.Get()->GetSubsystem<UFlowFieldSubsystem>();
+	UMinionHordeSubsystem* Horde = World.Get()->GetSubsystem<UMinionHordeSubsystem>();
+	if (!FlowFields || !Horde)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("FlowFieldOrderBenchmark: the benchmark world has no flow field or horde subsystem"));
+		return 1;
+	}
+	FlowFields->SetCostGrid(FlowFieldOrderBenchmark::MakeCostGrid(GridSize));
+
+	// A block of minions in the first corridor, sent to the far corner of the last one
+	const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumUnits)));
+	const FVector BlockOrigin(FlowFieldOrderBenchmark::CellSize * 4.f, FlowFieldOrderBenchmark::CellSize * 4.f, 0.f);
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		FCombatantDesc Desc;
+		Desc.Team = ECombatTeam::Undead;
+		Horde->SpawnMinion(BlockOrigin + FVector((Index % Columns) * FlowFieldOrderBenchmark::MinionSpacing * 0.5f, (Index / Columns) * FlowFieldOrderBenchmark::MinionSpacing, 0.f), Desc);
+	}
+	const FVector Goal(FVector2D(GridSize - 4) * FlowFieldOrderBenchmark::CellSize, 0.f);
+
+	const float DeltaSeconds = 1.f / FrameRate;
+	const int32 WarmupFrames = FMath::CeilToInt32(FrameRate);
+	for (int32 Frame = 0; Frame < WarmupFrames; ++Frame)
+	{
+		World.Tick(DeltaSeconds);
+	}
+
+	// The frame the order is given on counts the order itself
+	FBenchmarkFrameTimes GameThreadMs;
+	int32 FieldFrames = INDEX_NONE;
+	for (int32 Frame = 0; Frame < Frames; ++Frame)
+	{
+		double OrderMs = 0.0;
+		if (Frame == 0)
+		{
+			const uint64 OrderStartCycles = FPlatformTime::Cycles64();
+			Horde->OrderMoveAll(INDEX_NONE, Goal);
+			OrderMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - OrderStartCycles);
+		}
+		GameThreadMs.Add(OrderMs + World.Tick(DeltaSeconds));
+
+		if (FieldFrames == INDEX_NONE && FlowFields->FindOrRequestField(Goal).IsValid())
+		{
+			FieldFrames = Frame + 1;
+		}
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("FlowFieldOrderBenchmark: %d minions ordered across a %dx%d grid, %d frames at %.0f fps"),
+		Horde->GetNumMinions(), GridSize, GridSize, Frames, FrameRate);
+	UE_LOG(LogNecromancer, Display, TEXT("FlowFieldOrderBenchmark: field ready after %d frames, game thread %.3fms on average, p99 %.3fms, worst %.3fms"),
+		FieldFrames, GameThreadMs.GetAverage(), GameThreadMs.GetPercentile(99), GameThreadMs.GetMax());
+
+	bool bFailed = false;
+	if (MaxFrameMs > 0.f && GameThreadMs.GetMax() > MaxFrameMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("FlowFieldOrderBenchmark: worst frame %.3fms exceeds %.3fms"), GameThreadMs.GetMax(), MaxFrameMs);
+		bFailed = true;
+	}
+	if (MaxFieldFrames > 0 && (FieldFrames == INDEX_NONE || FieldFrames > MaxFieldFrames))
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("FlowFieldOrderBenchmark: field not ready within %d frames"), MaxFieldFrames);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
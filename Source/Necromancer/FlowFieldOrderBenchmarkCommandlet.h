@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "FlowFieldOrderBenchmarkCommandlet.generated.h"
+
+/**
+ * Gives a block of horde minions one move order across a walled cost grid in a benchmark world, and measures the
+ * frames that follow while the flow field is built and the minions start following it. The grid is generated, not
+ * baked, since the benchmark world has no navmesh.
+ *
+ * Usage: -run=FlowFieldOrderBenchmark [-Units=1000] [-GridSize=512] [-Frames=120] [-FrameRate=30] [-MaxFrameMs=8] [-MaxFieldFrames=5]
+ * Returns non-zero if any frame from the order on takes longer than MaxFrameMs, or if the field is not ready within
+ * MaxFieldFrames frames of the order; a limit of zero is not checked.
+ */
+UCLASS()
+class UFlowFieldOrderBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UFlowFieldOrderBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
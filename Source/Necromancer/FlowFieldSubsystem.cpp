@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FlowFieldSubsystem.h"
+#include "NecromancerStats.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flow Field Bake"), STAT_FlowFieldBake, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Flow Fields Cached"), STAT_FlowFieldsCached, STATGROUP_Necromancer);
+
+namespace FlowFieldBake
+{
+	// Cells sampled between checks of the frame budget
+	constexpr int32 CellsPerBudgetCheck = 32;
+}
+
+bool UFlowFieldSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFlowFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlowFieldSubsystem, STATGROUP_Tickables);
+}
+
+void UFlowFieldSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(&InWorld))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.AddDynamic(this, &UFlowFieldSubsystem::HandleNavigationGenerationFinished);
+	}
+	NavigationDirtyHandle = UNavigationSystemV1::NavigationDirtyEvent.AddUObject(this, &UFlowFieldSubsystem::HandleNavigationDirty);
+	BakeCostGrid();
+}
+
+void UFlowFieldSubsystem::Deinitialize()
+{
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UFlowFieldSubsystem::HandleNavigationGenerationFinished);
+	}
+	UNavigationSystemV1::NavigationDirtyEvent.Remove(NavigationDirtyHandle);
+
+	// Builds in flight only hold shared pointers and finish on their own
+	Fields.Empty();
+	CostGrid.Reset();
+	Bake = FCostGridBake();
+
+	Super::Deinitialize();
+}
+
+void UFlowFieldSubsystem::HandleNavigationDirty(const FBox& Bounds)
+{
+	// The event is shared by every world
+	if (Bounds.IsValid && FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		DirtyBounds += Bounds;
+	}
+}
+
+void UFlowFieldSubsystem::HandleNavigationGenerationFinished(ANavigationData* NavData)
+{
+	const FBox Bounds = DirtyBounds;
+	DirtyBounds = FBox(ForceInit);
+	StartBake(Bounds);
+}
+
+void UFlowFieldSubsystem::BakeCostGrid()
+{
+	StartBake(FBox(ForceInit));
+}
+
+void UFlowFieldSubsystem::SetCostGrid(const TSharedRef<const FFlowFieldCostGrid>& InCostGrid)
+{
+	Bake = FCostGridBake();
+	Fields.Empty();
+	CostGrid = InCostGrid;
+}
+
+bool UFlowFieldSubsystem::MakeGridLayout(FFlowFieldCostGrid& OutGrid, FBox& OutBounds) const
+{
+	const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	OutBounds = NavSys ? NavSys->GetNavigableWorldBounds() : FBox(ForceInit);
+	if (!OutBounds.IsValid)
+	{
+		return false;
+	}
+
+	const FVector2D BoundsSize(OutBounds.GetSize());
+	float GridCellSize = CellSize;
+	while ((FMath::CeilToInt32(BoundsSize.X / GridCellSize) * FMath::CeilToInt32(BoundsSize.Y / GridCellSize)) > MaxCells)
+	{
+		GridCellSize *= 2.f;
+	}
+
+	OutGrid.Origin = FVector2D(OutBounds.Min);
+	OutGrid.CellSize = GridCellSize;
+	OutGrid.Size = FIntPoint(FMath::Max(FMath::CeilToInt32(BoundsSize.X / GridCellSize), 1), FMath::Max(FMath::CeilToInt32(BoundsSize.Y / GridCellSize), 1));
+	return true;
+}
+
+void UFlowFieldSubsystem::StartBake(const FBox& Dirty)
+{
+	Bake = FCostGridBake();
+
+	const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	const ANavigationData* NavData = NavSys ? NavSys->GetDefaultNavDataInstance() : nullptr;
+	FFlowFieldCostGrid Layout;
+	FBox Bounds;
+	if (!NavData || !MakeGridLayout(Layout, Bounds))
+	{
+		Fields.Empty();
+		CostGrid.Reset();
+		return;
+	}
+
+	// Only the dirty cells are sampled again, into a copy of the current grid, as long as its layout still fits
+	const bool bSameLayout = CostGrid.IsValid() && CostGrid->Origin == Layout.Origin && CostGrid->CellSize == Layout.CellSize && CostGrid->Size == Layout.Size;
+	if (bSameLayout && Dirty.IsValid)
+	{
+		const FIntPoint Min = CostGrid->ToCell(Dirty.Min).ComponentMax(FIntPoint::ZeroValue);
+		const FIntPoint Max = (CostGrid->ToCell(Dirty.Max) + FIntPoint(1, 1)).ComponentMin(CostGrid->Size);
+		if (Min.X >= Max.X || Min.Y >= Max.Y)
+		{
+			return;
+		}
+		Bake.Grid = MakeShared<FFlowFieldCostGrid>(*CostGrid);
+		Bake.Cells = FIntRect(Min, Max);
+	}
+	else
+	{
+		if (Layout.CellSize != CellSize)
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("Flow field cell size raised from %.0f to %.0f to fit MaxCells"), CellSize, Layout.CellSize);
+		}
+		Bake.Grid = MakeShared<FFlowFieldCostGrid>(MoveTemp(Layout));
+		Bake.Grid->Cost.SetNumUninitialized(Bake.Grid->Num());
+		Bake.Grid->Height.SetNumUninitialized(Bake.Grid->Num());
+		Bake.Cells = FIntRect(FIntPoint::ZeroValue, Bake.Grid->Size);
+	}
+
+	// A cell is walkable if the navmesh covers its center within the cell's footprint
+	const float GridCellSize = Bake.Grid->CellSize;
+	Bake.NavData = NavData;
+	Bake.NextCell = Bake.Cells.Min;
+	Bake.ProjectionZ = Bounds.GetCenter().Z;
+	Bake.ProjectionExtent = FVector(GridCellSize * 0.5f, GridCellSize * 0.5f, Bounds.GetSize().Z + GridCellSize);
+	Bake.LastWalkableZ = Bake.ProjectionZ;
+}
+
+void UFlowFieldSubsystem::ContinueBake()
+{
+	if (!Bake.Grid.IsValid())
+	{
+		return;
+	}
+
+	NECRO_SCOPE(STAT_FlowFieldBake, Movement);
+
+	const ANavigationData* NavData = Bake.NavData.Get();
+	if (!NavData)
+	{
+		Bake = FCostGridBake();
+		return;
+	}
+
+	FFlowFieldCostGrid& Grid = *Bake.Grid;
+	const double EndTime = FPlatformTime::Seconds() + BakeBudgetMs / 1000.0;
+	int32 NumSampled = 0;
+	while (Bake.NextCell.Y < Bake.Cells.Max.Y)
+	{
+		const FIntPoint Cell = Bake.NextCell;
+
+		// A row starts from the height left of it, which a partial bake did not resample
+		if (Cell.X == Bake.Cells.Min.X && Cell.X > 0)
+		{
+			Bake.LastWalkableZ = Grid.Height[Grid.ToIndex(FIntPoint(Cell.X - 1, Cell.Y))];
+		}
+
+		const FVector2D Center = Grid.GetCellCenter(Cell);
+		FNavLocation Projected;
+		const bool bWalkable = NavData->ProjectPoint(FVector(Center.X, Center.Y, Bake.ProjectionZ), Projected, Bake.ProjectionExtent);
+		Grid.Cost[Grid.ToIndex(Cell)] = bWalkable ? 1 : FFlowFieldCostGrid::Blocked;
+		Bake.LastWalkableZ = bWalkable ? Projected.Location.Z : Bake.LastWalkableZ;
+		Grid.Height[Grid.ToIndex(Cell)] = Bake.LastWalkableZ;
+
+		Bake.NextCell.X = Cell.X + 1 < Bake.Cells.Max.X ? Cell.X + 1 : Bake.Cells.Min.X;
+		Bake.NextCell.Y = Cell.X + 1 < Bake.Cells.Max.X ? Cell.Y : Cell.Y + 1;
+		if (++NumSampled % FlowFieldBake::CellsPerBudgetCheck == 0 && FPlatformTime::Seconds() > EndTime)
+		{
+			return;
+		}
+	}
+
+	// Every field was integrated over the old costs
+	Fields.Empty();
+	CostGrid = Bake.Grid;
+	Bake = FCostGridBake();
+}
+
+FIntPoint UFlowFieldSubsystem::GetFieldKey(const FVector& Destination) const
+{
+	return CostGrid.IsValid() ? CostGrid->ToCell(Destination) : FIntPoint::NoneValue;
+}
+
+TSharedPtr<const FFlowField> UFlowFieldSubsystem::FindOrRequestField(const FVector& Destination)
+{
+	if (!CostGrid.IsValid())
+	{
+		return nullptr;
+	}
+
+	const FIntPoint Key = CostGrid->ToCell(Destination);
+	if (!CostGrid->IsValidCell(Key))
+	{
+		return nullptr;
+	}
+
+	FCachedField& Cached = Fields.FindOrAdd(Key);
+	Cached.LastUsedFrame = GFrameCounter;
+	if (!Cached.Field.IsValid() && !Cached.Build.IsValid())
+	{
+		Cached.Build = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Grid = CostGrid.ToSharedRef(), Key]()
+		{
+			return TSharedPtr<FFlowField>(FFlowField::Build(Grid, Key));
+		});
+	}
+	else if (Cached.Build.IsValid() && Cached.Build.IsCompleted())
+	{
+		Cached.Field = Cached.Build.GetResult();
+		Cached.Build = {};
+	}
+	return Cached.Field;
+}
+
+void UFlowFieldSubsystem::CollectFinishedBuilds()
+{
+	for (TPair<FIntPoint, FCachedField>& Pair : Fields)
+	{
+		FCachedField& Cached = Pair.Value;
+		if (Cached.Build.IsValid() && Cached.Build.IsCompleted())
+		{
+			Cached.Field = Cached.Build.GetResult();
+			Cached.Build = {};
+		}
+	}
+}
+
+void UFlowFieldSubsystem::EvictFields()
+{
+	while (Fields.Num() > MaxCachedFields)
+	{
+		// Builds still running are kept; their result is about to be asked for
+		const FIntPoint* Oldest = nullptr;
+		uint64 OldestFrame = MAX_uint64;
+		for (const TPair<FIntPoint, FCachedField>& Pair : Fields)
+		{
+			if (!Pair.Value.Build.IsValid() && Pair.Value.LastUsedFrame < OldestFrame)
+			{
+				Oldest = &Pair.Key;
+				OldestFrame = Pair.Value.LastUsedFrame;
+			}
+		}
+		if (!Oldest)
+		{
+			break;
+		}
+		Fields.Remove(FIntPoint(*Oldest));
+	}
+}
+
+void UFlowFieldSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	ContinueBake();
+	CollectFinishedBuilds();
+	EvictFields();
+
+	SET_DWORD_STAT(STAT_FlowFieldsCached, Fields.Num());
+}
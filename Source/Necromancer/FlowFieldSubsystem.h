@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "FlowField.h"
+#include "FlowFieldSubsystem.generated.h"
+
+class ANavigationData;
+
+/**
+ * Builds and caches flow fields for group move orders. Walkability is baked from the navmesh into a cost grid, a slice
+ * of at most BakeBudgetMs per frame; each destination cell then gets one field, integrated on a background task and
+ * shared by every unit sent there. Least recently used fields are dropped beyond MaxCachedFields.
+ * A navmesh rebuild rebakes only the cells inside the bounds that were dirtied.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UFlowFieldSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Returns the field toward Destination's cell if it is built. Otherwise queues the build and returns null;
+	 * callers should move straight toward Destination until it is ready.
+	 */
+	TSharedPtr<const FFlowField> FindOrRequestField(const FVector& Destination);
+
+	/** Key shared by every destination in the same cell */
+	FIntPoint GetFieldKey(const FVector& Destination) const;
+
+	bool HasCostGrid() const { return CostGrid.IsValid(); }
+	TSharedPtr<const FFlowFieldCostGrid> GetCostGrid() const { return CostGrid; }
+
+	/** Starts sampling the whole navmesh into a new cost grid. The current grid stays in use until it is done. */
+	void BakeCostGrid();
+
+	bool IsBaking() const { return Bake.Grid.IsValid(); }
+
+	/** Replaces the cost grid with one built elsewhere, e.g. without a navmesh, and drops every cached field */
+	void SetCostGrid(const TSharedRef<const FFlowFieldCostGrid>& InCostGrid);
+
+	/** Edge length of a grid cell */
+	UPROPERTY(Config)
+	float CellSize = 100.f;
+
+	/** The cell size grows until the grid fits in this many cells */
+	UPROPERTY(Config)
+	int32 MaxCells = 512 * 512;
+
+	UPROPERTY(Config)
+	int32 MaxCachedFields = 16;
+
+	/** Game thread time spent sampling the navmesh per frame while a bake is in progress */
+	UPROPERTY(Config)
+	float BakeBudgetMs = 1.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FCachedField
+	{
+		TSharedPtr<const FFlowField> Field;
+		UE::Tasks::TTask<TSharedPtr<FFlowField>> Build;
+		uint64 LastUsedFrame = 0;
+	};
+
+	/** Cost grid being sampled, published once every cell in Cells is done */
+	struct FCostGridBake
+	{
+		TSharedPtr<FFlowFieldCostGrid> Grid;
+		TWeakObjectPtr<const ANavigationData> NavData;
+		FIntRect Cells;
+		FIntPoint NextCell;
+		float ProjectionZ = 0.f;
+		FVector ProjectionExtent = FVector::ZeroVector;
+		float LastWalkableZ = 0.f;
+	};
+
+	/** Lays out a grid over the navigable bounds, without sampling it */
+	bool MakeGridLayout(FFlowFieldCostGrid& OutGrid, FBox& OutBounds) const;
+	void StartBake(const FBox& Dirty);
+	void ContinueBake();
+	void CollectFinishedBuilds();
+	void EvictFields();
+
+	UFUNCTION()
+	void HandleNavigationGenerationFinished(ANavigationData* NavData);
+	void HandleNavigationDirty(const FBox& Bounds);
+
+	TSharedPtr<const FFlowFieldCostGrid> CostGrid;
+	FCostGridBake Bake;
+
+	/** Union of the navigation changes since the last rebuild finished */
+	FBox DirtyBounds = FBox(ForceInit);
+	FDelegateHandle NavigationDirtyHandle;
+	TMap<FIntPoint, FCachedField> Fields;
+};
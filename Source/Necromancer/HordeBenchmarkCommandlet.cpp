@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HordeBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "MinionHordeSubsystem.h"
+#include "Necromancer.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+
+namespace HordeBenchmark
+{
+	constexpr float MinionSpacing = 100.f;
+
+	// Radius of the circuit of move orders around the horde's starting point
+	constexpr float OrderRadius = 3000.f;
+}
+
+UHordeBenchmarkCommandlet::UHordeBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UHordeBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumMinions = 10000;
+	int32 Frames = 600;
+	float FrameRate = 30.f;
+	float OrderInterval = 2.f;
+	float MaxP95Ms = 4.f;
+	float MaxP99Ms = 0.f;
+	FParse::Value(*Params, TEXT("Minions="), NumMinions);
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	FParse::Value(*Params, TEXT("OrderInterval="), OrderInterval);
+	FParse::Value(*Params, TEXT("MaxP95Ms="), MaxP95Ms);
+	FParse::Value(*Params, TEXT("MaxP99Ms="), MaxP99Ms);
+	NumMinions = FMath::Max(NumMinions, 1);
+	Frames = FMath::Max(Frames, 1);
+	FrameRate = FMath::Max(FrameRate, 1.f);
+
+	FBenchmarkWorld World;
+	World.BeginPlay();
+	UMinionHordeSubsystem* Horde = World.Get()->GetSubsystem<UMinionHordeSubsystem>();
+	if (!Horde)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("HordeBenchmark: the benchmark world has no horde subsystem"));
+		return 1;
+	}
+
+	const double SetupStart = FPlatformTime::Seconds();
+	const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumMinions)));
+	for (int32 Index = 0; Index < NumMinions; ++Index)
+	{
+		FCombatantDesc Desc;
+		Desc.Team = ECombatTeam::Undead;
+		Horde->SpawnMinion(FVector((Index % Columns - Columns / 2) * HordeBenchmark::MinionSpacing, (Index / Columns - Columns / 2) * HordeBenchmark::MinionSpacing, 0.f), Desc);
+	}
+	const double SetupMs = (FPlatformTime::Seconds() - SetupStart) * 1000.0;
+
+	if (Horde->GetNumMinions() != NumMinions)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("HordeBenchmark: %d of %d minions spawned"), Horde->GetNumMinions(), NumMinions);
+		return 1;
+	}
+
+	// One second of warmup, then every frame is measured while the horde walks from corner to corner of a square
+	const float DeltaSeconds = 1.f / FrameRate;
+	const int32 WarmupFrames = FMath::CeilToInt32(FrameRate);
+	const int32 FramesPerOrder = FMath::Max(FMath::RoundToInt32(OrderInterval * FrameRate), 1);
+	int32 NumOrders = 0;
+	FBenchmarkFrameTimes GameThreadMs;
+	for (int32 Frame = 0; Frame < WarmupFrames + Frames; ++Frame)
+	{
+		if (Frame % FramesPerOrder == 0)
+		{
+			Horde->OrderMoveAll(INDEX_NONE, FRotator(0.f, NumOrders++ * 90.f, 0.f).RotateVector(FVector(HordeBenchmark::OrderRadius, 0.f, 0.f)));
+		}
+
+		const double Ms = World.Tick(DeltaSeconds);
+		if (Frame >= WarmupFrames)
+		{
+			GameThreadMs.Add(Ms);
+		}
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("HordeBenchmark: %d minions, spawned in %.1fms, %d frames at %.0f fps, %d move orders"),
+		Horde->GetNumMinions(), SetupMs, Frames, FrameRate, NumOrders);
+	UE_LOG(LogNecromancer, Display, TEXT("HordeBenchmark: game thread %.3fms on average, p95 %.3fms, p99 %.3fms, worst %.3fms"),
+		GameThreadMs.GetAverage(), GameThreadMs.GetPercentile(95), GameThreadMs.GetPercentile(99), GameThreadMs.GetMax());
+
+	bool bFailed = false;
+	if (MaxP95Ms > 0.f && GameThreadMs.GetPercentile(95) > MaxP95Ms)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("HordeBenchmark: p95 %.3fms exceeds %.3fms"), GameThreadMs.GetPercentile(95), MaxP95Ms);
+		bFailed = true;
+	}
+	if (MaxP99Ms > 0.f && GameThreadMs.GetPercentile(99) > MaxP99Ms)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("HordeBenchmark: p99 %.3fms exceeds %.3fms"), GameThreadMs.GetPercentile(99), MaxP99Ms);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
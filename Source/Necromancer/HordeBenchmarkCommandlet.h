@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "HordeBenchmarkCommandlet.generated.h"
+
+/**
+ * Spawns a horde of minions into a benchmark world, sends it around a circuit of move orders and measures the game
+ * thread time of every world tick: horde processors, combat, flow fields, avoidance and instance updates. Meant to
+ * run with -nullrhi, which stands in for a headless server.
+ *
+ * Usage: -run=HordeBenchmark [-Minions=10000] [-Frames=600] [-FrameRate=30] [-OrderInterval=2] [-MaxP95Ms=4] [-MaxP99Ms=0]
+ * Returns non-zero if the horde could not be spawned or a limit is exceeded; a limit of zero is not checked.
+ */
+UCLASS()
+class UHordeBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UHordeBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
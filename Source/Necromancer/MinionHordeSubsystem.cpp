@@ -0,0 +1,877 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MinionHordeSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatPawn.h"
+#include "CombatPawnMovementComponent.h"
+#include "CombatPawnPoolSubsystem.h"
+#include "CombatSnapshot.h"
+#include "CombatSubsystem.h"
+#include "CorpseSubsystem.h"
+#include "FlowFieldSubsystem.h"
+#include "NecromancerStats.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Minion Horde Tick"), STAT_MinionHordeTick, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Minion Horde Step"), STAT_MinionHordeStep, STATGROUP_Necromancer);
+
+namespace MinionHorde
+{
+	// Minions processed per ParallelFor task
+	constexpr int32 BatchSize = 1024;
+
+	// Distance at which a minion counts as arrived at its move goal
+	constexpr float AcceptanceRadius = 50.f;
+
+	// Slower minions keep their facing, so avoidance jitter does not spin them
+	constexpr float MinTurnSpeed = 20.f;
+}
+
+bool UMinionHordeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UMinionHordeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMinionHordeSubsystem, STATGROUP_Tickables);
+}
+
+void UMinionHordeSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	LoadedPawnClass = PromotedPawnClass.LoadSynchronous();
+	if (!LoadedPawnClass)
+	{
+		LoadedPawnClass = ACombatPawn::StaticClass();
+	}
+
+	// Servers never draw the horde
+	if (InWorld.GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	if (UStaticMesh* Mesh = MinionMesh.LoadSynchronous())
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		RenderActor = InWorld.SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+
+		InstancedMesh = NewObject<UInstancedStaticMeshComponent>(RenderActor, TEXT("MinionInstances"));
+		InstancedMesh->SetMobility(EComponentMobility::Movable);
+		InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		InstancedMesh->SetStaticMesh(Mesh);
+		RenderActor->SetRootComponent(InstancedMesh);
+		InstancedMesh->RegisterComponent();
+	}
+}
+
+void UMinionHordeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UCombatSubsystem* CombatSubsystem = Collection.InitializeDependency<UCombatSubsystem>();
+	CombatStepHandle = CombatSubsystem->OnPreStep.AddUObject(this, &UMinionHordeSubsystem::HandleCombatStep);
+}
+
+void UMinionHordeSubsystem::Deinitialize()
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->OnPreStep.Remove(CombatStepHandle);
+	}
+
+	Combatant.Empty();
+	Location.Empty();
+	PreviousLocation.Empty();
+	Velocity.Empty();
+	Yaw.Empty();
+	MoveGoal.Empty();
+	HasMoveGoal.Empty();
+	IgnoresTargets.Empty();
+	MinionOwner.Empty();
+	WantsPromotion.Empty();
+	MoveField.Empty();
+	StepFields.Empty();
+	PreferredVelocity.Empty();
+	Avoidance.Reset();
+	CombatantToEntity.Empty();
+	PromotedPawns.Empty();
+	PromotedOrders.Empty();
+	InstanceTransforms.Empty();
+	RenderActor = nullptr;
+	InstancedMesh = nullptr;
+
+	Super::Deinitialize();
+}
+
+UCombatSubsystem* UMinionHordeSubsystem::GetCombatSubsystem() const
+{
+	return GetWorld()->GetSubsystem<UCombatSubsystem>();
+}
+
+void UMinionHordeSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	NECRO_SCOPE(STAT_MinionHordeTick, Movement);
+	RunDeathProcessor();
+	RunPromotionProcessor();
+	RunRenderProcessor();
+}
+
+void UMinionHordeSubsystem::HandleCombatStep(float StepSeconds)
+{
+	NECRO_SCOPE(STAT_MinionHordeStep, Movement);
+	GatherMoveFields();
+	RunMovementProcessor(StepSeconds);
+	RunAvoidanceProcessor(StepSeconds);
+	RunCombatSyncProcessor();
+	RunPromotedOrderProcessor();
+}
+
+FCombatHandle UMinionHordeSubsystem::SpawnMinion(const FVector& SpawnLocation, const FCombatantDesc& Desc, int32 OwnerId)
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem)
+	{
+		return FCombatHandle();
+	}
+
+	FCombatantDesc MinionDesc = Desc;
+	MinionDesc.Location = SpawnLocation;
+	const FCombatHandle Handle = CombatSubsystem->RegisterCombatant(MinionDesc);
+	AddEntity(Handle, SpawnLocation, 0.f, OwnerId);
+	return Handle;
+}
+
+void UMinionHordeSubsystem::AdoptMinion(FCombatHandle Handle, const FVector& MinionLocation, int32 OwnerId)
+{
+	if (!CombatantToEntity.Contains(Handle))
+	{
+		AddEntity(Handle, MinionLocation, 0.f, OwnerId);
+	}
+}
+
+void UMinionHordeSubsystem::RemoveMinion(FCombatHandle Handle)
+{
+	if (const int32* Index = CombatantToEntity.Find(Handle))
+	{
+		RemoveEntity(*Index);
+		if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+		{
+			CombatSubsystem->UnregisterCombatant(Handle);
+		}
+	}
+}
+
+void UMinionHordeSubsystem::SetMoveGoal(FCombatHandle Handle, const FVector& Goal, bool bAttackMove)
+{
+	if (const int32* Index = CombatantToEntity.Find(Handle))
+	{
+		MoveGoal[*Index] = Goal;
+		HasMoveGoal[*Index] = true;
+		IgnoresTargets[*Index] = !bAttackMove;
+	}
+}
+
+void UMinionHordeSubsystem::ClearMoveGoal(FCombatHandle Handle)
+{
+	if (const int32* Index = CombatantToEntity.Find(Handle))
+	{
+		HasMoveGoal[*Index] = false;
+		IgnoresTargets[*Index] = false;
+	}
+}
+
+int32 UMinionHordeSubsystem::GetMinionOwner(FCombatHandle Handle) const
+{
+	if (const int32* Index = CombatantToEntity.Find(Handle))
+	{
+		return MinionOwner[*Index];
+	}
+	const int32 PawnIndex = FindPromoted(Handle);
+	return PawnIndex != INDEX_NONE ? PromotedOrders[PawnIndex].Owner : INDEX_NONE;
+}
+
+bool UMinionHordeSubsystem::GetMoveGoal(FCombatHandle Handle, FVector& OutGoal) const
+{
+	if (const int32* Index = CombatantToEntity.Find(Handle))
+	{
+		OutGoal = MoveGoal[*Index];
+		return HasMoveGoal[*Index] != 0;
+	}
+	const int32 PawnIndex = FindPromoted(Handle);
+	if (PawnIndex != INDEX_NONE)
+	{
+		OutGoal = PromotedOrders[PawnIndex].MoveGoal;
+		return PromotedOrders[PawnIndex].bHasMoveGoal;
+	}
+	return false;
+}
+
+int32 UMinionHordeSubsystem::FindPromoted(FCombatHandle Handle) const
+{
+	for (int32 PawnIndex = 0; PawnIndex < PromotedPawns.Num(); ++PawnIndex)
+	{
+		const ACombatPawn* Pawn = PromotedPawns[PawnIndex].Get();
+		if (Pawn && Pawn->GetCombatComponent()->GetCombatHandle() == Handle)
+		{
+			return PawnIndex;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void UMinionHordeSubsystem::OrderMove(int32 OwnerId, TConstArrayView<FCombatHandle> Handles, const FVector& Goal, bool bAttackMove)
+{
+	// Promoted pawns are few, so handles that are not rows are looked up among them afterwards
+	TArray<FCombatHandle, TInlineAllocator<16>> NotInHorde;
+	for (const FCombatHandle& Handle : Handles)
+	{
+		const int32* Index = CombatantToEntity.Find(Handle);
+		if (!Index)
+		{
+			if (PromotedPawns.Num() > 0)
+			{
+				NotInHorde.Add(Handle);
+			}
+		}
+		else if (MinionOwner[*Index] == OwnerId)
+		{
+			MoveGoal[*Index] = Goal;
+			HasMoveGoal[*Index] = true;
+			IgnoresTargets[*Index] = !bAttackMove;
+		}
+	}
+	for (const FCombatHandle& Handle : NotInHorde)
+	{
+		const int32 PawnIndex = FindPromoted(Handle);
+		if (PawnIndex != INDEX_NONE && PromotedOrders[PawnIndex].Owner == OwnerId)
+		{
+			FPromotedOrder& Order = PromotedOrders[PawnIndex];
+			Order.MoveGoal = Goal;
+			Order.bHasMoveGoal = true;
+			Order.bIgnoresTargets = !bAttackMove;
+		}
+	}
+
+	// Start building the field now so it is likely ready by the next step
+	if (UFlowFieldSubsystem* FlowFields = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+	{
+		FlowFields->FindOrRequestField(Goal);
+	}
+}
+
+void UMinionHordeSubsystem::OrderMoveAll(int32 OwnerId, const FVector& Goal, bool bAttackMove)
+{
+	for (int32 Index = 0; Index < Combatant.Num(); ++Index)
+	{
+		if (MinionOwner[Index] == OwnerId)
+		{
+			MoveGoal[Index] = Goal;
+			HasMoveGoal[Index] = true;
+			IgnoresTargets[Index] = !bAttackMove;
+		}
+	}
+	for (FPromotedOrder& Order : PromotedOrders)
+	{
+		if (Order.Owner == OwnerId)
+		{
+			Order.MoveGoal = Goal;
+			Order.bHasMoveGoal = true;
+			Order.bIgnoresTargets = !bAttackMove;
+		}
+	}
+
+	if (UFlowFieldSubsystem* FlowFields = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+	{
+		FlowFields->FindOrRequestField(Goal);
+	}
+}
+
+int32 UMinionHordeSubsystem::AddEntity(FCombatHandle Handle, const FVector& EntityLocation, float EntityYaw, int32 EntityOwner)
+{
+	const int32 Index = Combatant.Add(Handle);
+	Location.Add(EntityLocation);
+	PreviousLocation.Add(EntityLocation);
+	Velocity.Add(FVector::ZeroVector);
+	Yaw.Add(EntityYaw);
+	MoveGoal.Add(EntityLocation);
+	HasMoveGoal.Add(false);
+	IgnoresTargets.Add(false);
+	MinionOwner.Add(EntityOwner);
+	WantsPromotion.Add(false);
+	CombatantToEntity.Add(Handle, Index);
+	return Index;
+}
+
+void UMinionHordeSubsystem::RemoveEntity(int32 Index)
+{
+	CombatantToEntity.Remove(Combatant[Index]);
+
+	Combatant.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Location.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PreviousLocation.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Velocity.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Yaw.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	MoveGoal.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	HasMoveGoal.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	IgnoresTargets.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	MinionOwner.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	WantsPromotion.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	// The last minion now lives at Index
+	if (Combatant.IsValidIndex(Index))
+	{
+		CombatantToEntity.Add(Combatant[Index], Index);
+	}
+}
+
+void UMinionHordeSubsystem::WriteSnapshot(FCombatSnapshotWriter& Writer) const
+{
+	TArray<FCombatHandle> SavedCombatant(Combatant);
+	TArray<FVector> SavedLocation(Location);
+	TArray<float> SavedYaw(Yaw);
+	TArray<FVector> SavedMoveGoal(MoveGoal);
+	TArray<uint8> SavedHasMoveGoal(HasMoveGoal);
+	TArray<uint8> SavedIgnoresTargets(IgnoresTargets);
+	TArray<int32> SavedOwner(MinionOwner);
+	for (int32 PawnIndex = 0; PawnIndex < PromotedPawns.Num(); ++PawnIndex)
+	{
+		const ACombatPawn* Pawn = PromotedPawns[PawnIndex].Get();
+		const FCombatHandle Handle = Pawn ? Pawn->GetCombatComponent()->GetCombatHandle() : FCombatHandle();
+		if (Handle.IsValid())
+		{
+			SavedCombatant.Add(Handle);
+			SavedLocation.Add(Pawn->GetActorLocation());
+			SavedYaw.Add(Pawn->GetActorRotation().Yaw);
+			const FPromotedOrder& Order = PromotedOrders[PawnIndex];
+			SavedMoveGoal.Add(Order.bHasMoveGoal ? Order.MoveGoal : Pawn->GetActorLocation());
+			SavedHasMoveGoal.Add(Order.bHasMoveGoal);
+			SavedIgnoresTargets.Add(Order.bIgnoresTargets);
+			SavedOwner.Add(Order.Owner);
+		}
+	}
+
+	Writer.AddSection<FCombatHandle>(ECombatSnapshotSection::HordeCombatant, SavedCombatant);
+	Writer.AddSection<FVector>(ECombatSnapshotSection::HordeLocation, SavedLocation);
+	Writer.AddSection<float>(ECombatSnapshotSection::HordeYaw, SavedYaw);
+	Writer.AddSection<FVector>(ECombatSnapshotSection::HordeMoveGoal, SavedMoveGoal);
+	Writer.AddSection<uint8>(ECombatSnapshotSection::HordeHasMoveGoal, SavedHasMoveGoal);
+	Writer.AddSection<uint8>(ECombatSnapshotSection::HordeIgnoresTargets, SavedIgnoresTargets);
+	Writer.AddSection<int32>(ECombatSnapshotSection::HordeOwner, SavedOwner);
+}
+
+void UMinionHordeSubsystem::ClearForSnapshot()
+{
+	UCombatPawnPoolSubsystem* Pool = GetWorld()->GetSubsystem<UCombatPawnPoolSubsystem>();
+	for (const TWeakObjectPtr<ACombatPawn>& WeakPawn : PromotedPawns)
+	{
+		if (ACombatPawn* Pawn = WeakPawn.Get())
+		{
+			Pawn->GetCombatComponent()->ReleaseCombatant();
+			Pool->ReleasePawn(Pawn);
+		}
+	}
+	PromotedPawns.Reset();
+	PromotedOrders.Reset();
+
+	Combatant.Reset();
+	Location.Reset();
+	PreviousLocation.Reset();
+	Velocity.Reset();
+	Yaw.Reset();
+	MoveGoal.Reset();
+	HasMoveGoal.Reset();
+	IgnoresTargets.Reset();
+	MinionOwner.Reset();
+	WantsPromotion.Reset();
+	MoveField.Reset();
+	PreferredVelocity.Reset();
+	CombatantToEntity.Reset();
+}
+
+bool UMinionHordeSubsystem::CanReadSnapshot(const FCombatSnapshotReader& Reader) const
+{
+	const int32 NumSaved = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::HordeCombatant).Num();
+	return Reader.GetSection<FVector>(ECombatSnapshotSection::HordeLocation).Num() == NumSaved
+		&& Reader.GetSection<float>(ECombatSnapshotSection::HordeYaw).Num() == NumSaved
+		&& Reader.GetSection<FVector>(ECombatSnapshotSection::HordeMoveGoal).Num() == NumSaved
+		&& Reader.GetSection<uint8>(ECombatSnapshotSection::HordeHasMoveGoal).Num() == NumSaved
+		&& Reader.GetSection<uint8>(ECombatSnapshotSection::HordeIgnoresTargets).Num() == NumSaved
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::HordeOwner).Num() == NumSaved;
+}
+
+void UMinionHordeSubsystem::ReadSnapshot(const FCombatSnapshotReader& Reader)
+{
+	const TConstArrayView<FCombatHandle> SavedCombatant = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::HordeCombatant);
+	const TConstArrayView<FVector> SavedLocation = Reader.GetSection<FVector>(ECombatSnapshotSection::HordeLocation);
+	const TConstArrayView<float> SavedYaw = Reader.GetSection<float>(ECombatSnapshotSection::HordeYaw);
+	const TConstArrayView<FVector> SavedMoveGoal = Reader.GetSection<FVector>(ECombatSnapshotSection::HordeMoveGoal);
+	const TConstArrayView<uint8> SavedHasMoveGoal = Reader.GetSection<uint8>(ECombatSnapshotSection::HordeHasMoveGoal);
+	const TConstArrayView<uint8> SavedIgnoresTargets = Reader.GetSection<uint8>(ECombatSnapshotSection::HordeIgnoresTargets);
+	const TConstArrayView<int32> SavedOwner = Reader.GetSection<int32>(ECombatSnapshotSection::HordeOwner);
+	const int32 NumSaved = SavedCombatant.Num();
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem || !CanReadSnapshot(Reader))
+	{
+		return;
+	}
+
+	const FCombatSimulation& Simulation = CombatSubsystem->GetSimulation();
+	CombatantToEntity.Reserve(NumSaved);
+	for (int32 Saved = 0; Saved < NumSaved; ++Saved)
+	{
+		if (Simulation.IsValid(SavedCombatant[Saved]) && !CombatantToEntity.Contains(SavedCombatant[Saved]))
+		{
+			const int32 Index = AddEntity(SavedCombatant[Saved], SavedLocation[Saved], SavedYaw[Saved], SavedOwner[Saved]);
+			MoveGoal[Index] = SavedMoveGoal[Saved];
+			HasMoveGoal[Index] = SavedHasMoveGoal[Saved];
+			IgnoresTargets[Index] = SavedIgnoresTargets[Saved];
+		}
+	}
+}
+
+void UMinionHordeSubsystem::GatherPlayerLocations(TArray<FVector>& OutLocations) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->IsValid() ? (*It)->GetPawn() : nullptr)
+		{
+			OutLocations.Add(PlayerPawn->GetActorLocation());
+		}
+	}
+}
+
+void UMinionHordeSubsystem::GatherMoveFields()
+{
+	StepFields.Reset();
+	MoveField.Reset();
+	MoveField.SetNumZeroed(Combatant.Num());
+
+	UFlowFieldSubsystem* FlowFields = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+	if (!FlowFields || !FlowFields->HasCostGrid())
+	{
+		return;
+	}
+
+	// Minions ordered together are usually adjacent and share a goal cell, so most lookups hit the last key
+	FIntPoint LastKey = FIntPoint::NoneValue;
+	const FFlowField* LastField = nullptr;
+	for (int32 Index = 0; Index < Combatant.Num(); ++Index)
+	{
+		if (!HasMoveGoal[Index])
+		{
+			continue;
+		}
+
+		const FIntPoint Key = FlowFields->GetFieldKey(MoveGoal[Index]);
+		if (Key != LastKey)
+		{
+			const TSharedPtr<const FFlowField>* Field = StepFields.Find(Key);
+			if (!Field)
+			{
+				Field = &StepFields.Add(Key, FlowFields->FindOrRequestField(MoveGoal[Index]));
+			}
+			LastKey = Key;
+			LastField = Field->Get();
+		}
+		MoveField[Index] = LastField;
+	}
+}
+
+void UMinionHordeSubsystem::RunMovementProcessor(float StepSeconds)
+{
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	const int32 NumMinions = Combatant.Num();
+	if (!CombatSubsystem || NumMinions == 0)
+	{
+		return;
+	}
+
+	// Combat state is only read here, and every minion writes its own fragments
+	const FCombatSimulation& Simulation = CombatSubsystem->GetSimulation();
+	const float ArrivalRadiusSq = FMath::Square(MoveArrivalRadius);
+	PreferredVelocity.SetNumUninitialized(NumMinions, EAllowShrinking::No);
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumMinions, MinionHorde::BatchSize);
+	ParallelFor(NumBatches, [this, &Simulation, StepSeconds, NumMinions, ArrivalRadiusSq](int32 BatchIndex)
+	{
+		const int32 Start = BatchIndex * MinionHorde::BatchSize;
+		const int32 End = FMath::Min(Start + MinionHorde::BatchSize, NumMinions);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			PreviousLocation[Index] = Location[Index];
+
+			FVector Goal = MoveGoal[Index];
+			float StopDistance = MinionHorde::AcceptanceRadius;
+			bool bMoving = HasMoveGoal[Index] != 0;
+
+			// Follow the shared field until inside the goal cell, then walk straight to the goal
+			FVector Waypoint;
+			if (bMoving && MoveField[Index] && MoveField[Index]->GetNextWaypoint(Location[Index], Waypoint))
+			{
+				Goal = Waypoint;
+				StopDistance = 0.f;
+			}
+
+			// A plain move walks past enemies until the minion has arrived; an attack move turns to fight them
+			if (IgnoresTargets[Index] && FVector::DistSquared2D(Location[Index], MoveGoal[Index]) < ArrivalRadiusSq)
+			{
+				IgnoresTargets[Index] = false;
+			}
+
+			// A live target overrides the move goal until it is in reach
+			const FCombatHandle TargetHandle = IgnoresTargets[Index] ? FCombatHandle() : Simulation.GetTarget(Combatant[Index]);
+			if (TargetHandle.IsValid() && Simulation.IsAlive(TargetHandle))
+			{
+				Goal = Simulation.GetLocation(TargetHandle);
+				StopDistance = Simulation.GetAttackRange(Combatant[Index]) * 0.9f;
+				bMoving = true;
+			}
+
+			// The step StepTowards would take becomes the preferred velocity for avoidance
+			FVector Next = Location[Index];
+			if (bMoving)
+			{
+				FCombatSimulation::StepTowards(Next, Goal, StopDistance, MoveSpeed, StepSeconds);
+			}
+			PreferredVelocity[Index] = (Next - Location[Index]) / StepSeconds;
+		}
+	});
+}
+
+void UMinionHordeSubsystem::RunAvoidanceProcessor(float StepSeconds)
+{
+	const int32 NumMinions = Combatant.Num();
+	if (NumMinions == 0)
+	{
+		return;
+	}
+
+	// Minions first so agent i is minion i, then pawns as obstacles that do not give way
+	Avoidance.Reset();
+	Avoidance.Reserve(NumMinions + PromotedPawns.Num());
+	for (int32 Index = 0; Index < NumMinions; ++Index)
+	{
+		Avoidance.AddAgent(Location[Index], Velocity[Index], PreferredVelocity[Index], MinionRadius, MoveSpeed);
+	}
+	for (const TWeakObjectPtr<ACombatPawn>& Pawn : PromotedPawns)
+	{
+		if (const ACombatPawn* PromotedPawn = Pawn.Get())
+		{
+			Avoidance.AddAgent(PromotedPawn->GetActorLocation(), PromotedPawn->GetVelocity(), FVector::ZeroVector, PromotedPawn->GetSimpleCollisionRadius(), 0.f);
+		}
+	}
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->IsValid() ? (*It)->GetPawn() : nullptr)
+		{
+			Avoidance.AddAgent(PlayerPawn->GetActorLocation(), PlayerPawn->GetVelocity(), FVector::ZeroVector, PlayerPawn->GetSimpleCollisionRadius(), 0.f);
+		}
+	}
+
+	Avoidance.Solve(StepSeconds);
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumMinions, MinionHorde::BatchSize);
+	ParallelFor(NumBatches, [this, StepSeconds, NumMinions](int32 BatchIndex)
+	{
+		const int32 Start = BatchIndex * MinionHorde::BatchSize;
+		const int32 End = FMath::Min(Start + MinionHorde::BatchSize, NumMinions);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			Velocity[Index] = Avoidance.GetVelocity(Index);
+			FCombatSimulation::MoveBy(Location[Index], Velocity[Index], StepSeconds);
+			if (Velocity[Index].SizeSquared2D() > FMath::Square(MinionHorde::MinTurnSpeed))
+			{
+				Yaw[Index] = FMath::RadiansToDegrees(FMath::Atan2(Velocity[Index].Y, Velocity[Index].X));
+			}
+		}
+	});
+}
+
+void UMinionHordeSubsystem::RunCombatSyncProcessor()
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->GetSimulation().SetLocations(Combatant, Location);
+	}
+}
+
+void UMinionHordeSubsystem::RunPromotedOrderProcessor()
+{
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem || PromotedPawns.Num() == 0)
+	{
+		return;
+	}
+
+	// Promoted pawns follow the same rules as the movement processor, steered through their movement component
+	const FCombatSimulation& Simulation = CombatSubsystem->GetSimulation();
+	UFlowFieldSubsystem* FlowFields = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+	const float ArrivalRadiusSq = FMath::Square(MoveArrivalRadius);
+	for (int32 PawnIndex = 0; PawnIndex < PromotedPawns.Num(); ++PawnIndex)
+	{
+		ACombatPawn* Pawn = PromotedPawns[PawnIndex].Get();
+		if (!Pawn || Pawn->IsInPool() || Pawn->IsPlayerControlled())
+		{
+			continue;
+		}
+
+		FPromotedOrder& Order = PromotedOrders[PawnIndex];
+		const FCombatHandle Handle = Pawn->GetCombatComponent()->GetCombatHandle();
+		const FVector PawnLocation = Pawn->GetActorLocation();
+		FVector Goal = Order.MoveGoal;
+		float StopDistance = MinionHorde::AcceptanceRadius;
+		bool bMoving = Order.bHasMoveGoal;
+
+		FVector Waypoint;
+		if (bMoving && FlowFields)
+		{
+			const TSharedPtr<const FFlowField> Field = FlowFields->FindOrRequestField(Order.MoveGoal);
+			if (Field && Field->GetNextWaypoint(PawnLocation, Waypoint))
+			{
+				Goal = Waypoint;
+				StopDistance = 0.f;
+			}
+		}
+
+		if (Order.bIgnoresTargets && FVector::DistSquared2D(PawnLocation, Order.MoveGoal) < ArrivalRadiusSq)
+		{
+			Order.bIgnoresTargets = false;
+		}
+
+		const FCombatHandle TargetHandle = Order.bIgnoresTargets ? FCombatHandle() : Simulation.GetTarget(Handle);
+		if (TargetHandle.IsValid() && Simulation.IsAlive(TargetHandle))
+		{
+			Goal = Simulation.GetLocation(TargetHandle);
+			StopDistance = Simulation.GetAttackRange(Handle) * 0.9f;
+			bMoving = true;
+		}
+
+		// A direct move request stands until it is replaced, so an idle pawn has to be stopped explicitly
+		UCombatPawnMovementComponent* Movement = Pawn->GetCombatPawnMovement();
+		const FVector ToGoal = (Goal - PawnLocation).GetSafeNormal2D();
+		if (bMoving && FVector::DistSquared2D(PawnLocation, Goal) > FMath::Square(FMath::Max(StopDistance, 1.f)))
+		{
+			Movement->RequestDirectMove(ToGoal * Movement->MaxSpeed, false);
+		}
+		else
+		{
+			Movement->StopActiveMovement();
+		}
+	}
+}
+
+void UMinionHordeSubsystem::RunDeathProcessor()
+{
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem)
+	{
+		return;
+	}
+
+	// Dead minions leave the horde and a corpse. Walk backwards so swaps only move already visited entries.
+	UCorpseSubsystem* Corpses = GetWorld()->GetSubsystem<UCorpseSubsystem>();
+	for (int32 Index = Combatant.Num() - 1; Index >= 0; --Index)
+	{
+		if (!CombatSubsystem->GetSimulation().IsAlive(Combatant[Index]))
+		{
+			const FCombatHandle Handle = Combatant[Index];
+			const FVector CorpseLocation = Location[Index];
+			const float CorpseYaw = Yaw[Index];
+			RemoveEntity(Index);
+			if (Corpses)
+			{
+				Corpses->AddCorpse(Handle, CorpseLocation, CorpseYaw, MinionCorpseType);
+			}
+			else
+			{
+				CombatSubsystem->UnregisterCombatant(Handle);
+			}
+		}
+	}
+}
+
+void UMinionHordeSubsystem::RunPromotionProcessor()
+{
+	TArray<FVector> PlayerLocations;
+	GatherPlayerLocations(PlayerLocations);
+
+	// Demote pawns that drifted away, unless a player is controlling them
+	const float DemotionRadiusSq = FMath::Square(DemotionRadius);
+	for (int32 PawnIndex = PromotedPawns.Num() - 1; PawnIndex >= 0; --PawnIndex)
+	{
+		// Pawns that died went back to the pool and left a corpse
+		ACombatPawn* Pawn = PromotedPawns[PawnIndex].Get();
+		if (!Pawn || Pawn->IsInPool())
+		{
+			PromotedPawns.RemoveAtSwap(PawnIndex);
+			PromotedOrders.RemoveAtSwap(PawnIndex);
+			continue;
+		}
+		if (Pawn->IsPlayerControlled())
+		{
+			continue;
+		}
+
+		const FVector PawnLocation = Pawn->GetActorLocation();
+		const bool bFar = !PlayerLocations.ContainsByPredicate([&PawnLocation, DemotionRadiusSq](const FVector& PlayerLocation)
+		{
+			return FVector::DistSquared2D(PawnLocation, PlayerLocation) < DemotionRadiusSq;
+		});
+		if (bFar)
+		{
+			DemoteMinion(Pawn);
+		}
+	}
+
+	const int32 NumMinions = Combatant.Num();
+	if (PlayerLocations.Num() == 0 || NumMinions == 0)
+	{
+		return;
+	}
+
+	const float PromotionRadiusSq = FMath::Square(PromotionRadius);
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumMinions, MinionHorde::BatchSize);
+	ParallelFor(NumBatches, [this, &PlayerLocations, PromotionRadiusSq, NumMinions](int32 BatchIndex)
+	{
+		const int32 Start = BatchIndex * MinionHorde::BatchSize;
+		const int32 End = FMath::Min(Start + MinionHorde::BatchSize, NumMinions);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			WantsPromotion[Index] = false;
+			for (const FVector& PlayerLocation : PlayerLocations)
+			{
+				if (FVector::DistSquared2D(Location[Index], PlayerLocation) < PromotionRadiusSq)
+				{
+					WantsPromotion[Index] = true;
+					break;
+				}
+			}
+		}
+	});
+
+	// Spawning is game thread only. Collect handles first since promotion reorders the fragments.
+	TArray<FCombatHandle, TInlineAllocator<16>> ToPromote;
+	for (int32 Index = 0; Index < NumMinions && ToPromote.Num() < MaxPromotionsPerFrame; ++Index)
+	{
+		if (WantsPromotion[Index])
+		{
+			ToPromote.Add(Combatant[Index]);
+		}
+	}
+	for (const FCombatHandle& Handle : ToPromote)
+	{
+		PromoteMinion(Handle);
+	}
+}
+
+void UMinionHordeSubsystem::RunRenderProcessor()
+{
+	if (!InstancedMesh)
+	{
+		return;
+	}
+
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	const float Alpha = CombatSubsystem ? CombatSubsystem->GetInterpolationAlpha() : 1.f;
+
+	// Draw between the last two fixed steps so motion stays smooth at any frame rate
+	const int32 NumMinions = Combatant.Num();
+	InstanceTransforms.SetNumUninitialized(NumMinions, EAllowShrinking::No);
+	ParallelFor(FMath::DivideAndRoundUp(NumMinions, MinionHorde::BatchSize), [this, NumMinions, Alpha](int32 BatchIndex)
+	{
+		const int32 Start = BatchIndex * MinionHorde::BatchSize;
+		const int32 End = FMath::Min(Start + MinionHorde::BatchSize, NumMinions);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			InstanceTransforms[Index] = FTransform(FRotator(0.f, Yaw[Index], 0.f), FMath::Lerp(PreviousLocation[Index], Location[Index], Alpha));
+		}
+	});
+
+	// Instance i always draws minion i, so only the tail has to be added or removed
+	const int32 NumInstances = InstancedMesh->GetInstanceCount();
+	if (NumInstances > NumMinions)
+	{
+		TArray<int32> ToRemove;
+		for (int32 Index = NumInstances - 1; Index >= NumMinions; --Index)
+		{
+			ToRemove.Add(Index);
+		}
+		InstancedMesh->RemoveInstances(ToRemove, true);
+	}
+	else if (NumInstances < NumMinions)
+	{
+		TArray<FTransform> NewInstances(InstanceTransforms.GetData() + NumInstances, NumMinions - NumInstances);
+		InstancedMesh->AddInstances(NewInstances, false, true);
+	}
+
+	if (NumMinions > 0)
+	{
+		InstancedMesh->BatchUpdateInstancesTransforms(0, InstanceTransforms, true, true, false);
+	}
+}
+
+ACombatPawn* UMinionHordeSubsystem::PromoteMinion(FCombatHandle Handle)
+{
+	const int32* IndexPtr = CombatantToEntity.Find(Handle);
+	if (!IndexPtr || !LoadedPawnClass)
+	{
+		return nullptr;
+	}
+
+	const int32 Index = *IndexPtr;
+	const FTransform SpawnTransform(FRotator(0.f, Yaw[Index], 0.f), Location[Index]);
+
+	// The pawn takes over the combatant, so health, cooldowns and target carry over
+	ACombatPawn* Pawn = GetWorld()->GetSubsystem<UCombatPawnPoolSubsystem>()->AcquirePawn(LoadedPawnClass, SpawnTransform, Handle);
+	if (!Pawn)
+	{
+		return nullptr;
+	}
+
+	FPromotedOrder& Order = PromotedOrders.AddDefaulted_GetRef();
+	Order.Owner = MinionOwner[Index];
+	Order.MoveGoal = MoveGoal[Index];
+	Order.bHasMoveGoal = HasMoveGoal[Index] != 0;
+	Order.bIgnoresTargets = IgnoresTargets[Index] != 0;
+	PromotedPawns.Add(Pawn);
+	RemoveEntity(Index);
+	return Pawn;
+}
+
+void UMinionHordeSubsystem::DemoteMinion(ACombatPawn* Pawn)
+{
+	if (!Pawn)
+	{
+		return;
+	}
+
+	const int32 PawnIndex = PromotedPawns.Find(Pawn);
+	const FPromotedOrder Order = PawnIndex != INDEX_NONE ? PromotedOrders[PawnIndex] : FPromotedOrder();
+	if (PawnIndex != INDEX_NONE)
+	{
+		PromotedPawns.RemoveAtSwap(PawnIndex);
+		PromotedOrders.RemoveAtSwap(PawnIndex);
+	}
+	Pawn->GetCombatPawnMovement()->StopActiveMovement();
+
+	// The minion carries on with the order it had as a pawn
+	const FCombatHandle Handle = Pawn->GetCombatComponent()->ReleaseCombatant();
+	if (Handle.IsValid())
+	{
+		const int32 Index = AddEntity(Handle, Pawn->GetActorLocation(), Pawn->GetActorRotation().Yaw, Order.Owner);
+		MoveGoal[Index] = Order.bHasMoveGoal ? Order.MoveGoal : Location[Index];
+		HasMoveGoal[Index] = Order.bHasMoveGoal;
+		IgnoresTargets[Index] = Order.bIgnoresTargets;
+	}
+	GetWorld()->GetSubsystem<UCombatPawnPoolSubsystem>()->ReleasePawn(Pawn);
+}
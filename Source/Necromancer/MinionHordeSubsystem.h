@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "CrowdAvoidance.h"
+#include "FlowField.h"
+#include "MinionHordeSubsystem.generated.h"
+
+class ACombatPawn;
+class FCombatSnapshotReader;
+class FCombatSnapshotWriter;
+class UCombatSubsystem;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/**
+ * Simulates raised minions without an actor each. Every minion is a row in a set of fragment arrays,
+ * updated by a fixed sequence of batched processors and drawn through one instanced static mesh.
+ * Movement runs on the combat subsystem's fixed step and is steered around other minions and pawns by FCrowdAvoidance;
+ * rendering interpolates between the last two steps.
+ * Minions close to a player are promoted to a full ACombatPawn and demoted again once they are far away. A promoted
+ * pawn keeps its minion's move order and follows the same flow fields through its movement component.
+ * A minion is identified by its combat handle, which it keeps across promotion and demotion.
+ * Every minion has an owner, the id of the player whose orders it takes, or INDEX_NONE for none.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UMinionHordeSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Adds a minion to the horde and registers it as a combatant. */
+	FCombatHandle SpawnMinion(const FVector& SpawnLocation, const FCombatantDesc& Desc, int32 OwnerId = INDEX_NONE);
+
+	/** Adds an existing live combatant to the horde, e.g. one raised from a corpse. */
+	void AdoptMinion(FCombatHandle Handle, const FVector& MinionLocation, int32 OwnerId = INDEX_NONE);
+
+	/** Removes a minion from the horde and unregisters its combatant. */
+	void RemoveMinion(FCombatHandle Handle);
+
+	/** Without bAttackMove the minion ignores its target until it reaches Goal, instead of stopping to fight */
+	void SetMoveGoal(FCombatHandle Handle, const FVector& Goal, bool bAttackMove = true);
+	void ClearMoveGoal(FCombatHandle Handle);
+
+	/**
+	 * Sends the minions of OwnerId among Handles to Goal together, promoted ones included, skipping every other handle.
+	 * They follow one shared flow field instead of pathing individually.
+	 */
+	void OrderMove(int32 OwnerId, TConstArrayView<FCombatHandle> Handles, const FVector& Goal, bool bAttackMove = true);
+
+	/** Sends every minion of OwnerId to Goal */
+	void OrderMoveAll(int32 OwnerId, const FVector& Goal, bool bAttackMove = true);
+
+	bool IsHordeMinion(FCombatHandle Handle) const { return CombatantToEntity.Contains(Handle); }
+
+	/** Owner of a minion in the horde or promoted, or INDEX_NONE if it has none or is neither */
+	int32 GetMinionOwner(FCombatHandle Handle) const;
+
+	/** Goal of a minion in the horde or promoted. False if it has no move goal or is neither. */
+	bool GetMoveGoal(FCombatHandle Handle, FVector& OutGoal) const;
+	int32 GetNumMinions() const { return Combatant.Num(); }
+	int32 GetNumPromoted() const { return PromotedPawns.Num(); }
+
+	/** Replaces a horde minion by a full ACombatPawn, e.g. so that it can be possessed. */
+	ACombatPawn* PromoteMinion(FCombatHandle Handle);
+
+	/** Hands a promoted pawn's combat state back to the horde and returns the pawn to the pool. */
+	void DemoteMinion(ACombatPawn* Pawn);
+
+	/** Copies every minion into Writer. Promoted pawns are saved as the minions they stand for. */
+	void WriteSnapshot(FCombatSnapshotWriter& Writer) const;
+
+	/** Returns promoted pawns to the pool and empties the horde, leaving the combatants to the caller */
+	void ClearForSnapshot();
+
+	/** True if the horde sections of Reader fit together, so that ReadSnapshot would take them */
+	bool CanReadSnapshot(const FCombatSnapshotReader& Reader) const;
+
+	/** Refills the emptied horde from Reader, on a simulation already restored from the same snapshot */
+	void ReadSnapshot(const FCombatSnapshotReader& Reader);
+
+	/** Mesh drawn for every minion still in the horde */
+	UPROPERTY(Config)
+	TSoftObjectPtr<UStaticMesh> MinionMesh;
+
+	/** Pawn spawned when a minion needs full actor behavior */
+	UPROPERTY(Config)
+	TSoftClassPtr<ACombatPawn> PromotedPawnClass;
+
+	/** Minions closer than this to a player pawn are promoted */
+	UPROPERTY(Config)
+	float PromotionRadius = 1500.f;
+
+	/** Promoted pawns further than this from every player pawn are demoted. Keep above PromotionRadius. */
+	UPROPERTY(Config)
+	float DemotionRadius = 2000.f;
+
+	UPROPERTY(Config)
+	float MoveSpeed = 300.f;
+
+	/** Footprint of a minion for crowd avoidance */
+	UPROPERTY(Config)
+	float MinionRadius = 40.f;
+
+	/** Corpse type left by minions that die in the horde */
+	UPROPERTY(Config)
+	FName MinionCorpseType;
+
+	/** Caps actor spawns caused by promotion in a single frame */
+	UPROPERTY(Config)
+	int32 MaxPromotionsPerFrame = 8;
+
+	/** A minion on a plain move order fights again once this close to its goal, so a crowd need not all reach it */
+	UPROPERTY(Config)
+	float MoveArrivalRadius = 400.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	int32 AddEntity(FCombatHandle Handle, const FVector& EntityLocation, float EntityYaw, int32 EntityOwner);
+
+	/** Index into PromotedPawns of the pawn promoted for Handle, or INDEX_NONE */
+	int32 FindPromoted(FCombatHandle Handle) const;
+	void RemoveEntity(int32 Index);
+	void GatherPlayerLocations(TArray<FVector>& OutLocations) const;
+
+	/** Fixed step processors, run before every combat step */
+	void HandleCombatStep(float StepSeconds);
+	void GatherMoveFields();
+	void RunMovementProcessor(float StepSeconds);
+	void RunAvoidanceProcessor(float StepSeconds);
+	void RunCombatSyncProcessor();
+	void RunPromotedOrderProcessor();
+
+	/** Frame processors, run in this order every frame */
+	void RunDeathProcessor();
+	void RunPromotionProcessor();
+	void RunRenderProcessor();
+
+	UCombatSubsystem* GetCombatSubsystem() const;
+
+	/** Fragments, one entry per minion in the horde */
+	TArray<FCombatHandle> Combatant;
+	TArray<FVector> Location;
+	TArray<FVector> PreviousLocation;
+	TArray<FVector> Velocity;
+	TArray<float> Yaw;
+	TArray<FVector> MoveGoal;
+	TArray<uint8> HasMoveGoal;
+	TArray<uint8> IgnoresTargets;
+	TArray<int32> MinionOwner;
+	TArray<uint8> WantsPromotion;
+
+	/** Flow field each minion follows this step, or null to walk straight. Rebuilt by GatherMoveFields. */
+	TArray<const FFlowField*> MoveField;
+	TMap<FIntPoint, TSharedPtr<const FFlowField>> StepFields;
+
+	/** Velocity each minion would take without others around. Written by the movement processor. */
+	TArray<FVector> PreferredVelocity;
+	FCrowdAvoidance Avoidance;
+
+	TMap<FCombatHandle, int32> CombatantToEntity;
+	TArray<TWeakObjectPtr<ACombatPawn>> PromotedPawns;
+
+	/** Owner and move order a minion keeps while it is a promoted pawn */
+	struct FPromotedOrder
+	{
+		int32 Owner = INDEX_NONE;
+		FVector MoveGoal = FVector::ZeroVector;
+		bool bHasMoveGoal = false;
+		bool bIgnoresTargets = false;
+	};
+
+	/** Order of each promoted pawn, followed by the pawn while it is promoted and handed back when it is demoted */
+	TArray<FPromotedOrder> PromotedOrders;
+
+	UPROPERTY(Transient)
+	TSubclassOf<ACombatPawn> LoadedPawnClass;
+
+	UPROPERTY(Transient)
+	TObjectPtr<AActor> RenderActor;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UInstancedStaticMeshComponent> InstancedMesh;
+
+	TArray<FTransform> InstanceTransforms;
+
+	FDelegateHandle CombatStepHandle;
+};
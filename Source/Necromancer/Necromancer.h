@@ -1,5 +1,8 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogNecromancer, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("Necromancer"), STATGROUP_Necromancer, STATCAT_Advanced);
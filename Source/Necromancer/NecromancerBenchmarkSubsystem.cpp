@@ -0,0 +1,445 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NecromancerBenchmarkSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatPawn.h"
+#include "CombatPawnPoolSubsystem.h"
+#include "CombatSubsystem.h"
+#include "MinionHordeSubsystem.h"
+#include "NecromancerPlayerController.h"
+#include "UnitRegistrySubsystem.h"
+#include "Necromancer.h"
+#include "Dom/JsonObject.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace NecroBenchmark
+{
+	// Spacing of the spawn formations
+	constexpr float Spacing = 150.f;
+
+	// Distance from the map center to the living block in MassCombat, and radius of the scripted click circuit
+	constexpr float EngageDistance = 2500.f;
+	constexpr float OrderRadius = 1500.f;
+
+	constexpr double BytesPerMB = 1024.0 * 1024.0;
+
+	double Percentile(const TArray<float>& Sorted, int32 Percent)
+	{
+		return Sorted.Num() > 0 ? Sorted[FMath::Min(Sorted.Num() * Percent / 100, Sorted.Num() - 1)] : 0.0;
+	}
+
+	FVector FormationOffset(int32 Index, int32 Count)
+	{
+		const int32 Side = FMath::Max(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(Count))), 1);
+		return FVector((Index % Side - Side / 2) * Spacing, (Index / Side - Side / 2) * Spacing, 0.f);
+	}
+}
+
+void UNecromancerBenchmarkSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(WorldPostActorTickHandle);
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGCHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGCHandle);
+
+	Super::Deinitialize();
+}
+
+bool UNecromancerBenchmarkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UNecromancerBenchmarkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UNecromancerBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+void UNecromancerBenchmarkSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	FString Filter;
+	if (FParse::Value(FCommandLine::Get(), TEXT("NecroBenchmark="), Filter))
+	{
+		OnlyScenario = FName(*Filter);
+	}
+	else if (!FParse::Param(FCommandLine::Get(), TEXT("NecroBenchmark")))
+	{
+		return;
+	}
+
+	WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UNecromancerBenchmarkSubsystem::HandleWorldTickStart);
+	WorldPostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UNecromancerBenchmarkSubsystem::HandleWorldPostActorTick);
+	PreGCHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &UNecromancerBenchmarkSubsystem::HandlePreGarbageCollect);
+	PostGCHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &UNecromancerBenchmarkSubsystem::HandlePostGarbageCollect);
+
+	UE_LOG(LogNecromancer, Display, TEXT("Benchmark: %d scenarios configured in %s"), Scenarios.Num(), *InWorld.GetMapName());
+
+	// The first scenario starts on the next tick, once every actor has begun play
+	Phase = EPhase::Idle;
+	ScenarioIndex = INDEX_NONE;
+	bRunning = true;
+}
+
+void UNecromancerBenchmarkSubsystem::HandleWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld())
+	{
+		// Wall time from one world tick to the next, which DeltaTime is not under a fixed frame rate
+		const uint64 NowCycles = FPlatformTime::Cycles64();
+		if (Phase == EPhase::Measure && WorldTickStartCycles != 0)
+		{
+			FrameMs.Add(FPlatformTime::ToMilliseconds64(NowCycles - WorldTickStartCycles));
+		}
+		WorldTickStartCycles = NowCycles;
+	}
+}
+
+void UNecromancerBenchmarkSubsystem::HandleWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	if (InWorld == GetWorld() && Phase == EPhase::Measure && WorldTickStartCycles != 0)
+	{
+		GameThreadMs.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - WorldTickStartCycles));
+	}
+}
+
+void UNecromancerBenchmarkSubsystem::HandlePreGarbageCollect()
+{
+	GCStartSeconds = FPlatformTime::Seconds();
+}
+
+void UNecromancerBenchmarkSubsystem::HandlePostGarbageCollect()
+{
+	GCSeconds += FPlatformTime::Seconds() - GCStartSeconds;
+}
+
+void UNecromancerBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!bRunning)
+	{
+		return;
+	}
+
+	switch (Phase)
+	{
+	case EPhase::Idle:
+		if (StartupSeconds < 0.0)
+		{
+			// Startup ends once the map's units are resident, which is what the first scenario spawns from
+			const UUnitRegistrySubsystem* Registry = GetWorld()->GetGameInstance() ? GetWorld()->GetGameInstance()->GetSubsystem<UUnitRegistrySubsystem>() : nullptr;
+			if (Registry && Registry->HasPendingLoads())
+			{
+				break;
+			}
+			StartupSeconds = FPlatformTime::Seconds() - GStartTime;
+			StartupMemoryMB = FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0);
+			UE_LOG(LogNecromancer, Display, TEXT("Benchmark startup: %.2f s to loaded units, %.1f MB resident"), StartupSeconds, StartupMemoryMB);
+		}
+		BeginScenario();
+		break;
+
+	case EPhase::Warmup:
+	case EPhase::Measure:
+	{
+		const FNecroBenchmarkScenarioDesc& Scenario = Scenarios[ScenarioIndex];
+		TimeUntilOrder -= DeltaTime;
+		if (TimeUntilOrder <= 0.f && Scenario.Type != ENecroBenchmarkScenario::Spawn)
+		{
+			TimeUntilOrder = Scenario.OrderInterval;
+			IssueScriptedOrder(Scenario);
+		}
+
+		if (Phase == EPhase::Measure)
+		{
+			MemoryHighWater = FMath::Max<uint64>(MemoryHighWater, FPlatformMemory::GetStats().UsedPhysical);
+		}
+
+		if (--FramesLeft <= 0)
+		{
+			if (Phase == EPhase::Warmup)
+			{
+				Phase = EPhase::Measure;
+				FramesLeft = FMath::Max(Scenario.Frames, 1);
+				GameThreadMs.Reset();
+				FrameMs.Reset();
+				GCSeconds = 0.0;
+			}
+			else
+			{
+				EndScenario();
+			}
+		}
+		break;
+	}
+
+	case EPhase::Done:
+		break;
+	}
+}
+
+void UNecromancerBenchmarkSubsystem::BeginScenario()
+{
+	do
+	{
+		++ScenarioIndex;
+	}
+	while (Scenarios.IsValidIndex(ScenarioIndex) && !OnlyScenario.IsNone() && Scenarios[ScenarioIndex].Name != OnlyScenario);
+
+	if (!Scenarios.IsValidIndex(ScenarioIndex))
+	{
+		Finish();
+		return;
+	}
+
+	const FNecroBenchmarkScenarioDesc& Scenario = Scenarios[ScenarioIndex];
+	UE_LOG(LogNecromancer, Display, TEXT("Benchmark: starting %s (%d pawns, %d minions)"), *Scenario.Name.ToString(), Scenario.NumPawns, Scenario.NumMinions);
+
+	Current = FNecroBenchmarkResult();
+	Current.Name = Scenario.Name;
+	MemoryHighWater = FPlatformMemory::GetStats().UsedPhysical;
+
+	const double SetupStart = FPlatformTime::Seconds();
+	SpawnScenario(Scenario);
+	Current.SetupMs = (FPlatformTime::Seconds() - SetupStart) * 1000.0;
+	MemoryHighWater = FMath::Max<uint64>(MemoryHighWater, FPlatformMemory::GetStats().UsedPhysical);
+
+	Phase = EPhase::Warmup;
+	FramesLeft = FMath::Max(Scenario.WarmupFrames, 1);
+	TimeUntilOrder = 0.f;
+	OrderCount = 0;
+}
+
+void UNecromancerBenchmarkSubsystem::SpawnScenario(const FNecroBenchmarkScenarioDesc& Scenario)
+{
+	UWorld* World = GetWorld();
+	UCombatSubsystem* Combat = World->GetSubsystem<UCombatSubsystem>();
+	UCombatPawnPoolSubsystem* Pool = World->GetSubsystem<UCombatPawnPoolSubsystem>();
+	UMinionHordeSubsystem* Horde = World->GetSubsystem<UMinionHordeSubsystem>();
+
+	const APlayerController* PlayerController = World->GetFirstPlayerController();
+	Center = PlayerController && PlayerController->GetPawn() ? PlayerController->GetPawn()->GetActorLocation() : FVector::ZeroVector;
+
+	// Living pawns wait in a block across the map from the horde; otherwise the pawns stand with it
+	const bool bMassCombat = Scenario.Type == ENecroBenchmarkScenario::MassCombat;
+	const ECombatTeam PawnTeam = bMassCombat ? ECombatTeam::Living : ECombatTeam::Undead;
+	const FVector PawnCenter = Center + FVector(bMassCombat ? NecroBenchmark::EngageDistance : 0.f, 0.f, 0.f);
+
+	if (Combat && Pool)
+	{
+		for (int32 Index = 0; Index < Scenario.NumPawns; ++Index)
+		{
+			FCombatantDesc Desc;
+			Desc.Team = PawnTeam;
+			Desc.Location = PawnCenter + NecroBenchmark::FormationOffset(Index, Scenario.NumPawns);
+			const FCombatHandle Handle = Combat->RegisterCombatant(Desc);
+
+			ACombatPawn* Pawn = Pool->AcquirePawn(ACombatPawn::StaticClass(), FTransform(Desc.Location), Handle);
+			if (!Pawn)
+			{
+				Combat->UnregisterCombatant(Handle);
+				continue;
+			}
+			Pawn->GetCombatComponent()->Team = PawnTeam;
+			SpawnedPawns.Add(Pawn);
+		}
+	}
+
+	if (Horde)
+	{
+		// The minions belong to the player, whose scripted orders only move its own
+		const ANecromancerPlayerController* NecroController = Cast<ANecromancerPlayerController>(PlayerController);
+		const int32 OwnerId = NecroController ? NecroController->GetHordeOwnerId() : INDEX_NONE;
+		const FVector MinionCenter = Center - FVector(Scenario.NumMinions > 0 ? NecroBenchmark::Spacing * 4.f : 0.f, 0.f, 0.f);
+		for (int32 Index = 0; Index < Scenario.NumMinions; ++Index)
+		{
+			FCombatantDesc Desc;
+			Desc.Team = ECombatTeam::Undead;
+			SpawnedMinions.Add(Horde->SpawnMinion(MinionCenter + NecroBenchmark::FormationOffset(Index, Scenario.NumMinions), Desc, OwnerId));
+		}
+	}
+}
+
+void UNecromancerBenchmarkSubsystem::IssueScriptedOrder(const FNecroBenchmarkScenarioDesc& Scenario)
+{
+	FVector Target = Center + FVector(NecroBenchmark::EngageDistance, 0.f, 0.f);
+	EPlayerCommandType Type = EPlayerCommandType::AttackMove;
+	if (Scenario.Type == ENecroBenchmarkScenario::ClickToMove)
+	{
+		// A circuit of clicks around the map center
+		Target = Center + FRotator(0.f, OrderCount * 90.f, 0.f).RotateVector(FVector(NecroBenchmark::OrderRadius, 0.f, 0.f));
+		Type = EPlayerCommandType::Move;
+	}
+	++OrderCount;
+
+	if (ANecromancerPlayerController* PlayerController = Cast<ANecromancerPlayerController>(GetWorld()->GetFirstPlayerController()))
+	{
+		PlayerController->IssueCommand(Type, Target);
+	}
+	else if (UMinionHordeSubsystem* Horde = GetWorld()->GetSubsystem<UMinionHordeSubsystem>())
+	{
+		Horde->OrderMoveAll(INDEX_NONE, Target, Type == EPlayerCommandType::AttackMove);
+	}
+}
+
+void UNecromancerBenchmarkSubsystem::EndScenario()
+{
+	const FNecroBenchmarkScenarioDesc& Scenario = Scenarios[ScenarioIndex];
+
+	GameThreadMs.Sort();
+	FrameMs.Sort();
+	Current.Frames = GameThreadMs.Num();
+	Current.GameThreadP50Ms = NecroBenchmark::Percentile(GameThreadMs, 50);
+	Current.GameThreadP95Ms = NecroBenchmark::Percentile(GameThreadMs, 95);
+	Current.GameThreadP99Ms = NecroBenchmark::Percentile(GameThreadMs, 99);
+	Current.GameThreadMaxMs = GameThreadMs.Num() > 0 ? GameThreadMs.Last() : 0.0;
+	Current.FrameP50Ms = NecroBenchmark::Percentile(FrameMs, 50);
+	Current.FrameP95Ms = NecroBenchmark::Percentile(FrameMs, 95);
+	Current.MemoryHighWaterMB = MemoryHighWater / NecroBenchmark::BytesPerMB;
+
+	// Tear down, then collect what the scenario left behind; GC time covers the measured frames and this collection
+	UWorld* World = GetWorld();
+	if (UCombatPawnPoolSubsystem* Pool = World->GetSubsystem<UCombatPawnPoolSubsystem>())
+	{
+		for (const TWeakObjectPtr<ACombatPawn>& Pawn : SpawnedPawns)
+		{
+			if (Pawn.IsValid() && !Pawn->IsInPool())
+			{
+				Pool->ReleasePawn(Pawn.Get());
+			}
+		}
+	}
+	if (UMinionHordeSubsystem* Horde = World->GetSubsystem<UMinionHordeSubsystem>())
+	{
+		for (const FCombatHandle& Handle : SpawnedMinions)
+		{
+			if (Horde->IsHordeMinion(Handle))
+			{
+				Horde->RemoveMinion(Handle);
+			}
+		}
+	}
+	SpawnedPawns.Reset();
+	SpawnedMinions.Reset();
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	Current.GCMs = GCSeconds * 1000.0;
+
+	auto Check = [this](const TCHAR* Metric, double Value, float Limit)
+	{
+		if (Limit > 0.f && Value > Limit)
+		{
+			Current.Failures.Add(FString::Printf(TEXT("%s %.2f over %.2f"), Metric, Value, Limit));
+		}
+	};
+	Check(TEXT("GameThreadP95Ms"), Current.GameThreadP95Ms, Scenario.MaxGameThreadP95Ms);
+	Check(TEXT("GameThreadP99Ms"), Current.GameThreadP99Ms, Scenario.MaxGameThreadP99Ms);
+	Check(TEXT("MemoryHighWaterMB"), Current.MemoryHighWaterMB, Scenario.MaxMemoryMB);
+	Check(TEXT("GCMs"), Current.GCMs, Scenario.MaxGCMs);
+
+	UE_LOG(LogNecromancer, Display, TEXT("Benchmark: %s game thread p50 %.2f p95 %.2f p99 %.2f max %.2f ms, frame p50 %.2f ms, memory %.0f MB, GC %.2f ms, setup %.1f ms"),
+		*Current.Name.ToString(), Current.GameThreadP50Ms, Current.GameThreadP95Ms, Current.GameThreadP99Ms, Current.GameThreadMaxMs,
+		Current.FrameP50Ms, Current.MemoryHighWaterMB, Current.GCMs, Current.SetupMs);
+	for (const FString& Failure : Current.Failures)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("Benchmark: %s failed: %s"), *Current.Name.ToString(), *Failure);
+	}
+
+	Results.Add(MoveTemp(Current));
+	Phase = EPhase::Idle;
+}
+
+void UNecromancerBenchmarkSubsystem::Finish()
+{
+	Phase = EPhase::Done;
+	bRunning = false;
+	WriteResults();
+
+	int32 NumFailed = 0;
+	for (const FNecroBenchmarkResult& Result : Results)
+	{
+		NumFailed += Result.Failures.Num() > 0 ? 1 : 0;
+	}
+	if (Results.Num() == 0)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("Benchmark: no scenario matched"));
+		NumFailed = 1;
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("Benchmark: %d of %d scenarios passed"), Results.Num() - FMath::Min(NumFailed, Results.Num()), Results.Num());
+	FPlatformMisc::RequestExitWithStatus(false, NumFailed > 0 ? 1 : 0);
+}
+
+void UNecromancerBenchmarkSubsystem::WriteResults() const
+{
+	FString OutputDir;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("NecroBenchmarkOut="), OutputDir))
+	{
+		OutputDir = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+	}
+	const FString BaseName = OutputDir / FString::Printf(TEXT("NecroBenchmark-%s"), *FDateTime::Now().ToString());
+
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetStringField(TEXT("Map"), GetWorld()->GetMapName());
+	Root->SetStringField(TEXT("Configuration"), LexToString(FApp::GetBuildConfiguration()));
+	Root->SetStringField(TEXT("Platform"), FPlatformProperties::IniPlatformName());
+	Root->SetNumberField(TEXT("StartupSeconds"), StartupSeconds);
+	Root->SetNumberField(TEXT("StartupMemoryMB"), StartupMemoryMB);
+
+	TArray<TSharedPtr<FJsonValue>> ScenarioValues;
+	FString Csv = TEXT("Scenario,Frames,SetupMs,GameThreadP50Ms,GameThreadP95Ms,GameThreadP99Ms,GameThreadMaxMs,FrameP50Ms,FrameP95Ms,MemoryHighWaterMB,GCMs,Passed\n");
+	for (const FNecroBenchmarkResult& Result : Results)
+	{
+		TSharedRef<FJsonObject> Scenario = MakeShared<FJsonObject>();
+		Scenario->SetStringField(TEXT("Name"), Result.Name.ToString());
+		Scenario->SetNumberField(TEXT("Frames"), Result.Frames);
+		Scenario->SetNumberField(TEXT("SetupMs"), Result.SetupMs);
+		Scenario->SetNumberField(TEXT("GameThreadP50Ms"), Result.GameThreadP50Ms);
+		Scenario->SetNumberField(TEXT("GameThreadP95Ms"), Result.GameThreadP95Ms);
+		Scenario->SetNumberField(TEXT("GameThreadP99Ms"), Result.GameThreadP99Ms);
+		Scenario->SetNumberField(TEXT("GameThreadMaxMs"), Result.GameThreadMaxMs);
+		Scenario->SetNumberField(TEXT("FrameP50Ms"), Result.FrameP50Ms);
+		Scenario->SetNumberField(TEXT("FrameP95Ms"), Result.FrameP95Ms);
+		Scenario->SetNumberField(TEXT("MemoryHighWaterMB"), Result.MemoryHighWaterMB);
+		Scenario->SetNumberField(TEXT("GCMs"), Result.GCMs);
+		Scenario->SetBoolField(TEXT("Passed"), Result.Failures.Num() == 0);
+
+		TArray<TSharedPtr<FJsonValue>> FailureValues;
+		for (const FString& Failure : Result.Failures)
+		{
+			FailureValues.Add(MakeShared<FJsonValueString>(Failure));
+		}
+		Scenario->SetArrayField(TEXT("Failures"), FailureValues);
+		ScenarioValues.Add(MakeShared<FJsonValueObject>(Scenario));
+
+		Csv += FString::Printf(TEXT("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.3f,%s\n"),
+			*Result.Name.ToString(), Result.Frames, Result.SetupMs, Result.GameThreadP50Ms, Result.GameThreadP95Ms, Result.GameThreadP99Ms,
+			Result.GameThreadMaxMs, Result.FrameP50Ms, Result.FrameP95Ms, Result.MemoryHighWaterMB, Result.GCMs, Result.Failures.Num() == 0 ? TEXT("true") : TEXT("false"));
+	}
+	Root->SetArrayField(TEXT("Scenarios"), ScenarioValues);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Root, Writer);
+
+	if (FFileHelper::SaveStringToFile(Json, *(BaseName + TEXT(".json"))) && FFileHelper::SaveStringToFile(Csv, *(BaseName + TEXT(".csv"))))
+	{
+		UE_LOG(LogNecromancer, Display, TEXT("Benchmark: results written to %s.json and .csv"), *BaseName);
+	}
+	else
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("Benchmark: could not write results to %s"), *OutputDir);
+	}
+}
@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "NecromancerBenchmarkSubsystem.generated.h"
+
+class ACombatPawn;
+
+UENUM()
+enum class ENecroBenchmarkScenario : uint8
+{
+	/** Pawns and minions are spawned and left standing */
+	Spawn,
+	/** The horde is sent around the map by scripted clicks through the player controller */
+	ClickToMove,
+	/** The horde is attack-moved into a block of living pawns */
+	MassCombat,
+};
+
+/** One benchmark run and the limits its results are checked against. A limit of zero is not checked. */
+USTRUCT()
+struct FNecroBenchmarkScenarioDesc
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName Name;
+
+	UPROPERTY(Config)
+	ENecroBenchmarkScenario Type = ENecroBenchmarkScenario::Spawn;
+
+	/** Combat pawns taken from the pool; living for MassCombat, undead otherwise */
+	UPROPERTY(Config)
+	int32 NumPawns = 500;
+
+	/** Undead horde minions */
+	UPROPERTY(Config)
+	int32 NumMinions = 0;
+
+	/** Seconds between scripted orders */
+	UPROPERTY(Config)
+	float OrderInterval = 2.f;
+
+	UPROPERTY(Config)
+	int32 WarmupFrames = 60;
+
+	UPROPERTY(Config)
+	int32 Frames = 600;
+
+	UPROPERTY(Config)
+	float MaxGameThreadP95Ms = 0.f;
+
+	UPROPERTY(Config)
+	float MaxGameThreadP99Ms = 0.f;
+
+	UPROPERTY(Config)
+	float MaxMemoryMB = 0.f;
+
+	UPROPERTY(Config)
+	float MaxGCMs = 0.f;
+};
+
+/** Measurements of one scenario */
+struct FNecroBenchmarkResult
+{
+	FName Name;
+	double SetupMs = 0.0;
+	double GameThreadP50Ms = 0.0;
+	double GameThreadP95Ms = 0.0;
+	double GameThreadP99Ms = 0.0;
+	double GameThreadMaxMs = 0.0;
+	double FrameP50Ms = 0.0;
+	double FrameP95Ms = 0.0;
+	double MemoryHighWaterMB = 0.0;
+	double GCMs = 0.0;
+	int32 Frames = 0;
+	TArray<FString> Failures;
+};
+
+/**
+ * Headless performance benchmark. Does nothing unless the game is started with -NecroBenchmark, e.g.
+ *   UnrealEditor Necromancer.uproject TopDownMap -game -nullrhi -unattended -NecroBenchmark[=Scenario]
+ * Runs every configured scenario in the loaded map, writes the results as JSON and CSV to
+ * Saved/Benchmarks (or -NecroBenchmarkOut=<dir>), and exits with status 1 if any scenario exceeded a limit.
+ * Game thread time is the world tick, from its start to the end of actor and tickable object ticking.
+ * Scenarios start once UUnitRegistrySubsystem has no loads pending; the time and memory to get there are reported too.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UNecromancerBenchmarkSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	UPROPERTY(Config)
+	TArray<FNecroBenchmarkScenarioDesc> Scenarios;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	enum class EPhase : uint8
+	{
+		Idle,
+		Warmup,
+		Measure,
+		Done,
+	};
+
+	void BeginScenario();
+	void SpawnScenario(const FNecroBenchmarkScenarioDesc& Scenario);
+	void IssueScriptedOrder(const FNecroBenchmarkScenarioDesc& Scenario);
+	void EndScenario();
+	void Finish();
+	void WriteResults() const;
+
+	void HandleWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void HandleWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void HandlePreGarbageCollect();
+	void HandlePostGarbageCollect();
+
+	bool bRunning = false;
+	EPhase Phase = EPhase::Idle;
+	int32 ScenarioIndex = INDEX_NONE;
+	int32 FramesLeft = 0;
+	float TimeUntilOrder = 0.f;
+	int32 OrderCount = 0;
+	FName OnlyScenario;
+
+	/** Seconds from process start until the map's units were loaded, and resident memory then; negative until measured */
+	double StartupSeconds = -1.0;
+	double StartupMemoryMB = 0.0;
+	FVector Center = FVector::ZeroVector;
+
+	TArray<TWeakObjectPtr<ACombatPawn>> SpawnedPawns;
+	TArray<FCombatHandle> SpawnedMinions;
+
+	/** Samples of the scenario being measured */
+	TArray<float> GameThreadMs;
+	TArray<float> FrameMs;
+	uint64 WorldTickStartCycles = 0;
+	double GCStartSeconds = 0.0;
+	double GCSeconds = 0.0;
+	uint64 MemoryHighWater = 0;
+
+	FNecroBenchmarkResult Current;
+	TArray<FNecroBenchmarkResult> Results;
+
+	FDelegateHandle WorldTickStartHandle;
+	FDelegateHandle WorldPostActorTickHandle;
+	FDelegateHandle PreGCHandle;
+	FDelegateHandle PostGCHandle;
+};
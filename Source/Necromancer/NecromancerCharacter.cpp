@@ -8,6 +8,7 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "Materials/Material.h"
 #include "Engine/World.h"
+#include "UnitSignificanceSubsystem.h"
 
 ANecromancerCharacter::ANecromancerCharacter()
 {
@@ -38,12 +39,26 @@ ANecromancerCharacter::ANecromancerCharacter()
 	TopDownCameraComponent->SetupAttachment(CameraBoom, USpringArmComponent::SocketName);
 	TopDownCameraComponent->bUsePawnControlRotation = false; // Camera does not rotate relative to arm
 
-	// Activate ticking in order to update the cursor every frame.
-	PrimaryActorTick.bCanEverTick = true;
-	PrimaryActorTick.bStartWithTickEnabled = true;
+	// Nothing to do per frame; movement and mesh components tick on their own and are throttled by UUnitSignificanceSubsystem
+	PrimaryActorTick.bCanEverTick = false;
 }
 
-void ANecromancerCharacter::Tick(float DeltaSeconds)
+void ANecromancerCharacter::BeginPlay()
 {
-    Super::Tick(DeltaSeconds);
+	Super::BeginPlay();
+
+	if (UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>())
+	{
+		Significance->RegisterUnit(this);
+	}
+}
+
+void ANecromancerCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UUnitSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UUnitSignificanceSubsystem>())
+	{
+		Significance->UnregisterUnit(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
@@ -1,24 +1,147 @@
+
+
+
 #include "NecromancerGameMode.h"
+#include "NecromancerGameState.h"
 #include "NecromancerPlayerController.h"
 #include "NecromancerCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "CombatPawn.h"
+#include "CombatPawnPoolSubsystem.h"
+#include "UnitDefinition.h"
+#include "UnitRegistrySubsystem.h"
+#include "Engine/AssetManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/StreamableManager.h"
+#include "GameFramework/PlayerState.h"
 
 ANecromancerGameMode::ANecromancerGameMode()
 {
-	// use our custom PlayerController class
+	// use our custom PlayerController class until the configured one is loaded
 	PlayerControllerClass = ANecromancerPlayerController::StaticClass();
 
-	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/TopDown/Blueprints/BP_TopDownCharacter"));
-	if (PlayerPawnBPClass.Class != nullptr)
+	// replicates combat state to remote players
+	GameStateClass = ANecromancerGameState::StaticClass();
+}
+
+void ANecromancerGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// Blueprint classes are loaded alongside the map instead of by the constructor of every game mode object
+	TArray<FSoftObjectPath> StartupClasses;
+	for (const FSoftObjectPath& Path : { PlayerPawnClass.ToSoftObjectPath(), PlayerControllerSoftClass.ToSoftObjectPath() })
+	{
+		if (Path.IsValid())
+		{
+			StartupClasses.Add(Path);
+		}
+	}
+	if (StartupClasses.Num() > 0)
+	{
+		StartupClassesHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(StartupClasses,
+			FStreamableDelegate::CreateUObject(this, &ANecromancerGameMode::HandleStartupClassesLoaded), FStreamableManager::AsyncLoadHighPriority);
+	}
+
+	UUnitRegistrySubsystem* Registry = GetGameInstance() ? GetGameInstance()->GetSubsystem<UUnitRegistrySubsystem>() : nullptr;
+	if (Registry && StartupUnits.Num() > 0)
+	{
+		StartupGroup = FName(*MapName);
+		Registry->PreloadGroup(StartupGroup, StartupUnits, FSimpleDelegate::CreateUObject(this, &ANecromancerGameMode::HandleStartupUnitsLoaded));
+	}
+}
+
+void ANecromancerGameMode::HandleStartupClassesLoaded()
+{
+	if (UClass* PawnClass = PlayerPawnClass.Get())
+	{
+		DefaultPawnClass = PawnClass;
+	}
+	if (UClass* ControllerClass = PlayerControllerSoftClass.Get())
+	{
+		PlayerControllerClass = ControllerClass;
+	}
+
+	// Players who logged in while the pawn class was loading were refused a restart
+	if (UWorld* World = GetWorld())
 	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* Player = It->Get();
+			if (Player && !Player->GetPawn() && PlayerCanRestart(Player))
+			{
+				RestartPlayer(Player);
+			}
+		}
 	}
+}
 
-	// set default controller to our Blueprinted controller
-	static ConstructorHelpers::FClassFinder<APlayerController> PlayerControllerBPClass(TEXT("/Game/TopDown/Blueprints/BP_TopDownPlayerController"));
-	if(PlayerControllerBPClass.Class != NULL)
+APlayerController* ANecromancerGameMode::SpawnPlayerController(ENetRole InRemoteRole, const FString& Options)
+{
+	// Login cannot be deferred, so a player arriving before the controller class is in waits for it
+	if (StartupClassesHandle.IsValid() && StartupClassesHandle->IsLoadingInProgress() && !PlayerControllerSoftClass.IsNull())
 	{
-		PlayerControllerClass = PlayerControllerBPClass.Class;
+		StartupClassesHandle->WaitUntilComplete();
+		HandleStartupClassesLoaded();
 	}
-}
\ No newline at end of file
+
+	return Super::SpawnPlayerController(InRemoteRole, Options);
+}
+
+bool ANecromancerGameMode::PlayerCanRestart_Implementation(APlayerController* Player)
+{
+	if (!PlayerPawnClass.IsNull() && !PlayerPawnClass.Get())
+	{
+		return false;
+	}
+
+	return Super::PlayerCanRestart_Implementation(Player);
+}
+
+void ANecromancerGameMode::HandleStartupUnitsLoaded()
+{
+	UUnitRegistrySubsystem* Registry = GetGameInstance()->GetSubsystem<UUnitRegistrySubsystem>();
+	UCombatPawnPoolSubsystem* Pool = GetWorld()->GetSubsystem<UCombatPawnPoolSubsystem>();
+	if (!Registry || !Pool)
+	{
+		return;
+	}
+
+	for (const FPrimaryAssetId& UnitId : StartupUnits)
+	{
+		const UUnitDefinition* Unit = Registry->FindUnit(UnitId.PrimaryAssetName);
+		if (Unit && Unit->PoolPrewarmCount > 0 && Unit->PawnClass.Get())
+		{
+			Pool->Prewarm(Unit->PawnClass.Get(), Unit->PoolPrewarmCount);
+		}
+	}
+}
+
+void ANecromancerGameMode::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UCombatPawnPoolSubsystem* Pool = GetWorld()->GetSubsystem<UCombatPawnPoolSubsystem>())
+	{
+		for (const TPair<TSubclassOf<ACombatPawn>, int32>& Entry : PooledPawnsToPrewarm)
+		{
+			Pool->Prewarm(Entry.Key, Entry.Value);
+		}
+	}
+}
+
+void ANecromancerGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (StartupClassesHandle.IsValid())
+	{
+		StartupClassesHandle->CancelHandle();
+		StartupClassesHandle.Reset();
+	}
+
+	UUnitRegistrySubsystem* Registry = GetGameInstance() ? GetGameInstance()->GetSubsystem<UUnitRegistrySubsystem>() : nullptr;
+	if (Registry && !StartupGroup.IsNone())
+	{
+		Registry->ReleaseGroup(StartupGroup);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -4,14 +4,45 @@
 #include "GameFramework/GameModeBase.h"
 #include "NecromancerGameMode.generated.h"
 
-UCLASS(minimalapi)
+class ACombatPawn;
+struct FStreamableHandle;
+
+UCLASS(Config = Game, minimalapi)
 class ANecromancerGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
 	ANecromancerGameMode();
-};
 
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual bool PlayerCanRestart_Implementation(APlayerController* Player) override;
+
+	/** Combat pawns spawned into the pool up front, so that the first promotions do not hitch */
+	UPROPERTY(EditDefaultsOnly, Category = Pooling)
+	TMap<TSubclassOf<ACombatPawn>, int32> PooledPawnsToPrewarm;
+
+	/** Loaded asynchronously in InitGame; becomes DefaultPawnClass once in, and players wait for it to restart */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Classes)
+	TSoftClassPtr<APawn> PlayerPawnClass;
 
+	/** Loaded asynchronously in InitGame; becomes PlayerControllerClass once in */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Classes)
+	TSoftClassPtr<APlayerController> PlayerControllerSoftClass;
 
+	/** Units preloaded for this map through UUnitRegistrySubsystem, with their pools prewarmed once they are in */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Units)
+	TArray<FPrimaryAssetId> StartupUnits;
+
+protected:
+	virtual APlayerController* SpawnPlayerController(ENetRole InRemoteRole, const FString& Options) override;
+
+private:
+	void HandleStartupClassesLoaded();
+	void HandleStartupUnitsLoaded();
+
+	TSharedPtr<FStreamableHandle> StartupClassesHandle;
+	FName StartupGroup;
+};
@@ -2,4 +2,95 @@
 
 
 #include "NecromancerGameState.h"
+#include "CombatReplicationProxy.h"
+#include "CombatSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "VisibilitySubsystem.h"
+#include "NecromancerStats.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
 
+DECLARE_CYCLE_STAT(TEXT("Combat Replication"), STAT_CombatReplication, STATGROUP_Necromancer);
+
+ANecromancerGameState::ANecromancerGameState()
+{
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+void ANecromancerGameState::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// Nothing to send without remote players
+	const ENetMode NetMode = GetNetMode();
+	if (NetMode != NM_ListenServer && NetMode != NM_DedicatedServer)
+	{
+		return;
+	}
+
+	TimeUntilViewUpdate -= DeltaSeconds;
+	if (TimeUntilViewUpdate <= 0.f)
+	{
+		NECRO_SCOPE(STAT_CombatReplication, Network);
+		TimeUntilViewUpdate += CombatReplicationInterval;
+		TimeUntilViewUpdate = FMath::Max(TimeUntilViewUpdate, 0.f);
+		UpdateCombatViews();
+	}
+}
+
+void ANecromancerGameState::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CombatViews.Empty();
+	LocalCombatView = nullptr;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ANecromancerGameState::UpdateCombatViews()
+{
+	const UCombatSubsystem* Combat = GetWorld()->GetSubsystem<UCombatSubsystem>();
+	if (!Combat)
+	{
+		return;
+	}
+	const UVisibilitySubsystem* Visibility = GetWorld()->GetSubsystem<UVisibilitySubsystem>();
+
+	// Forget controllers that left
+	for (auto It = CombatViews.CreateIterator(); It; ++It)
+	{
+		if (!IsValid(It.Key()) || !IsValid(It.Value()))
+		{
+			if (IsValid(It.Value()))
+			{
+				It.Value()->Destroy();
+			}
+			It.RemoveCurrent();
+		}
+	}
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (!PlayerController || PlayerController->IsLocalController())
+		{
+			continue;
+		}
+
+		TObjectPtr<ACombatReplicationProxy>& View = CombatViews.FindOrAdd(PlayerController);
+		if (!View)
+		{
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.Owner = PlayerController;
+			SpawnParams.ObjectFlags |= RF_Transient;
+			View = GetWorld()->SpawnActor<ACombatReplicationProxy>(SpawnParams);
+		}
+
+		// Players see through the eyes of their pawn's team, which is the Undead for a necromancer
+		const APawn* Pawn = PlayerController->GetPawn();
+		const FVector ViewLocation = Pawn ? Pawn->GetActorLocation() : PlayerController->GetFocalLocation();
+		const UCombatManagerComponent* PawnCombat = Pawn ? Pawn->FindComponentByClass<UCombatManagerComponent>() : nullptr;
+		const ECombatTeam ViewerTeam = PawnCombat ? PawnCombat->Team : ECombatTeam::Undead;
+		View->UpdateView(Combat->GetSimulation(), ViewLocation, CombatRelevancyRadius, MaxCombatantsPerConnection, Visibility, ViewerTeam);
+	}
+}
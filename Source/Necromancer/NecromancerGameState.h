@@ -6,12 +6,51 @@
 #include "GameFramework/GameStateBase.h"
 #include "NecromancerGameState.generated.h"
 
+class ACombatReplicationProxy;
+class APlayerController;
+
 /**
- * 
+ * Replicates combat state to clients. The combat simulation only runs on the server; every remote player gets an
+ * ACombatReplicationProxy owned by their controller, refreshed here with the combatants around their pawn.
+ * On a client, the proxy received from the server is exposed as the local combat view.
  */
-UCLASS()
+UCLASS(Config = Game)
 class NECROMANCER_API ANecromancerGameState : public AGameStateBase
 {
 	GENERATED_BODY()
-	
+
+public:
+	ANecromancerGameState();
+
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Client: the combatants the server sent this player, or null before the first update */
+	ACombatReplicationProxy* GetLocalCombatView() const { return LocalCombatView; }
+
+	/** Called by the proxy when it arrives on its owning client */
+	void SetLocalCombatView(ACombatReplicationProxy* View) { LocalCombatView = View; }
+
+	/** Combatants further than this from a player's pawn are not sent to that player */
+	UPROPERTY(Config)
+	float CombatRelevancyRadius = 6000.f;
+
+	/** Caps the records sent to one player; the closest are kept */
+	UPROPERTY(Config)
+	int32 MaxCombatantsPerConnection = 512;
+
+	/** Seconds between refreshes of every player's combat view */
+	UPROPERTY(Config)
+	float CombatReplicationInterval = 0.1f;
+
+private:
+	void UpdateCombatViews();
+
+	UPROPERTY(Transient)
+	TMap<TObjectPtr<APlayerController>, TObjectPtr<ACombatReplicationProxy>> CombatViews;
+
+	UPROPERTY(Transient)
+	TObjectPtr<ACombatReplicationProxy> LocalCombatView;
+
+	float TimeUntilViewUpdate = 0.f;
 };
@@ -1,10 +1,21 @@
 #include "NecromancerPlayerController.h"
 #include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerState.h"
 #include "Blueprint/AIBlueprintHelperLibrary.h"
 #include "NiagaraSystem.h"
-#include "NiagaraFunctionLibrary.h"
+#include "FXPoolSubsystem.h"
+#include "MinionHordeSubsystem.h"
 #include "NecromancerCharacter.h"
+#include "CorpseSubsystem.h"
+#include "CombatManagerComponent.h"
+#include "CombatReplicationProxy.h"
+#include "CombatSubsystem.h"
+#include "NecromancerGameState.h"
+#include "ProjectileSubsystem.h"
+#include "NecromancerStats.h"
 #include "Engine/World.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
 #include "EnhancedInputComponent.h"
 #include "InputActionValue.h"
 #include "EnhancedInputSubsystems.h"
@@ -14,12 +25,54 @@
 
 DEFINE_LOG_CATEGORY(LogTemplateCharacter);
 
+DECLARE_CYCLE_STAT(TEXT("Player Controller Tick"), STAT_PlayerControllerTick, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Player Input"), STAT_PlayerInput, STATGROUP_Necromancer);
+
+static FAutoConsoleCommandWithWorldAndArgs GCommandLatencyTestCommand(
+	TEXT("necro.Net.CommandLatency"),
+	TEXT("necro.Net.CommandLatency [LagMs] [LossPercent] [Count]: on a client, emulates outgoing lag and loss, sends Count move commands and logs their local and acknowledged response times"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANecromancerPlayerController* PlayerController = World ? Cast<ANecromancerPlayerController>(World->GetFirstPlayerController()) : nullptr;
+		if (!PlayerController || World->GetNetMode() != NM_Client)
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("necro.Net.CommandLatency needs a client connected to a server"));
+			return;
+		}
+
+		const int32 LagMs = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		const int32 LossPercent = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 5;
+		const int32 Count = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 50;
+
+		// Only affects this end; run the same on the server for a symmetric profile
+		PlayerController->ConsoleCommand(FString::Printf(TEXT("NetEmulation.PktLag %d"), LagMs));
+		PlayerController->ConsoleCommand(FString::Printf(TEXT("NetEmulation.PktLoss %d"), LossPercent));
+		PlayerController->RunCommandLatencyTest(Count, 0.25f);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GSelectionBenchmarkCommand(
+	TEXT("necro.Select.Benchmark"),
+	TEXT("necro.Select.Benchmark [Units] [Frames] [MaxMs]: fills the view with Units scratch undead units, then logs the per-frame cost of growing a drag box over them, against projecting every unit to the screen. Warns above MaxMs (0.2) per frame."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ANecromancerPlayerController* PlayerController = World ? Cast<ANecromancerPlayerController>(World->GetFirstPlayerController()) : nullptr;
+		if (!PlayerController || !PlayerController->IsLocalController())
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("necro.Select.Benchmark needs a local player"));
+			return;
+		}
+
+		PlayerController->RunSelectionBenchmark(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 5000, Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 120,
+			Args.Num() > 2 ? FCString::Atof(*Args[2]) : 0.2f);
+	}));
+
 ANecromancerPlayerController::ANecromancerPlayerController()
 {
 	bShowMouseCursor = true;
 	DefaultMouseCursor = EMouseCursor::Default;
 	CachedDestination = FVector::ZeroVector;
 	FollowTime = 0.f;
+	bIsTouch = false;
 }
 
 void ANecromancerPlayerController::BeginPlay()
@@ -53,6 +106,23 @@ void ANecromancerPlayerController::SetupInputComponent()
 		EnhancedInputComponent->BindAction(SetDestinationTouchAction, ETriggerEvent::Completed, this, &ANecromancerPlayerController::OnTouchReleased);
 		EnhancedInputComponent->BindAction(SetDestinationTouchAction, ETriggerEvent::Canceled, this, &ANecromancerPlayerController::OnTouchReleased);
 
+		// Raise dead on the corpses under the cursor
+		EnhancedInputComponent->BindAction(RaiseDeadAction, ETriggerEvent::Started, this, &ANecromancerPlayerController::OnRaiseDeadStarted);
+
+		// Horde orders and spells, sent to the server as commands
+		EnhancedInputComponent->BindAction(AttackMoveAction, ETriggerEvent::Started, this, &ANecromancerPlayerController::OnAttackMoveStarted);
+		EnhancedInputComponent->BindAction(CastAction, ETriggerEvent::Started, this, &ANecromancerPlayerController::OnCastStarted);
+
+		// Selection and control groups; orders then go to the selected units instead of the whole horde
+		EnhancedInputComponent->BindAction(SelectAction, ETriggerEvent::Started, this, &ANecromancerPlayerController::OnSelectStarted);
+		EnhancedInputComponent->BindAction(SelectAction, ETriggerEvent::Completed, this, &ANecromancerPlayerController::OnSelectCompleted);
+		EnhancedInputComponent->BindAction(SelectAction, ETriggerEvent::Canceled, this, &ANecromancerPlayerController::OnSelectCanceled);
+		EnhancedInputComponent->BindAction(SelectAllOfTypeAction, ETriggerEvent::Started, this, &ANecromancerPlayerController::OnSelectAllOfTypeStarted);
+		for (int32 Group = 0; Group < FMath::Min(ControlGroupActions.Num(), FUnitSelection::NumControlGroups); ++Group)
+		{
+			EnhancedInputComponent->BindAction(ControlGroupActions[Group], ETriggerEvent::Started, this, &ANecromancerPlayerController::OnControlGroupStarted, Group);
+		}
+
         // Camera Events
         // Camera Move
         EnhancedInputComponent->BindAction(SetCameraMoveClickAction, ETriggerEvent::Started, this, &ANecromancerPlayerController::OnCameraMoveStarted);
@@ -79,33 +149,754 @@ void ANecromancerPlayerController::SetupInputComponent()
 	}
 }
 
-void ANecromancerPlayerController::OnInputStarted()
+void ANecromancerPlayerController::PlayerTick(float DeltaTime)
 {
-	StopMovement();
+	Super::PlayerTick(DeltaTime);
+
+	NECRO_SCOPE(STAT_PlayerControllerTick, Input);
+
+	// One grid query per frame; only corpses entering or leaving the radius touch their mesh instance
+	UCorpseSubsystem* Corpses = GetWorld()->GetSubsystem<UCorpseSubsystem>();
+	FVector CursorLocation;
+	if (Corpses && GetCursorGroundLocation(CursorLocation))
+	{
+		Corpses->SetHighlight(CursorLocation, RaiseDeadRadius);
+	}
+
+	// The box is resolved again only when it, the camera or the units moved
+	FVector2D ScreenPosition;
+	if (Selection.IsDragging() && GetScreenPosition(ScreenPosition))
+	{
+		Selection.UpdateDrag(*this, ScreenPosition, SelectionGroundZ, GetSelectableUnits(), CombatTeamBit(ECombatTeam::Undead));
+	}
+
+	SteerPredictedMove();
+	SendCommands(DeltaTime);
+	UpdateLatencyTest();
 }
 
-// Triggered every frame when the input is held down
-void ANecromancerPlayerController::OnSetDestinationTriggered()
+void ANecromancerPlayerController::IssueCommand(EPlayerCommandType Type, const FVector& Target, uint8 Ability, bool bOrderHorde)
 {
-	// We flag that the input is being pressed
-	FollowTime += GetWorld()->GetDeltaSeconds();
-	
-	// We look for the location in the world where the player has pressed the input
-	FHitResult Hit;
-	bool bHitSuccessful = false;
+	FPlayerCommand Command;
+	Command.Type = Type;
+	Command.Ability = Ability;
+	Command.bOrderHorde = bOrderHorde;
+	Command.Target = FCombatNetPosition::FromVector(Target);
+
+	if (GetNetMode() != NM_Client)
+	{
+		ExecuteCommand(Command);
+		return;
+	}
+
+	// The server checks again, but a client that keeps to the cooldowns never has a command refused
+	if (!ConsumeCooldown(Type, 0.f))
+	{
+		return;
+	}
+
+	Command.Sequence = Commands.Push(Command);
+	PredictCommand(Command);
+
+	if (LatencyTest.bActive)
+	{
+		LatencyTest.IssueTimes.Add(Command.Sequence, FPlatformTime::Seconds());
+		LatencyTest.LocalIssueTime = FPlatformTime::Seconds();
+	}
+}
+
+int32 ANecromancerPlayerController::GetHordeOwnerId() const
+{
+	return PlayerState ? PlayerState->GetPlayerId() : INDEX_NONE;
+}
+
+bool ANecromancerPlayerController::ConsumeCooldown(EPlayerCommandType Type, float Slack)
+{
+	double* NextTime = nullptr;
+	float Cooldown = 0.f;
+	if (Type == EPlayerCommandType::Cast)
+	{
+		NextTime = &NextCastTime;
+		Cooldown = CastCooldown;
+	}
+	else if (Type == EPlayerCommandType::Raise)
+	{
+		NextTime = &NextRaiseTime;
+		Cooldown = RaiseDeadCooldown;
+	}
+	if (!NextTime)
+	{
+		return true;
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	if (Now < *NextTime - Slack)
+	{
+		return false;
+	}
+
+	// Counting from the scheduled time rather than from now keeps early arrivals from adding up
+	*NextTime = FMath::Max(Now, *NextTime) + Cooldown;
+	return true;
+}
+
+void ANecromancerPlayerController::ExecuteCommand(const FPlayerCommand& Command)
+{
+	const FVector Target = Command.Target.ToVector();
+	APawn* ControlledPawn = GetPawn();
+	const UCombatManagerComponent* Caster = ControlledPawn ? ControlledPawn->FindComponentByClass<UCombatManagerComponent>() : nullptr;
+
+	switch (Command.Type)
+	{
+	case EPlayerCommandType::Move:
+		// A remote client's character is already on its way through the predicted move
+		if (IsLocalController())
+		{
+			UAIBlueprintHelperLibrary::SimpleMoveToLocation(this, Target);
+		}
+		// Selected units got their own order instead
+		if (UMinionHordeSubsystem* Horde = GetWorld()->GetSubsystem<UMinionHordeSubsystem>())
+		{
+			if (Command.bOrderHorde)
+			{
+				Horde->OrderMoveAll(GetHordeOwnerId(), Target, false);
+			}
+		}
+		break;
+
+	case EPlayerCommandType::AttackMove:
+		// The necromancer stays put; minions engage whatever they meet on the way
+		if (UMinionHordeSubsystem* Horde = GetWorld()->GetSubsystem<UMinionHordeSubsystem>())
+		{
+			Horde->OrderMoveAll(GetHordeOwnerId(), Target, true);
+		}
+		break;
+
+	case EPlayerCommandType::Cast:
+	{
+		// Only the necromancer's own spell, and no faster than its cooldown
+		UProjectileSubsystem* Projectiles = GetWorld()->GetSubsystem<UProjectileSubsystem>();
+		if (Caster && Caster->IsAlive() && Projectiles && Command.Ability == CastProjectileType
+			&& ConsumeCooldown(Command.Type, IsLocalController() ? 0.f : CooldownSlack))
+		{
+			const FVector Origin = ControlledPawn->GetActorLocation();
+			Projectiles->Fire(Command.Ability, Caster->GetCombatHandle(), Caster->Team, Origin, (Target - Origin).GetSafeNormal2D());
+		}
+		break;
+	}
+
+	case EPlayerCommandType::Raise:
+	{
+		UCorpseSubsystem* Corpses = GetWorld()->GetSubsystem<UCorpseSubsystem>();
+		const bool bInRange = Caster && FVector::DistSquared2D(ControlledPawn->GetActorLocation(), Target) <= FMath::Square(RaiseDeadRange);
+		if (Corpses && bInRange && Caster->IsAlive() && ConsumeCooldown(Command.Type, IsLocalController() ? 0.f : CooldownSlack))
+		{
+			Corpses->RaiseCorpses(Target, RaiseDeadRadius, MaxRaisedPerCast, GetHordeOwnerId());
+		}
+		break;
+	}
+	}
+}
+
+void ANecromancerPlayerController::IssueSelectionOrder(EPlayerCommandType Type, const FVector& Target)
+{
+	PruneSelection();
+	if (GetNetMode() != NM_Client)
+	{
+		ExecuteSelectionOrder(Type, Target, Selection.GetSelected());
+		return;
+	}
+
+	// Sorted once so every chunk is a run of ascending slots; big selections go out as several orders
+	TArray<FCombatHandle> Selected(Selection.GetSelected());
+	Selected.Sort([](const FCombatHandle& A, const FCombatHandle& B) { return A.Slot < B.Slot; });
+	const FCombatNetPosition NetTarget = FCombatNetPosition::FromVector(Target);
+	for (int32 Start = 0; Start < Selected.Num(); Start += FCombatHandleSet::MaxHandles)
+	{
+		FCombatHandleSet Units;
+		Units.Handles.Append(Selected.GetData() + Start, FMath::Min(Selected.Num() - Start, FCombatHandleSet::MaxHandles));
+		ServerOrderSelection(Type, NetTarget, Units);
+	}
+}
+
+void ANecromancerPlayerController::ExecuteSelectionOrder(EPlayerCommandType Type, const FVector& Target, TConstArrayView<FCombatHandle> Units)
+{
+	if (Type != EPlayerCommandType::Move && Type != EPlayerCommandType::AttackMove)
+	{
+		return;
+	}
+
+	// Only this player's horde minions take orders; the horde ignores any other handle
+	if (UMinionHordeSubsystem* Horde = GetWorld()->GetSubsystem<UMinionHordeSubsystem>())
+	{
+		Horde->OrderMove(GetHordeOwnerId(), Units, Target, Type == EPlayerCommandType::AttackMove);
+	}
+}
+
+void ANecromancerPlayerController::ServerOrderSelection_Implementation(EPlayerCommandType Type, const FCombatNetPosition& Target, const FCombatHandleSet& Units)
+{
+	// The client's selection may hold anything it can see; the horde drops every handle that is not this player's minion
+	ExecuteSelectionOrder(Type, Target.ToVector(), Units.Handles);
+}
+
+void ANecromancerPlayerController::PredictCommand(const FPlayerCommand& Command)
+{
+	// Only our own movement is predicted. Horde orders, casts and raises change shared state,
+	// which the server replicates back once it has run them.
+	if (Command.Type == EPlayerCommandType::Move)
+	{
+		PredictedDestination = Command.Target.ToVector();
+		bHasPredictedDestination = true;
+	}
+}
+
+void ANecromancerPlayerController::SteerPredictedMove()
+{
+	APawn* ControlledPawn = GetPawn();
+	if (!bHasPredictedDestination || !ControlledPawn)
+	{
+		return;
+	}
+
+	// Steering goes through the character movement component, which sends its own moves and replays them on correction
+	const FVector ToDestination = PredictedDestination - ControlledPawn->GetActorLocation();
+	if (ToDestination.SizeSquared2D() <= FMath::Square(PredictedMoveAcceptanceRadius))
+	{
+		bHasPredictedDestination = false;
+		return;
+	}
+	ControlledPawn->AddMovementInput(ToDestination.GetSafeNormal2D(), 1.0, false);
+}
+
+void ANecromancerPlayerController::SendCommands(float DeltaTime)
+{
+	if (GetNetMode() != NM_Client)
+	{
+		return;
+	}
+
+	TimeUntilCommandSend -= DeltaTime;
+	if (TimeUntilCommandSend > 0.f)
+	{
+		return;
+	}
+	TimeUntilCommandSend = 1.f / FMath::Max(CommandSendRate, 1.f);
+
+	// Unacknowledged commands go out again in every batch until the server confirms them
+	FPlayerCommandBatch Batch;
+	if (Commands.MakeBatch(Batch))
+	{
+		ServerExecuteCommands(Batch);
+
+		if (LatencyTest.bActive)
+		{
+			++LatencyTest.NumBatchesSent;
+			LatencyTest.NumCommandsSent += Batch.Commands.Num();
+		}
+	}
+}
+
+void ANecromancerPlayerController::ServerExecuteCommands_Implementation(const FPlayerCommandBatch& Batch)
+{
+	TArray<FPlayerCommand> NewCommands;
+	Commands.Accept(Batch, NewCommands, FMath::Max(MaxCommandsPerBatch, 1));
+	for (const FPlayerCommand& Command : NewCommands)
+	{
+		ExecuteCommand(Command);
+	}
+
+	ClientAcknowledgeCommands(Commands.GetLastAccepted());
+}
+
+void ANecromancerPlayerController::ClientAcknowledgeCommands_Implementation(uint16 Sequence)
+{
+	if (LatencyTest.bActive)
+	{
+		const double Now = FPlatformTime::Seconds();
+		for (auto It = LatencyTest.IssueTimes.CreateIterator(); It; ++It)
+		{
+			if (!FPlayerCommandBuffer::IsNewer(It.Key(), Sequence))
+			{
+				LatencyTest.AcknowledgeTimes.Add(Now - It.Value());
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	Commands.Acknowledge(Sequence);
+}
+
+void ANecromancerPlayerController::RunCommandLatencyTest(int32 Count, float Interval)
+{
+	LatencyTest = FCommandLatencyTest();
+	LatencyTest.bActive = true;
+	LatencyTest.NumRemaining = FMath::Max(Count, 1);
+	LatencyTest.Deadline = FPlatformTime::Seconds() + LatencyTest.NumRemaining * Interval + 10.0;
+
+	// Alternate moves to either side so that every command turns the character around
+	GetWorldTimerManager().SetTimer(LatencyTest.IssueTimer, FTimerDelegate::CreateWeakLambda(this, [this]()
+	{
+		if (const APawn* ControlledPawn = GetPawn())
+		{
+			const float Side = LatencyTest.NumRemaining % 2 ? 1.f : -1.f;
+			IssueCommand(EPlayerCommandType::Move, ControlledPawn->GetActorLocation() + FVector(Side * 600.f, 0.f, 0.f));
+		}
+		if (--LatencyTest.NumRemaining <= 0)
+		{
+			GetWorldTimerManager().ClearTimer(LatencyTest.IssueTimer);
+		}
+	}), Interval, true);
+}
+
+void ANecromancerPlayerController::UpdateLatencyTest()
+{
+	if (!LatencyTest.bActive)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+
+	// Locally the command has landed once the character is heading for the new destination
+	const APawn* ControlledPawn = GetPawn();
+	if (LatencyTest.LocalIssueTime >= 0.0 && ControlledPawn)
+	{
+		const FVector Velocity = ControlledPawn->GetVelocity();
+		const FVector ToDestination = PredictedDestination - ControlledPawn->GetActorLocation();
+		if (Velocity.SizeSquared2D() > 1.f && FVector::DotProduct(Velocity.GetSafeNormal2D(), ToDestination.GetSafeNormal2D()) > 0.7f)
+		{
+			LatencyTest.LocalResponseTimes.Add(Now - LatencyTest.LocalIssueTime);
+			LatencyTest.LocalIssueTime = -1.0;
+		}
+	}
+
+	const bool bFinished = LatencyTest.NumRemaining <= 0 && LatencyTest.IssueTimes.IsEmpty();
+	if (!bFinished && Now < LatencyTest.Deadline)
+	{
+		return;
+	}
+
+	auto Summarize = [](TArray<double>& Times)
+	{
+		if (Times.IsEmpty())
+		{
+			return FString(TEXT("none"));
+		}
+		Times.Sort();
+		double Total = 0.0;
+		for (double Time : Times)
+		{
+			Total += Time;
+		}
+		return FString::Printf(TEXT("mean %.1f ms, p95 %.1f ms, max %.1f ms"),
+			Total * 1000.0 / Times.Num(), Times[FMath::Min(Times.Num() * 95 / 100, Times.Num() - 1)] * 1000.0, Times.Last() * 1000.0);
+	};
+
+	UE_LOG(LogNecromancer, Log, TEXT("Command latency: local response %s; server acknowledge %s; %d unacknowledged, %d batches carrying %d commands"),
+		*Summarize(LatencyTest.LocalResponseTimes), *Summarize(LatencyTest.AcknowledgeTimes), LatencyTest.IssueTimes.Num(),
+		LatencyTest.NumBatchesSent, LatencyTest.NumCommandsSent);
+
+	GetWorldTimerManager().ClearTimer(LatencyTest.IssueTimer);
+	LatencyTest.bActive = false;
+}
+
+bool ANecromancerPlayerController::GetScreenPosition(FVector2D& OutPosition)
+{
+	FVector2f ScreenPos;
+	bool bGetSuccessful = false;
 	if (bIsTouch)
 	{
-		bHitSuccessful = GetHitResultUnderFinger(ETouchIndex::Touch1, ECollisionChannel::ECC_Visibility, true, Hit);
+		GetInputTouchState(ETouchIndex::Touch1, ScreenPos.X, ScreenPos.Y, bGetSuccessful);
+	}
+	else
+	{
+		bGetSuccessful = GetMousePosition(ScreenPos.X, ScreenPos.Y);
+	}
+
+	OutPosition = FVector2D(ScreenPos);
+	return bGetSuccessful;
+}
+
+bool ANecromancerPlayerController::GetCursorGroundLocation(FVector& OutLocation)
+{
+	// The projector reuses last frame's answer while nothing moved
+	FVector2D ScreenPosition;
+	return GetScreenPosition(ScreenPosition) && CursorProjector.Project(*this, ScreenPosition, OutLocation);
+}
+
+const FSelectableUnitIndex& ANecromancerPlayerController::GetSelectableUnits()
+{
+	if (GetNetMode() != NM_Client)
+	{
+		const UCombatSubsystem* Combat = GetWorld()->GetSubsystem<UCombatSubsystem>();
+		SelectableUnits.SetSimulation(Combat ? &Combat->GetSimulation() : nullptr);
+		return SelectableUnits;
+	}
+
+	// Clients index their replicated combat view, at most once per replication update that changed it
+	const ANecromancerGameState* NecromancerGameState = GetWorld()->GetGameState<ANecromancerGameState>();
+	ACombatReplicationProxy* View = NecromancerGameState ? NecromancerGameState->GetLocalCombatView() : nullptr;
+	if (View != BoundCombatView.Get())
+	{
+		if (ACombatReplicationProxy* PreviousView = BoundCombatView.Get())
+		{
+			PreviousView->OnViewChanged.RemoveAll(this);
+		}
+		if (View)
+		{
+			View->OnViewChanged.AddUObject(this, &ANecromancerPlayerController::HandleCombatViewChanged);
+		}
+		BoundCombatView = View;
+		bSelectableUnitsDirty = true;
+	}
+	if (bSelectableUnitsDirty)
+	{
+		SelectableUnits.Rebuild(View ? View->GetCombatants() : TConstArrayView<FCombatantNetRecord>());
+		bSelectableUnitsDirty = false;
+	}
+	return SelectableUnits;
+}
+
+void ANecromancerPlayerController::HandleCombatViewChanged()
+{
+	bSelectableUnitsDirty = true;
+}
+
+const UClass* ANecromancerPlayerController::GetUnitType(FCombatHandle Handle) const
+{
+	// Clients only know positions and teams, so to them all units are of one type
+	if (GetNetMode() == NM_Client)
+	{
+		return nullptr;
+	}
+
+	const UCombatSubsystem* Combat = GetWorld()->GetSubsystem<UCombatSubsystem>();
+	const UCombatManagerComponent* Component = Combat ? Combat->FindCombatantComponent(Handle) : nullptr;
+	return Component && Component->GetOwner() ? Component->GetOwner()->GetClass() : nullptr;
+}
+
+bool ANecromancerPlayerController::IsSelectionModifierDown() const
+{
+	return IsInputKeyDown(EKeys::LeftShift) || IsInputKeyDown(EKeys::RightShift);
+}
+
+void ANecromancerPlayerController::PruneSelection()
+{
+	// Clients cannot tell; the server ignores the dead
+	const UCombatSubsystem* Combat = GetWorld()->GetSubsystem<UCombatSubsystem>();
+	if (Combat && GetNetMode() != NM_Client)
+	{
+		const FCombatSimulation& Simulation = Combat->GetSimulation();
+		Selection.RemoveInvalid([&Simulation](const FCombatHandle& Handle) { return Simulation.IsAlive(Handle); });
+	}
+}
+
+void ANecromancerPlayerController::OnSelectStarted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	FVector2D ScreenPosition;
+	FVector CursorLocation;
+	if (GetScreenPosition(ScreenPosition) && GetCursorGroundLocation(CursorLocation))
+	{
+		SelectionGroundZ = CursorLocation.Z;
+		Selection.BeginDrag(ScreenPosition, IsSelectionModifierDown());
+	}
+}
+
+void ANecromancerPlayerController::OnSelectCompleted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	if (!Selection.IsDragging())
+	{
+		return;
+	}
+
+	// Catch up with the cursor before committing, in case it moved since this frame's tick
+	const uint32 TeamMask = CombatTeamBit(ECombatTeam::Undead);
+	FVector2D ScreenPosition;
+	if (GetScreenPosition(ScreenPosition))
+	{
+		Selection.UpdateDrag(*this, ScreenPosition, SelectionGroundZ, GetSelectableUnits(), TeamMask);
+	}
+
+	const bool bAdditive = IsSelectionModifierDown();
+	if (Selection.EndDrag())
+	{
+		return;
+	}
+
+	// A click picks the unit nearest the cursor, or clears the selection if there is none
+	TArray<FCombatHandle> Picked;
+	FVector CursorLocation;
+	if (GetCursorGroundLocation(CursorLocation))
+	{
+		FCombatSpatialQuery Query;
+		Query.Shape = ECombatQueryShape::Nearest;
+		Query.Origin = CursorLocation;
+		Query.Radius = ClickSelectRadius;
+		Query.TeamMask = TeamMask;
+		Query.MaxResults = 1;
+		GetSelectableUnits().Query(Query, Picked);
+	}
+
+	if (Picked.Num() > 0)
+	{
+		Selection.Select(Picked, bAdditive);
+	}
+	else if (!bAdditive)
+	{
+		Selection.Clear();
+	}
+}
+
+void ANecromancerPlayerController::OnSelectCanceled()
+{
+	Selection.CancelDrag();
+}
+
+void ANecromancerPlayerController::OnSelectAllOfTypeStarted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	FVector CursorLocation;
+	if (!GetCursorGroundLocation(CursorLocation))
+	{
+		return;
+	}
+
+	const FSelectableUnitIndex& Units = GetSelectableUnits();
+	TArray<FCombatHandle> Candidates;
+	FCombatSpatialQuery Query;
+	Query.Shape = ECombatQueryShape::Nearest;
+	Query.Origin = CursorLocation;
+	Query.Radius = ClickSelectRadius;
+	Query.TeamMask = CombatTeamBit(ECombatTeam::Undead);
+	Query.MaxResults = 1;
+	Units.Query(Query, Candidates);
+	if (Candidates.IsEmpty())
+	{
+		return;
+	}
+	const UClass* Type = GetUnitType(Candidates[0]);
+
+	// Everything on screen is one query over the ground under the whole viewport
+	int32 ViewportX = 0;
+	int32 ViewportY = 0;
+	GetViewportSize(ViewportX, ViewportY);
+	FVector2D Corners[4];
+	if (!FUnitSelection::ProjectScreenRect(*this, FBox2D(FVector2D::ZeroVector, FVector2D(ViewportX, ViewportY)), CursorLocation.Z, Selection.MaxGroundDistance, Corners))
+	{
+		return;
+	}
+
+	Candidates.Reset();
+	Query.Shape = ECombatQueryShape::Polygon;
+	Query.PolygonPoints = MakeArrayView(Corners, 4);
+	Query.MaxResults = MAX_int32;
+	Units.Query(Query, Candidates);
+	Candidates.RemoveAllSwap([this, Type](const FCombatHandle& Handle) { return GetUnitType(Handle) != Type; }, EAllowShrinking::No);
+	Selection.Select(Candidates, IsSelectionModifierDown());
+}
+
+void ANecromancerPlayerController::OnControlGroupStarted(int32 Group)
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	if (IsInputKeyDown(EKeys::LeftControl) || IsInputKeyDown(EKeys::RightControl))
+	{
+		PruneSelection();
+		Selection.AssignControlGroup(Group);
+	}
+	else if (Selection.RecallControlGroup(Group, IsSelectionModifierDown()))
+	{
+		PruneSelection();
+	}
+}
+
+void ANecromancerPlayerController::RunSelectionBenchmark(int32 NumUnits, int32 Frames, float MaxMs)
+{
+	const APawn* ControlledPawn = GetPawn();
+	int32 ViewportX = 0;
+	int32 ViewportY = 0;
+	GetViewportSize(ViewportX, ViewportY);
+	const FBox2D Viewport(FVector2D::ZeroVector, FVector2D(ViewportX, ViewportY));
+	const float GroundZ = ControlledPawn ? ControlledPawn->GetActorLocation().Z : 0.f;
+	FVector2D Corners[4];
+	if (ViewportX <= 0 || ViewportY <= 0 || !FUnitSelection::ProjectScreenRect(*this, Viewport, GroundZ, Selection.MaxGroundDistance, Corners))
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Selection benchmark needs a viewport looking at the ground"));
+		return;
+	}
+	NumUnits = FMath::Max(NumUnits, 1);
+	Frames = FMath::Max(Frames, 1);
+
+	// Scratch units spread over the ground under the screen, so that the full box ends up holding them all. They are
+	// indexed the way a client indexes replicated combatants and never enter the simulation or the horde.
+	TArray<FCombatantNetRecord> Records;
+	Records.SetNum(NumUnits);
+	FRandomStream Random(NumUnits);
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		const float U = Random.FRand();
+		const float V = Random.FRand();
+		const FVector2D Point = FMath::Lerp(FMath::Lerp(Corners[0], Corners[1], U), FMath::Lerp(Corners[3], Corners[2], U), V);
+		Records[Index].Slot = Index;
+		Records[Index].Serial = 1;
+		Records[Index].Position = FCombatNetPosition::FromVector(FVector(Point, GroundZ));
+		Records[Index].Health = MAX_uint8;
+		Records[Index].Team = ECombatTeam::Undead;
+	}
+	FSelectableUnitIndex Units;
+	Units.Rebuild(Records);
+
+	// A box growing from the top left corner to the whole screen, so that every frame needs a new query
+	const uint32 TeamMask = CombatTeamBit(ECombatTeam::Undead);
+	FUnitSelection Benchmark;
+	Benchmark.BeginDrag(Viewport.Min, false);
+	double BoxTotalMs = 0.0;
+	double BoxMaxMs = 0.0;
+	for (int32 Frame = 0; Frame < Frames; ++Frame)
+	{
+		const FVector2D BoxEnd = Viewport.Min + Viewport.GetSize() * (static_cast<double>(Frame + 1) / Frames);
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		Benchmark.UpdateDrag(*this, BoxEnd, GroundZ, Units, TeamMask);
+		const double Ms = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+		BoxTotalMs += Ms;
+		BoxMaxMs = FMath::Max(BoxMaxMs, Ms);
+	}
+	const int32 NumBoxed = Benchmark.GetUnderBox().Num();
+
+	// The naive way: every unit projected to the screen and tested against the box
+	TArray<FCombatHandle> Inside;
+	double NaiveTotalMs = 0.0;
+	double NaiveMaxMs = 0.0;
+	for (int32 Frame = 0; Frame < Frames; ++Frame)
+	{
+		const FBox2D Box(Viewport.Min, Viewport.Min + Viewport.GetSize() * (static_cast<double>(Frame + 1) / Frames));
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		Inside.Reset();
+		for (const FCombatantNetRecord& Record : Records)
+		{
+			FVector2D ScreenPosition;
+			if (Record.Team == ECombatTeam::Undead && ProjectWorldLocationToScreen(Record.Position.ToVector(), ScreenPosition) && Box.IsInsideOrOn(ScreenPosition))
+			{
+				Inside.Add(Record.GetHandle());
+			}
+		}
+		const double Ms = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+		NaiveTotalMs += Ms;
+		NaiveMaxMs = FMath::Max(NaiveMaxMs, Ms);
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("Box selection over %d undead, %d frames: ground query %.3f ms average, %.3f ms worst, %d selected; screen projection %.3f ms average, %.3f ms worst, %d selected"),
+		NumUnits, Frames, BoxTotalMs / Frames, BoxMaxMs, NumBoxed, NaiveTotalMs / Frames, NaiveMaxMs, Inside.Num());
+	if (MaxMs > 0.f && (BoxTotalMs / Frames > MaxMs || BoxMaxMs > MaxMs))
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Box selection exceeds its budget of %.3f ms per frame: %.3f ms average, %.3f ms worst"), MaxMs, BoxTotalMs / Frames, BoxMaxMs);
+	}
+
+	// Units near the player are promoted to pawns and leave the horde's rows, yet a selection still holds them. A
+	// scratch minion is promoted in the middle of the view and ordered as a selection would be.
+	UMinionHordeSubsystem* Horde = GetWorld()->GetSubsystem<UMinionHordeSubsystem>();
+	if (!HasAuthority() || !Horde)
+	{
+		return;
+	}
+	const FVector Middle(FMath::Lerp(Corners[0], Corners[2], 0.5f), GroundZ);
+	FCombatantDesc Desc;
+	Desc.Team = ECombatTeam::Undead;
+	const FCombatHandle Scratch = Horde->SpawnMinion(Middle, Desc, GetHordeOwnerId());
+	ACombatPawn* Promoted = Horde->PromoteMinion(Scratch);
+	if (!Promoted)
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Selection benchmark could not promote a scratch minion to order"));
+		Horde->RemoveMinion(Scratch);
+		return;
+	}
+
+	const FVector Goal = Middle + FVector(500.f, 0.f, 0.f);
+	ExecuteSelectionOrder(EPlayerCommandType::Move, Goal, MakeArrayView(&Scratch, 1));
+	FVector OrderedGoal;
+	const bool bReceived = Horde->GetMoveGoal(Scratch, OrderedGoal) && OrderedGoal.Equals(Goal);
+	Horde->DemoteMinion(Promoted);
+	Horde->RemoveMinion(Scratch);
+	if (bReceived)
+	{
+		UE_LOG(LogNecromancer, Display, TEXT("Selection order reached a promoted minion"));
 	}
 	else
 	{
-		bHitSuccessful = GetHitResultUnderCursor(ECollisionChannel::ECC_Visibility, true, Hit);
+		UE_LOG(LogNecromancer, Warning, TEXT("Selection order did not reach a promoted minion"));
+	}
+}
+
+void ANecromancerPlayerController::OnRaiseDeadStarted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	FVector CursorLocation;
+	if (GetCursorGroundLocation(CursorLocation))
+	{
+		IssueCommand(EPlayerCommandType::Raise, CursorLocation);
+	}
+}
+
+void ANecromancerPlayerController::OnAttackMoveStarted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	FVector CursorLocation;
+	if (GetCursorGroundLocation(CursorLocation))
+	{
+		if (Selection.HasSelection())
+		{
+			IssueSelectionOrder(EPlayerCommandType::AttackMove, CursorLocation);
+		}
+		else
+		{
+			IssueCommand(EPlayerCommandType::AttackMove, CursorLocation);
+		}
+		if (UFXPoolSubsystem* FXPool = GetWorld()->GetSubsystem<UFXPoolSubsystem>())
+		{
+			FXPool->RequestEffect(FXCursor, CursorLocation);
+		}
+	}
+}
+
+void ANecromancerPlayerController::OnCastStarted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	FVector CursorLocation;
+	if (GetCursorGroundLocation(CursorLocation))
+	{
+		IssueCommand(EPlayerCommandType::Cast, CursorLocation, static_cast<uint8>(CastProjectileType));
 	}
+}
+
+void ANecromancerPlayerController::OnInputStarted()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	StopMovement();
+	bHasPredictedDestination = false;
+}
 
-	// If we hit a surface, cache the location
-	if (bHitSuccessful)
+// Triggered every frame when the input is held down
+void ANecromancerPlayerController::OnSetDestinationTriggered()
+{
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
+	// We flag that the input is being pressed
+	FollowTime += GetWorld()->GetDeltaSeconds();
+	
+	// We look for the location in the world where the player has pressed the input, and cache it if we hit a surface
+	FVector HitLocation;
+	if (GetCursorGroundLocation(HitLocation))
 	{
-		CachedDestination = Hit.Location;
+		CachedDestination = HitLocation;
 	}
 	
 	// Move towards mouse pointer or touch
@@ -119,12 +910,29 @@ void ANecromancerPlayerController::OnSetDestinationTriggered()
 
 void ANecromancerPlayerController::OnSetDestinationReleased()
 {
+	NECRO_SCOPE(STAT_PlayerInput, Input);
+
 	// If it was a short press
 	if (FollowTime <= ShortPressThreshold)
 	{
-		// We move there and spawn some particles
-		UAIBlueprintHelperLibrary::SimpleMoveToLocation(this, CachedDestination);
-		UNiagaraFunctionLibrary::SpawnSystemAtLocation(this, FXCursor, CachedDestination, FRotator::ZeroRotator, FVector(1.f, 1.f, 1.f), true, true, ENCPoolMethod::None, true);
+		// Resolve the exact surface under the last cursor ray, in case only an estimate was available
+		FVector HitLocation;
+		if (CursorProjector.ProjectLastExact(*this, HitLocation))
+		{
+			CachedDestination = HitLocation;
+		}
+
+		// We move there, the selected units or else the whole horde follow as a group on one shared flow field,
+		// and we spawn some particles
+		IssueCommand(EPlayerCommandType::Move, CachedDestination, 0, !Selection.HasSelection());
+		if (Selection.HasSelection())
+		{
+			IssueSelectionOrder(EPlayerCommandType::Move, CachedDestination);
+		}
+		if (UFXPoolSubsystem* FXPool = GetWorld()->GetSubsystem<UFXPoolSubsystem>())
+		{
+			FXPool->RequestEffect(FXCursor, CachedDestination);
+		}
 	}
 
 	FollowTime = 0.f;
@@ -145,6 +953,7 @@ void ANecromancerPlayerController::OnTouchReleased()
 
 void ANecromancerPlayerController::OnSetZoomInTriggered()
 {
+    NECRO_SCOPE(STAT_PlayerInput, Input);
     UE_LOG(LogTemplateCharacter, Verbose, TEXT("'%s' Zoom in triggered."), *GetNameSafe(this));
 
     USpringArmComponent* CameraBoom = GetPawn()->FindComponentByClass<USpringArmComponent>();
@@ -163,6 +972,7 @@ void ANecromancerPlayerController::OnSetZoomInTriggered()
 
 void ANecromancerPlayerController::OnSetZoomOutTriggered()
 {
+    NECRO_SCOPE(STAT_PlayerInput, Input);
     UE_LOG(LogTemplateCharacter, Verbose, TEXT("'%s' Zoom out triggered."), *GetNameSafe(this));
 
     USpringArmComponent* CameraBoom = GetPawn()->FindComponentByClass<USpringArmComponent>();
@@ -181,6 +991,7 @@ void ANecromancerPlayerController::OnSetZoomOutTriggered()
 
 void ANecromancerPlayerController::OnCameraMoveStarted()
 {
+    NECRO_SCOPE(STAT_PlayerInput, Input);
     UE_LOG(LogTemplateCharacter, Verbose, TEXT("'%s' Camera Move started."), *GetNameSafe(this));
 
     FVector2f coords;
@@ -202,6 +1013,7 @@ void ANecromancerPlayerController::OnCameraMoveStarted()
 
 void ANecromancerPlayerController::OnCameraMoveTriggered()
 {
+    NECRO_SCOPE(STAT_PlayerInput, Input);
     UE_LOG(LogTemplateCharacter, Verbose, TEXT("'%s' Camera Move Triggered."), *GetNameSafe(this));
 
     FVector2f deltaPos { 0, 0 };
@@ -247,6 +1059,7 @@ void ANecromancerPlayerController::OnCameraMoveTriggered()
 
 void ANecromancerPlayerController::OnCameraMoveReleased()
 {
+    NECRO_SCOPE(STAT_PlayerInput, Input);
     UE_LOG(LogTemplateCharacter, Verbose, TEXT("'%s' Camera Move ended."), *GetNameSafe(this));
 
     CachedScreenInputPos.X = CachedScreenInputPos.Y = -1.f;
@@ -3,6 +3,9 @@
 #include "CoreMinimal.h"
 #include "Templates/SubclassOf.h"
 #include "GameFramework/PlayerController.h"
+#include "CursorGroundProjector.h"
+#include "PlayerCommands.h"
+#include "UnitSelection.h"
 #include "NecromancerPlayerController.generated.h"
 
 /** Forward declaration to improve compiling times */
@@ -20,6 +23,20 @@ class ANecromancerPlayerController : public APlayerController
 public:
 	ANecromancerPlayerController();
 
+	/**
+	 * Issues a command. On the server it runs at once; on a client it is predicted locally and
+	 * queued for the next batch. Input handlers and scripted benchmarks both go through here.
+	 */
+	void IssueCommand(EPlayerCommandType Type, const FVector& Target, uint8 Ability = 0, bool bOrderHorde = true);
+
+	/** Sends the selected units to Target, attacking on the way for AttackMove. Reliable, since selections are not resent. */
+	void IssueSelectionOrder(EPlayerCommandType Type, const FVector& Target);
+
+	const FUnitSelection& GetUnitSelection() const { return Selection; }
+
+	/** Owner id of the minions this player raised and orders: its player id, or INDEX_NONE without a player state */
+	int32 GetHordeOwnerId() const;
+
 	/** Time Threshold to know if it was a short press */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Input)
 	float ShortPressThreshold;
@@ -39,6 +56,87 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
 	UInputAction* SetDestinationTouchAction;
 
+	/** Raise Dead Input Action */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
+	UInputAction* RaiseDeadAction;
+
+	/** Corpses within this distance of the cursor are highlighted and raised */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = RaiseDead)
+	float RaiseDeadRadius = 400.f;
+
+	/** Most corpses one cast raises, nearest to the cursor first */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = RaiseDead)
+	int32 MaxRaisedPerCast = 10;
+
+	/** Raise dead only reaches corpses around a cursor this close to the necromancer */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = RaiseDead)
+	float RaiseDeadRange = 1500.f;
+
+	/** Seconds between two raise dead casts */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = RaiseDead)
+	float RaiseDeadCooldown = 1.f;
+
+	/** Attack Move Input Action: sends the horde to the cursor, fighting on the way */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
+	UInputAction* AttackMoveAction;
+
+	/** Cast Input Action: fires CastProjectileType at the cursor */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
+	UInputAction* CastAction;
+
+	/** Select Input Action: drag a box to select undead units, or click to pick one. Shift adds to the selection. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
+	UInputAction* SelectAction;
+
+	/** Select All Of Type Input Action: selects every unit on screen of the kind under the cursor */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
+	UInputAction* SelectAllOfTypeAction;
+
+	/** Control Group Input Actions, one per group: recall it, or assign the selection to it while Ctrl is held */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
+	TArray<UInputAction*> ControlGroupActions;
+
+	/** A click selects the unit nearest the cursor within this distance */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Selection)
+	float ClickSelectRadius = 150.f;
+
+	/**
+	 * Logs the per-frame cost of resolving a growing drag box over NumUnits scratch units, against projecting each to
+	 * the screen, and warns if its average or worst frame exceeds MaxMs. With authority, also checks that a selection
+	 * order reaches a scratch minion promoted to a pawn.
+	 */
+	void RunSelectionBenchmark(int32 NumUnits, int32 Frames, float MaxMs);
+
+	/** Index into UProjectileSubsystem's projectile types */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cast)
+	int32 CastProjectileType = 0;
+
+	/** Seconds between two casts */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Cast)
+	float CastCooldown = 0.25f;
+
+	/** Command batches sent to the server per second */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Network)
+	float CommandSendRate = 20.f;
+
+	/** A predicted move ends this close to its destination */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Network)
+	float PredictedMoveAcceptanceRadius = 50.f;
+
+	/** Server: most new commands run from one batch. The client sends the rest again with its next batch. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Network)
+	int32 MaxCommandsPerBatch = 8;
+
+	/**
+	 * Server: how much earlier than its cooldown allows a remote cast or raise may arrive, since jitter and batching
+	 * bring commands closer together. Cooldowns still hold on average.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Network)
+	float CooldownSlack = 0.1f;
+
+	/** Sends Count move commands Interval seconds apart and logs how long they took to show locally and to be acknowledged */
+	void RunCommandLatencyTest(int32 Count, float Interval);
+
     /** Camera Actions */
     /** Mouse Move Camera Action */
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
@@ -81,12 +179,44 @@ protected:
 	// To add mapping context
 	virtual void BeginPlay();
 
+	/** Highlights the corpses under the cursor, steers predicted moves and sends pending commands */
+	virtual void PlayerTick(float DeltaTime) override;
+
+	/** Authoritative effect of a command */
+	void ExecuteCommand(const FPlayerCommand& Command);
+
+	/** Client-side effect of a command while it is on its way to the server */
+	void PredictCommand(const FPlayerCommand& Command);
+
+	UFUNCTION(Server, Unreliable)
+	void ServerExecuteCommands(const FPlayerCommandBatch& Batch);
+
+	UFUNCTION(Client, Unreliable)
+	void ClientAcknowledgeCommands(uint16 Sequence);
+
+	/** Authoritative effect of a selection order */
+	void ExecuteSelectionOrder(EPlayerCommandType Type, const FVector& Target, TConstArrayView<FCombatHandle> Units);
+
+	UFUNCTION(Server, Reliable)
+	void ServerOrderSelection(EPlayerCommandType Type, const FCombatNetPosition& Target, const FCombatHandleSet& Units);
+
+	/** Finds the ground under the mouse or touch point */
+	bool GetCursorGroundLocation(FVector& OutLocation);
+
 	/** Input handlers for SetDestination action. */
 	void OnInputStarted();
 	void OnSetDestinationTriggered();
 	void OnSetDestinationReleased();
 	void OnTouchTriggered();
 	void OnTouchReleased();
+	void OnRaiseDeadStarted();
+	void OnAttackMoveStarted();
+	void OnCastStarted();
+	void OnSelectStarted();
+	void OnSelectCompleted();
+	void OnSelectCanceled();
+	void OnSelectAllOfTypeStarted();
+	void OnControlGroupStarted(int32 Group);
 
     /** Section: Camera **/
 	void OnSetZoomInTriggered();
@@ -102,7 +232,60 @@ protected:
     void OnGestureCameraMoveReleased();
 
 private:
+	void SendCommands(float DeltaTime);
+
+	/** Starts the cooldown of a cast or raise, or returns false if it is still running. Other commands have none. */
+	bool ConsumeCooldown(EPlayerCommandType Type, float Slack);
+	void SteerPredictedMove();
+	void UpdateLatencyTest();
+
+	/** Selectable units in the simulation, or on a client in its replicated combat view */
+	const FSelectableUnitIndex& GetSelectableUnits();
+	void HandleCombatViewChanged();
+
+	/** What counts as the same type for SelectAllOfTypeAction: the pawn class, or null for horde minions */
+	const UClass* GetUnitType(FCombatHandle Handle) const;
+	bool GetScreenPosition(FVector2D& OutPosition);
+	bool IsSelectionModifierDown() const;
+	void PruneSelection();
+
+	FPlayerCommandBuffer Commands;
+	float TimeUntilCommandSend = 0.f;
+
+	/** World time at which the next cast or raise is allowed: locally issued on a client, executed on the server */
+	double NextCastTime = 0.0;
+	double NextRaiseTime = 0.0;
+
+	/** Client: destination of the last predicted move. The character movement component reconciles the result. */
+	FVector PredictedDestination;
+	bool bHasPredictedDestination = false;
+
+	/** State of RunCommandLatencyTest */
+	struct FCommandLatencyTest
+	{
+		TMap<uint16, double> IssueTimes;
+		TArray<double> LocalResponseTimes;
+		TArray<double> AcknowledgeTimes;
+		double LocalIssueTime = -1.0;
+		int32 NumRemaining = 0;
+		int32 NumBatchesSent = 0;
+		int32 NumCommandsSent = 0;
+		FTimerHandle IssueTimer;
+		double Deadline = 0.0;
+		bool bActive = false;
+	};
+	FCommandLatencyTest LatencyTest;
+
+	FUnitSelection Selection;
+	FSelectableUnitIndex SelectableUnits;
+	TWeakObjectPtr<ACombatReplicationProxy> BoundCombatView;
+	bool bSelectableUnitsDirty = true;
+
+	/** Ground height the drag box is projected onto, from the cursor when the drag started */
+	float SelectionGroundZ = 0.f;
+
 	FVector CachedDestination;
+	FCursorGroundProjector CursorProjector;
     FVector2f CachedScreenInputPos;
 
 	bool bIsTouch; // Is it a touch device
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NecromancerStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+
+DEFINE_STAT(STAT_NecroUnits);
+DEFINE_STAT(STAT_NecroTraces);
+DEFINE_STAT(STAT_NecroSpawns);
+DEFINE_STAT(STAT_NecroFX);
+
+#if NECRO_INSTRUMENTATION
+
+CSV_DEFINE_CATEGORY_MODULE(NECROMANCER_API, Necromancer, true);
+
+UE_TRACE_CHANNEL_DEFINE(NecroInputChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroCombatChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroAIChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroMovementChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroUnitsChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroProjectilesChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroFXChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroVisibilityChannel);
+UE_TRACE_CHANNEL_DEFINE(NecroNetworkChannel);
+
+namespace NecroBudget
+{
+	constexpr int32 NumBuckets = static_cast<int32>(ENecroBudget::Num);
+	constexpr int32 NumCounters = static_cast<int32>(ENecroCounter::Num);
+
+	const TCHAR* const BucketNames[NumBuckets] = { TEXT("Input"), TEXT("Combat"), TEXT("AI"), TEXT("Movement"), TEXT("Units"), TEXT("Projectiles"), TEXT("FX"), TEXT("Visibility"), TEXT("Network") };
+	const TCHAR* const CounterNames[NumCounters] = { TEXT("Units"), TEXT("Traces"), TEXT("Spawns"), TEXT("FX") };
+
+	/** Totals of the capture in progress */
+	struct FCapture
+	{
+		int32 FramesLeft = 0;
+		int32 Frames = 0;
+		double FrameSeconds = 0.0;
+		double MaxFrameSeconds = 0.0;
+		double Seconds[NumBuckets] = {};
+		double MaxSeconds[NumBuckets] = {};
+		uint64 Counts[NumCounters] = {};
+		uint32 MaxCounts[NumCounters] = {};
+	};
+	FCapture Capture;
+	FDelegateHandle EndFrameHandle;
+}
+
+static FAutoConsoleCommand GNecroBudgetCommand(
+	TEXT("necro.Stats.Budget"),
+	TEXT("necro.Stats.Budget [Frames]: logs how the game thread frame splits between input, combat, AI, movement, FX and the other systems, with unit, trace, spawn and FX counts"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FNecroBudget::BeginCapture(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300);
+	}));
+
+uint64 FNecroBudget::FrameCycles[static_cast<uint8>(ENecroBudget::Num)] = {};
+uint32 FNecroBudget::FrameCounts[static_cast<uint8>(ENecroCounter::Num)] = {};
+ENecroBudget FNecroBudget::Current = ENecroBudget::Num;
+uint64 FNecroBudget::CurrentStart = 0;
+
+FNecroBudget::FScope::FScope(ENecroBudget InBucket)
+	: Bucket(InBucket)
+	, Outer(Current)
+{
+	const uint64 Now = FPlatformTime::Cycles64();
+	if (Outer != ENecroBudget::Num)
+	{
+		FrameCycles[static_cast<uint8>(Outer)] += Now - CurrentStart;
+	}
+	Current = Bucket;
+	CurrentStart = Now;
+}
+
+FNecroBudget::FScope::~FScope()
+{
+	const uint64 Now = FPlatformTime::Cycles64();
+	FrameCycles[static_cast<uint8>(Bucket)] += Now - CurrentStart;
+	Current = Outer;
+	CurrentStart = Now;
+}
+
+void FNecroBudget::BeginCapture(int32 Frames)
+{
+	NecroBudget::Capture = NecroBudget::FCapture();
+	NecroBudget::Capture.FramesLeft = FMath::Max(Frames, 1);
+	if (!NecroBudget::EndFrameHandle.IsValid())
+	{
+		NecroBudget::EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&FNecroBudget::EndFrame);
+	}
+	FMemory::Memzero(FrameCycles);
+	FMemory::Memzero(FrameCounts);
+}
+
+void FNecroBudget::EndFrame()
+{
+	using namespace NecroBudget;
+
+	const double DeltaSeconds = FApp::GetDeltaTime();
+	Capture.FrameSeconds += DeltaSeconds;
+	Capture.MaxFrameSeconds = FMath::Max(Capture.MaxFrameSeconds, DeltaSeconds);
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		const double Seconds = FPlatformTime::ToSeconds64(FrameCycles[Bucket]);
+		Capture.Seconds[Bucket] += Seconds;
+		Capture.MaxSeconds[Bucket] = FMath::Max(Capture.MaxSeconds[Bucket], Seconds);
+	}
+	for (int32 Counter = 0; Counter < NumCounters; ++Counter)
+	{
+		Capture.Counts[Counter] += FrameCounts[Counter];
+		Capture.MaxCounts[Counter] = FMath::Max(Capture.MaxCounts[Counter], FrameCounts[Counter]);
+	}
+	FMemory::Memzero(FrameCycles);
+	FMemory::Memzero(FrameCounts);
+	++Capture.Frames;
+
+	if (--Capture.FramesLeft > 0)
+	{
+		return;
+	}
+
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	EndFrameHandle.Reset();
+
+	const double ToAverageMs = 1000.0 / Capture.Frames;
+	const double FrameMs = Capture.FrameSeconds * ToAverageMs;
+	double TrackedMs = 0.0;
+	UE_LOG(LogNecromancer, Display, TEXT("Frame budget over %d frames: %.2f ms average, %.2f ms worst"), Capture.Frames, FrameMs, Capture.MaxFrameSeconds * 1000.0);
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		const double AverageMs = Capture.Seconds[Bucket] * ToAverageMs;
+		TrackedMs += AverageMs;
+		UE_LOG(LogNecromancer, Display, TEXT("  %-12s %7.3f ms average %7.3f ms worst %5.1f%%"),
+			BucketNames[Bucket], AverageMs, Capture.MaxSeconds[Bucket] * 1000.0, FrameMs > 0.0 ? AverageMs / FrameMs * 100.0 : 0.0);
+	}
+	UE_LOG(LogNecromancer, Display, TEXT("  %-12s %7.3f ms average"), TEXT("Untracked"), FMath::Max(FrameMs - TrackedMs, 0.0));
+	for (int32 Counter = 0; Counter < NumCounters; ++Counter)
+	{
+		UE_LOG(LogNecromancer, Display, TEXT("  %-12s %9.1f per frame, %u worst"), CounterNames[Counter], static_cast<double>(Capture.Counts[Counter]) / Capture.Frames, Capture.MaxCounts[Counter]);
+	}
+}
+
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Necromancer.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+/** Instrumentation for stat Necromancer, CSV captures, Insights and necro.Stats.Budget. Compiled out in Shipping. */
+#define NECRO_INSTRUMENTATION !UE_BUILD_SHIPPING
+
+/** Systems a frame's game thread time is split between by necro.Stats.Budget, one Insights channel each */
+enum class ENecroBudget : uint8
+{
+	Input,
+	Combat,
+	AI,
+	Movement,
+	Units,
+	Projectiles,
+	FX,
+	Visibility,
+	Network,
+	Num,
+};
+
+/** Per-frame counts reported by stat Necromancer, CSV captures and necro.Stats.Budget */
+enum class ENecroCounter : uint8
+{
+	Units,
+	Traces,
+	Spawns,
+	FX,
+	Num,
+};
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frame Units"), STAT_NecroUnits, STATGROUP_Necromancer, NECROMANCER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Frame Traces"), STAT_NecroTraces, STATGROUP_Necromancer, NECROMANCER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Frame Spawns"), STAT_NecroSpawns, STATGROUP_Necromancer, NECROMANCER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Frame FX"), STAT_NecroFX, STATGROUP_Necromancer, NECROMANCER_API);
+
+#if NECRO_INSTRUMENTATION
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(NECROMANCER_API, Necromancer);
+
+UE_TRACE_CHANNEL_EXTERN(NecroInputChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroCombatChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroAIChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroMovementChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroUnitsChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroProjectilesChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroFXChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroVisibilityChannel, NECROMANCER_API);
+UE_TRACE_CHANNEL_EXTERN(NecroNetworkChannel, NECROMANCER_API);
+
+/**
+ * Game thread time and counts per frame, split by system. Scopes are exclusive: a scope opened inside another
+ * system's scope pauses the outer one, so the buckets add up to at most the frame. Game thread only.
+ */
+class NECROMANCER_API FNecroBudget
+{
+public:
+	/** Logs the average and worst of each bucket over the next Frames frames */
+	static void BeginCapture(int32 Frames);
+
+	static void AddCount(ENecroCounter Counter, uint32 Amount) { FrameCounts[static_cast<uint8>(Counter)] += Amount; }
+	static void SetCount(ENecroCounter Counter, uint32 Value) { FrameCounts[static_cast<uint8>(Counter)] = Value; }
+
+	struct FScope
+	{
+		explicit FScope(ENecroBudget InBucket);
+		~FScope();
+
+	private:
+		ENecroBudget Bucket;
+		ENecroBudget Outer;
+	};
+
+private:
+	static void EndFrame();
+
+	static uint64 FrameCycles[static_cast<uint8>(ENecroBudget::Num)];
+	static uint32 FrameCounts[static_cast<uint8>(ENecroCounter::Num)];
+	static ENecroBudget Current;
+	static uint64 CurrentStart;
+};
+
+/** Times a scope in stat Necromancer, the Necromancer CSV category, the Necro<Bucket> Insights channel and Bucket's budget */
+#define NECRO_SCOPE(Stat, Bucket) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	CSV_SCOPED_TIMING_STAT(Necromancer, Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, Necro##Bucket##Channel); \
+	const FNecroBudget::FScope PREPROCESSOR_JOIN(NecroBudgetScope_, __LINE__)(ENecroBudget::Bucket)
+
+/** Adds Amount to this frame's Counter */
+#define NECRO_COUNT(Counter, Amount) \
+	INC_DWORD_STAT_BY(STAT_Necro##Counter, Amount); \
+	CSV_CUSTOM_STAT(Necromancer, Counter, static_cast<int32>(Amount), ECsvCustomStatOp::Accumulate); \
+	FNecroBudget::AddCount(ENecroCounter::Counter, Amount)
+
+/** Sets this frame's Counter */
+#define NECRO_SET_COUNT(Counter, Value) \
+	SET_DWORD_STAT(STAT_Necro##Counter, Value); \
+	CSV_CUSTOM_STAT(Necromancer, Counter, static_cast<int32>(Value), ECsvCustomStatOp::Set); \
+	FNecroBudget::SetCount(ENecroCounter::Counter, Value)
+
+#else
+
+#define NECRO_SCOPE(Stat, Bucket)
+#define NECRO_COUNT(Counter, Amount)
+#define NECRO_SET_COUNT(Counter, Value)
+
+#endif
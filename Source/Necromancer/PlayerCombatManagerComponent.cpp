@@ -3,3 +3,7 @@
 
 #include "PlayerCombatManagerComponent.h"
 
+UPlayerCombatManagerComponent::UPlayerCombatManagerComponent()
+{
+	Team = ECombatTeam::Undead;
+}
@@ -7,11 +7,13 @@
 #include "PlayerCombatManagerComponent.generated.h"
 
 /**
- * 
+ * Combat handle for the player's necromancer. Fights on the Undead team alongside raised minions.
  */
 UCLASS()
 class NECROMANCER_API UPlayerCombatManagerComponent : public UCombatManagerComponent
 {
 	GENERATED_BODY()
-	
+
+public:
+	UPlayerCombatManagerComponent();
 };
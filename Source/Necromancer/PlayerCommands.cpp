@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PlayerCommands.h"
+
+bool FPlayerCommandBatch::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 NumCommands = Commands.Num();
+	Ar.SerializeIntPacked(NumCommands);
+	Ar << FirstSequence;
+	if (NumCommands > MaxCommands)
+	{
+		bOutSuccess = false;
+		return true;
+	}
+
+	if (Ar.IsLoading())
+	{
+		Commands.SetNum(NumCommands);
+	}
+
+	bOutSuccess = true;
+	for (int32 Index = 0; Index < Commands.Num(); ++Index)
+	{
+		FPlayerCommand& Command = Commands[Index];
+		Command.Sequence = static_cast<uint16>(FirstSequence + Index);
+
+		uint8 Type = static_cast<uint8>(Command.Type);
+		Ar.SerializeBits(&Type, 2);
+		Command.Type = static_cast<EPlayerCommandType>(Type);
+		if (Command.Type == EPlayerCommandType::Cast)
+		{
+			Ar << Command.Ability;
+		}
+		else if (Command.Type == EPlayerCommandType::Move)
+		{
+			uint8 bOrderHorde = Command.bOrderHorde ? 1 : 0;
+			Ar.SerializeBits(&bOrderHorde, 1);
+			Command.bOrderHorde = bOrderHorde != 0;
+		}
+
+		bool bTargetSuccess = true;
+		Command.Target.NetSerialize(Ar, Map, bTargetSuccess);
+		bOutSuccess &= bTargetSuccess;
+	}
+	return true;
+}
+
+bool FCombatHandleSet::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 NumHandles = FMath::Min(Handles.Num(), MaxHandles);
+	Ar.SerializeIntPacked(NumHandles);
+	if (NumHandles > static_cast<uint32>(MaxHandles))
+	{
+		bOutSuccess = false;
+		return true;
+	}
+
+	if (Ar.IsLoading())
+	{
+		Handles.SetNum(NumHandles);
+	}
+
+	int32 PreviousSlot = 0;
+	for (uint32 Index = 0; Index < NumHandles; ++Index)
+	{
+		FCombatHandle& Handle = Handles[Index];
+		uint32 SlotDelta = static_cast<uint32>(Handle.Slot - PreviousSlot);
+		Ar.SerializeIntPacked(SlotDelta);
+		Ar.SerializeIntPacked(Handle.Serial);
+		if (Ar.IsLoading())
+		{
+			Handle.Slot = PreviousSlot + static_cast<int32>(SlotDelta);
+		}
+		PreviousSlot = Handle.Slot;
+	}
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+uint16 FPlayerCommandBuffer::Push(const FPlayerCommand& Command)
+{
+	FPlayerCommand& Queued = Unacknowledged.Add_GetRef(Command);
+	Queued.Sequence = NextSequence++;
+	return Queued.Sequence;
+}
+
+bool FPlayerCommandBuffer::MakeBatch(FPlayerCommandBatch& OutBatch) const
+{
+	OutBatch.Commands.Reset();
+	if (Unacknowledged.IsEmpty())
+	{
+		return false;
+	}
+
+	// Anything past the cap goes in a later batch, once the oldest have been acknowledged
+	OutBatch.FirstSequence = Unacknowledged[0].Sequence;
+	OutBatch.Commands.Append(Unacknowledged.GetData(), FMath::Min(Unacknowledged.Num(), FPlayerCommandBatch::MaxCommands));
+	return true;
+}
+
+void FPlayerCommandBuffer::Acknowledge(uint16 Sequence)
+{
+	int32 NumAcknowledged = 0;
+	while (NumAcknowledged < Unacknowledged.Num() && !IsNewer(Unacknowledged[NumAcknowledged].Sequence, Sequence))
+	{
+		++NumAcknowledged;
+	}
+	Unacknowledged.RemoveAt(0, NumAcknowledged, EAllowShrinking::No);
+}
+
+void FPlayerCommandBuffer::Accept(const FPlayerCommandBatch& Batch, TArray<FPlayerCommand>& OutNew, int32 MaxNew)
+{
+	int32 NumNew = 0;
+	for (const FPlayerCommand& Command : Batch.Commands)
+	{
+		if (NumNew == MaxNew)
+		{
+			break;
+		}
+		if (IsNewer(Command.Sequence, LastAccepted))
+		{
+			OutNew.Add(Command);
+			LastAccepted = Command.Sequence;
+			++NumNew;
+		}
+	}
+}
+
+void FPlayerCommandBuffer::Reset()
+{
+	Unacknowledged.Reset();
+	NextSequence = 1;
+	LastAccepted = 0;
+}
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatReplicationProxy.h"
+#include "PlayerCommands.generated.h"
+
+/** Order a player gives with the mouse or a hotkey */
+UENUM()
+enum class EPlayerCommandType : uint8
+{
+	Move,
+	AttackMove,
+	Cast,
+	Raise,
+};
+
+/** One player order. Sequence numbers wrap around and are compared with FPlayerCommandBuffer::IsNewer. */
+struct FPlayerCommand
+{
+	uint16 Sequence = 0;
+	EPlayerCommandType Type = EPlayerCommandType::Move;
+
+	/** Projectile type for Cast, unused otherwise */
+	uint8 Ability = 0;
+
+	/** Move only: the whole horde follows. Cleared when the order goes to selected units instead. */
+	bool bOrderHorde = true;
+
+	FCombatNetPosition Target;
+};
+
+/**
+ * Consecutive commands sent in one RPC. Only the first sequence number is sent; each command then costs
+ * two bits of type, a byte of ability for casts and a packed quantized target.
+ */
+USTRUCT()
+struct FPlayerCommandBatch
+{
+	GENERATED_BODY()
+
+	static constexpr int32 MaxCommands = 32;
+
+	uint16 FirstSequence = 0;
+	TArray<FPlayerCommand, TInlineAllocator<8>> Commands;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FPlayerCommandBatch> : public TStructOpsTypeTraitsBase2<FPlayerCommandBatch>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/**
+ * Combatants a selection order applies to. The sender sorts them by slot so that each slot is sent as a packed
+ * delta from the previous one; serials are sent packed in full. Larger selections are split over several sets, which
+ * bounds what one RPC can make the server read and look up.
+ */
+USTRUCT()
+struct FCombatHandleSet
+{
+	GENERATED_BODY()
+
+	static constexpr int32 MaxHandles = 512;
+
+	TArray<FCombatHandle> Handles;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FCombatHandleSet> : public TStructOpsTypeTraitsBase2<FCombatHandleSet>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/**
+ * Both ends of the command pipeline. The client keeps every command until the server acknowledges it and resends
+ * the unacknowledged ones in each batch, so batches can travel unreliably: a lost batch only delays its commands
+ * until the next send. The server remembers the last sequence it accepted and drops the repeats.
+ */
+class NECROMANCER_API FPlayerCommandBuffer
+{
+public:
+	/** True if sequence A comes after B, allowing for wrap around */
+	static bool IsNewer(uint16 A, uint16 B) { return static_cast<int16>(A - B) > 0; }
+
+	/** Client: queues Command for sending and returns the sequence number it was given */
+	uint16 Push(const FPlayerCommand& Command);
+
+	/** Client: fills OutBatch with the oldest unacknowledged commands. Returns false if there are none. */
+	bool MakeBatch(FPlayerCommandBatch& OutBatch) const;
+
+	/** Client: forgets the commands up to and including Sequence */
+	void Acknowledge(uint16 Sequence);
+
+	int32 NumUnacknowledged() const { return Unacknowledged.Num(); }
+
+	/**
+	 * Server: appends the commands of Batch that were not accepted before, at most MaxNew of them. The rest stay
+	 * unacknowledged, so the client sends them again with its next batch.
+	 */
+	void Accept(const FPlayerCommandBatch& Batch, TArray<FPlayerCommand>& OutNew, int32 MaxNew = FPlayerCommandBatch::MaxCommands);
+
+	uint16 GetLastAccepted() const { return LastAccepted; }
+
+	void Reset();
+
+private:
+	TArray<FPlayerCommand> Unacknowledged;
+	uint16 NextSequence = 1;
+	uint16 LastAccepted = 0;
+};
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileBenchmarkCommandlet.h"
+#include "BenchmarkWorld.h"
+#include "CombatSubsystem.h"
+#include "Necromancer.h"
+#include "ProjectileSubsystem.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Parse.h"
+
+namespace ProjectileBenchmark
+{
+	constexpr float TargetSpacing = 150.f;
+
+	// Enough health that every target is still alive at the end of a run
+	constexpr float TargetHealth = 1000000.f;
+
+	// Projectiles are fired this high, inside the targets' hit height
+	constexpr float FireHeight = 50.f;
+
+	void AddVolley(TArray<FProjectileSpawn>& Spawns, int32 Count, int32 TypeIndex, float FieldHalfSize, FRandomStream& Random)
+	{
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			FProjectileSpawn& Spawn = Spawns.AddDefaulted_GetRef();
+			Spawn.TypeIndex = TypeIndex;
+			Spawn.Team = ECombatTeam::Undead;
+			const float Angle = Random.FRandRange(0.f, UE_TWO_PI);
+			Spawn.Direction = FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f);
+			Spawn.Origin = FVector(Random.FRandRange(-FieldHalfSize, FieldHalfSize), Random.FRandRange(-FieldHalfSize, FieldHalfSize), FireHeight);
+		}
+	}
+}
+
+UProjectileBenchmarkCommandlet::UProjectileBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UProjectileBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumProjectiles = 20000;
+	int32 NumTargets = 2000;
+	int32 TypeIndex = 0;
+	int32 Frames = 600;
+	float FrameRate = 60.f;
+	float MaxP95Ms = 4.f;
+	float MaxMs = 8.f;
+	FParse::Value(*Params, TEXT("Projectiles="), NumProjectiles);
+	FParse::Value(*Params, TEXT("Targets="), NumTargets);
+	FParse::Value(*Params, TEXT("Type="), TypeIndex);
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("FrameRate="), FrameRate);
+	FParse::Value(*Params, TEXT("MaxP95Ms="), MaxP95Ms);
+	FParse::Value(*Params, TEXT("MaxMs="), MaxMs);
+	NumProjectiles = FMath::Max(NumProjectiles, 1);
+	NumTargets = FMath::Max(NumTargets, 0);
+	Frames = FMath::Max(Frames, 1);
+	FrameRate = FMath::Max(FrameRate, 1.f);
+
+	FBenchmarkWorld World;
+	World.BeginPlay();
+	UCombatSubsystem* Combat = World.Get()->GetSubsystem<UCombatSubsystem>();
+	UProjectileSubsystem* Projectiles = World.Get()->GetSubsystem<UProjectileSubsystem>();
+	if (!Combat || !Projectiles)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("ProjectileBenchmark: the benchmark world has no combat or projectile subsystem"));
+		return 1;
+	}
+	if (!Projectiles->ProjectileTypes.IsValidIndex(TypeIndex))
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("ProjectileBenchmark: there is no projectile type %d, %d are configured"), TypeIndex, Projectiles->ProjectileTypes.Num());
+		return 1;
+	}
+	if (NumProjectiles > Projectiles->MaxProjectiles)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("ProjectileBenchmark: %d projectiles exceed the limit of %d"), NumProjectiles, Projectiles->MaxProjectiles);
+		return 1;
+	}
+
+	// A square field of targets hostile to the projectiles, which are fired from anywhere inside it
+	const int32 Columns = FMath::Max(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumTargets))), 1);
+	const float FieldHalfSize = Columns * ProjectileBenchmark::TargetSpacing * 0.5f;
+	for (int32 Index = 0; Index < NumTargets; ++Index)
+	{
+		FCombatantDesc Desc;
+		Desc.Team = ECombatTeam::Living;
+		Desc.MaxHealth = ProjectileBenchmark::TargetHealth;
+		Desc.Location = FVector((Index % Columns) * ProjectileBenchmark::TargetSpacing - FieldHalfSize, (Index / Columns) * ProjectileBenchmark::TargetSpacing - FieldHalfSize, 0.f);
+		Combat->RegisterCombatant(Desc);
+	}
+
+	FRandomStream Random(NumProjectiles);
+	TArray<FProjectileSpawn> Spawns;
+	Spawns.Reserve(NumProjectiles);
+	ProjectileBenchmark::AddVolley(Spawns, NumProjectiles, TypeIndex, FieldHalfSize, Random);
+	Projectiles->FireBatch(Spawns);
+
+	// One second of warmup lets the first volley spread out; each frame then tops the count back up before ticking
+	const float DeltaSeconds = 1.f / FrameRate;
+	const int32 WarmupFrames = FMath::CeilToInt32(FrameRate);
+	int32 MinLive = MAX_int32;
+	int64 NumFired = NumProjectiles;
+	FBenchmarkFrameTimes GameThreadMs;
+	for (int32 Frame = 0; Frame < WarmupFrames + Frames; ++Frame)
+	{
+		Spawns.Reset();
+		ProjectileBenchmark::AddVolley(Spawns, NumProjectiles - Projectiles->GetNumProjectiles(), TypeIndex, FieldHalfSize, Random);
+		Projectiles->FireBatch(Spawns);
+		NumFired += Spawns.Num();
+
+		const double Ms = World.Tick(DeltaSeconds);
+		if (Frame >= WarmupFrames)
+		{
+			GameThreadMs.Add(Ms);
+			MinLive = FMath::Min(MinLive, Projectiles->GetNumProjectiles());
+		}
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("ProjectileBenchmark: %d projectiles of type %s among %d targets, %lld fired, at least %d live, %d frames at %.0f fps"),
+		NumProjectiles, *Projectiles->ProjectileTypes[TypeIndex].Name.ToString(), NumTargets, NumFired, MinLive, Frames, FrameRate);
+	UE_LOG(LogNecromancer, Display, TEXT("ProjectileBenchmark: game thread %.3fms on average, p95 %.3fms, p99 %.3fms, worst %.3fms"),
+		GameThreadMs.GetAverage(), GameThreadMs.GetPercentile(95), GameThreadMs.GetPercentile(99), GameThreadMs.GetMax());
+
+	// Fired projectiles enter the simulation at the next step, so a world that never steps would measure nothing
+	bool bFailed = false;
+	if (MinLive == 0)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("ProjectileBenchmark: no projectiles were live during a measured frame"));
+		bFailed = true;
+	}
+	if (MaxP95Ms > 0.f && GameThreadMs.GetPercentile(95) > MaxP95Ms)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("ProjectileBenchmark: p95 %.3fms exceeds %.3fms"), GameThreadMs.GetPercentile(95), MaxP95Ms);
+		bFailed = true;
+	}
+	if (MaxMs > 0.f && GameThreadMs.GetMax() > MaxMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("ProjectileBenchmark: worst frame %.3fms exceeds %.3fms"), GameThreadMs.GetMax(), MaxMs);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ProjectileBenchmarkCommandlet.generated.h"
+
+/**
+ * Keeps a benchmark world full of projectiles flying through a field of targets and measures the game thread time
+ * of every world tick: projectile moves, hits through the spatial grid, the damage they queue and instance updates.
+ * Expired projectiles are replaced every frame so the count stays up. Meant to run with -nullrhi.
+ *
+ * Usage: -run=ProjectileBenchmark [-Projectiles=20000] [-Targets=2000] [-Type=0] [-Frames=600] [-FrameRate=60] [-MaxP95Ms=4] [-MaxMs=8]
+ * Returns non-zero if the projectile type does not exist, the projectiles could not be fired or a limit is exceeded;
+ * a limit of zero is not checked.
+ */
+UCLASS()
+class UProjectileBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UProjectileBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,411 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileSubsystem.h"
+#include "CombatSubsystem.h"
+#include "FlowFieldSubsystem.h"
+#include "NecromancerStats.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Tick"), STAT_ProjectileTick, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Projectile Step"), STAT_ProjectileStep, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Projectile Move"), STAT_ProjectileMove, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Projectile Hits"), STAT_ProjectileHits, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Projectile Render"), STAT_ProjectileRender, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectiles"), STAT_Projectiles, STATGROUP_Necromancer);
+
+namespace ProjectileSystem
+{
+	// Projectiles processed per ParallelFor task
+	constexpr int32 BatchSize = 1024;
+
+	// Candidates checked against the path per projectile
+	constexpr int32 MaxHitCandidates = 4;
+}
+
+bool UProjectileSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSubsystem, STATGROUP_Tickables);
+}
+
+void UProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UCombatSubsystem* CombatSubsystem = Collection.InitializeDependency<UCombatSubsystem>();
+	CombatStepHandle = CombatSubsystem->OnPreStep.AddUObject(this, &UProjectileSubsystem::HandleCombatStep);
+}
+
+void UProjectileSubsystem::Deinitialize()
+{
+	if (UCombatSubsystem* CombatSubsystem = GetCombatSubsystem())
+	{
+		CombatSubsystem->OnPreStep.Remove(CombatStepHandle);
+	}
+
+	PositionX.Empty();
+	PositionY.Empty();
+	PositionZ.Empty();
+	PreviousX.Empty();
+	PreviousY.Empty();
+	PreviousZ.Empty();
+	VelocityX.Empty();
+	VelocityY.Empty();
+	VelocityZ.Empty();
+	Gravity.Empty();
+	Radius.Empty();
+	Damage.Empty();
+	StepsLeft.Empty();
+	HostileMask.Empty();
+	Instigator.Empty();
+	Type.Empty();
+	PendingHit.Empty();
+	PendingSpawns.Empty();
+	InstanceTransforms.Empty();
+	InstancedMeshes.Empty();
+	RenderActor = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UProjectileSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	InstancedMeshes.Init(nullptr, ProjectileTypes.Num());
+	InstanceTransforms.SetNum(ProjectileTypes.Num());
+
+	// Servers never draw projectiles
+	if (InWorld.GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	RenderActor = InWorld.SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+	RenderActor->SetRootComponent(NewObject<USceneComponent>(RenderActor, TEXT("Root")));
+	RenderActor->GetRootComponent()->RegisterComponent();
+
+	for (int32 Index = 0; Index < ProjectileTypes.Num(); ++Index)
+	{
+		UStaticMesh* Mesh = ProjectileTypes[Index].Mesh.LoadSynchronous();
+		if (!Mesh)
+		{
+			continue;
+		}
+
+		UInstancedStaticMeshComponent* InstancedMesh = NewObject<UInstancedStaticMeshComponent>(RenderActor);
+		InstancedMesh->SetMobility(EComponentMobility::Movable);
+		InstancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		InstancedMesh->SetCastShadow(false);
+		InstancedMesh->SetStaticMesh(Mesh);
+		InstancedMesh->SetupAttachment(RenderActor->GetRootComponent());
+		InstancedMesh->RegisterComponent();
+		InstancedMeshes[Index] = InstancedMesh;
+	}
+}
+
+UCombatSubsystem* UProjectileSubsystem::GetCombatSubsystem() const
+{
+	return GetWorld()->GetSubsystem<UCombatSubsystem>();
+}
+
+int32 UProjectileSubsystem::FindProjectileType(FName Name) const
+{
+	return ProjectileTypes.IndexOfByPredicate([Name](const FProjectileType& ProjectileType)
+	{
+		return ProjectileType.Name == Name;
+	});
+}
+
+void UProjectileSubsystem::Fire(int32 InTypeIndex, FCombatHandle InInstigator, ECombatTeam Team, const FVector& Origin, const FVector& Direction)
+{
+	FProjectileSpawn& Spawn = PendingSpawns.AddDefaulted_GetRef();
+	Spawn.TypeIndex = InTypeIndex;
+	Spawn.Instigator = InInstigator;
+	Spawn.Team = Team;
+	Spawn.Origin = Origin;
+	Spawn.Direction = Direction;
+}
+
+void UProjectileSubsystem::FireBatch(TConstArrayView<FProjectileSpawn> Spawns)
+{
+	PendingSpawns.Append(Spawns.GetData(), Spawns.Num());
+}
+
+void UProjectileSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	NECRO_SCOPE(STAT_ProjectileTick, Projectiles);
+	RunRenderProcessor();
+
+	SET_DWORD_STAT(STAT_Projectiles, Type.Num());
+}
+
+void UProjectileSubsystem::HandleCombatStep(float StepSeconds)
+{
+	NECRO_SCOPE(STAT_ProjectileStep, Projectiles);
+	SpawnPending();
+	RunMoveProcessor(StepSeconds);
+	RunHitProcessor();
+}
+
+void UProjectileSubsystem::SpawnPending()
+{
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	if (!CombatSubsystem || PendingSpawns.Num() == 0)
+	{
+		return;
+	}
+
+	const FCombatSimulation& Simulation = CombatSubsystem->GetSimulation();
+	for (int32 SpawnIndex = 0; SpawnIndex < PendingSpawns.Num(); ++SpawnIndex)
+	{
+		const FProjectileSpawn& Spawn = PendingSpawns[SpawnIndex];
+		if (Type.Num() >= MaxProjectiles)
+		{
+			UE_LOG(LogNecromancer, Warning, TEXT("Projectile cap of %d reached, dropping %d projectiles"), MaxProjectiles, PendingSpawns.Num() - SpawnIndex);
+			break;
+		}
+		if (!ProjectileTypes.IsValidIndex(Spawn.TypeIndex))
+		{
+			continue;
+		}
+
+		const FProjectileType& ProjectileType = ProjectileTypes[Spawn.TypeIndex];
+		const FVector Velocity = Spawn.Direction.GetSafeNormal() * ProjectileType.Speed;
+		PositionX.Add(Spawn.Origin.X);
+		PositionY.Add(Spawn.Origin.Y);
+		PositionZ.Add(Spawn.Origin.Z);
+		PreviousX.Add(Spawn.Origin.X);
+		PreviousY.Add(Spawn.Origin.Y);
+		PreviousZ.Add(Spawn.Origin.Z);
+		VelocityX.Add(Velocity.X);
+		VelocityY.Add(Velocity.Y);
+		VelocityZ.Add(Velocity.Z);
+		Gravity.Add(ProjectileType.Gravity);
+		Radius.Add(ProjectileType.Radius);
+		Damage.Add(ProjectileType.Damage);
+		StepsLeft.Add(Simulation.SecondsToSteps(ProjectileType.Lifetime));
+		HostileMask.Add(CombatHostileTeamMask(Spawn.Team));
+		Instigator.Add(Spawn.Instigator);
+		Type.Add(static_cast<uint8>(Spawn.TypeIndex));
+	}
+	PendingSpawns.Reset();
+}
+
+void UProjectileSubsystem::RunMoveProcessor(float StepSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileMove);
+
+	const int32 NumProjectiles = Type.Num();
+	ParallelFor(FMath::DivideAndRoundUp(NumProjectiles, ProjectileSystem::BatchSize), [this, NumProjectiles, StepSeconds](int32 BatchIndex)
+	{
+		const int32 Start = BatchIndex * ProjectileSystem::BatchSize;
+		const int32 End = FMath::Min(Start + ProjectileSystem::BatchSize, NumProjectiles);
+
+		// Plain loops over separate float arrays, so the compiler can vectorize each of them
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			PreviousX[Index] = PositionX[Index];
+			PreviousY[Index] = PositionY[Index];
+			PreviousZ[Index] = PositionZ[Index];
+		}
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			VelocityZ[Index] -= Gravity[Index] * StepSeconds;
+		}
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			PositionX[Index] += VelocityX[Index] * StepSeconds;
+			PositionY[Index] += VelocityY[Index] * StepSeconds;
+			PositionZ[Index] += VelocityZ[Index] * StepSeconds;
+		}
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			--StepsLeft[Index];
+		}
+	});
+}
+
+void UProjectileSubsystem::RunHitProcessor()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileHits);
+
+	UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	const int32 NumProjectiles = Type.Num();
+	if (!CombatSubsystem || NumProjectiles == 0)
+	{
+		return;
+	}
+
+	// Ground heights come from the flow field cost grid, when there is one
+	const UFlowFieldSubsystem* FlowFields = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+	const TSharedPtr<const FFlowFieldCostGrid> CostGrid = FlowFields ? FlowFields->GetCostGrid() : TSharedPtr<const FFlowFieldCostGrid>();
+	const FFlowFieldCostGrid* Ground = CostGrid.Get();
+
+	// Look for a hostile near each step's path. The grids are only read, and each projectile writes its own slot.
+	// Every batch hands its hits to the event bus in one go; the bus orders them before they are applied.
+	const FCombatSimulation& Simulation = CombatSubsystem->GetSimulation();
+	FCombatEventBus& EventBus = CombatSubsystem->GetEventBus();
+	PendingHit.SetNumUninitialized(NumProjectiles, EAllowShrinking::No);
+	ParallelFor(FMath::DivideAndRoundUp(NumProjectiles, ProjectileSystem::BatchSize), [this, &Simulation, &EventBus, Ground, NumProjectiles](int32 BatchIndex)
+	{
+		TArray<FCombatHandle> Candidates;
+		TArray<FCombatEvent> Hits;
+		const int32 Start = BatchIndex * ProjectileSystem::BatchSize;
+		const int32 End = FMath::Min(Start + ProjectileSystem::BatchSize, NumProjectiles);
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			PendingHit[Index] = FCombatHandle();
+
+			// Into the ground: this step's path can still hit, but the projectile goes no further
+			if (Ground && PositionZ[Index] < Ground->SampleHeight(FVector(PositionX[Index], PositionY[Index], 0.f)))
+			{
+				StepsLeft[Index] = 0;
+			}
+			if (HostileMask[Index] == 0)
+			{
+				continue;
+			}
+
+			const FVector From(PreviousX[Index], PreviousY[Index], 0.f);
+			const FVector To(PositionX[Index], PositionY[Index], 0.f);
+
+			FCombatSpatialQuery Query;
+			Query.Shape = ECombatQueryShape::Nearest;
+			Query.Origin = (From + To) * 0.5;
+			Query.Radius = FVector::Dist(From, To) * 0.5f + Radius[Index];
+			Query.TeamMask = HostileMask[Index];
+			Query.MaxResults = ProjectileSystem::MaxHitCandidates;
+
+			Candidates.Reset();
+			Simulation.Query(Query, Candidates);
+			const FVector Path = To - From;
+			const double PathLengthSq = Path.SizeSquared();
+			for (const FCombatHandle& Candidate : Candidates)
+			{
+				const FVector CandidateLocation = Simulation.GetLocation(Candidate);
+				const FVector CandidateXY(CandidateLocation.X, CandidateLocation.Y, 0.f);
+				if (FMath::PointDistToSegmentSquared(CandidateXY, From, To) > FMath::Square(Radius[Index]))
+				{
+					continue;
+				}
+
+				// Height of the path where it passes closest, e.g. an arc over the candidate's head
+				const double Alpha = PathLengthSq > UE_SMALL_NUMBER ? FMath::Clamp(((CandidateXY - From) | Path) / PathLengthSq, 0.0, 1.0) : 1.0;
+				const float PathZ = FMath::Lerp(PreviousZ[Index], PositionZ[Index], static_cast<float>(Alpha));
+				if (FMath::Abs(PathZ - CandidateLocation.Z) <= CombatantHalfHeight + Radius[Index])
+				{
+					PendingHit[Index] = Candidate;
+					Hits.Add(FCombatEvent::MakeDamage(Candidate, Instigator[Index], Damage[Index]));
+					break;
+				}
+			}
+		}
+		EventBus.EnqueueBatch(MoveTemp(Hits));
+	});
+
+	for (int32 Index = NumProjectiles - 1; Index >= 0; --Index)
+	{
+		if (PendingHit[Index].IsValid() || StepsLeft[Index] <= 0)
+		{
+			RemoveProjectile(Index);
+		}
+	}
+}
+
+void UProjectileSubsystem::RemoveProjectile(int32 Index)
+{
+	PositionX.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PositionY.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PositionZ.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PreviousX.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PreviousY.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PreviousZ.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	VelocityX.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	VelocityY.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	VelocityZ.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Gravity.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Radius.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Damage.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	StepsLeft.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	HostileMask.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Instigator.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Type.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	PendingHit.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+}
+
+void UProjectileSubsystem::RunRenderProcessor()
+{
+	if (!RenderActor)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileRender);
+
+	const UCombatSubsystem* CombatSubsystem = GetCombatSubsystem();
+	const float Alpha = CombatSubsystem ? CombatSubsystem->GetInterpolationAlpha() : 1.f;
+
+	for (TArray<FTransform>& Transforms : InstanceTransforms)
+	{
+		Transforms.Reset();
+	}
+
+	// Bucket by type, drawn between the last two steps and facing along the velocity
+	for (int32 Index = 0; Index < Type.Num(); ++Index)
+	{
+		if (!InstancedMeshes[Type[Index]])
+		{
+			continue;
+		}
+
+		const FVector Previous(PreviousX[Index], PreviousY[Index], PreviousZ[Index]);
+		const FVector Current(PositionX[Index], PositionY[Index], PositionZ[Index]);
+		const FVector Velocity(VelocityX[Index], VelocityY[Index], VelocityZ[Index]);
+		InstanceTransforms[Type[Index]].Emplace(Velocity.Rotation(), FMath::Lerp(Previous, Current, Alpha), ProjectileTypes[Type[Index]].MeshScale);
+	}
+
+	for (int32 TypeIndex = 0; TypeIndex < InstancedMeshes.Num(); ++TypeIndex)
+	{
+		UInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[TypeIndex];
+		if (!InstancedMesh)
+		{
+			continue;
+		}
+
+		// Instances are interchangeable, so only the count changes at the tail
+		const TArray<FTransform>& Transforms = InstanceTransforms[TypeIndex];
+		const int32 NumInstances = InstancedMesh->GetInstanceCount();
+		if (NumInstances > Transforms.Num())
+		{
+			TArray<int32> ToRemove;
+			for (int32 Index = NumInstances - 1; Index >= Transforms.Num(); --Index)
+			{
+				ToRemove.Add(Index);
+			}
+			InstancedMesh->RemoveInstances(ToRemove, true);
+		}
+		else if (NumInstances < Transforms.Num())
+		{
+			TArray<FTransform> NewInstances(Transforms.GetData() + NumInstances, Transforms.Num() - NumInstances);
+			InstancedMesh->AddInstances(NewInstances, false, true);
+		}
+
+		if (Transforms.Num() > 0)
+		{
+			InstancedMesh->BatchUpdateInstancesTransforms(0, Transforms, true, true, false);
+		}
+	}
+}
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "ProjectileSubsystem.generated.h"
+
+class UCombatSubsystem;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/** Kind of projectile, e.g. an arrow or a bolt. Fired by index into UProjectileSubsystem::ProjectileTypes. */
+USTRUCT()
+struct FProjectileType
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName Name;
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UStaticMesh> Mesh;
+
+	/** Mesh scale; the mesh's X axis points along the velocity */
+	UPROPERTY(Config)
+	FVector MeshScale = FVector::OneVector;
+
+	UPROPERTY(Config)
+	float Speed = 2000.f;
+
+	/** Downward acceleration; zero flies straight */
+	UPROPERTY(Config)
+	float Gravity = 0.f;
+
+	/** Hits combatants within this distance of its path */
+	UPROPERTY(Config)
+	float Radius = 40.f;
+
+	UPROPERTY(Config)
+	float Lifetime = 3.f;
+
+	UPROPERTY(Config)
+	float Damage = 10.f;
+};
+
+/** A projectile to fire, see UProjectileSubsystem::FireBatch */
+struct FProjectileSpawn
+{
+	int32 TypeIndex = 0;
+	FCombatHandle Instigator;
+	ECombatTeam Team = ECombatTeam::Neutral;
+	FVector Origin = FVector::ZeroVector;
+	FVector Direction = FVector::ForwardVector;
+};
+
+/**
+ * Every live projectile, stored as parallel arrays rather than one actor each. Projectiles advance on the
+ * combat subsystem's fixed step in one parallel pass over contiguous components, find hits through the combat
+ * spatial grid, and queue them on the combat event bus. A projectile that goes below the ground heights of the flow
+ * field cost grid expires. Each type is drawn through one instanced mesh.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UProjectileSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Index of the type called Name, or INDEX_NONE */
+	int32 FindProjectileType(FName Name) const;
+
+	/** Queues a projectile; it enters the simulation at the next step. Hits only combatants hostile to Team. */
+	void Fire(int32 InTypeIndex, FCombatHandle InInstigator, ECombatTeam Team, const FVector& Origin, const FVector& Direction);
+
+	/** Queues a whole volley at once */
+	void FireBatch(TConstArrayView<FProjectileSpawn> Spawns);
+
+	int32 GetNumProjectiles() const { return Type.Num(); }
+
+	UPROPERTY(Config)
+	TArray<FProjectileType> ProjectileTypes;
+
+	/** Projectiles beyond this are not fired */
+	UPROPERTY(Config)
+	int32 MaxProjectiles = 32768;
+
+	/** A combatant can be hit this far above or below its location */
+	UPROPERTY(Config)
+	float CombatantHalfHeight = 100.f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void HandleCombatStep(float StepSeconds);
+	void SpawnPending();
+	void RunMoveProcessor(float StepSeconds);
+	void RunHitProcessor();
+	void RemoveProjectile(int32 Index);
+	void RunRenderProcessor();
+
+	UCombatSubsystem* GetCombatSubsystem() const;
+
+	/** Projectiles, one entry each. Positions and velocities are split per axis so the move pass vectorizes. */
+	TArray<float> PositionX;
+	TArray<float> PositionY;
+	TArray<float> PositionZ;
+	TArray<float> PreviousX;
+	TArray<float> PreviousY;
+	TArray<float> PreviousZ;
+	TArray<float> VelocityX;
+	TArray<float> VelocityY;
+	TArray<float> VelocityZ;
+	TArray<float> Gravity;
+	TArray<float> Radius;
+	TArray<float> Damage;
+	TArray<int32> StepsLeft;
+	TArray<uint32> HostileMask;
+	TArray<FCombatHandle> Instigator;
+	TArray<uint8> Type;
+
+	/** Combatant hit this step, written by the parallel hit pass */
+	TArray<FCombatHandle> PendingHit;
+
+	TArray<FProjectileSpawn> PendingSpawns;
+
+	UPROPERTY(Transient)
+	TObjectPtr<AActor> RenderActor;
+
+	/** One per entry of ProjectileTypes, null for types without a mesh */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> InstancedMeshes;
+
+	TArray<TArray<FTransform>> InstanceTransforms;
+
+	FDelegateHandle CombatStepHandle;
+};
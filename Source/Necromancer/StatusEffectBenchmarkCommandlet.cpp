@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StatusEffectBenchmarkCommandlet.h"
+#include "CombatEventBus.h"
+#include "CombatSimulation.h"
+#include "CombatTimerWheel.h"
+#include "StatusEffectStore.h"
+#include "Necromancer.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Parse.h"
+
+namespace StatusEffectBenchmark
+{
+	constexpr float UnitSpacing = 150.f;
+	constexpr float MinDuration = 2.f;
+	constexpr float MaxDuration = 8.f;
+
+	TArray<FStatusEffectDef> MakeDefinitions(int32 NumEffects, FRandomStream& Random)
+	{
+		TArray<FStatusEffectDef> Definitions;
+		for (int32 Index = 0; Index < NumEffects; ++Index)
+		{
+			FStatusEffectDef& Def = Definitions.AddDefaulted_GetRef();
+			Def.Name = FName(TEXT("Effect"), Index + 1);
+			Def.Attribute = static_cast<ECombatAttribute>(Index % static_cast<int32>(ECombatAttribute::Num));
+			Def.Op = Index % 2 ? EStatusEffectOp::Multiply : EStatusEffectOp::Add;
+			Def.Magnitude = Def.Op == EStatusEffectOp::Multiply ? 0.01f : 0.5f;
+			Def.Duration = Random.FRandRange(MinDuration, MaxDuration);
+			Def.MaxStacks = 3;
+			Def.DamagePerTick = Index % 5 == 0 ? 0.1f : 0.f;
+		}
+
+		FStatusEffectDef& Aura = Definitions.AddDefaulted_GetRef();
+		Aura.Name = TEXT("BenchmarkAura");
+		Aura.Duration = 0.f;
+		Aura.AuraRadius = 600.f;
+		Aura.AuraEffect = Definitions[0].Name;
+		return Definitions;
+	}
+}
+
+UStatusEffectBenchmarkCommandlet::UStatusEffectBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UStatusEffectBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumUnits = 2000;
+	int32 EffectsPerUnit = 50;
+	int32 NumAuras = 100;
+	float Seconds = 10.f;
+	int32 Seed = 0;
+	float MaxStepMs = 2.f;
+	float MaxWorstStepMs = 8.f;
+	FParse::Value(*Params, TEXT("Units="), NumUnits);
+	FParse::Value(*Params, TEXT("EffectsPerUnit="), EffectsPerUnit);
+	FParse::Value(*Params, TEXT("Auras="), NumAuras);
+	FParse::Value(*Params, TEXT("Seconds="), Seconds);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("MaxStepMs="), MaxStepMs);
+	FParse::Value(*Params, TEXT("MaxWorstStepMs="), MaxWorstStepMs);
+	NumUnits = FMath::Max(NumUnits, 1);
+	EffectsPerUnit = FMath::Max(EffectsPerUnit, 1);
+
+	FRandomStream Random(Seed);
+	FCombatSimulation Simulation;
+	FCombatTimerWheel Timers;
+	FCombatEventBus EventBus;
+	FStatusEffectStore StatusEffects(Simulation, Timers, EventBus);
+	StatusEffects.SetDefinitions(StatusEffectBenchmark::MakeDefinitions(EffectsPerUnit, Random));
+	const int32 AuraDefinition = EffectsPerUnit;
+
+	const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumUnits)));
+	TArray<FCombatHandle> Units;
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		FCombatantDesc Desc;
+		Desc.Team = ECombatTeam::Undead;
+		Desc.MaxHealth = 1000.f;
+		Desc.Location = FVector((Index % Columns) * StatusEffectBenchmark::UnitSpacing, (Index / Columns) * StatusEffectBenchmark::UnitSpacing, 0.f);
+		Units.Add(Simulation.Add(Desc));
+	}
+
+	double Start = FPlatformTime::Seconds();
+	for (const FCombatHandle& Unit : Units)
+	{
+		for (int32 Definition = 0; Definition < EffectsPerUnit; ++Definition)
+		{
+			StatusEffects.Apply(Unit, FCombatHandle(), Definition);
+		}
+	}
+	for (int32 Index = 0; Index < FMath::Min(NumAuras, NumUnits); ++Index)
+	{
+		StatusEffects.Apply(Units[Random.RandHelper(NumUnits)], FCombatHandle(), AuraDefinition);
+	}
+	StatusEffects.Flush();
+	const double SetupSeconds = FPlatformTime::Seconds() - Start;
+
+	// Re-apply about as many effects per step as expire, so every unit stays near EffectsPerUnit
+	const int32 Steps = FMath::CeilToInt32(Seconds * Simulation.GetSettings().StepsPerSecond);
+	const float MeanDurationSteps = (StatusEffectBenchmark::MinDuration + StatusEffectBenchmark::MaxDuration) * 0.5f * Simulation.GetSettings().StepsPerSecond;
+	const int32 ApplicationsPerStep = FMath::CeilToInt32(NumUnits * EffectsPerUnit / MeanDurationSteps);
+	const uint32 AuraRefreshSteps = Simulation.SecondsToSteps(0.5f);
+
+	TArray<FCombatTimerExpiry> Expired;
+	TArray<FCombatEventResult> Results;
+	double StepSeconds = 0.0;
+	double WorstStepSeconds = 0.0;
+	uint64 EffectSamples = 0;
+	for (int32 Step = 0; Step < Steps; ++Step)
+	{
+		Start = FPlatformTime::Seconds();
+
+		Expired.Reset();
+		Timers.Advance(Expired);
+		StatusEffects.HandleExpiredTimers(Expired);
+		for (int32 Index = 0; Index < ApplicationsPerStep; ++Index)
+		{
+			StatusEffects.Apply(Units[Random.RandHelper(NumUnits)], FCombatHandle(), Random.RandHelper(EffectsPerUnit));
+		}
+		if (Step % AuraRefreshSteps == 0)
+		{
+			StatusEffects.RefreshAuras(AuraRefreshSteps * 2);
+		}
+		StatusEffects.Flush();
+
+		const double Elapsed = FPlatformTime::Seconds() - Start;
+		StepSeconds += Elapsed;
+		WorstStepSeconds = FMath::Max(WorstStepSeconds, Elapsed);
+		EffectSamples += StatusEffects.GetNumEffects();
+
+		// Damage ticks are not part of the store's cost
+		Results.Reset();
+		EventBus.Apply(Simulation, Results);
+	}
+
+	UE_LOG(LogNecromancer, Display, TEXT("StatusEffectBenchmark: %d units, %d effect kinds, %d auras, setup %.1fms"),
+		NumUnits, EffectsPerUnit, NumAuras, SetupSeconds * 1000.0);
+	UE_LOG(LogNecromancer, Display, TEXT("StatusEffectBenchmark: %d steps, %.0f live effects on average, %d applications/step"),
+		Steps, EffectSamples / static_cast<double>(FMath::Max(Steps, 1)), ApplicationsPerStep);
+	const double AverageStepMs = StepSeconds * 1000.0 / FMath::Max(Steps, 1);
+	UE_LOG(LogNecromancer, Display, TEXT("StatusEffectBenchmark: %.3fms per step on average, %.3fms worst"),
+		AverageStepMs, WorstStepSeconds * 1000.0);
+
+	bool bFailed = false;
+	if (MaxStepMs > 0.f && AverageStepMs > MaxStepMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("StatusEffectBenchmark: %.3fms per step exceeds %.3fms"), AverageStepMs, MaxStepMs);
+		bFailed = true;
+	}
+	if (MaxWorstStepMs > 0.f && WorstStepSeconds * 1000.0 > MaxWorstStepMs)
+	{
+		UE_LOG(LogNecromancer, Error, TEXT("StatusEffectBenchmark: worst step %.3fms exceeds %.3fms"), WorstStepSeconds * 1000.0, MaxWorstStepMs);
+		bFailed = true;
+	}
+	return bFailed ? 1 : 0;
+}
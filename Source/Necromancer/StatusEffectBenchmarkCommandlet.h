@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StatusEffectBenchmarkCommandlet.generated.h"
+
+/**
+ * Measures the per-step cost of FStatusEffectStore with many effects per combatant, including churn and auras.
+ *
+ * Usage: -run=StatusEffectBenchmark [-Units=2000] [-EffectsPerUnit=50] [-Auras=100] [-Seconds=10] [-Seed=0] [-MaxStepMs=2] [-MaxWorstStepMs=8]
+ * Returns non-zero if the average or the worst step exceeds its limit; a limit of zero is not checked.
+ */
+UCLASS()
+class UStatusEffectBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStatusEffectBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,531 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StatusEffectStore.h"
+#include "CombatEventBus.h"
+#include "CombatSimulation.h"
+#include "CombatSnapshot.h"
+#include "Necromancer.h"
+
+DECLARE_CYCLE_STAT(TEXT("Status Effect Flush"), STAT_StatusEffectFlush, STATGROUP_Necromancer);
+DECLARE_CYCLE_STAT(TEXT("Status Effect Auras"), STAT_StatusEffectAuras, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Status Effects"), STAT_StatusEffects, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Status Effect Recomputes"), STAT_StatusEffectRecomputes, STATGROUP_Necromancer);
+
+FStatusEffectStore::FStatusEffectStore(FCombatSimulation& InSimulation, FCombatTimerWheel& InTimers, FCombatEventBus& InEventBus)
+	: Simulation(InSimulation)
+	, Timers(InTimers)
+	, EventBus(InEventBus)
+{
+}
+
+void FStatusEffectStore::SetDefinitions(TArray<FStatusEffectDef> InDefinitions)
+{
+	Reset();
+
+	// Records keep the definition index in 16 bits
+	check(InDefinitions.Num() <= MAX_uint16);
+	Definitions = MoveTemp(InDefinitions);
+
+	DefinitionsByName.Reset();
+	for (int32 Definition = 0; Definition < Definitions.Num(); ++Definition)
+	{
+		DefinitionsByName.Add(Definitions[Definition].Name, Definition);
+	}
+
+	AuraChildren.Init(INDEX_NONE, Definitions.Num());
+	for (int32 Definition = 0; Definition < Definitions.Num(); ++Definition)
+	{
+		const FStatusEffectDef& Def = Definitions[Definition];
+		if (Def.AuraRadius > 0.f)
+		{
+			AuraChildren[Definition] = FindDefinition(Def.AuraEffect);
+			UE_CLOG(AuraChildren[Definition] == INDEX_NONE, LogNecromancer, Warning, TEXT("Aura %s applies unknown effect %s"), *Def.Name.ToString(), *Def.AuraEffect.ToString());
+		}
+	}
+}
+
+int32 FStatusEffectStore::FindDefinition(FName Name) const
+{
+	const int32* Definition = DefinitionsByName.Find(Name);
+	return Definition ? *Definition : INDEX_NONE;
+}
+
+bool FStatusEffectStore::Apply(FCombatHandle Target, FCombatHandle Source, int32 Definition)
+{
+	return ApplyInternal(Target, Source, Definition, 0, true);
+}
+
+bool FStatusEffectStore::ApplyInternal(FCombatHandle Target, FCombatHandle Source, int32 Definition, uint32 LifetimeSteps, bool bAddStack)
+{
+	const FStatusEffectDef* Def = GetDefinition(Definition);
+	if (!Def || !Simulation.IsAlive(Target))
+	{
+		return false;
+	}
+
+	const int32 CacheIndex = FindOrAddCache(Target);
+	const uint8 Team = Caches[CacheIndex].Team;
+	TArray<FEffectRecord>& Arena = Records[Team];
+
+	int32 RecordIndex = FindRecord(Caches[CacheIndex], Definition);
+	if (RecordIndex != INDEX_NONE)
+	{
+		FEffectRecord& Record = Arena[RecordIndex];
+		const int32 MaxStacks = FMath::Clamp<int32>(Def->MaxStacks, 1, MAX_uint8);
+		const uint8 Stacks = bAddStack ? static_cast<uint8>(FMath::Min(Record.Stacks + 1, MaxStacks)) : Record.Stacks;
+		if (Stacks != Record.Stacks)
+		{
+			Record.Stacks = Stacks;
+			MarkDirty(CacheIndex, Def->Attribute);
+		}
+		ScheduleExpiry(Record, Team, RecordIndex, LifetimeSteps);
+		return true;
+	}
+
+	if (FreeRecords[Team].Num() > 0)
+	{
+		RecordIndex = FreeRecords[Team].Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		RecordIndex = Arena.AddDefaulted();
+	}
+
+	FAttributeCache& Cache = Caches[CacheIndex];
+	FEffectRecord& Record = Arena[RecordIndex];
+	Record.Target = Target;
+	Record.Source = Source;
+	Record.Definition = static_cast<uint16>(Definition);
+	Record.Stacks = 1;
+	Record.Next = Cache.FirstEffect;
+	Cache.FirstEffect = RecordIndex;
+	++NumEffects;
+
+	ScheduleExpiry(Record, Team, RecordIndex, LifetimeSteps);
+	if (Def->DamagePerTick != 0.f)
+	{
+		Record.Tick = Timers.Schedule(Simulation.SecondsToSteps(Def->TickInterval), ECombatTimerChannel::StatusEffect, Target, PackPayload(Team, RecordIndex, true));
+	}
+	if (AuraChildren[Definition] != INDEX_NONE)
+	{
+		AuraRecords.Add(PackPayload(Team, RecordIndex, false));
+	}
+
+	MarkDirty(CacheIndex, Def->Attribute);
+	return true;
+}
+
+void FStatusEffectStore::Remove(FCombatHandle Target, int32 Definition)
+{
+	const int32* CacheIndex = TargetToCache.Find(Target);
+	if (!CacheIndex)
+	{
+		return;
+	}
+
+	const int32 RecordIndex = FindRecord(Caches[*CacheIndex], Definition);
+	if (RecordIndex != INDEX_NONE)
+	{
+		RemoveRecord(*CacheIndex, RecordIndex);
+	}
+}
+
+void FStatusEffectStore::RemoveAll(FCombatHandle Target)
+{
+	const int32* CacheIndex = TargetToCache.Find(Target);
+	if (!CacheIndex)
+	{
+		return;
+	}
+
+	while (Caches[*CacheIndex].FirstEffect != INDEX_NONE)
+	{
+		RemoveRecord(*CacheIndex, Caches[*CacheIndex].FirstEffect);
+	}
+}
+
+int32 FStatusEffectStore::GetStacks(FCombatHandle Target, int32 Definition) const
+{
+	const int32* CacheIndex = TargetToCache.Find(Target);
+	if (!CacheIndex)
+	{
+		return 0;
+	}
+
+	const int32 RecordIndex = FindRecord(Caches[*CacheIndex], Definition);
+	return RecordIndex != INDEX_NONE ? Records[Caches[*CacheIndex].Team][RecordIndex].Stacks : 0;
+}
+
+void FStatusEffectStore::HandleExpiredTimers(TConstArrayView<FCombatTimerExpiry> Expired)
+{
+	for (const FCombatTimerExpiry& Expiry : Expired)
+	{
+		const bool bTick = (Expiry.Payload & 1u) != 0;
+		const uint8 Team = static_cast<uint8>((Expiry.Payload >> 1) & 3u);
+		const int32 RecordIndex = static_cast<int32>(Expiry.Payload >> 3);
+		if (Team >= UE_ARRAY_COUNT(Records) || !Records[Team].IsValidIndex(RecordIndex))
+		{
+			continue;
+		}
+
+		// A timer outlives its record only if it was cancelled, so a mismatch means a reused record
+		FEffectRecord& Record = Records[Team][RecordIndex];
+		if (Record.Stacks == 0 || (bTick ? Record.Tick : Record.Expiry) != Expiry.Handle)
+		{
+			continue;
+		}
+
+		if (bTick)
+		{
+			const FStatusEffectDef& Def = Definitions[Record.Definition];
+			const float Amount = Def.DamagePerTick * Record.Stacks;
+			EventBus.Enqueue(Amount > 0.f
+				? FCombatEvent::MakeDamage(Record.Target, Record.Source, Amount)
+				: FCombatEvent::MakeHeal(Record.Target, Record.Source, -Amount));
+			Record.Tick = Timers.Schedule(Simulation.SecondsToSteps(Def.TickInterval), ECombatTimerChannel::StatusEffect, Record.Target, Expiry.Payload);
+		}
+		else if (const int32* CacheIndex = TargetToCache.Find(Record.Target))
+		{
+			RemoveRecord(*CacheIndex, RecordIndex);
+		}
+	}
+}
+
+void FStatusEffectStore::RefreshAuras(uint32 AuraLifetimeSteps)
+{
+	SCOPE_CYCLE_COUNTER(STAT_StatusEffectAuras);
+
+	// Gather first: applying aura effects may add aura records of their own
+	const TArray<uint32> Holders = AuraRecords;
+	AuraQueries.Reset();
+	for (const uint32 Packed : Holders)
+	{
+		const FEffectRecord& Record = Records[(Packed >> 1) & 3u][Packed >> 3];
+		const FStatusEffectDef& Def = Definitions[Record.Definition];
+		const ECombatTeam HolderTeam = Simulation.GetTeam(Record.Target);
+
+		FCombatSpatialQuery& Query = AuraQueries.AddDefaulted_GetRef();
+		Query.Origin = Simulation.GetLocation(Record.Target);
+		Query.Radius = Def.AuraRadius;
+		Query.TeamMask = Simulation.IsAlive(Record.Target) ? (Def.bAuraAffectsAllies ? CombatTeamBit(HolderTeam) : CombatHostileTeamMask(HolderTeam)) : 0u;
+	}
+
+	Simulation.QueryBatch(AuraQueries, AuraResults);
+
+	for (int32 Index = 0; Index < Holders.Num(); ++Index)
+	{
+		const FEffectRecord& Record = Records[(Holders[Index] >> 1) & 3u][Holders[Index] >> 3];
+		const FCombatHandle Holder = Record.Target;
+		const int32 Child = AuraChildren[Record.Definition];
+		for (const FCombatHandle& Target : AuraResults[Index])
+		{
+			ApplyInternal(Target, Holder, Child, AuraLifetimeSteps, false);
+		}
+	}
+}
+
+void FStatusEffectStore::Flush()
+{
+	SCOPE_CYCLE_COUNTER(STAT_StatusEffectFlush);
+
+	int32 NumRecomputed = 0;
+	TArray<int32, TInlineAllocator<16>> Emptied;
+	for (const int32 CacheIndex : DirtyCaches)
+	{
+		FAttributeCache& Cache = Caches[CacheIndex];
+		const TArray<FEffectRecord>& Arena = Records[Cache.Team];
+		for (uint8 Attribute = 0; Attribute < static_cast<uint8>(ECombatAttribute::Num); ++Attribute)
+		{
+			if ((Cache.DirtyMask & (1u << Attribute)) == 0)
+			{
+				continue;
+			}
+
+			float Added = 0.f;
+			float Multiplier = 1.f;
+			for (int32 RecordIndex = Cache.FirstEffect; RecordIndex != INDEX_NONE; RecordIndex = Arena[RecordIndex].Next)
+			{
+				const FEffectRecord& Record = Arena[RecordIndex];
+				const FStatusEffectDef& Def = Definitions[Record.Definition];
+				if (static_cast<uint8>(Def.Attribute) == Attribute)
+				{
+					(Def.Op == EStatusEffectOp::Add ? Added : Multiplier) += Def.Magnitude * Record.Stacks;
+				}
+			}
+
+			const float Final = (Cache.Base[Attribute] + Added) * FMath::Max(Multiplier, 0.f);
+			if (Final != Cache.Final[Attribute])
+			{
+				Cache.Final[Attribute] = Final;
+				Simulation.SetAttribute(Cache.Target, static_cast<ECombatAttribute>(Attribute), Final);
+			}
+			++NumRecomputed;
+		}
+
+		Cache.DirtyMask = 0;
+		if (Cache.FirstEffect == INDEX_NONE)
+		{
+			Emptied.Add(CacheIndex);
+		}
+	}
+	DirtyCaches.Reset();
+
+	// Highest first so swap-removal never moves an entry that is still to be removed
+	Emptied.Sort(TGreater<int32>());
+	for (const int32 CacheIndex : Emptied)
+	{
+		RemoveCache(CacheIndex);
+	}
+
+	SET_DWORD_STAT(STAT_StatusEffects, NumEffects);
+	SET_DWORD_STAT(STAT_StatusEffectRecomputes, NumRecomputed);
+}
+
+void FStatusEffectStore::Reset()
+{
+	for (TArray<FEffectRecord>& Arena : Records)
+	{
+		for (const FEffectRecord& Record : Arena)
+		{
+			Timers.Cancel(Record.Expiry);
+			Timers.Cancel(Record.Tick);
+		}
+		Arena.Reset();
+	}
+	for (TArray<int32>& Free : FreeRecords)
+	{
+		Free.Reset();
+	}
+	Caches.Reset();
+	TargetToCache.Reset();
+	DirtyCaches.Reset();
+	AuraRecords.Reset();
+	NumEffects = 0;
+}
+
+void FStatusEffectStore::WriteSnapshot(FCombatSnapshotWriter& Writer) const
+{
+	constexpr int32 NumAttributes = static_cast<int32>(ECombatAttribute::Num);
+
+	TArray<FCombatHandle> Targets;
+	TArray<float> Base;
+	TArray<float> Final;
+	TArray<int32> NumRecords;
+	Targets.Reserve(Caches.Num());
+	Base.Reserve(Caches.Num() * NumAttributes);
+	Final.Reserve(Caches.Num() * NumAttributes);
+	NumRecords.Reserve(Caches.Num());
+
+	TArray<FCombatHandle> Sources;
+	TArray<int32> DefinitionNames;
+	TArray<uint8> Stacks;
+	TArray<uint32> RemainingSteps;
+	Sources.Reserve(NumEffects);
+	DefinitionNames.Reserve(NumEffects);
+	Stacks.Reserve(NumEffects);
+	RemainingSteps.Reserve(NumEffects);
+
+	for (const FAttributeCache& Cache : Caches)
+	{
+		Targets.Add(Cache.Target);
+		Base.Append(Cache.Base, NumAttributes);
+		Final.Append(Cache.Final, NumAttributes);
+
+		const int32 FirstRecord = Sources.Num();
+		const TArray<FEffectRecord>& Arena = Records[Cache.Team];
+		for (int32 RecordIndex = Cache.FirstEffect; RecordIndex != INDEX_NONE; RecordIndex = Arena[RecordIndex].Next)
+		{
+			const FEffectRecord& Record = Arena[RecordIndex];
+			Sources.Add(Record.Source);
+			DefinitionNames.Add(Writer.AddString(Definitions[Record.Definition].Name));
+			Stacks.Add(Record.Stacks);
+
+			// Zero for effects without an expiry, which ReadSnapshot turns back into the definition's duration
+			RemainingSteps.Add(Timers.GetRemainingSteps(Record.Expiry));
+		}
+		NumRecords.Add(Sources.Num() - FirstRecord);
+	}
+
+	Writer.AddSection<FCombatHandle>(ECombatSnapshotSection::EffectTarget, Targets);
+	Writer.AddSection<float>(ECombatSnapshotSection::EffectBase, Base);
+	Writer.AddSection<float>(ECombatSnapshotSection::EffectFinal, Final);
+	Writer.AddSection<int32>(ECombatSnapshotSection::EffectNumRecords, NumRecords);
+	Writer.AddSection<FCombatHandle>(ECombatSnapshotSection::EffectRecordSource, Sources);
+	Writer.AddSection<int32>(ECombatSnapshotSection::EffectRecordDefinition, DefinitionNames);
+	Writer.AddSection<uint8>(ECombatSnapshotSection::EffectRecordStacks, Stacks);
+	Writer.AddSection<uint32>(ECombatSnapshotSection::EffectRecordRemainingSteps, RemainingSteps);
+}
+
+bool FStatusEffectStore::CanReadSnapshot(const FCombatSnapshotReader& Reader)
+{
+	constexpr int32 NumAttributes = static_cast<int32>(ECombatAttribute::Num);
+
+	const int32 NumTargets = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::EffectTarget).Num();
+	const TConstArrayView<int32> NumRecords = Reader.GetSection<int32>(ECombatSnapshotSection::EffectNumRecords);
+	const int32 NumRecordsSaved = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::EffectRecordSource).Num();
+
+	int64 TotalRecords = 0;
+	for (const int32 Count : NumRecords)
+	{
+		TotalRecords += FMath::Max(Count, 0);
+	}
+	return Reader.GetSection<float>(ECombatSnapshotSection::EffectBase).Num() == NumTargets * NumAttributes
+		&& Reader.GetSection<float>(ECombatSnapshotSection::EffectFinal).Num() == NumTargets * NumAttributes
+		&& NumRecords.Num() == NumTargets && TotalRecords == NumRecordsSaved
+		&& Reader.GetSection<int32>(ECombatSnapshotSection::EffectRecordDefinition).Num() == NumRecordsSaved
+		&& Reader.GetSection<uint8>(ECombatSnapshotSection::EffectRecordStacks).Num() == NumRecordsSaved
+		&& Reader.GetSection<uint32>(ECombatSnapshotSection::EffectRecordRemainingSteps).Num() == NumRecordsSaved;
+}
+
+bool FStatusEffectStore::ReadSnapshot(const FCombatSnapshotReader& Reader)
+{
+	constexpr int32 NumAttributes = static_cast<int32>(ECombatAttribute::Num);
+
+	if (!CanReadSnapshot(Reader))
+	{
+		return false;
+	}
+	Reset();
+
+	const TConstArrayView<FCombatHandle> Targets = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::EffectTarget);
+	const TConstArrayView<float> Base = Reader.GetSection<float>(ECombatSnapshotSection::EffectBase);
+	const TConstArrayView<float> Final = Reader.GetSection<float>(ECombatSnapshotSection::EffectFinal);
+	const TConstArrayView<int32> NumRecords = Reader.GetSection<int32>(ECombatSnapshotSection::EffectNumRecords);
+	const TConstArrayView<FCombatHandle> Sources = Reader.GetSection<FCombatHandle>(ECombatSnapshotSection::EffectRecordSource);
+	const TConstArrayView<int32> DefinitionNames = Reader.GetSection<int32>(ECombatSnapshotSection::EffectRecordDefinition);
+	const TConstArrayView<uint8> Stacks = Reader.GetSection<uint8>(ECombatSnapshotSection::EffectRecordStacks);
+	const TConstArrayView<uint32> RemainingSteps = Reader.GetSection<uint32>(ECombatSnapshotSection::EffectRecordRemainingSteps);
+
+	int32 FirstRecord = 0;
+	for (int32 Index = 0; Index < Targets.Num(); ++Index)
+	{
+		const FCombatHandle Target = Targets[Index];
+		const int32 Count = FMath::Max(NumRecords[Index], 0);
+		if (Count == 0 || !Simulation.IsAlive(Target))
+		{
+			FirstRecord += Count;
+			continue;
+		}
+
+		const int32 CacheIndex = FindOrAddCache(Target);
+		FMemory::Memcpy(Caches[CacheIndex].Base, &Base[Index * NumAttributes], sizeof(FAttributeCache::Base));
+		FMemory::Memcpy(Caches[CacheIndex].Final, &Final[Index * NumAttributes], sizeof(FAttributeCache::Final));
+
+		// Chains are newest first, so applying the saved chain backwards rebuilds it in the same order
+		for (int32 Saved = FirstRecord + Count - 1; Saved >= FirstRecord; --Saved)
+		{
+			const int32 Definition = FindDefinition(Reader.GetString(DefinitionNames[Saved]));
+			if (!ApplyInternal(Target, Sources[Saved], Definition, RemainingSteps[Saved], false))
+			{
+				continue;
+			}
+
+			FEffectRecord& Record = Records[Caches[CacheIndex].Team][FindRecord(Caches[CacheIndex], Definition)];
+			Record.Stacks = static_cast<uint8>(FMath::Clamp<int32>(Stacks[Saved], 1, FMath::Clamp<int32>(Definitions[Definition].MaxStacks, 1, MAX_uint8)));
+		}
+		FirstRecord += Count;
+	}
+	return true;
+}
+
+int32 FStatusEffectStore::FindOrAddCache(FCombatHandle Target)
+{
+	if (const int32* CacheIndex = TargetToCache.Find(Target))
+	{
+		return *CacheIndex;
+	}
+
+	const int32 CacheIndex = Caches.AddDefaulted();
+	FAttributeCache& Cache = Caches[CacheIndex];
+	Cache.Target = Target;
+	Cache.Team = static_cast<uint8>(Simulation.GetTeam(Target));
+	for (uint8 Attribute = 0; Attribute < static_cast<uint8>(ECombatAttribute::Num); ++Attribute)
+	{
+		Cache.Base[Attribute] = Simulation.GetAttribute(Target, static_cast<ECombatAttribute>(Attribute));
+		Cache.Final[Attribute] = Cache.Base[Attribute];
+	}
+	TargetToCache.Add(Target, CacheIndex);
+	return CacheIndex;
+}
+
+int32 FStatusEffectStore::FindRecord(const FAttributeCache& Cache, int32 Definition) const
+{
+	const TArray<FEffectRecord>& Arena = Records[Cache.Team];
+	for (int32 RecordIndex = Cache.FirstEffect; RecordIndex != INDEX_NONE; RecordIndex = Arena[RecordIndex].Next)
+	{
+		if (Arena[RecordIndex].Definition == Definition)
+		{
+			return RecordIndex;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FStatusEffectStore::ScheduleExpiry(FEffectRecord& Record, uint8 Team, int32 RecordIndex, uint32 LifetimeSteps)
+{
+	const FStatusEffectDef& Def = Definitions[Record.Definition];
+	if (LifetimeSteps == 0 && Def.Duration > 0.f)
+	{
+		LifetimeSteps = Simulation.SecondsToSteps(Def.Duration);
+	}
+
+	Timers.Cancel(Record.Expiry);
+	Record.Expiry = LifetimeSteps > 0
+		? Timers.Schedule(LifetimeSteps, ECombatTimerChannel::StatusEffect, Record.Target, PackPayload(Team, RecordIndex, false))
+		: FCombatTimerHandle();
+}
+
+void FStatusEffectStore::RemoveRecord(int32 CacheIndex, int32 RecordIndex)
+{
+	FAttributeCache& Cache = Caches[CacheIndex];
+	TArray<FEffectRecord>& Arena = Records[Cache.Team];
+	FEffectRecord& Record = Arena[RecordIndex];
+
+	// Per-combatant chains are a handful of records long
+	if (Cache.FirstEffect == RecordIndex)
+	{
+		Cache.FirstEffect = Record.Next;
+	}
+	else
+	{
+		int32 Previous = Cache.FirstEffect;
+		while (Arena[Previous].Next != RecordIndex)
+		{
+			Previous = Arena[Previous].Next;
+		}
+		Arena[Previous].Next = Record.Next;
+	}
+
+	Timers.Cancel(Record.Expiry);
+	Timers.Cancel(Record.Tick);
+	if (AuraChildren[Record.Definition] != INDEX_NONE)
+	{
+		AuraRecords.RemoveSwap(PackPayload(Cache.Team, RecordIndex, false), EAllowShrinking::No);
+	}
+
+	MarkDirty(CacheIndex, Definitions[Record.Definition].Attribute);
+	Record = FEffectRecord();
+	FreeRecords[Cache.Team].Add(RecordIndex);
+	--NumEffects;
+}
+
+void FStatusEffectStore::MarkDirty(int32 CacheIndex, ECombatAttribute Attribute)
+{
+	FAttributeCache& Cache = Caches[CacheIndex];
+	if (Cache.DirtyMask == 0)
+	{
+		DirtyCaches.Add(CacheIndex);
+	}
+	Cache.DirtyMask |= 1u << static_cast<uint8>(Attribute);
+}
+
+void FStatusEffectStore::RemoveCache(int32 CacheIndex)
+{
+	TargetToCache.Remove(Caches[CacheIndex].Target);
+	Caches.RemoveAtSwap(CacheIndex, 1, EAllowShrinking::No);
+	if (Caches.IsValidIndex(CacheIndex))
+	{
+		TargetToCache.Add(Caches[CacheIndex].Target, CacheIndex);
+	}
+}
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatTypes.h"
+#include "CombatTimerWheel.h"
+#include "CombatSpatialGrid.h"
+#include "StatusEffectStore.generated.h"
+
+class FCombatEventBus;
+class FCombatSimulation;
+class FCombatSnapshotReader;
+class FCombatSnapshotWriter;
+
+/** How a status effect's magnitude combines with the base value */
+UENUM(BlueprintType)
+enum class EStatusEffectOp : uint8
+{
+	/** Added to the base value */
+	Add,
+	/** Summed with other multipliers: 0.25 means +25% */
+	Multiply,
+};
+
+/** Data for one kind of buff, debuff or aura */
+USTRUCT()
+struct FStatusEffectDef
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName Name;
+
+	UPROPERTY(Config)
+	ECombatAttribute Attribute = ECombatAttribute::AttackDamage;
+
+	UPROPERTY(Config)
+	EStatusEffectOp Op = EStatusEffectOp::Add;
+
+	/** Per stack */
+	UPROPERTY(Config)
+	float Magnitude = 0.f;
+
+	/** Seconds until it wears off. Zero or less lasts until removed. */
+	UPROPERTY(Config)
+	float Duration = 5.f;
+
+	UPROPERTY(Config)
+	int32 MaxStacks = 1;
+
+	/** Damage per stack dealt every TickInterval through the event bus. Negative values heal. */
+	UPROPERTY(Config)
+	float DamagePerTick = 0.f;
+
+	UPROPERTY(Config)
+	float TickInterval = 1.f;
+
+	/** If positive, the holder applies AuraEffect to combatants within this distance */
+	UPROPERTY(Config)
+	float AuraRadius = 0.f;
+
+	UPROPERTY(Config)
+	FName AuraEffect;
+
+	/** Whether the aura reaches the holder's own team or its enemies */
+	UPROPERTY(Config)
+	bool bAuraAffectsAllies = true;
+};
+
+/**
+ * Buffs, debuffs and auras on combatants.
+ *
+ * Effects are fixed-size records in one arena per team, chained per combatant by index, so applying one allocates
+ * nothing once the arena has grown. Every affected combatant caches its base and final attribute values;
+ * applying, stacking or expiring an effect only marks the attribute it touches, and Flush recomputes just those.
+ * Durations and damage ticks run on the combat timer wheel. Auras are refreshed for all holders in one batched
+ * spatial query and keep their effect alive on whoever stays in range.
+ */
+class NECROMANCER_API FStatusEffectStore
+{
+public:
+	FStatusEffectStore(FCombatSimulation& InSimulation, FCombatTimerWheel& InTimers, FCombatEventBus& InEventBus);
+
+	void SetDefinitions(TArray<FStatusEffectDef> InDefinitions);
+	int32 FindDefinition(FName Name) const;
+	const FStatusEffectDef* GetDefinition(int32 Definition) const { return Definitions.IsValidIndex(Definition) ? &Definitions[Definition] : nullptr; }
+
+	/** Adds a stack of an effect, or refreshes its duration if it is at MaxStacks. Returns false for dead or unknown targets. */
+	bool Apply(FCombatHandle Target, FCombatHandle Source, int32 Definition);
+
+	/** Removes every stack of an effect */
+	void Remove(FCombatHandle Target, int32 Definition);
+
+	/** Removes every effect, e.g. on death. The base attributes are written back by the next Flush. */
+	void RemoveAll(FCombatHandle Target);
+
+	int32 GetStacks(FCombatHandle Target, int32 Definition) const;
+
+	/** Called with expired StatusEffect timers: ends effects and deals their ticks */
+	void HandleExpiredTimers(TConstArrayView<FCombatTimerExpiry> Expired);
+
+	/** Re-applies every aura to the combatants currently in range. The applied effects last AuraLifetimeSteps. */
+	void RefreshAuras(uint32 AuraLifetimeSteps);
+
+	/** Recomputes the dirty attributes and writes them to the simulation */
+	void Flush();
+
+	/** Drops every effect without touching the simulation */
+	void Reset();
+
+	/** Copies every effect with its stacks and remaining duration into Writer. Definitions are stored by name. */
+	void WriteSnapshot(FCombatSnapshotWriter& Writer) const;
+
+	/**
+	 * Replaces every effect by those in Reader, on a simulation already restored from the same snapshot. Base and
+	 * final attributes are taken over as saved, so the simulation is not changed. Damage ticks restart their interval.
+	 * Returns false and leaves the effects alone if the sections do not fit together; effects of unknown definitions
+	 * are skipped.
+	 */
+	bool ReadSnapshot(const FCombatSnapshotReader& Reader);
+
+	/** True if the effect sections of Reader fit together, so that ReadSnapshot would take them */
+	static bool CanReadSnapshot(const FCombatSnapshotReader& Reader);
+
+	int32 GetNumEffects() const { return NumEffects; }
+	int32 GetNumAffected() const { return Caches.Num(); }
+
+private:
+	struct FEffectRecord
+	{
+		FCombatHandle Target;
+		FCombatHandle Source;
+		FCombatTimerHandle Expiry;
+		FCombatTimerHandle Tick;
+		int32 Next = INDEX_NONE;
+		uint16 Definition = 0;
+
+		/** Zero while the record is free */
+		uint8 Stacks = 0;
+	};
+
+	struct FAttributeCache
+	{
+		FCombatHandle Target;
+		float Base[static_cast<uint8>(ECombatAttribute::Num)];
+		float Final[static_cast<uint8>(ECombatAttribute::Num)];
+		uint8 Team = 0;
+		uint8 DirtyMask = 0;
+		int32 FirstEffect = INDEX_NONE;
+	};
+
+	/** Arena and index of a record, packed into a timer payload together with whether the timer is a tick */
+	static uint32 PackPayload(uint8 Team, int32 Record, bool bTick) { return (static_cast<uint32>(Record) << 3) | (static_cast<uint32>(Team) << 1) | (bTick ? 1u : 0u); }
+
+	/** Adds or refreshes an effect. LifetimeSteps overrides the definition's duration when non-zero. */
+	bool ApplyInternal(FCombatHandle Target, FCombatHandle Source, int32 Definition, uint32 LifetimeSteps, bool bAddStack);
+	int32 FindOrAddCache(FCombatHandle Target);
+	int32 FindRecord(const FAttributeCache& Cache, int32 Definition) const;
+	void ScheduleExpiry(FEffectRecord& Record, uint8 Team, int32 RecordIndex, uint32 LifetimeSteps);
+	void RemoveRecord(int32 CacheIndex, int32 RecordIndex);
+	void MarkDirty(int32 CacheIndex, ECombatAttribute Attribute);
+	void RemoveCache(int32 CacheIndex);
+
+	FCombatSimulation& Simulation;
+	FCombatTimerWheel& Timers;
+	FCombatEventBus& EventBus;
+
+	TArray<FStatusEffectDef> Definitions;
+	TMap<FName, int32> DefinitionsByName;
+
+	/** Effect records, one arena per team */
+	TArray<FEffectRecord> Records[static_cast<uint8>(ECombatTeam::Neutral) + 1];
+	TArray<int32> FreeRecords[static_cast<uint8>(ECombatTeam::Neutral) + 1];
+	int32 NumEffects = 0;
+
+	/** One entry per combatant with at least one effect */
+	TArray<FAttributeCache> Caches;
+	TMap<FCombatHandle, int32> TargetToCache;
+	TArray<int32> DirtyCaches;
+
+	/** Aura child definition per definition, or INDEX_NONE */
+	TArray<int32> AuraChildren;
+
+	/** Live records of aura definitions, packed like timer payloads */
+	TArray<uint32> AuraRecords;
+
+	/** Scratch for RefreshAuras */
+	TArray<FCombatSpatialQuery> AuraQueries;
+	TArray<TArray<FCombatHandle>> AuraResults;
+};
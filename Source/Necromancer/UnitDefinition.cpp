@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "UnitDefinition.h"
+
+const FPrimaryAssetType UUnitDefinition::PrimaryAssetType(TEXT("Unit"));
+
+FCombatantDesc UUnitDefinition::MakeCombatantDesc(const FVector& Location) const
+{
+	FCombatantDesc Desc;
+	Desc.Team = Team;
+	Desc.MaxHealth = MaxHealth;
+	Desc.AttackDamage = AttackDamage;
+	Desc.AttackInterval = AttackInterval;
+	Desc.AttackRange = AttackRange;
+	Desc.Location = Location;
+	return Desc;
+}
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "CombatTypes.h"
+#include "UnitDefinition.generated.h"
+
+class ACombatPawn;
+class UAbilityDefinition;
+class UNiagaraSystem;
+
+/**
+ * A kind of combat unit, registered with the Asset Manager as a "Unit" primary asset.
+ * Nothing is hard-referenced: the pawn class is in the "Game" bundle, cosmetics in the "FX" bundle,
+ * and abilities are separate primary assets that UUnitRegistrySubsystem loads along with the unit.
+ */
+UCLASS(BlueprintType)
+class NECROMANCER_API UUnitDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	static const FPrimaryAssetType PrimaryAssetType;
+
+	virtual FPrimaryAssetId GetPrimaryAssetId() const override { return FPrimaryAssetId(PrimaryAssetType, GetFName()); }
+
+	/** Combatant registered for a unit spawned from this definition */
+	FCombatantDesc MakeCombatantDesc(const FVector& Location) const;
+
+	UPROPERTY(EditDefaultsOnly, Category = Unit, meta = (AssetBundles = "Game"))
+	TSoftClassPtr<ACombatPawn> PawnClass;
+
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	ECombatTeam Team = ECombatTeam::Living;
+
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	float MaxHealth = 100.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	float AttackDamage = 10.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	float AttackInterval = 1.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	float AttackRange = 150.f;
+
+	/** Corpse left in UCorpseSubsystem when a unit dies */
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	FName CorpseType;
+
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	TArray<TSoftObjectPtr<UAbilityDefinition>> Abilities;
+
+	UPROPERTY(EditDefaultsOnly, Category = FX, meta = (AssetBundles = "FX"))
+	TSoftObjectPtr<UNiagaraSystem> SpawnFX;
+
+	/** Pawns spawned into the pool as soon as the unit is loaded */
+	UPROPERTY(EditDefaultsOnly, Category = Pooling)
+	int32 PoolPrewarmCount = 0;
+};
@@ -0,0 +1,223 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "UnitRegistrySubsystem.h"
+#include "AbilityDefinition.h"
+#include "CombatManagerComponent.h"
+#include "CombatPawn.h"
+#include "CombatPawnPoolSubsystem.h"
+#include "CombatSubsystem.h"
+#include "FXPoolSubsystem.h"
+#include "UnitDefinition.h"
+#include "Necromancer.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "NiagaraSystem.h"
+
+void UUnitRegistrySubsystem::Deinitialize()
+{
+	TArray<FName> GroupNames;
+	Groups.GetKeys(GroupNames);
+	for (const FName& Group : GroupNames)
+	{
+		ReleaseGroup(Group);
+	}
+
+	Super::Deinitialize();
+}
+
+TArray<FName> UUnitRegistrySubsystem::GetBundles() const
+{
+	// Servers simulate; they never show an effect
+	TArray<FName> Bundles = { TEXT("Game") };
+	if (!IsRunningDedicatedServer())
+	{
+		Bundles.Add(TEXT("FX"));
+	}
+	return Bundles;
+}
+
+void UUnitRegistrySubsystem::AddAssets(FGroup& InGroup, TConstArrayView<FPrimaryAssetId> Assets)
+{
+	for (const FPrimaryAssetId& Asset : Assets)
+	{
+		if (Asset.IsValid() && !InGroup.Assets.Contains(Asset))
+		{
+			InGroup.Assets.Add(Asset);
+			++AssetRefCounts.FindOrAdd(Asset);
+		}
+	}
+}
+
+void UUnitRegistrySubsystem::PreloadGroup(FName Group, TConstArrayView<FPrimaryAssetId> Units, FSimpleDelegate OnLoaded)
+{
+	ReleaseGroup(Group);
+
+	FGroup& NewGroup = Groups.Add(Group);
+	NewGroup.OnLoaded = MoveTemp(OnLoaded);
+	NewGroup.RequestSeconds = FPlatformTime::Seconds();
+	NewGroup.RequestMemory = FPlatformMemory::GetStats().UsedPhysical;
+	AddAssets(NewGroup, Units);
+
+	// Everything already resident completes straight away, possibly inside LoadPrimaryAssets
+	TSharedPtr<FStreamableHandle> Handle = UAssetManager::Get().LoadPrimaryAssets(NewGroup.Assets, GetBundles(),
+		FStreamableDelegate::CreateUObject(this, &UUnitRegistrySubsystem::HandleUnitsLoaded, Group));
+	if (FGroup* Found = Groups.Find(Group))
+	{
+		Found->UnitHandle = Handle;
+		if (!Handle.IsValid())
+		{
+			HandleUnitsLoaded(Group);
+		}
+	}
+}
+
+void UUnitRegistrySubsystem::HandleUnitsLoaded(FName Group)
+{
+	FGroup* Found = Groups.Find(Group);
+	if (!Found || Found->AbilityHandle.IsValid() || Found->bLoaded)
+	{
+		return;
+	}
+
+	// Abilities are primary assets of their own, so bundles do not reach them through the unit
+	UAssetManager& AssetManager = UAssetManager::Get();
+	TArray<FPrimaryAssetId> Abilities;
+	for (const FPrimaryAssetId& Asset : Found->Assets)
+	{
+		if (const UUnitDefinition* Unit = AssetManager.GetPrimaryAssetObject<UUnitDefinition>(Asset))
+		{
+			for (const TSoftObjectPtr<UAbilityDefinition>& Ability : Unit->Abilities)
+			{
+				Abilities.AddUnique(AssetManager.GetPrimaryAssetIdForPath(Ability.ToSoftObjectPath()));
+			}
+		}
+	}
+	AddAssets(*Found, Abilities);
+
+	TSharedPtr<FStreamableHandle> Handle = Abilities.Num() > 0
+		? AssetManager.LoadPrimaryAssets(Abilities, GetBundles(), FStreamableDelegate::CreateUObject(this, &UUnitRegistrySubsystem::HandleAbilitiesLoaded, Group))
+		: nullptr;
+	if ((Found = Groups.Find(Group)) != nullptr && !Found->bLoaded)
+	{
+		Found->AbilityHandle = Handle;
+		if (!Handle.IsValid())
+		{
+			HandleAbilitiesLoaded(Group);
+		}
+	}
+}
+
+void UUnitRegistrySubsystem::HandleAbilitiesLoaded(FName Group)
+{
+	FGroup* Found = Groups.Find(Group);
+	if (!Found || Found->bLoaded)
+	{
+		return;
+	}
+
+	Found->bLoaded = true;
+	const double LoadMs = (FPlatformTime::Seconds() - Found->RequestSeconds) * 1000.0;
+	const double MemoryMB = (static_cast<double>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<double>(Found->RequestMemory)) / (1024.0 * 1024.0);
+	UE_LOG(LogNecromancer, Log, TEXT("Unit group %s: %d assets loaded in %.1f ms, resident memory %+.1f MB"), *Group.ToString(), Found->Assets.Num(), LoadMs, MemoryMB);
+
+	const FSimpleDelegate OnLoaded = Found->OnLoaded;
+	OnLoaded.ExecuteIfBound();
+}
+
+void UUnitRegistrySubsystem::ReleaseGroup(FName Group)
+{
+	FGroup Released;
+	if (!Groups.RemoveAndCopyValue(Group, Released))
+	{
+		return;
+	}
+
+	for (const TSharedPtr<FStreamableHandle>& Handle : { Released.UnitHandle, Released.AbilityHandle })
+	{
+		if (Handle.IsValid())
+		{
+			Handle->CancelHandle();
+		}
+	}
+
+	TArray<FPrimaryAssetId> Unused;
+	for (const FPrimaryAssetId& Asset : Released.Assets)
+	{
+		int32& RefCount = AssetRefCounts.FindChecked(Asset);
+		if (--RefCount == 0)
+		{
+			AssetRefCounts.Remove(Asset);
+			Unused.Add(Asset);
+		}
+	}
+	if (Unused.Num() > 0 && UAssetManager::IsInitialized())
+	{
+		UAssetManager::Get().UnloadPrimaryAssets(Unused);
+	}
+}
+
+bool UUnitRegistrySubsystem::IsGroupLoaded(FName Group) const
+{
+	const FGroup* Found = Groups.Find(Group);
+	return Found && Found->bLoaded;
+}
+
+bool UUnitRegistrySubsystem::HasPendingLoads() const
+{
+	for (const TPair<FName, FGroup>& Entry : Groups)
+	{
+		if (!Entry.Value.bLoaded)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+const UUnitDefinition* UUnitRegistrySubsystem::FindUnit(FName UnitName) const
+{
+	return UAssetManager::Get().GetPrimaryAssetObject<UUnitDefinition>(FPrimaryAssetId(UUnitDefinition::PrimaryAssetType, UnitName));
+}
+
+ACombatPawn* UUnitRegistrySubsystem::SpawnUnit(UWorld* World, FName UnitName, const FTransform& SpawnTransform) const
+{
+	const UUnitDefinition* Unit = FindUnit(UnitName);
+	UClass* PawnClass = Unit ? Unit->PawnClass.Get() : nullptr;
+	UCombatSubsystem* Combat = World ? World->GetSubsystem<UCombatSubsystem>() : nullptr;
+	UCombatPawnPoolSubsystem* Pool = World ? World->GetSubsystem<UCombatPawnPoolSubsystem>() : nullptr;
+	if (!PawnClass || !Combat || !Pool)
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Unit %s is not loaded; preload a group holding it first"), *UnitName.ToString());
+		return nullptr;
+	}
+
+	const FCombatHandle Handle = Combat->RegisterCombatant(Unit->MakeCombatantDesc(SpawnTransform.GetLocation()));
+	ACombatPawn* Pawn = Pool->AcquirePawn(PawnClass, SpawnTransform, Handle);
+	if (!Pawn)
+	{
+		Combat->UnregisterCombatant(Handle);
+		return nullptr;
+	}
+
+	Pawn->GetCombatComponent()->Team = Unit->Team;
+	Pawn->CorpseType = Unit->CorpseType;
+	Pawn->Abilities.Reset();
+	for (const TSoftObjectPtr<UAbilityDefinition>& Ability : Unit->Abilities)
+	{
+		if (const UAbilityDefinition* Loaded = Ability.Get())
+		{
+			Pawn->Abilities.Add(Loaded->AI);
+		}
+	}
+
+	UFXPoolSubsystem* FXPool = World->GetSubsystem<UFXPoolSubsystem>();
+	if (FXPool && Unit->SpawnFX.IsValid())
+	{
+		FXPool->RequestEffect(Unit->SpawnFX.Get(), SpawnTransform.GetLocation());
+	}
+	return Pawn;
+}
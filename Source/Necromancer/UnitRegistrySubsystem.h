@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "UnitRegistrySubsystem.generated.h"
+
+class ACombatPawn;
+class UUnitDefinition;
+struct FStreamableHandle;
+
+/**
+ * Keeps unit and ability definitions resident while some group - a map, a wave - needs them.
+ * Groups are loaded asynchronously through the Asset Manager: first the units with their bundles, then the abilities
+ * they name. Dedicated servers skip the "FX" bundle. An asset is unloaded when the last group holding it is released.
+ * Lives on the game instance, so a group may outlast the map that requested it, e.g. across travel to the next map.
+ */
+UCLASS()
+class NECROMANCER_API UUnitRegistrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Starts loading Units for Group. OnLoaded runs once they and their abilities are in, at once if they already are. */
+	void PreloadGroup(FName Group, TConstArrayView<FPrimaryAssetId> Units, FSimpleDelegate OnLoaded = FSimpleDelegate());
+
+	/** Drops Group's hold on its assets and cancels its loads if they are still running */
+	void ReleaseGroup(FName Group);
+
+	bool IsGroupLoaded(FName Group) const;
+	bool HasPendingLoads() const;
+
+	/** The loaded definition of UnitName, or null */
+	const UUnitDefinition* FindUnit(FName UnitName) const;
+
+	/** Takes a pawn of a loaded unit from World's pool, as a combatant with the unit's stats, abilities and corpse */
+	ACombatPawn* SpawnUnit(UWorld* World, FName UnitName, const FTransform& SpawnTransform) const;
+
+private:
+	struct FGroup
+	{
+		TArray<FPrimaryAssetId> Assets;
+		TSharedPtr<FStreamableHandle> UnitHandle;
+		TSharedPtr<FStreamableHandle> AbilityHandle;
+		FSimpleDelegate OnLoaded;
+		double RequestSeconds = 0.0;
+		uint64 RequestMemory = 0;
+		bool bLoaded = false;
+	};
+
+	void HandleUnitsLoaded(FName Group);
+	void HandleAbilitiesLoaded(FName Group);
+	void AddAssets(FGroup& InGroup, TConstArrayView<FPrimaryAssetId> Assets);
+	TArray<FName> GetBundles() const;
+
+	TMap<FName, FGroup> Groups;
+
+	/** Groups holding each asset */
+	TMap<FPrimaryAssetId, int32> AssetRefCounts;
+};
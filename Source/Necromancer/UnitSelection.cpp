@@ -0,0 +1,303 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "UnitSelection.h"
+#include "CombatReplicationProxy.h"
+#include "CombatSimulation.h"
+#include "NecromancerStats.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Unit Selection"), STAT_UnitSelection, STATGROUP_Necromancer);
+
+void FSelectableUnitIndex::Rebuild(TConstArrayView<FCombatantNetRecord> Records)
+{
+	Grid.Reset();
+	RecordHandles.Reset();
+	for (const FCombatantNetRecord& Record : Records)
+	{
+		if (Record.Health > 0)
+		{
+			Grid.Add(RecordHandles.Num(), Record.Position.ToVector(), CombatTeamBit(Record.Team));
+			RecordHandles.Add(Record.GetHandle());
+		}
+	}
+	++NumRebuilds;
+}
+
+void FSelectableUnitIndex::Query(const FCombatSpatialQuery& Query, TArray<FCombatHandle>& OutHandles) const
+{
+	if (Simulation)
+	{
+		Simulation->Query(Query, OutHandles);
+		return;
+	}
+
+	Ids.Reset();
+	Grid.Query(Query, Ids);
+	OutHandles.Reserve(OutHandles.Num() + Ids.Num());
+	for (const int32 Id : Ids)
+	{
+		OutHandles.Add(RecordHandles[Id]);
+	}
+}
+
+uint32 FSelectableUnitIndex::GetVersion() const
+{
+	// The simulation's grid only moves when it steps
+	return Simulation ? Simulation->GetStepIndex() : NumRebuilds;
+}
+
+void FUnitSelection::BeginDrag(const FVector2D& ScreenPosition, bool bInAdditive)
+{
+	DragStart = ScreenPosition;
+	DragEnd = ScreenPosition;
+	bDragging = true;
+	bAdditive = bInAdditive;
+	bResolved = false;
+	UnderBox.Reset();
+	Entered.Reset();
+	Left.Reset();
+}
+
+bool FUnitSelection::UpdateDrag(const APlayerController& PlayerController, const FVector2D& ScreenPosition, float GroundZ, const FSelectableUnitIndex& Units, uint32 TeamMask)
+{
+	NECRO_SCOPE(STAT_UnitSelection, Input);
+
+	Entered.Reset();
+	Left.Reset();
+	if (!bDragging)
+	{
+		return false;
+	}
+
+	DragEnd = ScreenPosition;
+
+	FViewKey Key;
+	Key.DragEnd = DragEnd;
+	Key.GroundZ = GroundZ;
+	Key.UnitsVersion = Units.GetVersion();
+	if (const APlayerCameraManager* CameraManager = PlayerController.PlayerCameraManager)
+	{
+		Key.CameraLocation = CameraManager->GetCameraLocation();
+		Key.CameraRotation = CameraManager->GetCameraRotation();
+		Key.FOV = CameraManager->GetFOVAngle();
+	}
+	if (bResolved && Key == ResolvedKey)
+	{
+		return false;
+	}
+	ResolvedKey = Key;
+	bResolved = true;
+
+	QueryResults.Reset();
+	FVector2D Corners[4];
+	if (IsBoxDrag() && ProjectScreenRect(PlayerController, GetDragRect(), GroundZ, MaxGroundDistance, Corners))
+	{
+		FCombatSpatialQuery Query;
+		Query.Shape = ECombatQueryShape::Polygon;
+		Query.PolygonPoints = MakeArrayView(Corners, 4);
+		Query.TeamMask = TeamMask;
+		Units.Query(Query, QueryResults);
+	}
+
+	// Entered: under the box now but not before. Left: the other way round.
+	BeginMarking();
+	for (const FCombatHandle& Handle : UnderBox)
+	{
+		Mark(Handle);
+	}
+	for (const FCombatHandle& Handle : QueryResults)
+	{
+		if (!IsMarked(Handle))
+		{
+			Entered.Add(Handle);
+		}
+	}
+	BeginMarking();
+	for (const FCombatHandle& Handle : QueryResults)
+	{
+		Mark(Handle);
+	}
+	for (const FCombatHandle& Handle : UnderBox)
+	{
+		if (!IsMarked(Handle))
+		{
+			Left.Add(Handle);
+		}
+	}
+
+	Swap(UnderBox, QueryResults);
+	return Entered.Num() > 0 || Left.Num() > 0;
+}
+
+bool FUnitSelection::EndDrag()
+{
+	const bool bWasBoxDrag = bDragging && IsBoxDrag();
+	if (bWasBoxDrag)
+	{
+		Select(UnderBox, bAdditive);
+	}
+	CancelDrag();
+	return bWasBoxDrag;
+}
+
+void FUnitSelection::CancelDrag()
+{
+	bDragging = false;
+	bResolved = false;
+	UnderBox.Reset();
+	Entered.Reset();
+	Left.Reset();
+}
+
+bool FUnitSelection::IsBoxDrag() const
+{
+	const FVector2D Size = (DragEnd - DragStart).GetAbs();
+	return Size.X >= ClickThreshold || Size.Y >= ClickThreshold;
+}
+
+FBox2D FUnitSelection::GetDragRect() const
+{
+	return FBox2D(FVector2D::Min(DragStart, DragEnd), FVector2D::Max(DragStart, DragEnd));
+}
+
+void FUnitSelection::Select(TConstArrayView<FCombatHandle> Handles, bool bInAdditive)
+{
+	if (!bInAdditive)
+	{
+		Selected.Reset();
+		Selected.Append(Handles.GetData(), Handles.Num());
+		return;
+	}
+
+	BeginMarking();
+	for (const FCombatHandle& Handle : Selected)
+	{
+		Mark(Handle);
+	}
+	for (const FCombatHandle& Handle : Handles)
+	{
+		if (Mark(Handle))
+		{
+			Selected.Add(Handle);
+		}
+	}
+}
+
+void FUnitSelection::RemoveInvalid(TFunctionRef<bool(const FCombatHandle&)> IsValid)
+{
+	Selected.RemoveAllSwap([&IsValid](const FCombatHandle& Handle) { return !IsValid(Handle); }, EAllowShrinking::No);
+}
+
+void FUnitSelection::AssignControlGroup(int32 Group)
+{
+	if (Group >= 0 && Group < NumControlGroups)
+	{
+		ControlGroups[Group] = Selected;
+	}
+}
+
+bool FUnitSelection::RecallControlGroup(int32 Group, bool bInAdditive)
+{
+	if (Group < 0 || Group >= NumControlGroups || ControlGroups[Group].IsEmpty())
+	{
+		return false;
+	}
+
+	Select(ControlGroups[Group], bInAdditive);
+	return true;
+}
+
+bool FUnitSelection::ProjectScreenRect(const APlayerController& PlayerController, const FBox2D& ScreenRect, float GroundZ, float MaxDistance, FVector2D OutCorners[4])
+{
+	const FVector2D ScreenCorners[4] =
+	{
+		ScreenRect.Min,
+		FVector2D(ScreenRect.Max.X, ScreenRect.Min.Y),
+		ScreenRect.Max,
+		FVector2D(ScreenRect.Min.X, ScreenRect.Max.Y),
+	};
+
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		FVector RayOrigin;
+		FVector RayDirection;
+		if (!PlayerController.DeprojectScreenPositionToWorld(ScreenCorners[Index].X, ScreenCorners[Index].Y, RayOrigin, RayDirection))
+		{
+			return false;
+		}
+
+		double Distance = MaxDistance;
+		if (RayDirection.Z < -UE_KINDA_SMALL_NUMBER)
+		{
+			Distance = FMath::Min((GroundZ - RayOrigin.Z) / RayDirection.Z, static_cast<double>(MaxDistance));
+		}
+		if (Distance < 0.0)
+		{
+			// The camera is below the ground
+			return false;
+		}
+		OutCorners[Index] = FVector2D(RayOrigin + RayDirection * Distance);
+	}
+
+	// Screen order is clockwise on screen, which depends on the camera once on the ground
+	double TwiceArea = 0.0;
+	for (int32 Index = 0, Previous = 3; Index < 4; Previous = Index++)
+	{
+		TwiceArea += FVector2D::CrossProduct(OutCorners[Previous], OutCorners[Index]);
+	}
+	if (TwiceArea < 0.0)
+	{
+		Swap(OutCorners[1], OutCorners[3]);
+	}
+	return true;
+}
+
+void FUnitSelection::BeginMarking()
+{
+	if (++MarkRound == 0)
+	{
+		FMemory::Memzero(SlotMarks.GetData(), SlotMarks.Num() * sizeof(uint32));
+		MarkRound = 1;
+	}
+	MarkedCollisions.Reset();
+}
+
+bool FUnitSelection::Mark(const FCombatHandle& Handle)
+{
+	if (Handle.Slot < 0)
+	{
+		return false;
+	}
+	if (Handle.Slot >= SlotMarks.Num())
+	{
+		SlotMarks.SetNumZeroed(Handle.Slot + 1);
+		SlotMarkSerials.SetNumZeroed(Handle.Slot + 1);
+	}
+
+	uint32& SlotMark = SlotMarks[Handle.Slot];
+	if (SlotMark != MarkRound)
+	{
+		SlotMark = MarkRound;
+		SlotMarkSerials[Handle.Slot] = Handle.Serial;
+		return true;
+	}
+
+	// Two handles to one slot in a round are rare, so the second and later ones are kept in a short list
+	if (SlotMarkSerials[Handle.Slot] == Handle.Serial || MarkedCollisions.Contains(Handle))
+	{
+		return false;
+	}
+	MarkedCollisions.Add(Handle);
+	return true;
+}
+
+bool FUnitSelection::IsMarked(const FCombatHandle& Handle) const
+{
+	if (!SlotMarks.IsValidIndex(Handle.Slot) || SlotMarks[Handle.Slot] != MarkRound)
+	{
+		return false;
+	}
+	return SlotMarkSerials[Handle.Slot] == Handle.Serial || MarkedCollisions.Contains(Handle);
+}
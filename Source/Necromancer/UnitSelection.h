@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatTypes.h"
+#include "CombatSpatialGrid.h"
+
+class APlayerController;
+class FCombatSimulation;
+struct FCombatantNetRecord;
+
+/**
+ * Where selectable units are looked up. Where the combat simulation is authoritative its spatial grid is queried
+ * directly; a client has no simulation and indexes the combatants replicated to it instead.
+ */
+class NECROMANCER_API FSelectableUnitIndex
+{
+public:
+	/** Queries go straight to Simulation, which must outlive this index */
+	void SetSimulation(const FCombatSimulation* InSimulation) { Simulation = InSimulation; }
+
+	/** Client: indexes the live combatants among Records. Call whenever the replicated slice changed. */
+	void Rebuild(TConstArrayView<FCombatantNetRecord> Records);
+
+	/** Appends the units matching Query to OutHandles */
+	void Query(const FCombatSpatialQuery& Query, TArray<FCombatHandle>& OutHandles) const;
+
+	/** Changes whenever units may have moved, so that unchanged queries can be skipped */
+	uint32 GetVersion() const;
+
+private:
+	const FCombatSimulation* Simulation = nullptr;
+
+	/** Client: replicated combatants keyed by their index in RecordHandles */
+	FCombatSpatialGrid Grid;
+	TArray<FCombatHandle> RecordHandles;
+	uint32 NumRebuilds = 0;
+	mutable TArray<int32> Ids;
+};
+
+/**
+ * Drag-box selection, control groups and the current selection of one player.
+ *
+ * The screen rectangle is projected onto the ground as a quad and resolved with one polygon query against the
+ * selectable unit index, never by projecting units to the screen. While dragging, the query only runs again when the
+ * box, the camera or the units moved, and reports which units entered and left the box so that highlights only touch
+ * those. Sets are plain handle arrays; membership tests go through a per-slot mark instead of hashing or sorting.
+ */
+class NECROMANCER_API FUnitSelection
+{
+public:
+	static constexpr int32 NumControlGroups = 10;
+
+	/** Starts a box at ScreenPosition. An additive box adds to the selection instead of replacing it. */
+	void BeginDrag(const FVector2D& ScreenPosition, bool bInAdditive);
+
+	/**
+	 * Moves the free corner of the box to ScreenPosition and resolves the units of TeamMask under it, on the ground
+	 * plane at GroundZ. Skipped while the box, the camera and the units are unchanged. Returns true if the units under
+	 * the box changed.
+	 */
+	bool UpdateDrag(const APlayerController& PlayerController, const FVector2D& ScreenPosition, float GroundZ, const FSelectableUnitIndex& Units, uint32 TeamMask);
+
+	/** Selects the units under the box. Returns false if the box was too small to be more than a click. */
+	bool EndDrag();
+	void CancelDrag();
+
+	bool IsDragging() const { return bDragging; }
+
+	/** True once the box is big enough to count as a drag rather than a click */
+	bool IsBoxDrag() const;
+
+	/** The box in screen pixels */
+	FBox2D GetDragRect() const;
+
+	/** Units under the box while dragging */
+	TConstArrayView<FCombatHandle> GetUnderBox() const { return UnderBox; }
+
+	/** Units that entered and left the box in the last UpdateDrag */
+	TConstArrayView<FCombatHandle> GetEnteredBox() const { return Entered; }
+	TConstArrayView<FCombatHandle> GetLeftBox() const { return Left; }
+
+	void Select(TConstArrayView<FCombatHandle> Handles, bool bInAdditive);
+	void Clear() { Selected.Reset(); }
+	TConstArrayView<FCombatHandle> GetSelected() const { return Selected; }
+	bool HasSelection() const { return Selected.Num() > 0; }
+
+	/** Drops the selected units IsValid rejects, e.g. the dead */
+	void RemoveInvalid(TFunctionRef<bool(const FCombatHandle&)> IsValid);
+
+	void AssignControlGroup(int32 Group);
+
+	/** Selects the units of Group. Returns false if it is empty. */
+	bool RecallControlGroup(int32 Group, bool bInAdditive);
+
+	/**
+	 * Corners of the ground under ScreenRect on the plane at GroundZ, counter-clockwise on XY. Rays that do not reach
+	 * the plane within MaxDistance, e.g. above the horizon, are cut there. Returns false if the view cannot be deprojected.
+	 */
+	static bool ProjectScreenRect(const APlayerController& PlayerController, const FBox2D& ScreenRect, float GroundZ, float MaxDistance, FVector2D OutCorners[4]);
+
+	/** Box size in pixels below which a drag counts as a click */
+	float ClickThreshold = 6.f;
+
+	/** How far a view ray that never reaches the ground is followed */
+	float MaxGroundDistance = 20000.f;
+
+private:
+	struct FViewKey
+	{
+		FVector2D DragEnd = FVector2D(-1.f, -1.f);
+		FVector CameraLocation = FVector::ZeroVector;
+		FRotator CameraRotation = FRotator::ZeroRotator;
+		float FOV = 0.f;
+		float GroundZ = 0.f;
+		uint32 UnitsVersion = 0;
+
+		bool operator==(const FViewKey& Other) const
+		{
+			return DragEnd == Other.DragEnd && CameraLocation == Other.CameraLocation && CameraRotation == Other.CameraRotation
+				&& FOV == Other.FOV && GroundZ == Other.GroundZ && UnitsVersion == Other.UnitsVersion;
+		}
+	};
+
+	/** Starts a new membership round; Mark then reports each handle once per round */
+	void BeginMarking();
+	bool Mark(const FCombatHandle& Handle);
+	bool IsMarked(const FCombatHandle& Handle) const;
+
+	FVector2D DragStart = FVector2D::ZeroVector;
+	FVector2D DragEnd = FVector2D::ZeroVector;
+	bool bDragging = false;
+	bool bAdditive = false;
+
+	/** Key the units under the box were resolved for */
+	FViewKey ResolvedKey;
+	bool bResolved = false;
+
+	TArray<FCombatHandle> Selected;
+	TArray<FCombatHandle> UnderBox;
+	TArray<FCombatHandle> Entered;
+	TArray<FCombatHandle> Left;
+	TArray<FCombatHandle> QueryResults;
+	TArray<FCombatHandle> ControlGroups[NumControlGroups];
+
+	/** Round in which each slot was last marked, and the serial of the handle marked in it */
+	TArray<uint32> SlotMarks;
+	TArray<uint32> SlotMarkSerials;
+	uint32 MarkRound = 0;
+
+	/** Handles marked this round whose slot was already marked for another serial, e.g. a dead unit's reused slot */
+	TArray<FCombatHandle, TInlineAllocator<8>> MarkedCollisions;
+};
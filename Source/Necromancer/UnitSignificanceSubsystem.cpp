@@ -0,0 +1,310 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "UnitSignificanceSubsystem.h"
+#include "NecromancerStats.h"
+#include "NecromancerCharacter.h"
+#include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Significance Update"), STAT_SignificanceUpdate, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Units"), STAT_SignificanceUnits, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Tier 0"), STAT_SignificanceTier0, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Tier 1"), STAT_SignificanceTier1, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Tier 2"), STAT_SignificanceTier2, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Significance Tier 3+"), STAT_SignificanceTier3, STATGROUP_Necromancer);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Significance Ticks Saved/Frame"), STAT_SignificanceTicksSaved, STATGROUP_Necromancer);
+
+namespace UnitSignificance
+{
+	// Units not rendered for longer than this count as off screen
+	constexpr float RenderTimeTolerance = 0.2f;
+}
+
+UUnitSignificanceSubsystem::UUnitSignificanceSubsystem()
+{
+	auto AddTier = [this](float MaxDistance, float TickInterval, EVisibilityBasedAnimTickOption AnimTickOption, int32 MaxSimulationIterations)
+	{
+		FUnitSignificanceTier& Tier = Tiers.AddDefaulted_GetRef();
+		Tier.MaxDistance = MaxDistance;
+		Tier.TickInterval = TickInterval;
+		Tier.AnimTickOption = AnimTickOption;
+		Tier.MovementMaxSimulationIterations = MaxSimulationIterations;
+	};
+
+	// Replaced as a whole when Tiers is set in config
+	AddTier(2500.f, 0.f, EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones, 8);
+	AddTier(5000.f, 1.f / 20.f, EVisibilityBasedAnimTickOption::AlwaysTickPose, 4);
+	AddTier(10000.f, 1.f / 5.f, EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered, 2);
+	AddTier(0.f, 1.f / 2.f, EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered, 1);
+}
+
+bool UUnitSignificanceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UUnitSignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UUnitSignificanceSubsystem, STATGROUP_Tickables);
+}
+
+void UUnitSignificanceSubsystem::Deinitialize()
+{
+	Units.Empty();
+	UnitIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UUnitSignificanceSubsystem::RegisterUnit(AActor* Unit)
+{
+	if (!Unit || UnitIndices.Contains(Unit))
+	{
+		return;
+	}
+
+	FUnit& NewUnit = Units.AddDefaulted_GetRef();
+	NewUnit.Actor = Unit;
+	NewUnit.ActorTickInterval = Unit->GetActorTickInterval();
+	UnitIndices.Add(Unit, Units.Num() - 1);
+
+	for (UActorComponent* Component : Unit->GetComponents())
+	{
+		if (!Component || !Component->PrimaryComponentTick.bCanEverTick)
+		{
+			continue;
+		}
+
+		FComponentSettings& Settings = NewUnit.Components.AddDefaulted_GetRef();
+		Settings.Component = Component;
+		Settings.TickInterval = Component->GetComponentTickInterval();
+		if (const USkinnedMeshComponent* Mesh = Cast<USkinnedMeshComponent>(Component))
+		{
+			Settings.AnimTickOption = Mesh->VisibilityBasedAnimTickOption;
+		}
+		else if (const UCharacterMovementComponent* Movement = Cast<UCharacterMovementComponent>(Component))
+		{
+			Settings.MaxSimulationIterations = Movement->MaxSimulationIterations;
+		}
+	}
+
+	// Start at full fidelity; the next update demotes it if needed
+	ApplyTier(NewUnit, 0);
+}
+
+void UUnitSignificanceSubsystem::UnregisterUnit(AActor* Unit)
+{
+	int32 Index = INDEX_NONE;
+	if (!UnitIndices.RemoveAndCopyValue(Unit, Index))
+	{
+		return;
+	}
+
+	// Leave the actor as it would be without throttling, e.g. for the pawn pool
+	RestoreSettings(Units[Index]);
+
+	Units.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (Units.IsValidIndex(Index))
+	{
+		UnitIndices.Add(Units[Index].Actor, Index);
+	}
+}
+
+int32 UUnitSignificanceSubsystem::GetUnitTier(const AActor* Unit) const
+{
+	const int32* Index = UnitIndices.Find(Unit);
+	return Index ? Units[*Index].Tier : INDEX_NONE;
+}
+
+bool UUnitSignificanceSubsystem::GetViewLocation(FVector& OutLocation) const
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!PlayerController || !PlayerController->IsLocalController())
+	{
+		return false;
+	}
+
+	if (const ANecromancerCharacter* Character = Cast<ANecromancerCharacter>(PlayerController->GetPawn()))
+	{
+		OutLocation = Character->GetTopDownCameraComponent()->GetComponentLocation();
+		return true;
+	}
+	if (PlayerController->PlayerCameraManager)
+	{
+		OutLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+		return true;
+	}
+	return false;
+}
+
+int32 UUnitSignificanceSubsystem::ComputeTier(const AActor& Unit, const FVector& ViewLocation) const
+{
+	const APawn* Pawn = Cast<APawn>(&Unit);
+	if (Pawn && Pawn->IsLocallyControlled())
+	{
+		return 0;
+	}
+
+	float Distance = FVector::Dist(Unit.GetActorLocation(), ViewLocation);
+	if (!Unit.WasRecentlyRendered(UnitSignificance::RenderTimeTolerance))
+	{
+		Distance *= OffscreenDistanceScale;
+	}
+
+	const int32 LastTier = Tiers.Num() - 1;
+	for (int32 TierIndex = 0; TierIndex < LastTier; ++TierIndex)
+	{
+		if (Distance < Tiers[TierIndex].MaxDistance)
+		{
+			return TierIndex;
+		}
+	}
+	return LastTier;
+}
+
+void UUnitSignificanceSubsystem::ApplyTier(FUnit& Unit, int32 NewTier)
+{
+	AActor* Actor = Unit.Actor.Get();
+	if (!Actor || Unit.Tier == NewTier || !Tiers.IsValidIndex(NewTier))
+	{
+		return;
+	}
+
+	const FUnitSignificanceTier& Tier = Tiers[NewTier];
+	Unit.Tier = NewTier;
+	Unit.NumTickFunctions = 0;
+
+	// Actors without per-frame work are not ticking at all and are left that way
+	if (Actor->PrimaryActorTick.bCanEverTick)
+	{
+		Actor->SetActorTickInterval(Tier.TickInterval);
+		++Unit.NumTickFunctions;
+	}
+
+	for (const FComponentSettings& Settings : Unit.Components)
+	{
+		UActorComponent* Component = Settings.Component.Get();
+		if (!Component)
+		{
+			continue;
+		}
+
+		Component->SetComponentTickInterval(Tier.TickInterval);
+		++Unit.NumTickFunctions;
+
+		if (USkinnedMeshComponent* Mesh = Cast<USkinnedMeshComponent>(Component))
+		{
+			Mesh->VisibilityBasedAnimTickOption = Tier.AnimTickOption;
+		}
+		else if (UCharacterMovementComponent* Movement = Cast<UCharacterMovementComponent>(Component))
+		{
+			Movement->MaxSimulationIterations = Tier.MovementMaxSimulationIterations;
+		}
+	}
+}
+
+void UUnitSignificanceSubsystem::RestoreSettings(const FUnit& Unit) const
+{
+	AActor* Actor = Unit.Actor.Get();
+	if (!Actor)
+	{
+		return;
+	}
+
+	if (Actor->PrimaryActorTick.bCanEverTick)
+	{
+		Actor->SetActorTickInterval(Unit.ActorTickInterval);
+	}
+
+	for (const FComponentSettings& Settings : Unit.Components)
+	{
+		UActorComponent* Component = Settings.Component.Get();
+		if (!Component)
+		{
+			continue;
+		}
+
+		Component->SetComponentTickInterval(Settings.TickInterval);
+		if (USkinnedMeshComponent* Mesh = Cast<USkinnedMeshComponent>(Component))
+		{
+			Mesh->VisibilityBasedAnimTickOption = Settings.AnimTickOption;
+		}
+		else if (UCharacterMovementComponent* Movement = Cast<UCharacterMovementComponent>(Component))
+		{
+			Movement->MaxSimulationIterations = Settings.MaxSimulationIterations;
+		}
+	}
+}
+
+void UUnitSignificanceSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeUntilUpdate -= DeltaTime;
+	if (TimeUntilUpdate <= 0.f && Tiers.Num() > 0)
+	{
+		NECRO_SCOPE(STAT_SignificanceUpdate, Units);
+		TimeUntilUpdate = UpdateInterval;
+
+		FVector ViewLocation;
+		if (GetViewLocation(ViewLocation))
+		{
+			for (int32 Index = Units.Num() - 1; Index >= 0; --Index)
+			{
+				FUnit& Unit = Units[Index];
+				if (const AActor* Actor = Unit.Actor.Get())
+				{
+					ApplyTier(Unit, ComputeTier(*Actor, ViewLocation));
+				}
+				else
+				{
+					UnitIndices.Remove(Unit.Actor);
+					Units.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+					if (Units.IsValidIndex(Index))
+					{
+						UnitIndices.Add(Units[Index].Actor, Index);
+					}
+				}
+			}
+		}
+	}
+
+	UpdateStats(DeltaTime);
+}
+
+void UUnitSignificanceSubsystem::UpdateStats(float DeltaTime) const
+{
+#if STATS
+	int32 TierCounts[4] = {};
+	float TicksSaved = 0.f;
+	for (const FUnit& Unit : Units)
+	{
+		if (!Tiers.IsValidIndex(Unit.Tier))
+		{
+			continue;
+		}
+
+		++TierCounts[FMath::Min(Unit.Tier, 3)];
+
+		// A tick function with an interval runs about DeltaTime / Interval times per frame
+		const float TickInterval = Tiers[Unit.Tier].TickInterval;
+		if (TickInterval > DeltaTime)
+		{
+			TicksSaved += Unit.NumTickFunctions * (1.f - DeltaTime / TickInterval);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SignificanceUnits, Units.Num());
+	SET_DWORD_STAT(STAT_SignificanceTier0, TierCounts[0]);
+	SET_DWORD_STAT(STAT_SignificanceTier1, TierCounts[1]);
+	SET_DWORD_STAT(STAT_SignificanceTier2, TierCounts[2]);
+	SET_DWORD_STAT(STAT_SignificanceTier3, TierCounts[3]);
+	SET_FLOAT_STAT(STAT_SignificanceTicksSaved, TicksSaved);
+#endif
+}
@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "UnitSignificanceSubsystem.generated.h"
+
+/** Update budget applied to every unit in one significance tier */
+USTRUCT()
+struct FUnitSignificanceTier
+{
+	GENERATED_BODY()
+
+	/** Units whose significance distance is below this fall in this tier. Ignored for the last tier. */
+	UPROPERTY(Config)
+	float MaxDistance = 0.f;
+
+	/** Tick interval of the actor and its ticking components, zero for every frame */
+	UPROPERTY(Config)
+	float TickInterval = 0.f;
+
+	/** Animation update policy of skeletal meshes */
+	UPROPERTY(Config)
+	EVisibilityBasedAnimTickOption AnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+
+	/** Substeps character movement may take per tick */
+	UPROPERTY(Config)
+	int32 MovementMaxSimulationIterations = 8;
+};
+
+/**
+ * Buckets units into LOD tiers by how far they are from the local top-down camera and whether they were on screen,
+ * and lowers their tick rate, animation updates and movement substeps accordingly.
+ * Off-screen units count as OffscreenDistanceScale times further away. Locally controlled pawns always use tier 0.
+ * The settings a unit had when it was registered are restored when it is unregistered.
+ * Tier counts and the estimated ticks saved are shown by "stat Necromancer".
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UUnitSignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UUnitSignificanceSubsystem();
+
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterUnit(AActor* Unit);
+	void UnregisterUnit(AActor* Unit);
+
+	/** Tier Unit was last placed in, or INDEX_NONE if it is not registered */
+	int32 GetUnitTier(const AActor* Unit) const;
+
+	/** Ordered from most to least significant */
+	UPROPERTY(Config)
+	TArray<FUnitSignificanceTier> Tiers;
+
+	UPROPERTY(Config)
+	float OffscreenDistanceScale = 3.f;
+
+	/** Seconds between significance updates */
+	UPROPERTY(Config)
+	float UpdateInterval = 0.25f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	/** Settings of a ticking component before the first tier was applied */
+	struct FComponentSettings
+	{
+		TWeakObjectPtr<UActorComponent> Component;
+		float TickInterval = 0.f;
+		EVisibilityBasedAnimTickOption AnimTickOption = EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones;
+		int32 MaxSimulationIterations = 0;
+	};
+
+	struct FUnit
+	{
+		TWeakObjectPtr<AActor> Actor;
+		int32 Tier = INDEX_NONE;
+
+		/** Ticking functions throttled by the tier, for the savings estimate */
+		int32 NumTickFunctions = 0;
+
+		/** What RegisterUnit found, put back by UnregisterUnit */
+		float ActorTickInterval = 0.f;
+		TArray<FComponentSettings, TInlineAllocator<4>> Components;
+	};
+
+	bool GetViewLocation(FVector& OutLocation) const;
+	int32 ComputeTier(const AActor& Unit, const FVector& ViewLocation) const;
+	void ApplyTier(FUnit& Unit, int32 NewTier);
+	void RestoreSettings(const FUnit& Unit) const;
+	void UpdateStats(float DeltaTime) const;
+
+	TArray<FUnit> Units;
+	TMap<TWeakObjectPtr<AActor>, int32> UnitIndices;
+	float TimeUntilUpdate = 0.f;
+};
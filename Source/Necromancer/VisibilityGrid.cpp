@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VisibilityGrid.h"
+
+void FVisibilityGrid::Init(const FVector2D& InOrigin, float InCellSize, const FIntPoint& InSize, int32 RadiusCells)
+{
+	Origin = InOrigin;
+	CellSize = InCellSize;
+	Size = InSize;
+	WordsPerRow = FMath::DivideAndRoundUp(Size.X, 64);
+	Radius = FMath::Clamp(RadiusCells, 1, MaxRadiusCells);
+
+	Occluders.Init(0, WordsPerRow * Size.Y);
+	for (TArray<uint64>& Visibility : TeamVisibility)
+	{
+		Visibility.Init(0, WordsPerRow * Size.Y);
+	}
+
+	// One ray from the center to every cell on the border of the window, traced with Bresenham's line
+	const int32 Width = 2 * Radius + 1;
+	TArray<FRayMask> WindowRays;
+	WindowRays.SetNum(Width * Width);
+	int32 RayIndex = 0;
+	auto TraceRay = [&](int32 EndX, int32 EndY)
+	{
+		const uint64 Bit = 1ull << (RayIndex & 63);
+		const bool bHigh = RayIndex >= 64;
+		++RayIndex;
+
+		const int32 DeltaX = FMath::Abs(EndX);
+		const int32 DeltaY = -FMath::Abs(EndY);
+		const int32 StepX = EndX > 0 ? 1 : -1;
+		const int32 StepY = EndY > 0 ? 1 : -1;
+		int32 Error = DeltaX + DeltaY;
+		int32 X = 0;
+		int32 Y = 0;
+		while (true)
+		{
+			FRayMask& Rays = WindowRays[(Y + Radius) * Width + X + Radius];
+			(bHigh ? Rays.High : Rays.Low) |= Bit;
+			if (X == EndX && Y == EndY)
+			{
+				break;
+			}
+			const int32 Error2 = 2 * Error;
+			if (Error2 >= DeltaY)
+			{
+				Error += DeltaY;
+				X += StepX;
+			}
+			if (Error2 <= DeltaX)
+			{
+				Error += DeltaX;
+				Y += StepY;
+			}
+		}
+	};
+	for (int32 Offset = -Radius; Offset < Radius; ++Offset)
+	{
+		TraceRay(Offset, -Radius);
+		TraceRay(Radius, Offset);
+		TraceRay(-Offset, Radius);
+		TraceRay(-Radius, -Offset);
+	}
+
+	// Round vision: the window corners are dropped
+	StampCells.Reset();
+	const int32 RadiusSq = Radius * Radius + Radius;
+	for (int32 Y = -Radius; Y <= Radius; ++Y)
+	{
+		for (int32 X = -Radius; X <= Radius; ++X)
+		{
+			if (X * X + Y * Y <= RadiusSq)
+			{
+				StampCells.Add({ static_cast<int8>(X), static_cast<int8>(Y), WindowRays[(Y + Radius) * Width + X + Radius] });
+			}
+		}
+	}
+	StampCells.StableSort([](const FStampCell& A, const FStampCell& B)
+	{
+		return A.X * A.X + A.Y * A.Y < B.X * B.X + B.Y * B.Y;
+	});
+}
+
+void FVisibilityGrid::SetOccluder(const FIntPoint& Cell, bool bOccludes)
+{
+	if (!IsValidCell(Cell))
+	{
+		return;
+	}
+
+	uint64& Word = Occluders[Cell.Y * WordsPerRow + (Cell.X >> 6)];
+	const uint64 Bit = 1ull << (Cell.X & 63);
+	Word = bOccludes ? Word | Bit : Word & ~Bit;
+}
+
+void FVisibilityGrid::ComputeStamp(const FIntPoint& Cell, uint64* OutRows) const
+{
+	FMemory::Memzero(OutRows, StampRows() * sizeof(uint64));
+
+	// The center is always seen and never blocks, even if the unit stands inside an occluder cell
+	FRayMask Blocked;
+	for (int32 Index = 0; Index < StampCells.Num(); ++Index)
+	{
+		const FStampCell& StampCell = StampCells[Index];
+		const FIntPoint WorldCell(Cell.X + StampCell.X, Cell.Y + StampCell.Y);
+		if (!IsValidCell(WorldCell))
+		{
+			Blocked |= StampCell.Rays;
+			continue;
+		}
+		if (!StampCell.Rays.IsOpen(Blocked))
+		{
+			continue;
+		}
+
+		OutRows[StampCell.Y + Radius] |= 1ull << (StampCell.X + Radius);
+		if (Index > 0 && IsOccluder(WorldCell))
+		{
+			Blocked |= StampCell.Rays;
+		}
+	}
+}
+
+void FVisibilityGrid::ClearTeam(ECombatTeam Team)
+{
+	TArray<uint64>& Visibility = TeamVisibility[static_cast<uint8>(Team)];
+	FMemory::Memzero(Visibility.GetData(), Visibility.Num() * sizeof(uint64));
+}
+
+void FVisibilityGrid::AddStamp(ECombatTeam Team, const FIntPoint& Cell, const uint64* Rows)
+{
+	TArray<uint64>& Visibility = TeamVisibility[static_cast<uint8>(Team)];
+
+	// A window entirely off the grid has nothing to add, and would shift or index past the rows
+	const int32 Left = Cell.X - Radius;
+	const int32 FirstRow = FMath::Max(Cell.Y - Radius, 0);
+	const int32 LastRow = FMath::Min(Cell.Y + Radius, Size.Y - 1);
+	if (Left >= Size.X || Cell.X + Radius < 0 || FirstRow > LastRow)
+	{
+		return;
+	}
+
+	// Cells outside the grid are never set in a stamp, so a negative left edge only needs the row shifted down
+	const int32 Word = FMath::Max(Left, 0) >> 6;
+	const int32 Shift = FMath::Max(Left, 0) & 63;
+	const int32 RightShift = FMath::Max(-Left, 0);
+	for (int32 Y = FirstRow; Y <= LastRow; ++Y)
+	{
+		const uint64 Bits = Rows[Y - Cell.Y + Radius] >> RightShift;
+		uint64* RowWords = Visibility.GetData() + Y * WordsPerRow;
+		RowWords[Word] |= Bits << Shift;
+		if (Shift > 0 && Word + 1 < WordsPerRow)
+		{
+			RowWords[Word + 1] |= Bits >> (64 - Shift);
+		}
+	}
+}
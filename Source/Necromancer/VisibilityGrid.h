@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CombatTypes.h"
+
+/**
+ * Line of sight on a 2D grid of cells, kept as bitsets.
+ *
+ * Occluders are one bit per cell. What a unit sees from its cell is a stamp: a square window of 2R + 1 rows,
+ * one 64-bit word per row. Stamps are shadow cast with the rays as bit lanes: every cell of the window knows
+ * which of the 8R rays from the center cross it, cells are visited nearest first, a cell is visible while any
+ * of its rays is still open, and an occluder closes all of its rays with one OR. A team's visibility is the OR
+ * of its units' stamps, written into a row-major bitset word by word, so "is this cell visible" is one bit test.
+ */
+class NECROMANCER_API FVisibilityGrid
+{
+public:
+	/** Largest vision radius in cells: 8R rays must fit the 128 bit ray mask */
+	static constexpr int32 MaxRadiusCells = 16;
+
+	static constexpr int32 NumTeams = 3;
+
+	/** Sizes the grid, clears every bit and builds the ray tables for RadiusCells */
+	void Init(const FVector2D& InOrigin, float InCellSize, const FIntPoint& InSize, int32 RadiusCells);
+
+	bool IsInitialized() const { return WordsPerRow > 0; }
+
+	FIntPoint ToCell(const FVector& Location) const
+	{
+		return FIntPoint(FMath::FloorToInt32((Location.X - Origin.X) / CellSize), FMath::FloorToInt32((Location.Y - Origin.Y) / CellSize));
+	}
+
+	bool IsValidCell(const FIntPoint& Cell) const { return Cell.X >= 0 && Cell.Y >= 0 && Cell.X < Size.X && Cell.Y < Size.Y; }
+	FVector2D GetCellCenter(const FIntPoint& Cell) const { return Origin + (FVector2D(Cell) + 0.5) * CellSize; }
+	const FIntPoint& GetSize() const { return Size; }
+
+	void SetOccluder(const FIntPoint& Cell, bool bOccludes);
+	bool IsOccluder(const FIntPoint& Cell) const { return TestBit(Occluders, Cell); }
+
+	/** Words per stamp; a stamp is written to StampRows() consecutive words */
+	int32 StampRows() const { return 2 * Radius + 1; }
+
+	/** Shadow casts the view from Cell into OutRows. Bit i of row j is the cell (Cell.X - R + i, Cell.Y - R + j). */
+	void ComputeStamp(const FIntPoint& Cell, uint64* OutRows) const;
+
+	void ClearTeam(ECombatTeam Team);
+
+	/** Marks the cells of a stamp computed from Cell as visible to Team */
+	void AddStamp(ECombatTeam Team, const FIntPoint& Cell, const uint64* Rows);
+
+	bool IsVisible(ECombatTeam Team, const FIntPoint& Cell) const { return TestBit(TeamVisibility[static_cast<uint8>(Team)], Cell); }
+	bool IsVisible(ECombatTeam Team, const FVector& Location) const { return IsVisible(Team, ToCell(Location)); }
+
+private:
+	struct FRayMask
+	{
+		uint64 Low = 0;
+		uint64 High = 0;
+
+		FRayMask& operator|=(const FRayMask& Other) { Low |= Other.Low; High |= Other.High; return *this; }
+		bool IsOpen(const FRayMask& Blocked) const { return ((Low & ~Blocked.Low) | (High & ~Blocked.High)) != 0; }
+	};
+
+	/** A cell of the stamp window, relative to its center, and the rays crossing it */
+	struct FStampCell
+	{
+		int8 X;
+		int8 Y;
+		FRayMask Rays;
+	};
+
+	bool TestBit(const TArray<uint64>& Bits, const FIntPoint& Cell) const
+	{
+		return IsValidCell(Cell) && (Bits[Cell.Y * WordsPerRow + (Cell.X >> 6)] >> (Cell.X & 63)) & 1;
+	}
+
+	FVector2D Origin = FVector2D::ZeroVector;
+	float CellSize = 100.f;
+	FIntPoint Size = FIntPoint::ZeroValue;
+	int32 WordsPerRow = 0;
+	int32 Radius = 0;
+
+	/** Row-major bitsets, WordsPerRow words per row */
+	TArray<uint64> Occluders;
+	TArray<uint64> TeamVisibility[NumTeams];
+
+	/** Window cells within the radius, nearest first */
+	TArray<FStampCell> StampCells;
+};
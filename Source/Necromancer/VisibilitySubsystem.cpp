@@ -0,0 +1,266 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VisibilitySubsystem.h"
+#include "CombatSubsystem.h"
+#include "NecromancerStats.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+
+DECLARE_CYCLE_STAT(TEXT("Visibility Update"), STAT_VisibilityUpdate, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Visibility Sources"), STAT_VisibilitySources, STATGROUP_Necromancer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Visibility Stamps Cast"), STAT_VisibilityStampsCast, STATGROUP_Necromancer);
+
+namespace VisibilitySystem
+{
+	// Stamps shadow cast by one parallel task
+	constexpr int32 StampTaskSize = 32;
+}
+
+void UVisibilitySubsystem::Deinitialize()
+{
+	SourceCombatant.Empty();
+	SourceTeam.Empty();
+	SourceCell.Empty();
+	SourceLastSeen.Empty();
+	Stamps.Empty();
+	CombatantToSource.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UVisibilitySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UVisibilitySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVisibilitySubsystem, STATGROUP_Tickables);
+}
+
+UCombatSubsystem* UVisibilitySubsystem::GetCombatSubsystem() const
+{
+	return GetWorld()->GetSubsystem<UCombatSubsystem>();
+}
+
+void UVisibilitySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	BakeOccluders();
+}
+
+void UVisibilitySubsystem::BakeOccluders()
+{
+	const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	const FBox Bounds = NavSys ? NavSys->GetNavigableWorldBounds() : FBox(ForceInit);
+	if (!Bounds.IsValid)
+	{
+		return;
+	}
+
+	const FVector2D BoundsSize(Bounds.GetSize());
+	float GridCellSize = CellSize;
+	while ((FMath::CeilToInt32(BoundsSize.X / GridCellSize) * FMath::CeilToInt32(BoundsSize.Y / GridCellSize)) > MaxCells)
+	{
+		GridCellSize *= 2.f;
+	}
+
+	const int32 RadiusCells = FMath::CeilToInt32(VisionRadius / GridCellSize);
+	if (RadiusCells > FVisibilityGrid::MaxRadiusCells)
+	{
+		UE_LOG(LogNecromancer, Warning, TEXT("Vision radius %.0f is %d cells; clamped to %d"), VisionRadius, RadiusCells, FVisibilityGrid::MaxRadiusCells);
+	}
+
+	const FIntPoint GridSize(FMath::Max(FMath::CeilToInt32(BoundsSize.X / GridCellSize), 1), FMath::Max(FMath::CeilToInt32(BoundsSize.Y / GridCellSize), 1));
+	Grid.Init(FVector2D(Bounds.Min), GridCellSize, GridSize, RadiusCells);
+
+	// A wall is static geometry that blocks a box at eye height above the navigable floor of its cell. Cells off the
+	// navmesh, usually the walls themselves, take the floor of the last walkable cell before them.
+	const ANavigationData* NavData = NavSys->GetDefaultNavDataInstance();
+	const FVector FloorExtent(GridCellSize * 0.5f, GridCellSize * 0.5f, Bounds.GetSize().Z + GridCellSize);
+	const FCollisionShape Probe = FCollisionShape::MakeBox(FVector(GridCellSize * 0.4f, GridCellSize * 0.4f, 10.f));
+	const FCollisionObjectQueryParams StaticObjects(ECC_WorldStatic);
+	float RowStartFloorZ = Bounds.Min.Z;
+	int32 NumOccluders = 0;
+	for (int32 Y = 0; Y < GridSize.Y; ++Y)
+	{
+		float FloorZ = RowStartFloorZ;
+		for (int32 X = 0; X < GridSize.X; ++X)
+		{
+			const FIntPoint Cell(X, Y);
+			const FVector2D Center = Grid.GetCellCenter(Cell);
+			FNavLocation Floor;
+			if (NavData && NavData->ProjectPoint(FVector(Center.X, Center.Y, Bounds.GetCenter().Z), Floor, FloorExtent))
+			{
+				FloorZ = Floor.Location.Z;
+			}
+			if (X == 0)
+			{
+				RowStartFloorZ = FloorZ;
+			}
+
+			if (GetWorld()->OverlapAnyTestByObjectType(FVector(Center.X, Center.Y, FloorZ + EyeHeight), FQuat::Identity, StaticObjects, Probe))
+			{
+				Grid.SetOccluder(Cell, true);
+				++NumOccluders;
+			}
+		}
+	}
+	NECRO_COUNT(Traces, GridSize.X * GridSize.Y);
+	UE_LOG(LogNecromancer, Log, TEXT("Visibility grid %dx%d at %.0f cm: %d occluder cells"), GridSize.X, GridSize.Y, GridCellSize, NumOccluders);
+
+	// Every stamp was cast against the old grid
+	SourceCombatant.Reset();
+	SourceTeam.Reset();
+	SourceCell.Reset();
+	SourceLastSeen.Reset();
+	Stamps.Reset();
+	CombatantToSource.Reset();
+	TimeUntilUpdate = 0.f;
+}
+
+void UVisibilitySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeUntilUpdate -= DeltaTime;
+	if (TimeUntilUpdate <= 0.f && Grid.IsInitialized())
+	{
+		TimeUntilUpdate = UpdateInterval;
+		UpdateVision();
+	}
+}
+
+bool UVisibilitySubsystem::IsCombatantVisibleToTeam(ECombatTeam Team, FCombatHandle Handle) const
+{
+	const UCombatSubsystem* Combat = GetCombatSubsystem();
+	return Combat && Combat->GetSimulation().IsValid(Handle) && IsVisibleToTeam(Team, Combat->GetSimulation().GetLocation(Handle));
+}
+
+void UVisibilitySubsystem::RemoveSource(int32 Index)
+{
+	const int32 Rows = Grid.StampRows();
+	const int32 Last = SourceCombatant.Num() - 1;
+	CombatantToSource.Remove(SourceCombatant[Index]);
+	if (Index != Last)
+	{
+		FMemory::Memcpy(&Stamps[Index * Rows], &Stamps[Last * Rows], Rows * sizeof(uint64));
+	}
+	Stamps.SetNum(Last * Rows, EAllowShrinking::No);
+
+	SourceCombatant.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	SourceTeam.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	SourceCell.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	SourceLastSeen.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	if (SourceCombatant.IsValidIndex(Index))
+	{
+		CombatantToSource[SourceCombatant[Index]] = Index;
+	}
+}
+
+void UVisibilitySubsystem::UpdateVision()
+{
+	NECRO_SCOPE(STAT_VisibilityUpdate, Visibility);
+
+	const UCombatSubsystem* Combat = GetCombatSubsystem();
+	if (!Combat)
+	{
+		return;
+	}
+
+	LiveHandles.Reset();
+	LiveTeams.Reset();
+	LiveLocations.Reset();
+	Combat->GetSimulation().GatherLive(LiveHandles, LiveTeams, LiveLocations);
+
+	// Find the sources that are new, moved to another cell or changed side
+	const int32 Rows = Grid.StampRows();
+	bool bTeamDirty[FVisibilityGrid::NumTeams] = {};
+	++UpdateSerial;
+	MovedCombatants.Reset();
+	for (int32 LiveIndex = 0; LiveIndex < LiveHandles.Num(); ++LiveIndex)
+	{
+		const FCombatHandle Handle = LiveHandles[LiveIndex];
+		const FIntPoint Cell = Grid.ToCell(LiveLocations[LiveIndex]);
+		const ECombatTeam Team = LiveTeams[LiveIndex];
+
+		int32 Source;
+		if (const int32* Found = CombatantToSource.Find(Handle))
+		{
+			Source = *Found;
+			if (SourceCell[Source] != Cell || SourceTeam[Source] != Team)
+			{
+				bTeamDirty[static_cast<uint8>(SourceTeam[Source])] = true;
+				bTeamDirty[static_cast<uint8>(Team)] = true;
+				MovedCombatants.Add(Handle);
+			}
+		}
+		else
+		{
+			Source = SourceCombatant.Add(Handle);
+			SourceTeam.AddDefaulted();
+			SourceCell.AddDefaulted();
+			SourceLastSeen.AddDefaulted();
+			Stamps.AddUninitialized(Rows);
+			CombatantToSource.Add(Handle, Source);
+			bTeamDirty[static_cast<uint8>(Team)] = true;
+			MovedCombatants.Add(Handle);
+		}
+
+		SourceCell[Source] = Cell;
+		SourceTeam[Source] = Team;
+		SourceLastSeen[Source] = UpdateSerial;
+	}
+
+	// Sources of dead or removed combatants
+	for (int32 Source = SourceCombatant.Num() - 1; Source >= 0; --Source)
+	{
+		if (SourceLastSeen[Source] != UpdateSerial)
+		{
+			bTeamDirty[static_cast<uint8>(SourceTeam[Source])] = true;
+			RemoveSource(Source);
+		}
+	}
+
+	// Removal swapped sources around, so moved ones are resolved only now
+	MovedSources.Reset();
+	for (const FCombatHandle& Handle : MovedCombatants)
+	{
+		MovedSources.Add(CombatantToSource[Handle]);
+	}
+
+	// Shadow cast only what moved
+	ParallelFor(FMath::DivideAndRoundUp(MovedSources.Num(), VisibilitySystem::StampTaskSize), [this, Rows](int32 TaskIndex)
+	{
+		const int32 Start = TaskIndex * VisibilitySystem::StampTaskSize;
+		const int32 End = FMath::Min(Start + VisibilitySystem::StampTaskSize, MovedSources.Num());
+		for (int32 Index = Start; Index < End; ++Index)
+		{
+			const int32 Source = MovedSources[Index];
+			Grid.ComputeStamp(SourceCell[Source], &Stamps[Source * Rows]);
+		}
+	});
+
+	for (uint8 Team = 0; Team < FVisibilityGrid::NumTeams; ++Team)
+	{
+		if (bTeamDirty[Team])
+		{
+			Grid.ClearTeam(static_cast<ECombatTeam>(Team));
+		}
+	}
+	for (int32 Source = 0; Source < SourceCombatant.Num(); ++Source)
+	{
+		if (bTeamDirty[static_cast<uint8>(SourceTeam[Source])])
+		{
+			Grid.AddStamp(SourceTeam[Source], SourceCell[Source], &Stamps[Source * Rows]);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_VisibilitySources, SourceCombatant.Num());
+	SET_DWORD_STAT(STAT_VisibilityStampsCast, MovedSources.Num());
+}
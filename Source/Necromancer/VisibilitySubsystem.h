@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatTypes.h"
+#include "VisibilityGrid.h"
+#include "VisibilitySubsystem.generated.h"
+
+class UCombatSubsystem;
+
+/**
+ * Fog of war for every team. Occluders are baked once from the level's static geometry over the navigable area;
+ * every live combatant then sees VisionRadius around it through an FVisibilityGrid stamp.
+ * A stamp is only shadow cast again when its combatant crosses into another cell, and a team's visibility is only
+ * rebuilt when one of its stamps changed, so a standing army costs nothing. Queries are a single bit test.
+ */
+UCLASS(Config = Game)
+class NECROMANCER_API UVisibilitySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** True if Location is seen by a member of Team. Everything counts as visible until the grid is baked. */
+	bool IsVisibleToTeam(ECombatTeam Team, const FVector& Location) const
+	{
+		return !Grid.IsInitialized() || Grid.IsVisible(Team, Location);
+	}
+
+	/** True if a member of Team sees the combatant. Safe to call from worker threads between game thread updates. */
+	bool IsCombatantVisibleToTeam(ECombatTeam Team, FCombatHandle Handle) const;
+
+	const FVisibilityGrid& GetGrid() const { return Grid; }
+
+	/** Probes the level into a new occluder grid and recomputes every stamp */
+	void BakeOccluders();
+
+	/** Edge length of a grid cell */
+	UPROPERTY(Config)
+	float CellSize = 100.f;
+
+	/** The cell size grows until the grid fits in this many cells */
+	UPROPERTY(Config)
+	int32 MaxCells = 512 * 512;
+
+	/** How far a combatant sees. Limited to FVisibilityGrid::MaxRadiusCells cells. */
+	UPROPERTY(Config)
+	float VisionRadius = 1500.f;
+
+	/** Height above the navigable floor of each cell of the probe that finds walls */
+	UPROPERTY(Config)
+	float EyeHeight = 100.f;
+
+	/** Seconds between vision updates */
+	UPROPERTY(Config)
+	float UpdateInterval = 0.1f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void UpdateVision();
+	void RemoveSource(int32 Index);
+
+	UCombatSubsystem* GetCombatSubsystem() const;
+
+	FVisibilityGrid Grid;
+
+	/** Vision sources, one per live combatant; Stamps holds Grid.StampRows() words per source */
+	TArray<FCombatHandle> SourceCombatant;
+	TArray<ECombatTeam> SourceTeam;
+	TArray<FIntPoint> SourceCell;
+	TArray<uint32> SourceLastSeen;
+	TArray<uint64> Stamps;
+	TMap<FCombatHandle, int32> CombatantToSource;
+	uint32 UpdateSerial = 0;
+
+	/** Scratch for UpdateVision */
+	TArray<FCombatHandle> LiveHandles;
+	TArray<ECombatTeam> LiveTeams;
+	TArray<FVector> LiveLocations;
+	TArray<FCombatHandle> MovedCombatants;
+	TArray<int32> MovedSources;
+
+	float TimeUntilUpdate = 0.f;
+};